@@ -6,8 +6,21 @@ layout(constant_id = 0) const uint NUM_SAMPLES = 15;
 layout(constant_id = 1) const float DELTA = 0.001;
 layout(constant_id = 2) const float RANGE = 10.0;
 
-layout(binding = 0) uniform sampler2D inGBuffPosition;
-layout(binding = 1) uniform sampler2D inGBuffNormal;
+#include "inc/gbuffer.glsl"
+
+layout(binding = 0) uniform sampler2D inGBuff0;
+layout(binding = 1) uniform sampler2D inGBuff1;
+layout(binding = 2) uniform sampler2D inGBuffDepth;
+
+layout(binding = 3) uniform CameraUBO {
+  mat4 view;
+  mat4 proj;
+  vec3 eye;
+  vec3 viewDir;
+  float farDist;
+  float nearDist;
+  mat4 invViewProj;
+} cam;
 
 layout(location = 0) in vec2 inUV;
 layout(location = 0) out vec4 fragColor;
@@ -21,11 +34,8 @@ float HeavisideStep(float value) {
 }
 
 void main() {
-    vec4 sampledPosition = texture(inGBuffPosition, inUV);
-    vec4 sampledNormal = texture(inGBuffNormal, inUV);
-    
-    vec3 P = sampledPosition.xyz;
-    vec3 N = normalize(sampledNormal.xyz);
+    vec3 P = readGBufferPosition(inGBuff0, inGBuffDepth, inUV, cam.invViewProj);
+    vec3 N = readGBufferNormal(inGBuff1, inUV);
 
     // S = 2 * pi * c
     float c = 0.1 * RANGE;
@@ -41,7 +51,7 @@ void main() {
         float h = alpha * RANGE / d;
         float theta = 2 * PI * alpha * (7.0 * NUM_SAMPLES / 9.0) + phi;
 
-        vec3 point = texture(inGBuffPosition, inUV + h * cos(theta) * sin(theta)).xyz;
+        vec3 point = readGBufferPosition(inGBuff0, inGBuffDepth, inUV + h * cos(theta) * sin(theta), cam.invViewProj);
 
         vec3 w = point - P;
 
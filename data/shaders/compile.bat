@@ -1,6 +1,8 @@
 @echo off
 Setlocal EnableDelayedExpansion
 
+IF NOT EXIST spv MKDIR spv
+
 FOR %%f IN (*.*) DO (
   SET fext=%%~xf
   SET fname=%%~nf
@@ -15,6 +15,9 @@ layout(constant_id = 7) const float FXAA_SEARCH_THRESHOLD   = 1.0 / 4.0;
 
 layout(binding = 0) uniform sampler2D image;
 
+// the same image at this pixel, without going through the sampler
+layout(input_attachment_index = 0, binding = 1) uniform subpassInput centerImage;
+
 layout(location = 0) in vec2 inUV;
 layout(location = 0) out vec4 fragColor;
 
@@ -45,7 +48,7 @@ void main() {
     vec3 rgbS = texture(image, southLoad).xyz;//loadedData[S.x][S.y].xyz;
     vec3 rgbE = texture(image, eastLoad).xyz;//loadedData[E.x][E.y].xyz;
     vec3 rgbW = texture(image, westLoad).xyz;//loadedData[W.x][W.y].xyz;
-    vec3 rgbC = texture(image, centerLoad).xyz;//loadedData[C.x][C.y].xyz;
+    vec3 rgbC = subpassLoad(centerImage).xyz;//loadedData[C.x][C.y].xyz;
 
     // FXAA STEP 1: LUMINANCE CONVERSION & LOCAL CONTRAST CHECK
     float lumaN = fxaaLuma(rgbN);
@@ -0,0 +1,6 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+#define BINDLESS_TEXTURES
+#include "inc/gbuffer_filler.glsl"
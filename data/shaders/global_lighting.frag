@@ -3,6 +3,8 @@
 
 #include "inc/defines.glsl"
 #include "inc/lighting.glsl"
+#include "inc/gbuffer.glsl"
+#include "inc/moments.glsl"
 
 // should be an even number
 layout(constant_id = 0) const int MAX_IMPORTANCE_SAMPLES = 32;
@@ -14,10 +16,11 @@ layout(binding = 0) uniform CameraUBO {
   vec3 viewDir;
   float farDist;
   float nearDist;
+  mat4 invViewProj;
 } cam;
 
 layout(binding = 1) uniform ShadowLights {
-  ShadowLight at[MAX_GLOBAL_LIGHTS];
+  ShadowLight at[MAX_SHADOW_MAPS];
   uint count;
 } lights;
 
@@ -28,13 +31,18 @@ layout(binding = 2) uniform ImportanceSampling {
 // shader control
 layout(binding = 3) SHADER_CONTROL_UNIFORM control;
 
-layout(binding = 4) uniform sampler2D inGBuffPosition;
-layout(binding = 5) uniform sampler2D inGBuffNormal;
-layout(binding = 6) uniform sampler2D inGBuffColor;
-layout(binding = 7) uniform sampler2D inBackground;
-layout(binding = 8) uniform sampler2D inIrradiance;
+layout(binding = 4) uniform sampler2D inGBuff0;
+layout(binding = 5) uniform sampler2D inGBuff1;
+layout(binding = 6) uniform sampler2D inGBuff2;
+layout(binding = 7) uniform sampler2D inGBuffDepth;
+layout(binding = 8) uniform sampler2D inBackground;
+layout(binding = 9) uniform sampler2D inIrradiance;
 
-layout(binding = 9) uniform sampler2D shadowMap[MAX_GLOBAL_LIGHTS];
+// every light's shadow map is a tile of this; ShadowLight.atlasRect says which
+layout(binding = 10) uniform sampler2D shadowAtlas;
+
+// its summed-area table, while the renderer filters with one (control.summedAreaShadows)
+layout(binding = 11) uniform usampler2D shadowSAT;
 
 layout(location = 0) in vec2 inUV;
 
@@ -62,6 +70,49 @@ vec3 getSampleDirection(float u, float v, float roughness, vec3 A, vec3 B, vec3
   return w;
 }
 
+// The sum of the texels [lo, hi] of the tile whose corner is tileMin. The table wraps around,
+// but the differences still come out right
+uvec4 boxSum(ivec2 tileMin, ivec2 lo, ivec2 hi) {
+  uvec4 sum = texelFetch(shadowSAT, hi, 0);
+
+  if(lo.x > tileMin.x)
+    sum -= texelFetch(shadowSAT, ivec2(lo.x - 1, hi.y), 0);
+  if(lo.y > tileMin.y)
+    sum -= texelFetch(shadowSAT, ivec2(hi.x, lo.y - 1), 0);
+  if(lo.x > tileMin.x && lo.y > tileMin.y)
+    sum += texelFetch(shadowSAT, lo - 1, 0);
+
+  return sum;
+}
+
+// The average of the (quantized) moments in a box of size x size texels centered on uv, clamped to
+// its tile. Like bilinear filtering, it blends the 4 whole-texel boxes around uv so the box slides
+// smoothly. Same cost at any size; past 255 the sums could overflow.
+vec4 boxFilterMoments(vec4 rect, vec2 uv, int size) {
+  size = clamp(size, 1, 255);
+
+  vec2 atlasSize = vec2(textureSize(shadowSAT, 0));
+  ivec2 tileMin = ivec2(rect.xy * atlasSize + 0.5);
+  ivec2 tileMax = tileMin + ivec2(rect.zw * atlasSize + 0.5) - 1;
+
+  vec2 corner = uv * atlasSize - 0.5 * size;
+  ivec2 base = ivec2(floor(corner));
+  vec2 f = corner - floor(corner);
+
+  vec4 average = vec4(0);
+  for(int j = 0; j < 4; ++j) {
+    ivec2 offset = ivec2(j & 1, j >> 1);
+    ivec2 lo = clamp(base + offset, tileMin, tileMax);
+    ivec2 hi = clamp(base + offset + size - 1, tileMin, tileMax);
+
+    vec2 texels = vec2(hi - lo + 1);
+    vec2 weight = mix(1 - f, f, vec2(offset));
+    average += (weight.x * weight.y / (texels.x * texels.y)) * vec4(boxSum(tileMin, lo, hi));
+  }
+
+  return average / 65535.0;
+}
+
 float getG(vec4 moments, float fragmentDepth) {
   // Code comes from the supplementary paper for Hamburger 4MSM.
   // Converted from HLSL to GLSL.
@@ -110,20 +161,17 @@ float getG(vec4 moments, float fragmentDepth) {
 }
 
 void main() {
-  vec4 sampledPos = texture(inGBuffPosition, inUV);
-  vec4 sampledColor = texture(inGBuffColor, inUV);
-  vec4 sampledNormal = texture(inGBuffNormal, inUV);
+  GBufferSample gbuff = readGBuffer(inGBuff0, inGBuff1, inGBuff2, inGBuffDepth, inUV, cam.invViewProj);
   
-  float isObject    = sampledPos.w;
-  float inRoughness = sampledColor.w;
-  float inMetallic  = sampledNormal.w;
-  vec3 inPos = sampledPos.xyz;
-  vec3 inColor = sampledColor.xyz;
+  float inRoughness = gbuff.roughness;
+  float inMetallic  = gbuff.metallic;
+  vec3 inPos = gbuff.pos;
+  vec3 inColor = gbuff.color;
   
   vec3 V = normalize(cam.eye - inPos);
 
-  if(int(isObject) == 1 && control.doGlobalLighting == 1) {
-    vec3 N = normalize(sampledNormal.xyz);
+  if(gbuff.isObject && control.doGlobalLighting == 1) {
+    vec3 N = gbuff.normal;
     vec3 R = 2 * max(dot(N, V), 0) * N - V;
 
     mat4 shadowBias = mat4( .5,  0,  0, 0,
@@ -131,22 +179,59 @@ void main() {
                             0,  0,  1, 0,
                             .5, .5,  0, 1);
     
+    // a directional light's cascades each cover a range of view depths; exactly one of them takes a pixel
+    float viewDepth = dot(inPos - cam.eye, cam.viewDir);
+
+    // filtering stops half a texel inside a tile so it never reads its neighbors
+    vec2 atlasTexel = 0.5 / vec2(textureSize(shadowAtlas, 0));
+
     vec3 color = vec3(0, 0, 0);
     for(int i = 0; i < lights.count; ++i) {
+      if(viewDepth < lights.at[i].splitNear || viewDepth >= lights.at[i].splitFar)
+        continue;
+
+      bool directional = lights.at[i].type == LIGHT_TYPE_DIRECTIONAL;
+
       vec4 shadowCoord =  shadowBias * lights.at[i].proj *  lights.at[i].view * vec4(inPos, 1.f);
       
       vec2 shadowIndex = shadowCoord.xy / shadowCoord.w;
+      bool inMap = shadowCoord.w > 0 && shadowIndex.x >= 0 && shadowIndex.y >= 0 && shadowIndex.x <= 1 && shadowIndex.y <= 1;
       
-      if(shadowCoord.w > 0 && shadowIndex.x >= 0 && shadowIndex.y >= 0 && shadowIndex.x <= 1 && shadowIndex.y <= 1) {
-        vec4 lightDepth = texture(shadowMap[i], shadowIndex);
-        float pixelDepth = shadowCoord.z;
-        pixelDepth = (pixelDepth - lights.at[i].nearDist) / (lights.at[i].farDist - lights.at[i].nearDist);
+      // directional lights reach everywhere; past their maps they're just unshadowed
+      if(inMap || directional) {
+        float G = 0;
+
+        // lights that didn't get a tile this frame go unshadowed
+        vec4 rect = lights.at[i].atlasRect;
+        if(inMap && rect.z > 0) {
+          vec2 atlasUV = clamp(rect.xy + shadowIndex * rect.zw, rect.xy + atlasTexel, rect.xy + rect.zw - atlasTexel);
+          float pixelDepth = shadowCoord.z;
+          pixelDepth = (pixelDepth - lights.at[i].nearDist) / (lights.at[i].farDist - lights.at[i].nearDist);
+
+          vec4 lightDepth;
+          if(control.summedAreaShadows == 1) {
+            // the radius is in texels of the biggest tile (half the atlas), so shrinking a light's
+            // tile doesn't sharpen its shadows
+            float radius = control.shadowFilterRadius * rect.z * 2;
+
+            // the widest box's average depth stands in for the blockers': the further behind them
+            // the pixel is, the wider the penumbra, and contact shadows stay hard
+            if(control.variablePenumbra == 1) {
+              float blocker = decodeMoments(boxFilterMoments(rect, atlasUV, int(2 * radius) + 1)).x;
+              radius *= clamp((pixelDepth - blocker) / max(blocker, 0.001), 0.0625, 1);
+            }
+
+            lightDepth = decodeMoments(boxFilterMoments(rect, atlasUV, int(2 * radius) + 1));
+          }
+          else
+            lightDepth = decodeMoments(texture(shadowAtlas, atlasUV));
         
-        float G = getG(lightDepth, pixelDepth);
+          G = getG(lightDepth, pixelDepth);
+        }
         
         if(G < 1 || control.doShadows == 0) {         
           vec3 lightColor = lights.at[i].color;
-          vec3 lightPos   = lights.at[i].pos;
+          vec3 lightPos   = directional ? inPos - normalize(lights.at[i].dir) : lights.at[i].pos;
           vec3 lightAtten = lights.at[i].atten;
           float lightRad  = lights.at[i].radius * 100;
           
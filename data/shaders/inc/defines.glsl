@@ -6,10 +6,18 @@
 // AO/Sheen = 4
 // Height = 5? unknown
 
-#define MAX_MATERIALS 4
 #define MTL_MAP_COUNT 4
 
-#define MAX_GLOBAL_LIGHTS 2
+// Texture table size when descriptor indexing isn't available (see GeometryStep)
+#define FALLBACK_TEXTURE_SLOTS 64
+#define NO_TEXTURE 0xFFFFFFFFu
+
+// Specialization constant selecting the gbuffer layout, see inc/gbuffer.glsl.
+// Has to match RenderStep::GBUFFER_LAYOUT_CONSTANT_ID.
+#define GBUFFER_LAYOUT_CONSTANT_ID 10
+
+#define MAX_SHADOW_MAPS 32 // GlobalLightStep::MAX_SHADOW_MAPS
+#define SHADOW_ROUTE_MAP_BITS 5 // Renderer::SHADOW_ROUTE_MAP_BITS
 #define MAX_DYNAMIC_LOCAL_LIGHTS 128
 
 #define SHADER_CONTROL_UNIFORM  \
@@ -25,4 +33,17 @@
     int   doShadows;            \
     int   doIBLLighting;        \
     int   enableHDRBackground;  \
-  }
\ No newline at end of file
+    float shadowFilterRadius;   \
+    int   variablePenumbra;     \
+    int   summedAreaShadows;    \
+  }
+
+// Per-object records: the model matrix's top three rows (it's affine), then the
+// material index's bits. 13 floats with no padding, indexed by gl_InstanceIndex.
+// Declare as layout(std430, binding = N) OBJECT_BUFFER; then include inc/objects.glsl
+#define OBJECT_DATA_FLOATS 13
+
+#define OBJECT_BUFFER             \
+  readonly buffer ObjectBuffer {  \
+    float objectData[];           \
+  }
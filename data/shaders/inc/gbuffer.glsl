@@ -0,0 +1,110 @@
+// Packing & unpacking of the geometry pass's outputs. Include after defines.glsl.
+//
+// COMPACT_GBUFFER picks the layout (GBufferLayout in RenderSteps.h). It's a specialization
+// constant, so the driver drops whichever branch isn't taken.
+//
+//            target 0                     target 1                  target 2
+//   full:    RGBA32F position, is object  RGBA32F normal, metallic  RGBA32F color, roughness
+//   compact: RGBA8 metallic, roughness,   RG16 octahedral normal    RGBA8 sRGB albedo
+//            is object
+//
+// The compact layout has no position; it's rebuilt from the depth buffer & the camera's
+// inverse view-projection. Its targets are read with texelFetch, as filtering depth or
+// octahedral normals across an edge gives nonsense.
+
+layout(constant_id = GBUFFER_LAYOUT_CONSTANT_ID) const bool COMPACT_GBUFFER = false;
+
+struct GBufferSample {
+  vec3  pos;
+  vec3  normal;
+  vec3  color;
+  float metallic;
+  float roughness;
+  bool  isObject;
+};
+
+vec2 signNotZero(vec2 v) {
+  return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit vector -> [0, 1]^2. The lower hemisphere is folded over the diagonals.
+vec2 encodeNormal(vec3 n) {
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+  return e * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 e) {
+  e = e * 2.0 - 1.0;
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if(n.z < 0.0)
+    n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+  return normalize(n);
+}
+
+// uv is the gbuffer's; [0, 1] depth (GLM_FORCE_DEPTH_ZERO_TO_ONE)
+vec3 reconstructPosition(vec2 uv, float depth, mat4 invViewProj) {
+  vec4 world = invViewProj * vec4(uv * 2.0 - 1.0, depth, 1.0);
+  return world.xyz / world.w;
+}
+
+ivec2 gbufferTexel(sampler2D target, vec2 uv) {
+  ivec2 size = textureSize(target, 0);
+  return clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1);
+}
+
+vec3 readGBufferPosition(sampler2D target0, sampler2D depth, vec2 uv, mat4 invViewProj) {
+  if(COMPACT_GBUFFER)
+    return reconstructPosition(uv, texelFetch(depth, gbufferTexel(depth, uv), 0).r, invViewProj);
+
+  return texture(target0, uv).xyz;
+}
+
+vec3 readGBufferNormal(sampler2D target1, vec2 uv) {
+  if(COMPACT_GBUFFER)
+    return decodeNormal(texelFetch(target1, gbufferTexel(target1, uv), 0).xy);
+
+  return normalize(texture(target1, uv).xyz);
+}
+
+GBufferSample readGBuffer(sampler2D target0, sampler2D target1, sampler2D target2, sampler2D depth,
+                          vec2 uv, mat4 invViewProj) {
+  GBufferSample s;
+  s.pos    = readGBufferPosition(target0, depth, uv, invViewProj);
+  s.normal = readGBufferNormal(target1, uv);
+
+  if(COMPACT_GBUFFER) {
+    ivec2 texel    = gbufferTexel(target0, uv);
+    vec4  material = texelFetch(target0, texel, 0);
+    s.color        = texelFetch(target2, texel, 0).rgb;
+    s.metallic     = material.r;
+    s.roughness    = material.g;
+    s.isObject     = material.b > 0.5;
+  }
+  else {
+    vec4 t0 = texture(target0, uv);
+    vec4 t1 = texture(target1, uv);
+    vec4 t2 = texture(target2, uv);
+    s.color     = t2.rgb;
+    s.metallic  = t1.w;
+    s.roughness = t2.w;
+    s.isObject  = int(t0.w) == 1;
+  }
+
+  return s;
+}
+
+// The geometry pass's three outputs for a fragment
+void writeGBuffer(out vec4 target0, out vec4 target1, out vec4 target2,
+                  vec3 pos, vec3 normal, vec3 color, float metallic, float roughness, bool isObject) {
+  if(COMPACT_GBUFFER) {
+    target0 = vec4(metallic, roughness, isObject ? 1.0 : 0.0, 0.0);
+    target1 = vec4(encodeNormal(normal), 0.0, 0.0);
+    target2 = vec4(color, 1.0);
+  }
+  else {
+    target0 = vec4(pos, isObject ? 1.0 : 0.0);
+    target1 = vec4(normal, metallic);
+    target2 = vec4(color, roughness);
+  }
+}
@@ -0,0 +1,93 @@
+// Body of the geometry pass's fragment shader. gbuffer_filler.frag and
+// gbuffer_filler_bindless.frag only differ in how the texture table is declared;
+// the latter defines BINDLESS_TEXTURES & enables GL_EXT_nonuniform_qualifier.
+
+layout(binding = 0) uniform CameraUBO {
+  mat4 view;
+  mat4 proj;
+  vec3 eye;
+  vec3 viewDir;
+  float farDist;
+  float nearDist;
+} cam;
+
+#include "defines.glsl"
+#include "gbuffer.glsl"
+
+struct Material {
+  vec3  diffuseCoeff;
+  float metallicCoeff;  // if 0, ignore metallic sampler
+  vec3  specularCoeff;
+  float roughnessCoeff; // if 0, ignore roughness sampler
+  uvec4 textures;       // albedo, normal, metallic, roughness slots; NO_TEXTURE if unused
+};
+
+layout(std430, binding = 2) readonly buffer MaterialBuffer {
+  Material at[];
+} mtls;
+
+#ifdef BINDLESS_TEXTURES
+layout(binding = 3) uniform sampler2D textures[];
+#define SAMPLE_TEXTURE(slot, uv) texture(textures[nonuniformEXT(slot)], uv)
+#else
+layout(binding = 3) uniform sampler2D textures[FALLBACK_TEXTURE_SLOTS];
+#define SAMPLE_TEXTURE(slot, uv) texture(textures[slot], uv)
+#endif
+
+// shader control
+layout(binding = 4) SHADER_CONTROL_UNIFORM control;
+
+layout(location = 0) in vec4 inWorldPosition;
+layout(location = 1) in vec4 inWorldNormal;
+layout(location = 2) in vec3 inTangent;
+layout(location = 3) in vec3 inBitangent;
+layout(location = 4) in vec2 inUV;
+layout(location = 5) in vec3 inColor;
+layout(location = 6) flat in uint inMtlIndex;
+
+// what goes in each depends on the layout, see gbuffer.glsl
+layout(location = 0) out vec4 outTarget0;
+layout(location = 1) out vec4 outTarget1;
+layout(location = 2) out vec4 outTarget2;
+
+void main() {  
+  vec3 pos      = inWorldPosition.xyz;
+  vec3 normal   = normalize(inWorldNormal.xyz);
+  vec3 tangent  = normalize(inTangent);
+  vec3 bitan    = normalize(inBitangent);
+  vec3 color    = inColor.xyz;
+  Material mtl  = mtls.at[inMtlIndex];
+  float roughness = control.defaultRoughness * mtl.roughnessCoeff;
+  float metallic  = control.defaultMetallic * mtl.metallicCoeff;
+  int hasObject = 1;
+  
+  if(mtl.textures.x != NO_TEXTURE) {
+    vec3 albedoMap = pow(SAMPLE_TEXTURE(mtl.textures.x, inUV).xyz, vec3(2.2));
+    color = color * albedoMap * mtl.diffuseCoeff;
+  }
+  else if(abs(bitan.y - 1) < 0.001 && abs(bitan.x) < 0.001 && abs(bitan.z) < 0.001) {
+    hasObject = 0;
+  }
+  
+  if(mtl.textures.y != NO_TEXTURE) {
+    vec3 normalMap = SAMPLE_TEXTURE(mtl.textures.y, inUV).xyz;
+    normalMap = normalMap * vec3(2.0) - vec3(1.0);
+    // do normal mapping, output in 'normal'
+    
+    mat3 TBN = mat3(tangent, bitan, normal);
+    normal = normalize(TBN * normalMap);
+  }
+  
+  if(mtl.textures.z != NO_TEXTURE) {
+    float metallicMap = SAMPLE_TEXTURE(mtl.textures.z, inUV).r;
+    metallic = metallicMap * mtl.metallicCoeff;
+  }
+  
+  if(mtl.textures.w != NO_TEXTURE) {
+    float roughnessMap = SAMPLE_TEXTURE(mtl.textures.w, inUV).r;
+    roughness = roughnessMap * mtl.roughnessCoeff;
+  }
+  
+  writeGBuffer(outTarget0, outTarget1, outTarget2,
+               pos, normal, color, metallic, roughness, hasObject == 1);
+}
@@ -23,6 +23,9 @@ struct ShadowLight {
   float farDist;
   float radius;
   int type;
+  float splitNear; // camera view depths this map is used for
+  float splitFar;
+  vec4 atlasRect;  // where its map is in the shadow atlas: xy corner, zw size. Zero size is no map
 };
 
 /*float GSchlickGGX(float N_V, float k) {
@@ -0,0 +1,31 @@
+// Hamburger 4MSM moments, stored with the optimized quantization from the 4MSM paper: a fixed
+// linear transform spreads (z, z^2, z^3, z^4) over [0, 1] so they survive 16 bit unorm storage.
+// The transform is affine, so filtering the stored moments (the blur, bilinear sampling) is the
+// same as filtering the moments themselves.
+
+// Converted from the paper's HLSL; mat4() takes its rows as columns, so these multiply as M * b
+vec4 encodeMoments(float depth) {
+  float z2 = depth * depth;
+  vec4 b = vec4(depth, z2, z2 * depth, z2 * z2);
+
+  vec4 optimized = mat4(
+    -2.07224649,    13.7948857237,  0.105877704,   9.7924062118,
+    32.23703778,   -59.4683975703, -1.9077466311, -33.7652110555,
+    -68.571074599,  82.0359750338,  9.3496555107,  47.9456096605,
+    39.3703274134, -35.364903257,  -6.6543490743, -23.9728048165
+  ) * b;
+
+  optimized[0] += 0.035955884801;
+  return optimized;
+}
+
+vec4 decodeMoments(vec4 optimized) {
+  optimized[0] -= 0.035955884801;
+
+  return mat4(
+    0.2227744146,  0.1549679261,  0.1451988946,  0.163127443,
+    0.0771972861,  0.1394629426,  0.2120202157,  0.2591432266,
+    0.7926986636,  0.7963415838,  0.7258694464,  0.6539092497,
+    0.0319417555, -0.1722823173, -0.2758014811, -0.3376131734
+  ) * optimized;
+}
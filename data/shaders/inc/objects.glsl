@@ -0,0 +1,17 @@
+// Reads per-object records out of the object buffer.
+// Needs inc/defines.glsl and the buffer declared before being included:
+//   layout(std430, binding = N) OBJECT_BUFFER;
+
+mat4 GetObjectModel(int object) {
+  int b = object * OBJECT_DATA_FLOATS;
+
+  // stored by rows, and mat4() takes columns
+  return transpose(mat4(objectData[b + 0], objectData[b + 1], objectData[b + 2],  objectData[b + 3],
+                        objectData[b + 4], objectData[b + 5], objectData[b + 6],  objectData[b + 7],
+                        objectData[b + 8], objectData[b + 9], objectData[b + 10], objectData[b + 11],
+                        0, 0, 0, 1));
+}
+
+uint GetObjectMaterial(int object) {
+  return floatBitsToUint(objectData[object * OBJECT_DATA_FLOATS + 12]);
+}
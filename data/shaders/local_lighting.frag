@@ -3,6 +3,7 @@
 
 #include "inc/defines.glsl"
 #include "inc/lighting.glsl"
+#include "inc/gbuffer.glsl"
 
 layout(binding = 0) uniform CameraUBO {
   mat4 view;
@@ -11,17 +12,20 @@ layout(binding = 0) uniform CameraUBO {
   vec3 viewDir;
   float farDist;
   float nearDist;
+  mat4 invViewProj;
 } cam;
 
 layout(binding = 1) SHADER_CONTROL_UNIFORM control;
 
-layout(binding = 2) uniform sampler2D inGBuffPosition;
-layout(binding = 3) uniform sampler2D inGBuffNormal;
-layout(binding = 4) uniform sampler2D inGBuffColor;
+layout(binding = 2) uniform sampler2D inGBuff0;
+layout(binding = 3) uniform sampler2D inGBuff1;
+layout(binding = 4) uniform sampler2D inGBuff2;
+layout(binding = 5) uniform sampler2D inGBuffDepth;
 
-layout(binding = 5) uniform sampler2D previousImage;
+// global lighting, read from the render pass's attachment at this pixel
+layout(input_attachment_index = 0, binding = 6) uniform subpassInput previousImage;
 
-layout(binding = 6) uniform DynamicLightUBO {
+layout(binding = 7) uniform DynamicLightUBO {
   Light at[MAX_DYNAMIC_LOCAL_LIGHTS];
   uint count;
 } dynLights;
@@ -30,19 +34,16 @@ layout(location = 0) in vec2 inUV;
 layout(location = 0) out vec4 fragColor;
 
 void main() {
-  vec4 sampledPos = texture(inGBuffPosition, inUV);
-  vec4 sampledNormal = texture(inGBuffNormal, inUV);
-  vec4 sampledColor = texture(inGBuffColor, inUV);
-  vec4 previousColor = texture(previousImage, inUV);
+  GBufferSample gbuff = readGBuffer(inGBuff0, inGBuff1, inGBuff2, inGBuffDepth, inUV, cam.invViewProj);
+  vec4 previousColor = subpassLoad(previousImage);
   
-  float isObject    = sampledPos.w;
-  float inMetallic  = sampledNormal.w;
-  float inRoughness = sampledColor.w;
-  vec3  inPos       = sampledPos.xyz;
-  vec3  inColor     = sampledColor.xyz;
+  float inMetallic  = gbuff.metallic;
+  float inRoughness = gbuff.roughness;
+  vec3  inPos       = gbuff.pos;
+  vec3  inColor     = gbuff.color;
   
-  if(int(isObject) == 1) {
-    vec3 N = normalize(sampledNormal.xyz);
+  if(gbuff.isObject) {
+    vec3 N = gbuff.normal;
     vec3 V = normalize(cam.eye - inPos);
     
     //fragColor = vec4(N + vec3(1.0) / vec3(2.0), 1);
@@ -1,6 +1,8 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+#include "inc/defines.glsl"
+
 layout(binding = 0) uniform CameraUBO {
   mat4 view;
   mat4 proj;
@@ -10,10 +12,8 @@ layout(binding = 0) uniform CameraUBO {
   float nearDist;
 } cam;
 
-layout(binding = 1) uniform ObjectUBO {
-  mat4 model;
-  uint mtlIndex;
-} obj;
+layout(std430, binding = 1) OBJECT_BUFFER;
+#include "inc/objects.glsl"
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -28,16 +28,19 @@ layout(location = 2) out vec3 outTangent;
 layout(location = 3) out vec3 outBitangent;
 layout(location = 4) out vec2 outUV;
 layout(location = 5) out vec3 outColor;
+layout(location = 6) flat out uint outMtlIndex;
 
 void main() {
-  mat4 multNorm = inverse(transpose(obj.model));
+  mat4 model    = GetObjectModel(gl_InstanceIndex);
+  mat4 multNorm = inverse(transpose(model));
   
-  outWorldPosition  = obj.model * vec4(inPosition, 1.0);
+  outWorldPosition  = model * vec4(inPosition, 1.0);
   outWorldNormal    = normalize(multNorm * vec4(inNormal, 0));
   outTangent        = normalize(multNorm * vec4(inTangent, 0)).xyz;
   outBitangent      = normalize(multNorm * vec4(inBitangent, 0)).xyz;
   outUV             = inUV;
   outColor          = inColor;
+  outMtlIndex       = GetObjectMaterial(gl_InstanceIndex);
 
   gl_Position = cam.proj * cam.view * outWorldPosition;
 }
\ No newline at end of file
@@ -1,24 +1,23 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+#include "inc/defines.glsl"
+#include "inc/lighting.glsl"
+#include "inc/moments.glsl"
+
+layout(binding = 0) uniform ShadowLights {
+  ShadowLight at[MAX_SHADOW_MAPS];
+} lights;
+
 layout(location = 0) in vec4 inWorldPosition;
+layout(location = 1) flat in int inMap;
 
 layout(location = 0) out vec4 outDepth;
 
-layout(push_constant) uniform Depth {
-  layout(offset = 4) float near;
-  layout(offset = 8) float far;
-} depths;
-
 void main() {
   float depth = gl_FragCoord.z / gl_FragCoord.w;
-  depth = (depth - depths.near) / (depths.far - depths.near);
-  
-  // we want to store the four moments needed for Hamburger 4MSM
-  float z1 = depth;
-  float z2 = depth * depth;
-  float z3 = z2 * depth;
-  float z4 = z3 * depth;
+  depth = (depth - lights.at[inMap].nearDist) / (lights.at[inMap].farDist - lights.at[inMap].nearDist);
   
-  outDepth = vec4(z1, z2, z3, z4);
+  // the four moments needed for Hamburger 4MSM, quantized for RGBA16
+  outDepth = encodeMoments(depth);
 }
\ No newline at end of file
@@ -5,16 +5,17 @@
 #include "inc/lighting.glsl"
 
 layout(binding = 0) uniform ShadowLights {
-  ShadowLight at[MAX_GLOBAL_LIGHTS];
+  ShadowLight at[MAX_SHADOW_MAPS];
 } lights;
 
-layout(binding = 1) uniform ObjectUBO {
-  mat4 model;
-} obj;
+layout(std430, binding = 1) OBJECT_BUFFER;
+#include "inc/objects.glsl"
 
-layout(push_constant) uniform LightIndexPush {
-  int index;
-} push;
+// Every instance is a (slot, map) pair: the object to draw & the shadow map to draw it into.
+// The low SHADOW_ROUTE_MAP_BITS are the map, the rest the slot.
+layout(std430, binding = 2) readonly buffer ShadowRoutes {
+  uint routes[];
+};
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -24,10 +25,31 @@ layout(location = 4) in vec2 inUV;
 layout(location = 5) in vec3 inColor;
 
 layout(location = 0) out vec4 outWorldPosition;
+layout(location = 1) flat out int outMap;
+
+out gl_PerVertex {
+  vec4 gl_Position;
+  float gl_ClipDistance[4];
+};
 
 void main() {
-  outWorldPosition  = obj.model * vec4(inPosition, 1.0);
+  uint route = routes[gl_InstanceIndex];
+  outMap = int(route & ((1u << SHADOW_ROUTE_MAP_BITS) - 1));
+  
+  outWorldPosition  = GetObjectModel(int(route >> SHADOW_ROUTE_MAP_BITS)) * vec4(inPosition, 1.0);
+  
+  ShadowLight light = lights.at[outMap];
+  vec4 pos = light.proj * light.view * outWorldPosition;
+  
+  // clipped to the map's own frustum, as its tile's viewport would have
+  gl_ClipDistance[0] = pos.w + pos.x;
+  gl_ClipDistance[1] = pos.w - pos.x;
+  gl_ClipDistance[2] = pos.w + pos.y;
+  gl_ClipDistance[3] = pos.w - pos.y;
+  
+  // then squeezed into the tile; the viewport covers the whole atlas
+  vec4 rect = light.atlasRect;
+  pos.xy = pos.xy * rect.zw + pos.w * (2 * rect.xy + rect.zw - 1);
   
-  ShadowLight light = lights.at[push.index];
-  gl_Position = light.proj * light.view * outWorldPosition;
-}
\ No newline at end of file
+  gl_Position = pos;
+}
@@ -771,7 +771,7 @@ bool ImGui_ImplVulkan_CreateDeviceObjects()
     info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     info.flags = g_PipelineCreateFlags;
     info.stageCount = 2;
-    info.subpass = 1; // NOTE: changed
+    info.subpass = 3; // NOTE: changed, FinalStep::IMGUI_SUBPASS
     info.pStages = stage;
     info.pVertexInputState = &vertex_info;
     info.pInputAssemblyState = &ia_info;
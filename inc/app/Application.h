@@ -19,12 +19,14 @@
 #ifndef DW_APPLICATION_H
 #define DW_APPLICATION_H
 
+#include "app/FramePacer.h"
 #include "render/Renderer.h"
 #include "render/MeshManager.h"
 #include "obj/Camera.h"
 #include "obj/Material.h"
 
 #include <chrono>
+#include <deque>
 #include <memory>
 
 namespace dw {
@@ -62,6 +64,88 @@ namespace dw {
     MeshManager m_meshManager;
     Renderer::ShaderControl m_shaderControl {};
     bool m_resizedWindow{ false };
+    bool m_restartWindow{ false };  //!< Something the steps are made with changed, not just the size
+    uint32_t m_stressObjectCount{ 0 };
+    GBufferLayout m_gbufferLayout{ GBufferLayout::Full };
+    Renderer::ShadowSettings m_shadowSettings{};
+    bool m_directionalSun{ false };
+    bool m_benchmarkShadowFilter{ false };
+    bool m_benchmarkAsyncCompute{ false };
+    bool m_asyncCompute{ true };
+    unsigned m_windowWidth{ 1600 };
+    unsigned m_windowHeight{ 800 };
+
+    Renderer::PresentSettings m_presentSettings{};
+    FramePacer::Settings m_pacerSettings{};
+    FramePacer m_framePacer;
+    bool m_benchmarkLatency{ false };
+
+    void updatePresentDelay(); //!< After the swapchain's remade, its present mode may have changed
+
+    // --benchmark-resize: the window's resized back & forth, the first half of the times remaking
+    // everything (what a resize used to do), the second only what's sized to the window
+    struct ResizeBenchmark {
+      static constexpr uint32_t FRAMES_APART = 30;
+
+      uint32_t count{ 0 };   //!< Resizes each way
+      uint32_t done{ 0 };
+      uint32_t frame{ 0 };
+      double   totalMs[2]{};
+      double   maxMs[2]{};
+    };
+
+    void benchmarkResize(); //!< Called every frame
+    void logResizeBenchmark() const;
+
+    ResizeBenchmark m_resizeBenchmark;
+
+    // --benchmark-scene-switch: switches between the main scene & a second one, the first half of
+    // the times with no scene kept prepared (each one built by setScene(), as it used to be), the
+    // second with the other scene prepared in the background & both kept resident
+    struct SceneSwitchBenchmark {
+      static constexpr uint32_t FRAMES_APART = 30;
+
+      uint32_t     count{ 0 };   //!< Switches each way
+      uint32_t     done{ 0 };
+      uint32_t     frame{ 0 };
+      VkDeviceSize budget{ 0 };  //!< The renderer's scene budget, put back for the second half
+      double       totalMs[2]{};
+      double       maxMs[2]{};
+    };
+
+    void benchmarkSceneSwitch(); //!< Called every frame
+    void logSceneSwitchBenchmark() const;
+
+    SceneSwitchBenchmark m_sceneSwitchBenchmark;
+    util::ptr<Scene> m_switchScene{ nullptr };
+
+    // --benchmark-shadow-filter: the blur, then the summed-area table at each of RADII, each timed
+    // for FRAMES frames once the setting's had SETTLE_FRAMES to take; the blur's kernel is fixed,
+    // so it's timed once
+    struct ShadowFilterBenchmark {
+      static constexpr uint32_t SETTLE_FRAMES = 30;
+      static constexpr uint32_t FRAMES        = 240;
+      static constexpr uint32_t RADIUS_COUNT  = 6;
+      static constexpr float    RADII[RADIUS_COUNT]{ 1, 2, 4, 8, 16, 32 };
+
+      uint32_t step{ 0 };      //!< 0 is the blur, then one per radius
+      uint32_t frame{ 0 };
+      float    radius{ 0 };    //!< The one asked for, put back afterwards
+      Renderer::ShadowFilterTiming timings[RADIUS_COUNT + 1]{};
+    };
+
+    void benchmarkShadowFilter(); //!< Called every frame
+    void logShadowFilterBenchmark() const;
+
+    ShadowFilterBenchmark m_shadowFilterBenchmark;
+
+    // --stress-churn: the oldest stress cubes are removed & as many new ones inserted at random
+    // spots, this many a second, through the scene's handles; the renderer logs what the edits cost
+    void churnStressObjects(float dt); //!< Called every frame
+
+    uint32_t m_churnRate{ 0 };
+    double m_churnDue{ 0 };                    //!< Cubes owed to the rate, carried between frames
+    std::deque<Scene::Handle> m_stressHandles; //!< Oldest first
   };
 } // namespace dw
 #endif
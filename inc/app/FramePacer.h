@@ -0,0 +1,101 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : FramePacer.h
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 18d
+// * Last Altered: 2020y 03m 18d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description : Decides when the main loop starts a frame: caps the frame rate,
+// *               and holds input sampling back until just before the renderer
+// *               can use it. Estimates how long input takes to reach the screen.
+
+#ifndef DW_FRAME_PACER_H
+#define DW_FRAME_PACER_H
+
+#include "render/Renderer.h"
+
+#include <array>
+#include <chrono>
+
+namespace dw {
+  // Whatever time drawFrame() spends blocked on the last frame or the swapchain is time the
+  // frame's input sat around getting older. With a latency budget the pacer sleeps that time
+  // away before input is sampled instead, leaving MARGIN_MS so the frame isn't late to the GPU.
+  class FramePacer {
+  public:
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms    = std::chrono::duration<double, std::milli>;
+
+    static constexpr double   MARGIN_MS    = 1.0;   //!< Blocked time left over for the frame's own jitter
+    static constexpr double   GAIN         = 0.25;  //!< How much of the error the delay takes up a frame
+    static constexpr double   MAX_DELAY_MS = 50.0;
+    static constexpr double   SPIN_MS      = 2.0;   //!< Sleeps this close to the deadline yield instead
+    static constexpr uint32_t LOG_FRAMES   = 240;   //!< Averages are logged every this many frames
+
+    struct Settings {
+      float fpsCap{ 0 };           //!< Frames a second, 0 = uncapped
+      float latencyBudgetMs{ 0 };  //!< Input to present, 0 = input's sampled as soon as the frame starts
+    };
+
+    void setSettings(Settings const& settings) { m_settings = settings; }
+    NO_DISCARD Settings const& getSettings() const { return m_settings; }
+
+    // Logs the averages every LOG_FRAMES frames
+    void setLogging(bool enabled = true) { m_logging = enabled; }
+
+    // Added to every estimate for how long the display holds a finished image, e.g. half a
+    // refresh when it waits for the vblank
+    void setPresentDelay(double ms) { m_presentDelayMs = ms; }
+
+    // Sleeps until the frame should start, then notes the time as when its input was sampled.
+    // Call right before polling input.
+    void beginFrame();
+
+    // Call after Renderer::drawFrame(), with what it waited on
+    void endFrame(Renderer::FrameWaits const& waits);
+
+    NO_DISCARD bool   hasLatency() const { return m_hasLatency; }
+    NO_DISCARD double getLatencyMs() const { return m_latencyMs; } //!< The last frame seen done
+    NO_DISCARD double getBlockedMs() const { return m_blockedMs; }
+    NO_DISCARD double getDelayMs() const { return m_delayMs; }     //!< Slept before sampling input
+    NO_DISCARD double getFrameMs() const { return m_frameMs; }
+
+  private:
+    // input times are kept until their frame's seen done, which is a frame later at most
+    static constexpr uint64_t INPUT_HISTORY = 4;
+
+    static void SleepUntil(Clock::time_point when);
+    void log();
+
+    Settings m_settings{};
+    bool     m_logging{ false };
+    double   m_presentDelayMs{ 0 };
+
+    Clock::time_point m_slot{};       //!< When the capped frame was due to start
+    Clock::time_point m_inputTime{};
+    std::array<Clock::time_point, INPUT_HISTORY> m_inputTimes{}; //!< By frame number
+    uint64_t m_submitted{ 0 };
+    uint64_t m_done{ 0 };
+
+    bool   m_hasLatency{ false };
+    double m_latencyMs{ 0 };
+    double m_blockedMs{ 0 };
+    double m_delayMs{ 0 };
+    double m_frameMs{ 0 };
+
+    // logging
+    uint32_t m_loggedFrames{ 0 };
+    uint32_t m_latencyFrames{ 0 };
+    double   m_totalFrameMs{ 0 };
+    double   m_totalLatencyMs{ 0 };
+    double   m_maxLatencyMs{ 0 };
+    double   m_totalBlockedMs{ 0 };
+    double   m_totalDelayMs{ 0 };
+  };
+}
+
+#endif
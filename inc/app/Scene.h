@@ -49,12 +49,40 @@ namespace dw {
     using ObjContainer    = std::vector<util::ptr<obj::Object>>;
     using LightContainer  = std::vector<util::ptr<Light>>;
 
+    // A handle names an object or light until it's removed, after which it's stale & ignored.
+    // Removing swaps the last one into the removed one's place, so indices into getObjects() &
+    // getLights() move where handles don't.
+    using Handle = uint64_t;
+    static constexpr Handle NO_HANDLE = ~0ull;
+
+    // What changed about the objects & global lights, oldest first, for the renderer to apply
+    // between frames instead of preparing the whole scene again
+    struct Edit {
+      enum class Type {
+        AddObject,
+        RemoveObject,
+        UpdateObject,  //!< Its mesh, material or static flag changed
+        GlobalLights   //!< One was added or removed
+      };
+
+      Type                   type;
+      Handle                 handle{ NO_HANDLE };
+      util::ptr<obj::Object> object; //!< Kept alive until the renderer's let go of it
+    };
+
     //virtual void update(InputHandler* input, float t, float dt) = 0;
 
     Scene& addObject(ObjContainer::value_type const& object);
     Scene& addLight(LightContainer::value_type const& light);
     Scene& addGlobalLight(ShadowedLight const& light);
 
+    NO_DISCARD Handle insertObject(ObjContainer::value_type const& object);
+    void removeObject(Handle handle);
+    void updateObject(Handle handle);
+    NO_DISCARD Handle insertLight(LightContainer::value_type const& light);
+    void removeLight(Handle handle);
+    void removeGlobalLight(size_t index);
+
     Scene& setCamera(util::ptr<obj::Camera> camera);
     Scene& setBackground(util::ptr<Texture> bg, util::ptr<Texture> irradiance);
     //Scene& setControl(Renderer::ShaderControl* control);
@@ -71,7 +99,42 @@ namespace dw {
     LightContainer& getLights();
     NO_DISCARD util::ptr<obj::Camera> getCamera() const;
 
+    NO_DISCARD ObjContainer::value_type getObject(Handle handle) const; //!< Null once it's removed
+    NO_DISCARD Handle getObjectHandle(size_t index) const;              //!< getObjects()[index]'s
+    NO_DISCARD uint32_t getObjectSlots() const; //!< Handle slots are below this, see GetSlot()
+
+    // Handles are their slot's generation << 32 | the slot, so the renderer can keep its own
+    // tables by slot. A slot's reused once what it named is removed.
+    NO_DISCARD static uint32_t GetSlot(Handle handle) { return static_cast<uint32_t>(handle); }
+
+    // Bumped by every edit journaled, which is whatever changes what the renderer prepares for
+    // the scene: its objects & global lights. Changes made through getObjects() aren't counted.
+    NO_DISCARD uint64_t getRevision() const;
+
+    // Everything journaled since the last call
+    std::vector<Edit> takeEdits();
+
+    // Only the renderer's live scene has its edits applied, so only it keeps a journal; the rest
+    // just bump their revision. Either way, what's journaled so far is dropped.
+    void setJournaling(bool journaling);
+
   private:
+    // Handles for a container kept dense by swapping its last element into a removed one's place
+    struct HandleTable {
+      static constexpr uint32_t NONE = ~0u;
+
+      Handle   insert();                    //!< For a new last element
+      uint32_t find(Handle handle) const;   //!< Its index, or NONE if it's stale
+      uint32_t remove(Handle handle);       //!< Its index, which the last element moves to
+
+      std::vector<uint32_t> indices;      //!< By slot
+      std::vector<uint32_t> generations;  //!< By slot
+      std::vector<uint32_t> slots;        //!< By index
+      std::vector<uint32_t> free;
+    };
+
+    void journal(Edit const& edit);
+
     //Renderer::ShaderControl m_control;
     util::ptr<Texture> m_background;
     util::ptr<Texture> m_backgroundIrradiance;
@@ -79,6 +142,11 @@ namespace dw {
     LightContainer m_lights;
     std::vector<ShadowedLight> m_globalLights;
     util::ptr<obj::Camera> m_camera {nullptr};
+    uint64_t m_revision{ 0 };
+    HandleTable m_objectHandles;
+    HandleTable m_lightHandles;
+    std::vector<Edit> m_edits;
+    bool m_journaling{ false };
   };
 
   /*class LevelScene : public Scene {
@@ -16,6 +16,8 @@
 
 #include "util/MyMath.h"
 
+#include <limits>
+
 #ifndef NO_DISCARD
 #define NO_DISCARD [[nodiscard]]
 #endif
@@ -41,6 +43,9 @@ namespace dw {
     alignas(04) float farDist;
     alignas(04) float radius;
     alignas(04) int type; // 0, 1, 2
+    alignas(04) float splitNear; // camera view depths the map is used for; cascades only cover part
+    alignas(04) float splitFar;
+    alignas(16) glm::vec4 atlasRect; // xy: corner, zw: size, in shadow atlas UVs. Zero size is no shadow map
   };
 
   class Light {
@@ -110,7 +115,10 @@ namespace dw {
         m_nearDist,
         m_farDist,
         m_localRadius,
-        (int)m_type
+        (int)m_type,
+        0.f,
+        std::numeric_limits<float>::max(),
+        glm::vec4(0.f)
       };
     }
 
@@ -39,25 +39,25 @@ namespace dw {
 
     NO_DISCARD uint32_t getID() const;
 
-    //
-    struct MaterialUBO {
+    // One per material in the material buffer (std430), indexed by the material's ID.
+    // textures holds texture table slots, Texture::NO_SLOT for maps that aren't used.
+    struct MaterialData {
       alignas(16) glm::vec3 kd;
-      alignas(16) glm::vec3 ks;
       alignas(04) float metallic;
+      alignas(16) glm::vec3 ks;
       alignas(04) float roughness;
-      alignas(04) int hasAlbedo;
-      alignas(04) int hasNormal;
-      alignas(04) int hasMetallic;
-      alignas(04) int hasRoughness;
+      alignas(16) glm::uvec4 textures;
     };
 
-    NO_DISCARD MaterialUBO getAsUBO() const {
-      return { m_kd, m_ks, m_metallic, m_roughness,
-        m_useMap[0],//m_textures[0] != nullptr,
-        m_useMap[1],//m_textures[1] != nullptr,
-        m_useMap[2],//m_textures[2] != nullptr,
-        m_useMap[3]//m_textures[3] != nullptr,
-      };
+    NO_DISCARD MaterialData getAsData() const {
+      MaterialData data = { m_kd, m_metallic, m_ks, m_roughness, glm::uvec4(Texture::NO_SLOT) };
+
+      for (unsigned i = 0; i < MTL_MAP_COUNT; ++i) {
+        if (m_useMap[i] && m_textures[i])
+          data.textures[i] = m_textures[i]->getSlot();
+      }
+
+      return data;
     }
 
     NO_DISCARD std::array<util::ptr<Texture>, MTL_MAP_COUNT> const& getTextures() const;
@@ -107,6 +107,9 @@ namespace dw {
 
     MtlKey load(tinyobj::material_t const& mtl);
 
+    // Drops the material and recycles its ID, which is also its place in the material buffer
+    void unload(MtlKey const& key);
+
     NO_DISCARD util::ptr<Material> getMtl(MtlKey key);
     NO_DISCARD util::ptr<Material> getDefaultMtl();
     NO_DISCARD util::ptr<Material> getSkyboxMtl();
@@ -117,9 +120,12 @@ namespace dw {
 
     MtlMap const& getMaterials() const;
   private:
+    uint32_t allocateID();
+
     TextureManager& m_textureStorage;
 
     MtlMap m_loadedMtls;
+    std::vector<uint32_t> m_freeIDs;
     uint32_t m_curID {0};
   };
 
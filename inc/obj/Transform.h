@@ -38,6 +38,12 @@ namespace dw::obj {
     Transform& addScale(glm::vec3 const& plusScale);
     Transform& addRotation(glm::quat const& plusRot);
 
+    // A promise that the object won't move, which lets the renderer keep it in cached shadow
+    // layers. Setting the same transform every frame is fine; actually moving one costs a
+    // redraw of every layer.
+    Transform& setStatic(bool isStatic = true);
+    NO_DISCARD bool isStatic() const;
+
     // etc.
   private:
     glm::mat4 m_matrix {};
@@ -46,6 +52,7 @@ namespace dw::obj {
     glm::vec3 m_scale{ 1.f };
 
     bool m_dirty{ true };
+    bool m_static{ false };
   };
 }
 
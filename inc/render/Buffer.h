@@ -36,6 +36,8 @@ namespace dw {
     static Buffer CreateVertex(LogicalDevice& device, VkDeviceSize size, bool fromStaging = true);
     static Buffer CreateIndex(LogicalDevice& device, VkDeviceSize size, bool fromStaging = true);
     static Buffer CreateUniform(LogicalDevice& device, VkDeviceSize size, bool fromStaging = false);
+    static Buffer CreateIndirect(LogicalDevice& device, VkDeviceSize size, bool fromStaging = false);
+    static Buffer CreateStorage(LogicalDevice& device, VkDeviceSize size, bool fromStaging = false);
     // TODO other buffer types e.g. uniform buffers
     
     operator VkBuffer() const;
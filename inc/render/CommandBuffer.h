@@ -79,8 +79,8 @@ namespace dw {
 
     void freeSelf();
 
-    // singular submit to a queue.
-    void submit(Queue& q);
+    // singular submit to a queue. Returns the queue's timeline value for it, 0 if it wasn't ready
+    uint64_t submit(Queue& q);
 
     // gets the submit info for the queue,
     // meant for submission of multiple submit infos
@@ -47,6 +47,15 @@ namespace dw {
       MemoryAllocator allocator(m_device.getOwningPhysical());
       m_images.back().back(allocator, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
       m_views.emplace_back(m_images.back().createView(viewAspect));
+      m_viewAspects.push_back(viewAspect);
+    }
+
+    // An image without memory, for the render graph to bind. Its view is made by finalize(), so
+    // these come after every addImage().
+    template<typename... Args>
+    void addTransientImage(VkFlags viewAspect, Args&&... args) {
+      m_images.emplace_back(m_device).initImage(std::move(args)...);
+      m_viewAspects.push_back(viewAspect);
     }
 
     void finalize(const RenderPass& pass);
@@ -66,6 +75,7 @@ namespace dw {
     VkFramebuffer m_framebuffer{ nullptr };
     std::vector<DependentImage> m_images;
     std::vector<ImageView> m_views;
+    std::vector<VkFlags> m_viewAspects;
     VkExtent3D m_extent;
   };
 
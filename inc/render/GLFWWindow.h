@@ -44,6 +44,9 @@ namespace dw {
 
     void setShouldClose(bool close = true);
 
+    // The resize callback follows once events are polled
+    void setSize(unsigned width, unsigned height) const;
+
   private:
     friend class GLFWControl;
 
@@ -0,0 +1,141 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : GeometryArena.h
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 02d
+// * Last Altered: 2020y 03m 02d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description : One device-local vertex buffer and one index buffer that every
+// *               mesh lives inside of. Meshes only own a range of each.
+
+#ifndef DW_GEOMETRY_ARENA_H
+#define DW_GEOMETRY_ARENA_H
+
+#include "Buffer.h"
+#include "Vertex.h"
+#include "util/Utils.h"
+
+#include <map>
+#include <vector>
+
+namespace dw {
+  class CommandBuffer;
+
+  // Offset/count free list. Units are elements (vertices or indices), not bytes.
+  // First fit, with neighbouring free blocks merged back together on release.
+  class RangeAllocator {
+  public:
+    static constexpr uint32_t INVALID = ~0u;
+
+    RangeAllocator(uint32_t capacity = 0);
+
+    // returns INVALID if there is no block large enough
+    NO_DISCARD uint32_t allocate(uint32_t count);
+    void                release(uint32_t offset, uint32_t count);
+
+    // adds [oldCapacity, newCapacity) to the free list
+    void grow(uint32_t newCapacity);
+
+    NO_DISCARD uint32_t getCapacity() const;
+    NO_DISCARD uint32_t getUsed() const;
+    NO_DISCARD uint32_t getLargestFree() const;
+    NO_DISCARD size_t   getNumFreeBlocks() const;
+
+  private:
+    std::map<uint32_t, uint32_t> m_free; // offset -> count
+    uint32_t m_capacity{0};
+    uint32_t m_used{0};
+  };
+
+  CREATE_DEVICE_DEPENDENT(GeometryArena)
+  public:
+    static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 1u << 18;
+    static constexpr uint32_t DEFAULT_INDEX_CAPACITY  = 1u << 20;
+
+    // The range a mesh occupies. Drawn with
+    // vkCmdDrawIndexed(indexCount, n, firstIndex, vertexOffset, firstInstance)
+    struct Allocation {
+      uint32_t vertexOffset{RangeAllocator::INVALID};
+      uint32_t vertexCount{0};
+      uint32_t firstIndex{RangeAllocator::INVALID};
+      uint32_t indexCount{0};
+
+      NO_DISCARD bool isValid() const { return vertexOffset != RangeAllocator::INVALID; }
+    };
+
+    GeometryArena(LogicalDevice& device,
+                  uint32_t       vertexCapacity = DEFAULT_VERTEX_CAPACITY,
+                  uint32_t       indexCapacity  = DEFAULT_INDEX_CAPACITY);
+    ~GeometryArena() = default;
+
+    // Reserves room for the mesh data and writes it into a staging buffer that is
+    // copied over on the next flush(). Grows the device buffers if needed.
+    NO_DISCARD Allocation allocate(std::vector<Vertex> const&   vertices,
+                                   std::vector<uint32_t> const& indices);
+
+    // The range is only handed out again once retire() says every frame that could have drawn
+    // from it is done
+    void release(Allocation const& alloc);
+
+    // Records every pending copy (including the old contents, if the arena grew)
+    // onto cmdBuff. The returned buffers must live until cmdBuff finishes. Buffers the
+    // arena grew out of are also kept until retire() passes the current frame.
+    NO_DISCARD std::vector<util::ptr<Buffer>> flush(CommandBuffer& cmdBuff);
+
+    // Frames are numbered as they're submitted. Releases & replaced buffers are tagged with the
+    // last frame submitted, and retired once that frame's done.
+    void setFrame(uint64_t submitted);
+    void retire(uint64_t done);
+
+    // Binds the shared buffers. Once per pass.
+    void bind(VkCommandBuffer cmdBuff) const;
+
+    NO_DISCARD bool hasPending() const;
+
+    // Bumped whenever the underlying VkBuffers are replaced; anything that recorded
+    // a bind() against an older generation needs to be re-recorded.
+    NO_DISCARD uint32_t getGeneration() const;
+
+    NO_DISCARD RangeAllocator const& getVertexRanges() const;
+    NO_DISCARD RangeAllocator const& getIndexRanges() const;
+
+  private:
+    struct PendingCopy {
+      util::ptr<Buffer> vertStaging;
+      util::ptr<Buffer> indexStaging;
+      Allocation        dest;
+    };
+
+    // Freed while a frame may still be reading it
+    struct Retired {
+      uint64_t          frame;
+      Allocation        range;
+      util::ptr<Buffer> buffer;
+    };
+
+    void reserve(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+    util::ptr<Buffer> m_vertexBuff;
+    util::ptr<Buffer> m_indexBuff;
+
+    // buffers replaced by a grow, copied from & released on the next flush
+    util::ptr<Buffer> m_oldVertexBuff;
+    util::ptr<Buffer> m_oldIndexBuff;
+    uint32_t          m_oldVertexCount{0};
+    uint32_t          m_oldIndexCount{0};
+
+    RangeAllocator m_vertexRanges;
+    RangeAllocator m_indexRanges;
+
+    std::vector<PendingCopy> m_pending;
+    std::vector<Retired>     m_retired;
+    uint64_t                 m_frame{0};
+    uint32_t                 m_generation{0};
+  };
+}
+
+#endif
@@ -54,6 +54,7 @@ namespace dw {
     std::vector<VkVertexInputAttributeDescription> m_attribs;
     std::vector<VkPipelineShaderStageCreateInfo> m_shaders;
     std::vector<VkPipelineColorBlendAttachmentState> m_colorBlendStates;
+    std::vector<VkDynamicState> m_dynamicStates;
 
     /* What can be dynamic in a graphics pipeline:
      *  - Viewport              ViewportState
@@ -164,7 +165,7 @@ namespace dw {
     GraphicsPipelineCreator& setAttachments(std::vector<VkPipelineColorBlendAttachmentState> const& attachments);;
 
     // DYNAMIC
-    // TODO
+    GraphicsPipelineCreator& setDynamicStates(std::vector<VkDynamicState> const& states); // Default: none
 
     // SHADER STAGES
     GraphicsPipelineCreator& addShaderStage(VkPipelineShaderStageCreateInfo const& info);
@@ -167,6 +167,12 @@ namespace dw {
     ~DependentImage() override;
 
     void back(MemoryAllocator& allocator, VkMemoryPropertyFlags memFlags);
+
+    // Binds memory that something else owns & frees, e.g. the render graph sharing it between
+    // transient images
+    void bind(VkDeviceMemory memory, VkDeviceSize offset);
+    NO_DISCARD VkMemoryRequirements getMemoryRequirements() const;
+
     void* map();
     void unMap();
 
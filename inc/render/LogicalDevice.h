@@ -22,6 +22,8 @@
 
 #include "PhysicalDevice.h"
 
+#include <limits>
+
 #define DEVICE_DEPENDENT_FUNCTION(varName, x) \
   NO_DISCARD LogicalDevice& getOwningDevice() const {return (varName).getOwningDevice();} \
   PHYSICAL_DEPENDENT_FUNCTION(varName, x)
@@ -83,6 +85,10 @@ namespace dw {
      * \param useRequested
      *    If this is false, then requestedFeatures will be ignored, skipping
      *    a for-loop. Set to false if there are no optional features.
+     *
+     * \param next
+     *    Chained onto VkDeviceCreateInfo::pNext, for enabling extension
+     *    features (e.g. VkPhysicalDeviceDescriptorIndexingFeaturesEXT).
      */
     LogicalDevice(PhysicalDevice&                 physical,
                   std::vector<const char*> const& layers,
@@ -90,7 +96,8 @@ namespace dw {
                   QueueList const&                queues,
                   VkPhysicalDeviceFeatures        requiredFeatures,
                   VkPhysicalDeviceFeatures const& requestedFeatures,
-                  bool                            useRequested = true);
+                  bool                            useRequested = true,
+                  const void*                     next         = nullptr);
 
     ~LogicalDevice();
 
@@ -101,6 +108,20 @@ namespace dw {
     NO_DISCARD Queue& getBestQueue(VkQueueFlagBits flag);
     NO_DISCARD Queue& getPresentableQueue(Surface& surface);
 
+    // VK_KHR_timeline_semaphore; only there if it was one of the extensions
+    NO_DISCARD bool     hasTimelineSemaphores() const;
+    NO_DISCARD uint64_t getTimelineValue(VkSemaphore timeline) const;
+
+    // Waits until every timeline has reached its value. False if it timed out first.
+    bool waitTimelines(uint32_t           count,
+                       VkSemaphore const* timelines,
+                       uint64_t const*    values,
+                       uint64_t           timeout = std::numeric_limits<uint64_t>::max()) const;
+
+    // Every pipeline created on the device goes through it; null until the renderer sets one
+    void                       setPipelineCache(VkPipelineCache cache);
+    NO_DISCARD VkPipelineCache getPipelineCache() const;
+
     //NO_DISCARD CommandPool* createCommandPool(uint32_t queueFamilyIndex,
     //                                          bool     indivCmdBfrResetable = true,
     //                                          bool     frequentRecording    = false) const;
@@ -108,6 +129,10 @@ namespace dw {
   private:
     VkDevice                        m_device;
     std::vector<std::vector<Queue>> m_queues;
+    VkPipelineCache                 m_pipelineCache{nullptr};
+
+    PFN_vkWaitSemaphoresKHR           m_waitSemaphores{nullptr};
+    PFN_vkGetSemaphoreCounterValueKHR m_getSemaphoreCounterValue{nullptr};
     static Queue m_badQueue;
     //uint32_t                        m_graphicsQFamily;
     //uint32_t                        m_presentQFamily;
@@ -22,6 +22,7 @@ namespace dw {
     MemoryAllocator(PhysicalDevice& physDev);
   
     NO_DISCARD uint32_t GetAppropriateMemType(uint32_t filter, VkMemoryPropertyFlags memProps) const;
+    NO_DISCARD bool     HasAppropriateMemType(uint32_t filter, VkMemoryPropertyFlags memProps) const;
   };
 }
 
@@ -3,7 +3,7 @@
 // * Copyright (C) DigiPen Institute of Technology 2019
 // * 
 // * Created     : 2019y 09m 25d
-// * Last Altered: 2019y 09m 25d
+// * Last Altered: 2020y 03m 02d
 // * 
 // * Author      : David Walker
 // * E-mail      : d.walker\@digipen.edu
@@ -19,15 +19,12 @@
 #ifndef DW_MESH_H
 #define DW_MESH_H
 
-#include "Buffer.h"
+#include "GeometryArena.h"
 #include "Vertex.h"
 #include "obj/Material.h"
 #include "util/Utils.h"
 
 namespace dw {
-  class Queue;
-  class CommandBuffer;
-
   class Mesh {
   public:
     Mesh(std::vector<Vertex> vertices = {}, std::vector<uint32_t> indices = {});
@@ -44,9 +41,6 @@ namespace dw {
 
     NO_DISCARD util::ptr<Material> getMaterial() const;
 
-    NO_DISCARD Buffer& getVertexBuffer() const;
-    NO_DISCARD Buffer& getIndexBuffer() const;
-
     NO_DISCARD size_t getNumVertices() const;
     NO_DISCARD size_t getNumIndices() const;
 
@@ -60,42 +54,20 @@ namespace dw {
 
     NO_DISCARD std::string const& getName() const;
 
-    // TODO: These can be better.
-    // I'd like to be able to have two functions overall:
-    // upload(cmdBuff, queue) -> uploads & submits everything.
-    // upload(cmdBuff) -> uploads to staging buffers, adds commands to the command buffer,
-    //                    but doesn't submit to a queue. this is for adding more cmds to the
-    //                    queue before submitting to create bigger batches
-    //void uploadStaging(Buffer& vertStage, Buffer& indexStage);
-
-    // returns the staging buffers that are used. these staging buffers should be kept alive
-    // until cmdBuff has finished executing on the queue. assumes cmdBuff has been started already
-
-    /*  UPLOAD [CmdBuff, Queue] -> All in one. Uploads & submits queue
-     *  UPLOAD [CmdBuff]        -> Uploads but no submit. Returns staging buffers.
-     *
-     *  CREATE BUFFERS -> Creates vertex/index buffers.
-     *  CREATE STAGING -> Creates staging buffers and returns them.
-     *  UPLOAD STAGING -> Uploads the vertex data onto the staging buffers.
-     *  UPLOAD COMMANDS -> Puts the copy commands onto the command buffer.
-     */
-
-    // vertex, index
-    using StagingBuffs = std::pair<Buffer, Buffer>;
-
-    void                    createBuffers(LogicalDevice& device);
-    NO_DISCARD StagingBuffs createStaging(LogicalDevice& device) const;
+    // model space bounding sphere. xyz = center, w = radius
+    NO_DISCARD glm::vec4 const& getBoundingSphere() const;
 
-    NO_DISCARD StagingBuffs createAllBuffs(LogicalDevice& device) {
-      createBuffers(device);
-      return createStaging(device);
-    };
+    // Where this mesh lives inside of the renderer's geometry arena.
+    // Draw with vkCmdDrawIndexed(indexCount, n, firstIndex, vertexOffset, 0).
+    NO_DISCARD GeometryArena::Allocation const& getRange() const;
 
-    void uploadStaging(StagingBuffs& buffs);
-    void uploadCmds(CommandBuffer& cmdBuff, StagingBuffs& staging) const;
+    // Reserves a range in the arena & queues the vertex/index data to be copied in on
+    // the arena's next flush. Does nothing if the mesh is already resident.
+    void upload(util::ptr<GeometryArena> const& arena);
 
-    NO_DISCARD StagingBuffs upload(CommandBuffer& cmdBuff);
-    void                    upload(CommandBuffer& cmdBuff, Queue& queue);
+    // gives the range back to the arena. the cpu-side cache is untouched, so the mesh
+    // can be uploaded again later
+    void release();
 
     // clears out the cached vertices/indices
     void clearCache();
@@ -107,8 +79,9 @@ namespace dw {
   private:
     std::vector<Vertex>   m_vertices;
     std::vector<uint32_t> m_indices;
-    util::ptr<Buffer> m_vertexBuff;
-    util::ptr<Buffer> m_indexBuff;
+    GeometryArena::Allocation m_range;
+    std::weak_ptr<GeometryArena> m_arena;
+    glm::vec4 m_bounds{ 0.f };
     util::ptr<Material> m_material;
     std::string m_name;
   };
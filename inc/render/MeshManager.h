@@ -15,6 +15,7 @@
 #define DW_MESH_MANAGER_H
 
 #include "Mesh.h"
+#include "VertexWelder.h"
 
 #include <unordered_map>
 
@@ -41,11 +42,21 @@ namespace dw {
 
     util::ptr<Mesh> getMesh(MeshKey key);
 
-    MeshKey load(std::string const& filename, bool flipWinding = false);
+    // Vertices are welded before normals/tangents are computed. By default only exact
+    // duplicates are merged; set an epsilon to also weld near-coincident ones.
+    MeshKey load(std::string const& filename, bool flipWinding = false, VertexWelder::Options const& weld = {});
+
+    // drops the mesh & hands its range in the geometry arena back to the free list.
+    // objects still holding the mesh keep it alive (and resident) until they let go.
+    void unload(MeshKey key);
 
     void clear();
 
   private:
+    // welds & traces the result
+    static void weld(std::string const& name, std::vector<Vertex>& verts, std::vector<uint32_t>& indices,
+                     VertexWelder::Options const& options = {});
+
     util::Ref<MaterialManager> m_materialLoader;
     MeshMap m_loadedMeshes;
     MeshKey m_curKey{ 0 };
@@ -0,0 +1,74 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : ObjLoader.h
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 05d
+// * Last Altered: 2020y 03m 05d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description : OBJ/MTL reader used by MeshManager::load. The file is mapped,
+// *               cut into line-aligned chunks that are parsed on their own
+// *               threads, then stitched together into de-duplicated vertices.
+
+#ifndef DW_OBJ_LOADER_H
+#define DW_OBJ_LOADER_H
+
+#include "Vertex.h"
+#include "util/Utils.h"
+
+#include <tiny_obj_loader.h>
+
+#include <string>
+#include <vector>
+
+namespace dw {
+  // A run of faces sharing a group name & material. Split on g, o and usemtl.
+  struct ObjShape {
+    std::string name;
+    uint32_t    firstIndex{0};
+    uint32_t    indexCount{0};
+    int         materialID{-1}; // into ObjData::materials, -1 if none
+  };
+
+  struct ObjData {
+    std::vector<Vertex>   vertices;
+    std::vector<uint32_t> indices;
+    std::vector<ObjShape> shapes;
+
+    // tinyobj's material record is kept as the material description MaterialManager loads from
+    std::vector<tinyobj::material_t> materials;
+
+    bool   hasNormals{false};
+    bool   hasTexCoords{false};
+    size_t duplicatesSaved{0};
+  };
+
+  class ObjLoader {
+  public:
+    // files smaller than this are parsed on the calling thread only
+    static constexpr size_t MIN_CHUNK_SIZE = 1u << 16;
+
+    // Faces are triangulated as fans. Vertices are unique (position, uv, normal) index
+    // combinations, positions only being shared where the file shares them.
+    // mtlDirectory is prepended to mtllib names without a separator, like tinyobj's base dir.
+    // Returns false and fills err if the file can't be read or references missing data.
+    static bool Load(std::string const& filename,
+                     std::string const& mtlDirectory,
+                     ObjData&           out,
+                     std::string*       warn,
+                     std::string*       err);
+
+    // Appends every newmtl in the file. Returns false if the file can't be opened.
+    static bool LoadMtl(std::string const&                filename,
+                        std::vector<tinyobj::material_t>& materials,
+                        std::string*                      warn);
+
+    // Times Load against tinyobj::LoadObj for every .obj in the directory and traces the results
+    static void Benchmark(std::string const& directory, std::string const& mtlDirectory, int iterations = 3);
+  };
+}
+
+#endif
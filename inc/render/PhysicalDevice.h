@@ -55,6 +55,10 @@ namespace dw {
     NO_DISCARD std::vector<std::string> const& getAvailableExtensions() const;
     NO_DISCARD std::vector<std::string> const& getAvailableLayers() const;
     NO_DISCARD const VkPhysicalDeviceLimits& getLimits() const;
+    NO_DISCARD VkPhysicalDeviceProperties const& getProperties() const;
+
+    // deviceUUID & driverUUID; what a pipeline cache saved to disk is checked against
+    NO_DISCARD VkPhysicalDeviceIDProperties const& getIDProperties() const;
 
     NO_DISCARD uint32_t pickMemoryType(VkMemoryPropertyFlagBits memoryRequired,
                                           VkFlags                  required,
@@ -69,6 +73,22 @@ namespace dw {
 
     NO_DISCARD VkFormatProperties getFormatProperties(VkFormat format) const;
 
+    // Only filled in if VK_EXT_descriptor_indexing is available
+    NO_DISCARD VkPhysicalDeviceDescriptorIndexingFeaturesEXT const& getDescriptorIndexingFeatures() const;
+    NO_DISCARD VkPhysicalDeviceDescriptorIndexingPropertiesEXT const& getDescriptorIndexingProperties() const;
+
+    NO_DISCARD bool hasExtension(const char* name) const;
+
+    // Whether a large, partially bound, update-after-bind array of sampled images
+    // indexed with non-uniform indices can be used (see GeometryStep)
+    NO_DISCARD bool supportsBindlessTextures() const;
+
+    // VK_KHR_timeline_semaphore, which every Queue's timeline needs
+    NO_DISCARD bool supportsTimelineSemaphores() const;
+
+    // multiDrawIndirect & drawIndirectFirstInstance, which the batched indirect draws need
+    NO_DISCARD bool supportsIndirectDraws() const;
+
   private:
     friend class VulkanControl;
     friend class LogicalDevice;
@@ -77,6 +97,9 @@ namespace dw {
     void queryExtensions();
     void queryLayers();
     void queryQueueFamilies();
+    void queryDescriptorIndexing();
+    void queryTimelineSemaphores();
+    void queryIDProperties();
 
     VkPhysicalDevice m_device{nullptr};
 
@@ -84,6 +107,19 @@ namespace dw {
     VkPhysicalDeviceFeatures         m_features{};
     VkPhysicalDeviceMemoryProperties m_memProps{};
 
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT   m_indexingFeatures{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT
+    };
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT m_indexingProperties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT
+    };
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR    m_timelineFeatures{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR
+    };
+    VkPhysicalDeviceIDProperties                    m_idProperties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES
+    };
+
     std::vector<VkQueueFamilyProperties> m_queueFamilies;
 
     std::vector<std::string> m_extensions;
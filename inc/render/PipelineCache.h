@@ -0,0 +1,63 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : PipelineCache.h
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 17d
+// * Last Altered: 2020y 03m 17d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description : A VkPipelineCache that's loaded from & saved back to disk, so
+// *               the driver doesn't compile every pipeline from scratch each run.
+
+#ifndef DW_PIPELINE_CACHE_H
+#define DW_PIPELINE_CACHE_H
+
+#include "LogicalDevice.h"
+
+#include <filesystem>
+
+namespace dw {
+  // The file's data is only handed to the driver if it was saved by the same device (UUID) &
+  // driver version; anything else starts the cache out empty.
+  CREATE_DEVICE_DEPENDENT(PipelineCache)
+  public:
+    PipelineCache(LogicalDevice& device, std::filesystem::path path);
+    ~PipelineCache();
+
+    // Throws if the file can't be written
+    void save() const;
+
+    NO_DISCARD std::filesystem::path const& getPath() const;
+    NO_DISCARD size_t getLoadedBytes() const; //!< 0 if the cache started out empty
+
+    operator VkPipelineCache() const;
+
+    MOVE_CONSTRUCT_ONLY(PipelineCache);
+
+  private:
+    // What's written ahead of the driver's data
+    struct FileHeader {
+      uint32_t magic;
+      uint32_t vendorID;
+      uint32_t deviceID;
+      uint32_t driverVersion;
+      uint8_t  deviceUUID[VK_UUID_SIZE];
+      uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+      uint64_t dataSize;
+    };
+
+    static constexpr uint32_t MAGIC = 0x43505744; //!< "DWPC"
+
+    NO_DISCARD FileHeader makeHeader(uint64_t dataSize) const;
+    NO_DISCARD std::vector<char> readFile() const;
+
+    std::filesystem::path m_path;
+    VkPipelineCache       m_cache{nullptr};
+    size_t                m_loadedBytes{0};
+  };
+}
+
+#endif
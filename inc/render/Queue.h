@@ -22,34 +22,49 @@
 #include "LogicalDevice.h"
 #include "util/Utils.h"
 
+#include <deque>
+#include <functional>
+
 namespace dw {
   class CommandBuffer;
 
+  // Every submission signals the queue's timeline semaphore with the next value, so anything can
+  // wait on a submission, on the CPU or on another queue, by its value. Any number of them can be
+  // in flight at once.
   class Queue {
   public:
     Queue(uint32_t family);
 
     operator VkQueue() const;
 
-    // wait until the queue is idle
+    // wait until the queue is idle, then retire everything
     void waitIdle();
 
-    // waits until the current submission is done
-    void waitSubmit();
+    // Returns the timeline value the submission signals. The info's own semaphores have to be binary.
+    uint64_t submitOne(CommandBuffer const&                     buffer,
+                       std::vector<VkSemaphore> const&          waitSemaphores   = {},
+                       std::vector<VkPipelineStageFlags> const& waitSemStages    = {},
+                       std::vector<VkSemaphore> const&          signalSemaphores = {});
+
+    uint64_t submit(VkSubmitInfo const& info);
+
+    // For submit infos built elsewhere, like the render graph's: the value the next one has to
+    // signal the timeline with. Values have to be submitted in the order they're handed out.
+    NO_DISCARD uint64_t nextValue();
 
-    void submitOne(CommandBuffer const&                     buffer,
-                   std::vector<VkSemaphore> const&          waitSemaphores   = {},
-                   std::vector<VkPipelineStageFlags> const& waitSemStages    = {},
-                   std::vector<VkSemaphore> const&          signalSemaphores = {});
+    NO_DISCARD VkSemaphore getTimeline() const;
+    NO_DISCARD uint64_t    getSubmitted() const; //!< The last value handed out
+    NO_DISCARD uint64_t    getCompleted() const;
 
-    void submitOne(VkSubmitInfo const& info);
-    void submitOne(VkSubmitInfo const& info, VkFence fence);
+    // False if it timed out first
+    bool wait(uint64_t value, uint64_t timeout = std::numeric_limits<uint64_t>::max()) const;
 
-    // this is kinda slow as i need to make a new vector of just
-    // VkCommandBuffers in order to build a single submit info
-    //void submitMulti(std::vector<CommandBuffer*> const& buffers);
+    // Holds on to release until the timeline reaches value, then runs & drops it. Whatever it
+    // captures, like staging buffers, lives until then.
+    void retire(uint64_t value, std::function<void()> release);
 
-    void submitMulti(std::vector<VkSubmitInfo> const& infos);
+    // Runs every release whose value has been reached
+    void collect();
 
     //void present();
 
@@ -58,9 +73,6 @@ namespace dw {
     NO_DISCARD bool         isLocked() const;
     NO_DISCARD bool         isValid() const;
 
-    NO_DISCARD bool isSubmitting() const;
-    NO_DISCARD bool isSubmitFinished();
-
     // locks usage so the logical device cannot give out this queue
     // anymore to be used by anything else
     void lockUsage();
@@ -70,14 +82,15 @@ namespace dw {
     friend class LogicalDevice;
     void init(LogicalDevice* dev);
     void stop(const VkAllocationCallbacks* callbacks = nullptr);
-    void reset();
 
     LogicalDevice* m_device{nullptr};
     VkQueue  m_queue{nullptr};
-    VkFence  m_submitFence{nullptr};
+    VkSemaphore m_timeline{nullptr};
+    uint64_t m_submitted{0};
     uint32_t m_family{std::numeric_limits<uint32_t>::max()};
     bool     m_locked{false};
-    bool     m_submitting{false};
+
+    std::deque<std::pair<uint64_t, std::function<void()>>> m_retiring; //!< In value order
   };
 }
 
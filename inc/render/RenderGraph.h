@@ -0,0 +1,190 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : RenderGraph.h
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 14d
+// * Last Altered: 2020y 03m 14d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description : The frame's passes & the images they read and write. Works out
+// *               the barriers, layout transitions, queue ownership transfers and
+// *               timeline waits between them, and lets transient images that are
+// *               never in use at the same time share memory.
+
+#ifndef DW_RENDER_GRAPH_H
+#define DW_RENDER_GRAPH_H
+
+#include "LogicalDevice.h"
+#include "util/Utils.h"
+
+#include <string>
+#include <vector>
+
+namespace dw {
+  class CommandBuffer;
+  class CommandPool;
+  class DependentImage;
+  class Image;
+  class Queue;
+
+  // Passes are declared in an order they could run in, and two passes that touch the same image
+  // depend on each other unless both only read it, in the same layout, on the same queue family.
+  // compile() picks the order they're submitted in, starting the work other queues wait for as
+  // early as it can so the queues overlap. Passes can be skipped from frame to frame: what waits
+  // on what comes from the whole graph, so a skipped pass never lets the ones around it overlap.
+  CREATE_DEVICE_DEPENDENT(RenderGraph)
+  public:
+    using Handle = uint32_t;
+
+    static constexpr uint32_t MAX_PASSES = 32; //!< What a pass has to wait for is a bit mask
+    static constexpr Handle   NONE       = ~0u;
+    static constexpr uint32_t TIMING_FRAMES = 240; //!< Pass timing is logged every this many frames
+
+    RenderGraph(LogicalDevice& device);
+    ~RenderGraph();
+
+    // Persistent images keep their contents, layout & queue family from one frame to the next,
+    // and start out undefined.
+    Handle addImage(std::string name, Image const& image, VkImageAspectFlags aspect);
+
+    // Transient images are only good within a frame, and mustn't have memory yet: compile()
+    // binds it, sharing it between images whose passes never overlap.
+    Handle addTransientImage(std::string name, DependentImage& image, VkImageAspectFlags aspect);
+
+    // pool is the queue's, for the barriers the graph records itself
+    Handle addPass(std::string name, Queue& queue, CommandPool& pool);
+
+    // layout is what the pass needs the image in when it starts; UNDEFINED throws its contents
+    // away (render passes that clear). leaves is the layout the pass's own commands leave it in.
+    void read(Handle pass, Handle image, VkImageLayout layout, VkPipelineStageFlags stages);
+    void write(Handle pass, Handle image, VkImageLayout layout, VkImageLayout leaves, VkPipelineStageFlags stages);
+
+    // Orders the passes & binds the transient images. Nothing can be added afterwards.
+    void compile();
+
+    // Timestamps every pass on the GPU and logs how long each queue was busy, and for how much of
+    // that another queue was too. Has to be set before compile().
+    void setTiming(bool enabled = true);
+
+    // Only call once the last executed frame is done
+    void readTiming();
+
+    // A pass only runs on the frames it's given a command buffer. Waits & signals are for the
+    // semaphores the graph doesn't own: the swapchain's binary ones, or a timeline at value, like
+    // a queue's upload.
+    void setCommandBuffer(Handle pass, VkCommandBuffer cmdBuff);
+    void addWait(Handle pass, VkSemaphore semaphore, VkPipelineStageFlags stage, uint64_t value = 0);
+    void addSignal(Handle pass, VkSemaphore semaphore);
+
+    // Records the barriers & submits the frame, one vkQueueSubmit per run of passes on the same
+    // queue. Every submit info signals its queue's timeline, and passes wait on the values of the
+    // ones on other queues they need. The frame has to be done (see wait()) before the next one
+    // is executed, and the command buffers, waits & signals are cleared for it.
+    void execute();
+
+    // Waits on the CPU for everything the last execute() submitted
+    void wait() const;
+
+    NO_DISCARD VkDeviceSize getTransientBytes() const; //!< Every transient image with its own memory
+    NO_DISCARD VkDeviceSize getAliasedBytes() const;   //!< What compile() allocated for them instead
+
+  private:
+    struct Access {
+      Handle               image;
+      VkImageLayout        layout;
+      VkImageLayout        leaves;
+      VkPipelineStageFlags stages;
+      bool                 writes;
+    };
+
+    struct Resource {
+      std::string        name;
+      VkImage            image{nullptr};
+      VkImageAspectFlags aspect{0};
+      DependentImage*    transient{nullptr};
+      uint32_t           users{0};  //!< Bit per pass
+
+      // where it's at; persistent images carry this over between frames
+      VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+      uint32_t      family{VK_QUEUE_FAMILY_IGNORED};
+    };
+
+    struct Pass {
+      std::string          name;
+      Queue*               queue{nullptr};
+      CommandPool*         pool{nullptr};
+      std::vector<Access>  accesses;
+      VkPipelineStageFlags stages{0};
+      uint32_t             reach{0}; //!< Every pass that waits for this one, directly or not
+      uint32_t             queueSlot{0};
+
+      double   timedMs{0};
+      uint32_t timedFrames{0};
+
+      CommandBuffer* pre{nullptr};  //!< Barriers before the pass; acquires images from other queues
+      CommandBuffer* post{nullptr}; //!< Releases images to other queues
+
+      // this frame
+      VkCommandBuffer                   cmdBuff{nullptr};
+      std::vector<VkSemaphore>          waits;
+      std::vector<VkPipelineStageFlags> waitStages;
+      std::vector<uint64_t>             waitValues;
+      std::vector<VkSemaphore>          signals;
+      std::vector<VkImageMemoryBarrier> barriers;
+      std::vector<VkImageMemoryBarrier> releases;
+      VkPipelineStageFlags              srcStages{0};
+      uint32_t                          waitsOn{0};   //!< Passes on other queues it waits for
+      bool                              awaited{false};
+      uint64_t                          value{0};     //!< What its submit info signals its queue's timeline with
+      bool                              hasPre{false};
+      bool                              hasPost{false};
+    };
+
+    // What a submit info points to
+    struct SubmitSync {
+      std::vector<VkSemaphore>          waits;
+      std::vector<VkPipelineStageFlags> waitStages;
+      std::vector<uint64_t>             waitValues;
+      std::vector<VkSemaphore>          signals;
+      std::vector<uint64_t>             signalValues;
+      VkTimelineSemaphoreSubmitInfoKHR  timeline;
+    };
+
+    void addAccess(Handle pass, Access const& access);
+    void allocateTransients();
+    void recordBarriers(Handle pass);
+    void submit(uint32_t active);
+    void logTiming();
+
+    NO_DISCARD uint32_t getFamily(Pass const& pass) const;
+
+    std::vector<Pass>     m_passes;
+    std::vector<Resource> m_resources;
+    std::vector<Handle>   m_order;       //!< Submission order
+    std::vector<Queue*>   m_queues;      //!< Per queue slot; passes share a slot when they share a VkQueue
+    std::vector<uint64_t> m_frameValues; //!< Per queue slot, what the last frame signalled its timeline with
+    bool                  m_compiled{false};
+
+    std::vector<VkDeviceMemory> m_memory; //!< One per group of transient images that share it
+    VkDeviceSize                m_transientBytes{0};
+    VkDeviceSize                m_aliasedBytes{0};
+
+    std::vector<VkSubmitInfo>    m_submits;
+    std::vector<VkCommandBuffer> m_submitBuffers;
+    std::vector<SubmitSync>      m_submitSyncs; //!< One a pass at most; never resized
+
+    // timing: two timestamps a pass
+    VkQueryPool         m_queries{nullptr};
+    bool                m_timing{false};
+    uint32_t            m_timedPasses{0}; //!< What ran in the last executed frame
+    uint32_t            m_timedFrames{0};
+    double              m_frameMs{0};
+    double              m_overlapMs{0};   //!< More than one queue busy
+    std::vector<double> m_busyMs;         //!< Per queue slot
+  };
+}
+
+#endif
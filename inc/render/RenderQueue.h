@@ -0,0 +1,116 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : RenderQueue.h
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 08d
+// * Last Altered: 2020y 03m 08d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description : Draws as 64-bit sort keys + a 32-bit payload, put in order
+// *               with an LSD radix sort.
+
+#ifndef DW_RENDER_QUEUE_H
+#define DW_RENDER_QUEUE_H
+
+#include "util/Utils.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace dw {
+  // How many times each key field changes walking a queue in order
+  struct DrawStateChanges {
+    size_t passes{0};
+    size_t pipelines{0};
+    size_t meshes{0};
+    size_t materials{0};
+  };
+
+  class RenderQueue {
+  public:
+    enum Pass : uint32_t {
+      pGeometry = 0,
+      pShadow   = 1
+    };
+
+    enum Mobility : uint32_t {
+      mStatic  = 0,
+      mDynamic = 1
+    };
+
+    // Key layout, most significant first:
+    //   [63:62] pass | [61:58] pipeline | [57] mobility | [56:41] mesh | [40:25] material | [24:1] depth | [0] unused
+    // Mesh sits above material so a mesh's draws stay together whatever their material,
+    // which is what lets the shadow pass draw each mesh once. Mobility sits above mesh so
+    // every static draw comes before every dynamic one, and cached shadow layers can draw
+    // just the first run.
+    static constexpr uint32_t PASS_BITS     = 2;
+    static constexpr uint32_t PIPELINE_BITS = 4;
+    static constexpr uint32_t MOBILITY_BITS = 1;
+    static constexpr uint32_t MESH_BITS     = 16;
+    static constexpr uint32_t MATERIAL_BITS = 16;
+    static constexpr uint32_t DEPTH_BITS    = 24;
+
+    static constexpr uint32_t DEPTH_SHIFT    = 1;
+    static constexpr uint32_t MATERIAL_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+    static constexpr uint32_t MESH_SHIFT     = MATERIAL_SHIFT + MATERIAL_BITS;
+    static constexpr uint32_t MOBILITY_SHIFT = MESH_SHIFT + MESH_BITS;
+    static constexpr uint32_t PIPELINE_SHIFT = MOBILITY_SHIFT + MOBILITY_BITS;
+    static constexpr uint32_t PASS_SHIFT     = PIPELINE_SHIFT + PIPELINE_BITS;
+
+    static_assert(PASS_SHIFT + PASS_BITS == 64, "sort key fields must fill 64 bits");
+
+    // Fields wider than their bits are truncated
+    NO_DISCARD static uint64_t MakeKey(uint32_t pass,
+                                       uint32_t pipeline,
+                                       uint32_t mobility,
+                                       uint32_t mesh,
+                                       uint32_t material,
+                                       uint32_t depth = 0);
+
+    // View depth mapped onto [0, 2^DEPTH_BITS), clamped to [nearDist, farDist]. Nearer is smaller.
+    NO_DISCARD static uint32_t QuantizeDepth(float viewDepth, float nearDist, float farDist);
+
+    NO_DISCARD static uint32_t GetPass(uint64_t key);
+    NO_DISCARD static uint32_t GetPipeline(uint64_t key);
+    NO_DISCARD static uint32_t GetMobility(uint64_t key);
+    NO_DISCARD static uint32_t GetMesh(uint64_t key);
+    NO_DISCARD static uint32_t GetMaterial(uint64_t key);
+    NO_DISCARD static uint32_t GetDepth(uint64_t key);
+
+    void clear();
+    void reserve(size_t count);
+    void push(uint64_t key, uint32_t value);
+
+    // Stable, 8 bits a pass. Passes where every key has the same digit are skipped,
+    // so unused high fields (e.g. pass & pipeline, currently always 0) cost nothing.
+    void sort();
+
+    NO_DISCARD size_t   size() const;
+    NO_DISCARD bool     empty() const;
+    NO_DISCARD uint64_t getKey(size_t i) const;
+    NO_DISCARD uint32_t getValue(size_t i) const;
+
+    NO_DISCARD DrawStateChanges countStateChanges() const;
+
+    // Times sort() against std::stable_sort on random keys & traces the results
+    static void Benchmark(size_t count, int iterations = 5);
+
+  private:
+    struct Entry {
+      uint64_t key;
+      uint32_t value;
+    };
+
+    std::vector<Entry> m_entries;
+    std::vector<Entry> m_scratch;
+  };
+
+  std::ostream& operator<<(std::ostream& os, DrawStateChanges const& changes);
+}
+
+#endif
@@ -45,7 +45,18 @@ namespace dw {
   CREATE_DEVICE_DEPENDENT(RenderStep)
   public:
     static constexpr unsigned NUM_EXPECTED_GBUFFER_IMAGES = 3;
-    static constexpr unsigned MAX_MATERIALS               = 4;
+    static constexpr unsigned NUM_SAMPLED_GBUFFER_IMAGES  = NUM_EXPECTED_GBUFFER_IMAGES + 1; // + depth
+
+    // COMPACT_GBUFFER in gbuffer.glsl, a VkBool32. Matches GBUFFER_LAYOUT_CONSTANT_ID in defines.glsl.
+    static constexpr uint32_t                 GBUFFER_LAYOUT_CONSTANT_ID = 10;
+    static constexpr VkSpecializationMapEntry GBUFFER_LAYOUT_ENTRY       = {
+      GBUFFER_LAYOUT_CONSTANT_ID, 0, sizeof(VkBool32)
+    };
+
+    // Size of the geometry pass's texture table. Bindless is further limited by the device;
+    // the fallback has to match FALLBACK_TEXTURE_SLOTS in defines.glsl.
+    static constexpr unsigned MAX_BINDLESS_TEXTURE_SLOTS  = 1u << 14;
+    static constexpr unsigned FALLBACK_TEXTURE_SLOTS      = 64;
 
     RenderStep(LogicalDevice& device);
 
@@ -67,12 +78,19 @@ namespace dw {
     NO_DISCARD VkPipelineLayout  getLayout() const;
 
   protected:
-    static void renderScene(CommandBuffer&             commandBuff,
-                            VkRenderPassBeginInfo&     beginInfo,
-                            Scene::ObjContainer const& scene,
-                            uint32_t                   alignment,
-                            VkPipelineLayout           layout,
-                            VkDescriptorSet            descriptorSet);
+    // For pipelines made with a dynamic viewport & scissor, which survive the window resizing.
+    // Both cover area; flipY makes the viewport's y go up.
+    static void setViewport(CommandBuffer& commandBuff, VkRect2D const& area, bool flipY = false);
+
+    // Draws indirect commands [firstDraw, firstDraw + drawCount) from the indirect buffer
+    static void renderScene(CommandBuffer&         commandBuff,
+                            VkRenderPassBeginInfo& beginInfo,
+                            GeometryArena const&   arena,
+                            Buffer const&          indirect,
+                            uint32_t               firstDraw,
+                            uint32_t               drawCount,
+                            VkPipelineLayout       layout,
+                            VkDescriptorSet        descriptorSet);
 
     friend class Renderer;
     VkPipelineLayout      m_layout{nullptr};
@@ -126,6 +144,12 @@ namespace dw {
    *  - Output framebuffer:
    *    + 3x R32G32B32A32 SFLOAT
    *    + 1x D24_S8
+   *
+   * Materials live in a storage buffer indexed by material ID, and their maps are
+   * slots into one texture table. With descriptor indexing ("bindless") the table is
+   * partially bound & update-after-bind, so textures can be added under recorded
+   * command buffers. Without it, the table is FALLBACK_TEXTURE_SLOTS wide, every slot
+   * must be written, and writing it means re-recording.
    */
 
   class GeometryStep : public RenderStep {
@@ -133,7 +157,7 @@ namespace dw {
   public:
   MOVE_CONSTRUCT_ONLY(GeometryStep);
 
-    GeometryStep(LogicalDevice& device, CommandPool& pool);
+    GeometryStep(LogicalDevice& device, CommandPool& pool, bool bindless, uint32_t textureSlots, GBufferLayout layout);
     ~GeometryStep() override = default;
 
     void setupRenderPass(std::vector<util::Ref<Image>> const& images) override;
@@ -142,18 +166,25 @@ namespace dw {
     void setupShaders() override;
 
     // fb = output framebuffer from renderpass
-    void writeCmdBuff(Framebuffer&               fb,
-                      Scene::ObjContainer const& scene,
-                      uint32_t                   alignment,
-                      VkRect2D                   renderArea = {}) const;
-
-    void updateDescriptorSets(Buffer&                  modelUBO,
-                              Buffer&                  cameraUBO,
-                              Buffer&                  mtlUBO,
-                              Buffer&                  shaderControlUBO,
-                              MaterialManager::MtlMap& materialMap,
-                              VkSampler                sampler) const;
-
+    void writeCmdBuff(Framebuffer&         fb,
+                      GeometryArena const& arena,
+                      Buffer const&        indirect,
+                      uint32_t             firstDraw,
+                      uint32_t             drawCount,
+                      VkRect2D             renderArea = {}) const;
+
+    void updateDescriptorSets(Buffer& cameraUBO,
+                              Buffer& objectBuffer,
+                              Buffer& materialBuffer,
+                              Buffer& shaderControlUBO) const;
+
+    // Writes each loaded texture into its slot of the texture table. Without descriptor
+    // indexing every slot must be valid, so the rest are given the default texture.
+    void updateTextureTable(TextureManager::TexMap const& textures,
+                            VkSampler                     sampler,
+                            VkImageView                   defaultTexture) const;
+
+    NO_DISCARD bool isBindless() const;
     NO_DISCARD CommandBuffer& getCommandBuffer() const;
 
   private:
@@ -161,6 +192,9 @@ namespace dw {
     util::ptr<IShader>       m_fragmentShader;
     util::Ref<CommandBuffer> m_cmdBuff;
     VkDescriptorSet          m_descriptorSet{nullptr};
+    bool                     m_bindless{false};
+    uint32_t                 m_textureSlots{0};
+    GBufferLayout            m_gbufferLayout{GBufferLayout::Full};
   };
 
   class ShadowMapStep : public RenderStep {
@@ -168,6 +202,10 @@ namespace dw {
   public:
   MOVE_CONSTRUCT_ONLY(ShadowMapStep);
 
+    // 4MSM moments after the paper's optimized quantization; see moments.glsl
+    static constexpr VkFormat MOMENT_FORMAT = VK_FORMAT_R16G16B16A16_UNORM;
+    static constexpr float    MOMENT_CLEAR  = 0.035955884801f; //!< What depth 0 encodes to in x; y, z & w are 0
+
     ShadowMapStep(LogicalDevice& device, CommandPool& pool);
     ~ShadowMapStep() override = default;
 
@@ -177,12 +215,21 @@ namespace dw {
     void setupPipelineLayout(VkPipelineLayout layout = nullptr) override;
     void setupShaders() override;
 
+    // Two passes, each drawing every map at once: staticCount commands from firstDraw redraw
+    // the static layers into staticAtlas, the static layers are copied into atlas, then
+    // drawCount commands after them draw into it. Each command is one mesh instanced over the
+    // routes the renderer writes between frames. Which tiles are cleared & copied follows each
+    // light's m_update.
     void writeCmdBuff(std::vector<Renderer::ShadowMappedLight> const& lights,
-                      Scene::ObjContainer const&                      scene,
-                      uint32_t                                        alignment,
-                      VkRect2D                                        renderArea = {}) const;
+                      Framebuffer const&                              atlas,
+                      Framebuffer const&                              staticAtlas,
+                      GeometryArena const&                            arena,
+                      Buffer const&                                   indirect,
+                      uint32_t                                        firstDraw,
+                      uint32_t                                        staticCount,
+                      uint32_t                                        drawCount) const;
 
-    void updateDescriptorSets(Buffer& modelUBO, Buffer& lightsUBO) const;
+    void updateDescriptorSets(Buffer& lightsUBO, Buffer& objectBuffer, Buffer& routes) const;
 
     NO_DISCARD CommandBuffer& getCommandBuffer() const;
 
@@ -191,6 +238,9 @@ namespace dw {
     util::ptr<IShader>       m_fragmentShader;
     util::Ref<CommandBuffer> m_cmdBuff;
     VkDescriptorSet          m_descriptorSet{nullptr};
+
+    // Compatible with m_pass, which draws the live atlas, so it shares its pipeline & framebuffers
+    util::ptr<RenderPass>    m_staticPass;  //!< Left ready to be copied from
   };
 
   class BlurStep : public RenderStep {
@@ -208,9 +258,14 @@ namespace dw {
     void setupDescriptors() override;
     void setupShaders() override;
 
+    // Blurs the tiles drawn this frame, in place, through intermediaryImg (the atlas's size).
+    // With a query pool, it's timestamped into its first two queries.
     void writeCmdBuff(std::vector<Renderer::ShadowMappedLight> const& lights,
+                      DependentImage const&                           atlasImg,
+                      ImageView&                                      atlasView,
                       DependentImage&                                 intermediaryImg,
-                      ImageView&                                      intermediaryView);
+                      ImageView&                                      intermediaryView,
+                      VkQueryPool                                     timestamps = nullptr);
 
     NO_DISCARD CommandBuffer& getCommandBuffer() const;
 
@@ -237,10 +292,53 @@ namespace dw {
     //VkDescriptorSet          m_descriptorSet_y{ nullptr };
   };
 
+  // Builds a summed-area table of each shadow map tile drawn this frame: every texel holds the sum
+  // of the moments above & left of it in its tile, so any box of them can be summed from 4 reads.
+  // The sums are integers (the moments are 16 bit unorm) and wrap around, which keeps the
+  // differences exact for any box of up to 65536 texels.
+  class SummedAreaStep : public RenderStep {
+    friend class Renderer;
+  public:
+    static constexpr VkFormat TABLE_FORMAT = VK_FORMAT_R32G32B32A32_UINT;
+    static constexpr uint32_t GROUP_SIZE   = 128; //!< Invocations per row or column; sat_x/y.comp's local size
+
+  MOVE_CONSTRUCT_ONLY(SummedAreaStep);
+
+    SummedAreaStep(LogicalDevice& device, CommandPool& pool);
+    ~SummedAreaStep() override;
+
+    void setupRenderPass(std::vector<util::Ref<Image>> const& images) override;
+    void setupPipelineLayout(VkPipelineLayout layout = nullptr) override;
+    void setupPipeline(VkExtent2D extent) override;
+    void setupDescriptors() override;
+    void setupShaders() override;
+
+    // Rows first, from the atlas into the table, then columns in place. The table stays in
+    // VK_IMAGE_LAYOUT_GENERAL. With a query pool, it's timestamped into its first two queries.
+    void writeCmdBuff(std::vector<Renderer::ShadowMappedLight> const& lights,
+                      DependentImage const&                           atlasImg,
+                      ImageView&                                      atlasView,
+                      DependentImage const&                           tableImg,
+                      ImageView&                                      tableView,
+                      VkQueryPool                                     timestamps = nullptr);
+
+    NO_DISCARD CommandBuffer& getCommandBuffer() const;
+
+  private:
+    void updateDescriptorSet(ImageView& atlas, ImageView& table) const;
+
+    util::ptr<IShader>       m_sat_x;
+    util::ptr<IShader>       m_sat_y;
+    util::Ref<CommandBuffer> m_cmdBuff;
+    VkPipeline               m_compute_x{nullptr};
+    VkPipeline               m_compute_y{nullptr};
+    VkDescriptorSet          m_descriptorSet{nullptr};
+  };
+
   class GlobalLightStep : public RenderStep {
     friend class Renderer;
   public:
-    static constexpr uint32_t MAX_GLOBAL_LIGHTS = 2;
+    static constexpr uint32_t MAX_SHADOW_MAPS = 32; // atlas tiles: global lights, one per cascade for directional ones
     static constexpr uint32_t MAX_IMPORTANCE_SAMPLES = 32;
 
     struct ImportanceSampleUBO {
@@ -250,7 +348,7 @@ namespace dw {
 
   MOVE_CONSTRUCT_ONLY(GlobalLightStep);
 
-    GlobalLightStep(LogicalDevice& device, CommandPool& pool);
+    GlobalLightStep(LogicalDevice& device, CommandPool& pool, GBufferLayout layout);
     ~GlobalLightStep() override = default;
 
     void setupRenderPass(std::vector<util::Ref<Image>> const& images) override;
@@ -259,10 +357,12 @@ namespace dw {
     void setupDescriptors() override;
     void setupShaders() override;
 
-    void writeCmdBuff(Framebuffer& fb, VkRect2D renderArea = {}) const;
+    // With a query pool, the pass is timestamped into queries 2 & 3 (the shadow filter has 0 & 1)
+    void writeCmdBuff(Framebuffer& fb, VkRect2D renderArea = {}, VkQueryPool timestamps = nullptr) const;
 
     void updateDescriptorSets(std::vector<ImageView> const&                   gbufferViews,
-                              std::vector<Renderer::ShadowMappedLight> const& lights,
+                              ImageView&                                      shadowAtlas,
+                              ImageView&                                      shadowSAT,
                               ImageView&                                      backgroundImg,
                               ImageView&                                      irradianceImg,
                               Buffer&                                         cameraUBO,
@@ -278,26 +378,31 @@ namespace dw {
     util::ptr<IShader>       m_fragmentShader;
     util::Ref<CommandBuffer> m_cmdBuff;
     VkDescriptorSet          m_descriptorSet{nullptr};
+    GBufferLayout            m_gbufferLayout{GBufferLayout::Full};
   };
 
+  // Local lighting, ambient & final are subpasses of FinalStep's render pass: these two make their
+  // pipelines for it & record into its command buffers, and have no render pass of their own.
   class LocalLightingStep : public RenderStep {
     friend class Renderer;
   public:
     static constexpr uint32_t MAX_LOCAL_LIGHTS = 128;
     MOVE_CONSTRUCT_ONLY(LocalLightingStep);
 
-    LocalLightingStep(LogicalDevice& device, CommandPool& pool);
+    LocalLightingStep(LogicalDevice& device, GBufferLayout layout);
     ~LocalLightingStep() override = default;
 
+    // the render pass is FinalStep's, set with the overload below
     void setupRenderPass(std::vector<util::Ref<Image>> const& images) override;
+    void setupRenderPass(util::ptr<RenderPass> const& pass, uint32_t subpass);
     void setupPipeline(VkExtent2D extent) override;
     void setupDescriptors() override;
     void setupShaders() override;
 
-    void writeCmdBuff(Framebuffer&    fb,
-      Image const&                    previousImage,
-      VkRect2D                        renderArea = {});
+    // Draws into the current subpass of a started render pass
+    void writeSubpass(CommandBuffer& commandBuffer) const;
 
+    // previousImage is global lighting's, read as an input attachment
     void updateDescriptorSets(std::vector<ImageView> const& gbufferViews,
       ImageView const& previousImage,
       Buffer& cameraUBO,
@@ -305,12 +410,12 @@ namespace dw {
       Buffer& shaderControlUBO,
       VkSampler sampler);
 
-    NO_DISCARD CommandBuffer& getCommandBuffer();
   private:
     util::ptr<IShader>       m_vertexShader;
     util::ptr<IShader>       m_fragmentShader;
-    util::Ref<CommandBuffer> m_cmdBuff;
     VkDescriptorSet          m_descriptorSet{ nullptr };
+    uint32_t                 m_subpass{ 0 };
+    GBufferLayout            m_gbufferLayout{ GBufferLayout::Full };
   };
 
   class AmbientStep : public RenderStep {
@@ -318,44 +423,69 @@ namespace dw {
   public:
     MOVE_CONSTRUCT_ONLY(AmbientStep);
 
-    AmbientStep(LogicalDevice& device, CommandPool& pool);
+    AmbientStep(LogicalDevice& device, GBufferLayout layout);
     ~AmbientStep() override = default;
 
+    // the render pass is FinalStep's, set with the overload below
     void setupRenderPass(std::vector<util::Ref<Image>> const& images) override;
+    void setupRenderPass(util::ptr<RenderPass> const& pass, uint32_t subpass);
     void setupPipeline(VkExtent2D extent) override;
     void setupDescriptors() override;
     void setupShaders() override;
 
-    void writeCmdBuff(Framebuffer const& fb,
-      VkRect2D                        renderArea = {});
+    // Draws into the current subpass of a started render pass
+    void writeSubpass(CommandBuffer& commandBuffer) const;
 
-    void updateDescriptorSets(ImageView const& gbuffPosition, ImageView const& gbuffNormal,
+    void updateDescriptorSets(std::vector<ImageView> const& gbufferViews,
+      Buffer&                       cameraUBO,
       VkSampler                     sampler);
 
-    NO_DISCARD CommandBuffer& getCommandBuffer() const;
-
   private:
     util::ptr<IShader>       m_vertexShader;
     util::ptr<IShader>       m_fragmentShader;
-    util::Ref<CommandBuffer> m_cmdBuff;
     VkDescriptorSet          m_descriptorSet{ nullptr };
+    uint32_t                 m_subpass{ 0 };
+    GBufferLayout            m_gbufferLayout{ GBufferLayout::Full };
   };
 
+  // One render pass from global lighting's image to the swapchain's, so the lighting images can
+  // stay in tile memory:
+  //  0: local lighting, reading global lighting's image as an input attachment
+  //  1: ambient, into a transient image
+  //  2: FXAA, into the swapchain image. It reads local lighting's neighbours, so it waits for all
+  //     of subpass 0 rather than just its own pixels.
+  //  3: ImGui, with DW_USE_IMGUI
   class FinalStep : public RenderStep {
     friend class Renderer;
   public:
+    static constexpr uint32_t LOCAL_LIGHTING_SUBPASS = 0;
+    static constexpr uint32_t AMBIENT_SUBPASS        = 1;
+    static constexpr uint32_t FXAA_SUBPASS           = 2;
+    static constexpr uint32_t IMGUI_SUBPASS          = 3; //!< Hard-coded in imgui_impl_vulkan.cpp
+
+    // attachment indices; the swapchain framebuffers' views go in this order
+    enum Attachment : uint32_t {
+      atSwapchain,
+      atGlobalLit,
+      atLocalLit,
+      atAmbient,
+      atCount
+    };
+
     MOVE_CONSTRUCT_ONLY(FinalStep);
 
     FinalStep(LogicalDevice& device, CommandPool& pool, uint32_t numSwapchainImages);
     ~FinalStep() override = default;
 
+    // images are the swapchain's, global lighting's, local lighting's & ambient's, in that order
     void setupRenderPass(std::vector<util::Ref<Image>> const& images) override;
     void setupPipeline(VkExtent2D extent) override;
     void setupDescriptors() override;
     void setupShaders() override;
 
     void writeCmdBuff(std::vector<Framebuffer> const& fbs,
-                      Image const&                    previousImage,
+                      LocalLightingStep const&        localLighting,
+                      AmbientStep const&              ambient,
                       VkRect2D                        renderArea = {},
                       uint32_t                        image      = ~0u);
 
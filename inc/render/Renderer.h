@@ -20,8 +20,14 @@
 #define DW_RENDERER_H
 
 #include "RenderPass.h"
+#include "Framebuffer.h"
+#include "RenderGraph.h"
+#include "PipelineCache.h"
 #include "MeshManager.h"
 #include "Texture.h"
+#include "RenderQueue.h"
+#include "ShadowCascades.h"
+#include "ShadowAtlas.h"
 
 #include "obj/Object.h"
 #include "obj/Camera.h"
@@ -32,13 +38,17 @@
 #include "app/Scene.h"
 #include "app/ImGui.h"
 
+#include <chrono>
+#include <future>
 #include <unordered_map>
+#include <utility>
 
 namespace dw {
   //class Camera;
   class GeometryStep;
   class ShadowMapStep;
   class BlurStep;
+  class SummedAreaStep;
   class GlobalLightStep;
   class LocalLightingStep;
   class AmbientStep;
@@ -55,15 +65,18 @@ namespace dw {
   class CommandPool;
   class CommandBuffer;
   class Buffer;
+  class GeometryArena;
   class IShader;
   class Image;
   class DependentImage;
   class ImageView;
   class Framebuffer;
 
-  struct ObjectUniform {
-    alignas(16) glm::mat4 model;
-    alignas(04) int mtlIndex;
+  // How the geometry pass packs its three targets; data/shaders/inc/gbuffer.glsl has the details.
+  enum class GBufferLayout {
+    Full,    //!< RGBA32F position, normal & color: 48 bytes a pixel + depth
+    Compact  //!< RGBA8 material, RG16 octahedral normal, RGBA8 sRGB albedo: 12 bytes a pixel + depth.
+             //!< Position is rebuilt from depth.
   };
 
   struct CameraUniform {
@@ -73,38 +86,152 @@ namespace dw {
     alignas(16) glm::vec3 viewVec;
     alignas(04) float farDist;
     alignas(04) float nearDist;
+    alignas(16) glm::mat4 invViewProj; //!< For rebuilding positions from depth
   };
 
+  // One per drawn object in the object storage buffer, fetched in the vertex shaders with
+  // gl_InstanceIndex. Tightly packed to match OBJECT_DATA_FLOATS in defines.glsl.
+  struct ObjectData {
+    glm::vec4 modelRows[3]; //!< Top three rows of the model matrix; the last is always 0 0 0 1
+    uint32_t  mtlIndex{ 0 };
+  };
+
+  static_assert(sizeof(ObjectData) == 13 * sizeof(float), "ObjectData must match OBJECT_DATA_FLOATS");
+
   class Renderer {
   public:
     // initialize
     void init(GLFWWindow* window, bool startImgui = true);
 
+    // Remakes everything that goes with the window, steps & pipelines included, e.g. for a new
+    // g-buffer layout
     void restartWindow();
 
+    // Remakes the swapchain & the images sized to it, keeping the steps, their pipelines & the
+    // scene. False while the window has no area (minimized); nothing's changed, try again later.
+    bool resizeWindow();
+
     NO_DISCARD bool done() const;
 
-    void uploadMeshes(MeshManager::MeshMap& meshes) const;
+    void uploadMeshes(MeshManager::MeshMap& meshes);
     void uploadMaterials(MaterialManager::MtlMap& materials);
-    void uploadTextures(TextureManager::TexMap& textures) const;
+    void uploadTextures(TextureManager::TexMap& textures);
 
+    // Swaps the scene in between frames. What it draws from is built by prepareScene(), or kept
+    // from when the scene was last set; if neither, it's built here, which is the slow part.
     void setScene(util::ptr<Scene> scene);
 
-    void drawFrame() const;
+    // Builds the scene's draw groups, shadow maps & buffers on a worker thread, so setScene() only
+    // has to swap them in. The worker builds from a snapshot taken here, so the scene can be edited
+    // meanwhile; the build is then stale & setScene() builds again.
+    void prepareScene(util::ptr<Scene> scene);
+    NO_DISCARD bool isScenePrepared(util::ptr<Scene> const& scene) const; //!< setScene() wouldn't build or wait
+
+    // GPU memory the prepared scenes may keep between them, the live one's counted first. The
+    // least recently prepared or set are evicted first; 0 keeps nothing but the live scene.
+    void setSceneBudget(VkDeviceSize bytes);
+    NO_DISCARD VkDeviceSize getSceneBudget() const { return m_sceneBudget; }
+
+    // Edits to the live scene (Scene::insertObject() & co.) are applied by the next drawFrame(),
+    // costing what the edit touches rather than what the scene holds. This logs how long they
+    // took, & how many object slots were uploaded, every EDIT_LOG_FRAMES frames that had some.
+    void setSceneEditLogging(bool enabled = true) { m_editLogging = enabled; }
+
+    void drawFrame();
     void displayLogo(util::ptr<ImageView> logoView) const;
 
     void shutdown(bool shutdownImgui = true);
 
+    // One shadow map: a tile of the shadow atlas. A directional light with cascades gets one
+    // of these per cascade. The tile's size follows how much of the screen the light can reach.
+    //
+    // Static casters are drawn into the same tile of the static atlas, which is kept until one
+    // of them, the map's matrices, or its tile change. The map itself is that layer copied in,
+    // the dynamic casters drawn over it, then blurred. Filtered moments can't be depth tested
+    // against each other, so the blur has to run on the composite; a map with no dynamic
+    // casters in it isn't touched at all.
     struct ShadowMappedLight {
-      ShadowMappedLight(ShadowedLight const& light);
+      static constexpr uint32_t NO_CASCADE = ~0u;
+
+      // What the map needs this frame
+      enum class Update {
+        None,     //!< Nothing it shows changed; last frame's map is used as is
+        Dynamic,  //!< Static layer copied in, dynamic casters drawn over it, blurred
+        Full,     //!< As Dynamic, with the static layer redrawn first
+        Uncached  //!< Every caster drawn straight into the map, caching is off
+      };
+
+      ShadowMappedLight(ShadowedLight const& light, uint32_t cascadeSet = NO_CASCADE, uint32_t cascade = 0);
 
       ShadowedLight m_light;
-      util::ptr<Framebuffer> m_depthBuffer;
+      ShadowAtlas::Tile m_tile; //!< Where it is in both atlases; no tile, no shadows
+      ShadowAtlas::Tile m_recordedTile;
+      float m_importance{ 0 };  //!< Who gives up texels first when the atlas is full
+      uint32_t m_cascadeSet;  //!< The light's entry in m_shadowCascades, or NO_CASCADE for a perspective map
+      uint32_t m_cascade;     //!< Which of the light's cascades this map holds
+      ShadowedUBO m_ubo;      //!< This frame's matrices & ranges, as the shaders see them
+
+      Update m_update{ Update::Full };
+      Update m_recordedUpdate{ Update::Full }; //!< What the shadow & blur command buffers do for it
+      bool m_staticValid{ false };
+      bool m_hasDynamic{ false };              //!< The map has dynamic casters drawn into it
+      glm::mat4 m_staticView{ 1 };             //!< Matrices the static layer was drawn with
+      glm::mat4 m_staticProj{ 1 };
+    };
+
+    // Directional global lights get cascadeCount orthographic maps fitted to the camera's view out
+    // to maxDistance; other global lights get one perspective map. Every map is a tile of one
+    // atlas, the largest that fits in memoryBudget, and is resized each frame to how much of the
+    // screen it covers.
+    //
+    // Blur filters the maps with the separable blur as they're drawn, so they're sampled as they
+    // are. SummedArea builds a summed-area table of them instead, and global lighting box filters
+    // that with a radius of its own choosing per pixel, for the same cost at any radius.
+    enum class ShadowFilter {
+      Blur,
+      SummedArea
+    };
+
+    struct ShadowSettings {
+      uint32_t     cascadeCount{ 4 };              //!< Per directional light, up to MAX_CASCADES. 0 = no cascades
+      float        splitLambda{ 0.75f };           //!< 0 = uniform splits, 1 = logarithmic
+      float        maxDistance{ 60.f };            //!< Camera view depth the last cascade ends at
+      VkDeviceSize memoryBudget{ 256ull << 20 };   //!< Bytes, for the atlas & everything sized with it
+      ShadowFilter filter{ ShadowFilter::Blur };
+    };
+
+    // A run of objects in the object buffer that share a mesh & material.
+    // Each one gets a VkDrawIndexedIndirectCommand in the indirect buffer.
+    // Its slots past instanceCount are room to add more without moving it.
+    struct DrawGroup {
+      GeometryArena::Allocation range;
+      uint32_t mtlID{ 0 };
+      uint32_t firstInstance{ 0 };
+      uint32_t instanceCount{ 0 };
+      uint32_t capacity{ 0 };
+      uint64_t key{ 0 };  //!< Its instances' sort key, without depth
+    };
+
+    // FIFO waits for the vblank & never tears. FIFO_RELAXED tears a late frame instead of holding it
+    // a whole refresh, MAILBOX replaces a queued image with a newer one, and IMMEDIATE shows every
+    // frame right away, tearing. Anything the surface doesn't support falls back to FIFO.
+    struct PresentSettings {
+      VkPresentModeKHR mode{ VK_PRESENT_MODE_IMMEDIATE_KHR };
+      uint32_t         imageCount{ 0 };  //!< 0 = one more than the surface's minimum
+    };
+
+    // What the last drawFrame() waited on, for pacing the CPU against the GPU & the display.
+    // Frames are numbered as they're submitted; waitFrame() notes when each one's seen done.
+    struct FrameWaits {
+      double   blockedMs{ 0 };  //!< On the frame before it, the next swapchain image & present
+      uint64_t submitted{ 0 };  //!< The last frame submitted
+      uint64_t done{ 0 };       //!< The last frame seen done, at doneTime
+      std::chrono::high_resolution_clock::time_point doneTime;
     };
 
     // contains control
     struct ShaderControl {
-      alignas(04) float global_momentBias {0.00000005f};
+      alignas(04) float global_momentBias {0.00003f};    // 16 bit moments need a lot more than 32 bit floats did
       alignas(04) float global_depthBias  {0.0004f};
       alignas(04) float geometry_defaultRoughness{ 0.16f };
       alignas(04) float geometry_defaultMetallic { 0.08f };
@@ -115,6 +242,9 @@ namespace dw {
       alignas(04) int   global_enableShadows{ 1 };
       alignas(04) int   global_enableIBL{ 1 };
       alignas(04) int   global_enableBackgrounds{ 1 };
+      alignas(04) float global_shadowFilterRadius{ 4.f }; // summed-area filtering: texels, in the biggest tile
+      alignas(04) int   global_variablePenumbra{ 1 };     // summed-area filtering: widen with the blocker distance
+      alignas(04) int   global_summedAreaShadows{ 0 };    // set by the renderer from ShadowSettings::filter
     };
 
     void setShaderControl(ShaderControl* control);
@@ -126,8 +256,57 @@ namespace dw {
     void setShadowMapBlurEnabled(bool enabled = true) { m_blurEnabled = enabled; }
     void setGlobalLightingEnabled(bool enabled = true) { m_globalLightEnabled = enabled; }
 
+    // Takes effect on the next init() or restartWindow()
+    void setGBufferLayout(GBufferLayout layout) { m_gbufferLayout = layout; }
+    NO_DISCARD GBufferLayout getGBufferLayout() const { return m_gbufferLayout; }
+
+    // Off redraws every caster into every shadow map each frame
+    void setShadowCachingEnabled(bool enabled = true) { m_shadowCaching = enabled; }
+
+    // Takes effect on the next setScene()
+    void setShadowSettings(ShadowSettings const& settings) { m_shadowSettings = settings; }
+    NO_DISCARD ShadowSettings const& getShadowSettings() const { return m_shadowSettings; }
+
+    // GPU milliseconds summed over the frames timed, see setShadowFilterTiming()
+    struct ShadowFilterTiming {
+      double   filterMs{ 0 };
+      double   lightingMs{ 0 };
+      uint32_t filteredFrames{ 0 }; //!< Frames the filter had something to filter
+      uint32_t timedFrames{ 0 };
+    };
+
+    // Times the shadow filter & global lighting on the GPU. Takes effect on the next setScene()
+    void setShadowFilterTiming(bool enabled = true) { m_filterTiming = enabled; }
+
+    // What's been timed since the last call, which starts it over
+    NO_DISCARD ShadowFilterTiming takeShadowFilterTiming() { return std::exchange(m_filterTimes, {}); }
+
+    // Off puts the shadow filter on the graphics queue. Takes effect on the next init() or restartWindow()
+    void setAsyncComputeEnabled(bool enabled = true) { m_asyncCompute = enabled; }
+
+    // Times every pass on the GPU, logging how long each queue was busy and how much of it
+    // overlapped. Takes effect on the next init() or restartWindow()
+    void setFrameTiming(bool enabled = true) { m_frameTiming = enabled; }
+
+    // Takes effect on the next init(), restartWindow() or resizeWindow()
+    void setPresentSettings(PresentSettings const& settings) { m_presentSettings = settings; }
+    NO_DISCARD PresentSettings const& getPresentSettings() const { return m_presentSettings; }
+    NO_DISCARD VkPresentModeKHR getPresentMode() const; //!< What the swapchain ended up with
+
+    NO_DISCARD FrameWaits const& getFrameWaits() const { return m_frameWaits; }
+
   private:
-    static constexpr VkExtent3D SHADOW_DEPTH_MAP_EXTENT = { 1024, 1024, 1 };
+    static constexpr uint32_t MIN_SHADOW_ATLAS_SIZE = 1024;
+    static constexpr uint32_t MAX_SHADOW_ATLAS_SIZE = 8192;
+    static constexpr uint32_t MIN_SHADOW_TILE_SIZE = 64;   //!< The biggest tile is half the atlas
+    static constexpr uint32_t SHADOW_ROUTE_MAP_BITS = 5;   //!< Shadow routes are slot << 5 | map; defines.glsl has a copy
+    static constexpr VkDeviceSize SHADOW_MOMENT_BYTES = 8; //!< RGBA16 moments, see ShadowMapStep::MOMENT_FORMAT
+    static constexpr VkDeviceSize SHADOW_TEXEL_BYTES = SHADOW_MOMENT_BYTES + 4; //!< + D24S8
+    static constexpr VkDeviceSize SHADOW_SAT_BYTES = 16;   //!< RGBA32UI summed-area table, see SummedAreaStep
+    static constexpr uint32_t EDIT_LOG_FRAMES = 240;       //!< Frames per scene edit log
+    static constexpr uint32_t MIN_GROUP_CAPACITY = 8;      //!< Slots a group that's added to starts with
+    static constexpr uint32_t SLOT_SLACK = 4;              //!< Slots are compacted past this many per instance
+    static constexpr uint32_t NO_INSTANCE = ~0u;
 
     //////////////////////////////////////////////////////
     //////////////////////////////////////////////////////
@@ -143,18 +322,132 @@ namespace dw {
 
     // specific to the rendering engine & what i support setup
     void setupSamplers();
+    void setupDefaultTexture();
     void setupUniformBuffers();
     void setupFrameBufferImages();
+    void setupBlurIntermediate();
     void setupRenderSteps();
-    void setupFrameBuffers() const;
+    void setupFrameGraph();
+    void setupFrameBuffers();
     void transitionRenderImages() const;
 
+    // What a scene's prepared with, so a prepared scene that no longer matches it is built again
+    struct SceneKey {
+      uint64_t revision{ 0 };
+      uint32_t cascadeCount{ 0 };  //!< ShadowSettings::cascadeCount
+
+      bool operator==(SceneKey const& o) const { return revision == o.revision && cascadeCount == o.cascadeCount; }
+    };
+
+    // Everything setScene() needs for one scene that doesn't depend on the window or the shadow
+    // atlas. It's the renderer's own scene state, moved out: setScene() swaps it in member by
+    // member, and what was live goes back to the cache.
+    struct PreparedScene {
+      util::ptr<Scene> scene;
+      SceneKey         key;
+      VkDeviceSize     bytes{ 0 };  //!< The buffers below
+      DrawStateChanges sceneOrder{};  //!< These three describe the build; not swapped
+      DrawStateChanges sorted{};
+      double           buildMs{ 0 };
+      bool             swapped{ false }; //!< Holds what was live once, so the three above aren't its own
+
+      std::vector<ShadowMappedLight> globalLights;
+      std::vector<ShadowCascades> shadowCascades;
+      uint32_t cascadesPerLight{ 0 };
+      std::vector<DrawGroup> drawGroups;
+      std::vector<VkDrawIndexedIndirectCommand> shadowDraws;
+      uint32_t numShadowDraws{ 0 };
+      uint32_t numStaticShadowDraws{ 0 };
+      std::vector<util::ptr<obj::Object>> instanceObjects;
+      std::vector<Scene::Handle> instanceHandles;
+      std::vector<uint64_t> instanceKeys;
+      std::vector<uint32_t> instanceGroups;
+      std::vector<uint32_t> handleInstances;
+      std::unordered_map<uint64_t, uint32_t> groupOfKey;
+      std::unordered_map<uint32_t, uint32_t> meshIndices;
+      uint32_t slotEnd{ 0 };
+      uint32_t staticInstances{ 0 };
+
+      RenderQueue frameQueue;
+      RenderQueue groupQueue;
+      std::vector<glm::mat4> frameModels;
+      std::vector<glm::vec4> frameBounds;
+      std::vector<glm::vec4> slotSpheres;
+      std::vector<uint32_t> casterMasks;
+      std::vector<uint32_t> groupBack;
+
+      util::ptr<Buffer> objectBuffer;
+      util::ptr<Buffer> indirectBuffer;
+      util::ptr<Buffer> shadowRoutes;
+    };
+
+    // What buildScene() reads of a scene, copied on the main thread so a worker never touches
+    // the scene or its objects while they're edited
+    struct SceneSnapshot {
+      struct Instance {
+        util::ptr<obj::Object>    object;
+        Scene::Handle             handle;
+        GeometryArena::Allocation range;
+        uint32_t                  materialID;
+        bool                      isStatic;
+      };
+
+      util::ptr<Scene>           scene;      //!< Only handed on to the PreparedScene, never read
+      uint64_t                   revision{ 0 };
+      uint32_t                   objectSlots{ 0 };
+      std::vector<ShadowedLight> globalLights;
+      std::vector<Instance>      instances;  //!< The drawable objects, in scene order
+    };
+
+    // One scene in the cache: built, or still building
+    struct SceneSlot {
+      util::ptr<Scene> scene;
+      util::ptr<PreparedScene> prepared;
+      std::future<util::ptr<PreparedScene>> building;
+    };
+
     // specific to the current scene
-    void releasePreviousDynamicUniforms();
-    void prepareDynamicUniformBuffers();
+    NO_DISCARD SceneKey getSceneKey(Scene const& scene) const;
+    NO_DISCARD bool keepsLive(util::ptr<Scene> const& scene) const;
+
+    // Only reads the snapshot & the settings it's given, so it can run on any thread
+    NO_DISCARD static SceneSnapshot TakeSnapshot(util::ptr<Scene> const& scene);
+    NO_DISCARD util::ptr<PreparedScene> buildScene(SceneSnapshot const& snapshot, ShadowSettings settings) const;
+    void prepareDrawGroups(PreparedScene& prepared, SceneSnapshot const& snapshot) const;
+    static void BuildShadowMaps(std::vector<ShadowedLight> const& shadowLights,
+                                uint32_t                          cascadeCount,
+                                std::vector<ShadowMappedLight>&   maps,
+                                std::vector<ShadowCascades>&      cascadeSets,
+                                uint32_t&                         cascadesPerLight);
+    static void BuildShadowDraws(std::vector<DrawGroup> const&              groups,
+                                 std::vector<VkDrawIndexedIndirectCommand>& draws,
+                                 uint32_t&                                  numStatic);
+
+    // The live scene's edits, between frames
+    void applySceneEdits();
+    void addInstance(Scene::Handle handle, util::ptr<obj::Object> const& object);
+    void removeInstance(Scene::Handle handle);
+    void compactSlots();
+    void logSceneEdits();
+
+    void swapScene(PreparedScene& prepared);
+    NO_DISCARD util::ptr<PreparedScene> takePreparedScene(util::ptr<Scene> const& scene);
+    void evictScenes();
+    void resizeShadowMaps(uint32_t size);
+    void recordShadowCommands();
+    void recordWindowCommands(); // everything that reads or draws the window-sized images
+    void readFilterTimestamps(bool filtered);
+
+    // Waits for the frame in flight, if there is one, and retires what the queues are done with.
+    // Anything that writes what a frame reads, or records its command buffers, calls this first.
+    void waitFrame();
+
+    // called every frame, once the slots are laid out & before the buffers are written
+    void updateShadowMaps();
+    void assignShadowTiles();
 
     // called every frame
-    void updateUniformBuffers(uint32_t imageIndex) const;// , Camera& cam, Object& obj);
+    void updateUniformBuffers(uint32_t imageIndex);// , Camera& cam, Object& obj);
 
     void setupWindow();
     void shutdownWindow();
@@ -182,6 +475,7 @@ namespace dw {
     VulkanControl* m_control{ nullptr };
     GLFWWindow* m_window{ nullptr };
     LogicalDevice* m_device{ nullptr };
+    util::ptr<PipelineCache> m_pipelineCache{ nullptr }; //!< Saved to disk at shutdown
 
     util::ptr<Surface> m_surface{ nullptr };
     util::ptr<Swapchain> m_swapchain{ nullptr };
@@ -203,61 +497,150 @@ namespace dw {
 
     // global
     VkSampler m_sampler{ nullptr };       //!< Sampler used for sampling the gbuffer
-    util::ptr<Buffer> m_modelUBO;         //!< Contains all model matrices for objects in scene
+    util::ptr<DependentImage> m_defaultTexture{ nullptr };  //!< 1x1 white; fills unused texture table slots
+    util::ptr<ImageView> m_defaultTextureView{ nullptr };
+    util::ptr<Buffer> m_objectBuffer;     //!< Per-object ObjectData, ordered by draw group
+    util::ptr<Buffer> m_indirectBuffer;   //!< Geometry pass draw commands, then shadow pass commands
+    util::ptr<Buffer> m_shadowRoutes;     //!< The (slot, map) each shadow pass instance draws
     util::ptr<Buffer> m_cameraUBO;        //!< Contains rendering camera info
     util::ptr<Buffer> m_localLightsUBO;   //!< Contains all local light info
     util::ptr<Buffer> m_globalLightsUBO;  //!< Contains all global (shadow mapped) light info
     util::ptr<Buffer> m_globalImportanceUBO;
-    util::ptr<Buffer> m_materialsUBO;     //!< Contains the coefficients for the materials
+    util::ptr<Buffer> m_materialBuffer;   //!< Material::MaterialData, indexed by material ID
+    util::ptr<GeometryArena> m_geometryArena; //!< Vertex & index buffers shared by every mesh
     // TODO: not this this is hacky
     MaterialManager::MtlMap* m_materials {nullptr};
+    TextureManager::TexMap* m_textures {nullptr};
+
+    bool m_bindless{ false };      //!< Whether the texture table uses descriptor indexing
+    uint32_t m_textureSlots{ 0 };  //!< Size of the texture table
+
+    GBufferLayout m_gbufferLayout{ GBufferLayout::Full };
+    ShadowSettings m_shadowSettings;
+    VkExtent3D m_shadowAtlasExtent{ 2048, 2048, 1 };
 
     bool m_blurEnabled{ true };
+    bool m_shadowCaching{ true };
     bool m_globalLightEnabled{ true };
     // bool m_ambientLightEnabled{ true };
 
     // logo display pass
     util::ptr<SplashScreenStep> m_splashScreenStep;
+    std::vector<Framebuffer> m_splashFramebuffers; //!< The swapchain's, with just its image
 
     // gbuffer/deferred pass
     util::ptr<GeometryStep> m_geometryStep;
     util::ptr<Framebuffer> m_gbuffer{ nullptr };
-    VkSemaphore m_deferredSemaphore{ nullptr };
 
     // shadow map pass
     util::ptr<ShadowMapStep> m_shadowMapStep;
-    VkSemaphore m_shadowSemaphore{ nullptr };
+    util::ptr<Framebuffer> m_shadowAtlas;       //!< Every shadow map, sampled by global lighting
+    util::ptr<Framebuffer> m_staticShadowAtlas; //!< Every map's cached static layer, unblurred
+    ShadowAtlas m_atlasTiles;
 
     // blur pass
     util::ptr<BlurStep> m_blurStep{ nullptr };
     util::ptr<DependentImage> m_blurIntermediate{ nullptr };
     util::ptr<ImageView> m_blurIntermediateView{ nullptr };
-    VkSemaphore m_blurSemaphore{ nullptr };
+
+    // summed-area table pass, instead of the blur
+    util::ptr<SummedAreaStep> m_summedAreaStep{ nullptr };
+    util::ptr<DependentImage> m_shadowSAT{ nullptr };   //!< Atlas-sized; 1x1 while the blur filters
+    util::ptr<ImageView> m_shadowSATView{ nullptr };
+    ShadowFilter m_atlasFilter{ ShadowFilter::Blur };   //!< The filter the atlas was last built for
+
+    // filter timing: the filter's two timestamps, then global lighting's
+    VkQueryPool m_filterQueries{ nullptr };
+    bool m_filterTiming{ false };
+    ShadowFilterTiming m_filterTimes{};
+
+    bool m_asyncCompute{ true };
+    bool m_frameTiming{ false };
+
+    PresentSettings m_presentSettings{};
+    FrameWaits m_frameWaits{};
 
     // global lighting pass
     util::ptr<GlobalLightStep> m_globalLightStep;
     util::ptr<Framebuffer> m_globalLitFrameBuffer;
-    VkSemaphore m_globalLightSemaphore{ nullptr };
 
-    // local lighting pass
+    // local lighting, ambient & the final fsq: subpasses of the final step's render pass, so the
+    // swapchain framebuffers hold their images too
     util::ptr<LocalLightingStep> m_localLightStep;
-    util::ptr<Framebuffer> m_localLitFramebuffer;
-    VkSemaphore m_localLightSemaphore{ nullptr };
-
-    // ambient pass
+    util::ptr<DependentImage> m_localLitImage{ nullptr };  //!< Transient; FXAA samples it within the pass
+    util::ptr<ImageView> m_localLitView{ nullptr };
     util::ptr<AmbientStep> m_ambientStep;
-    util::ptr<Framebuffer> m_ambientFramebuffer;
-    VkSemaphore m_ambientSemaphore{ nullptr };
-
-    // final fsq pass
+    util::ptr<DependentImage> m_ambientImage{ nullptr };   //!< Never leaves the pass; lazily allocated if it can be
+    util::ptr<ImageView> m_ambientView{ nullptr };
     util::ptr<FinalStep> m_finalStep;
-    VkSemaphore m_finalSemaphore{ nullptr };
 
-    // Scene variables
+    // The frame's passes & the images between them. Rebuilt with the shadow atlas; the g-buffer
+    // & lighting images are transient.
+    util::ptr<RenderGraph> m_frameGraph;
+    RenderGraph::Handle m_geometryPass{ RenderGraph::NONE };
+    RenderGraph::Handle m_shadowPass{ RenderGraph::NONE };
+    RenderGraph::Handle m_filterPass{ RenderGraph::NONE };  //!< The blur or the summed-area table
+    RenderGraph::Handle m_globalLightPass{ RenderGraph::NONE };
+    RenderGraph::Handle m_finalPass{ RenderGraph::NONE };       //!< Local lighting, ambient & FXAA
+    bool m_framePending{ false };     //!< Submitted, and not waited on yet
+    bool m_frameFiltered{ false };
+    uint64_t m_meshUpload{ 0 };       //!< The transfer queue's timeline value for the last mesh upload
+
+    // Scene variables. setScene() swaps these with a PreparedScene, along with the object, indirect
+    // & route buffers; the flags that carry the shadow maps from frame to frame stay.
     util::ptr<Scene> m_scene{ nullptr };
+    SceneKey m_sceneKey{};
+    VkDeviceSize m_sceneBytes{ 0 };
     std::vector<ShadowMappedLight> m_globalLights;
-    size_t m_modelUBOdynamicAlignment {0};
-    ObjectUniform* m_modelUBOdata = nullptr;
+    std::vector<DrawGroup> m_drawGroups;
+    uint32_t m_numShadowDraws{ 0 };        //!< Commands in the live shadow pass, after the static pass's
+    uint32_t m_numStaticShadowDraws{ 0 };  //!< Commands in the static shadow pass, after the geometry ones
+    bool m_staticCastersMoved{ true };     //!< A static object moved since the cached layers were drawn
+    bool m_shadowWork{ true };             //!< Some shadow map is drawn this frame
+    bool m_shadowsBlurred{ true };         //!< Whether the maps were last blurred
+    std::vector<VkDrawIndexedIndirectCommand> m_shadowDraws; //!< One per run of a mesh's groups, covering their instances
+    std::vector<ShadowCascades> m_shadowCascades;            //!< One per cascaded directional light
+    uint32_t m_cascadesPerLight{ 0 };
+    // Instances are in no particular order; each frame writes them into their group's slots
+    std::vector<util::ptr<obj::Object>> m_instanceObjects;
+    std::vector<Scene::Handle> m_instanceHandles;
+    std::vector<uint64_t> m_instanceKeys;  //!< Sort key (without depth) for each instance
+    std::vector<uint32_t> m_instanceGroups;//!< Draw group for each instance
+    std::vector<uint32_t> m_handleInstances;  //!< By Scene::GetSlot(), NO_INSTANCE if it isn't drawn
+    std::unordered_map<uint64_t, uint32_t> m_groupOfKey;
+    std::unordered_map<uint32_t, uint32_t> m_meshIndices; //!< Sort key mesh by the mesh's first index in the arena
+    uint32_t m_slotEnd{ 0 };               //!< Past the last group's slots; the object buffer holds at least this many
+    uint32_t m_staticInstances{ 0 };
+
+    // Per-frame scratch for culling & sorting
+    RenderQueue m_frameQueue;              //!< Visible instances, by (mesh, material) then front-to-back
+    RenderQueue m_groupQueue;              //!< Geometry draw groups by their nearest visible instance
+    std::vector<glm::mat4> m_frameModels;
+    std::vector<glm::vec4> m_frameBounds;  //!< World space bounding sphere of each instance
+    std::vector<glm::vec4> m_slotSpheres;  //!< World space bounds of the instance in each slot, for caster culling
+    std::vector<uint32_t> m_casterMasks;   //!< Shadow maps the instance in each slot casts into, a bit each
+    std::vector<uint32_t> m_groupBack;
+
+    // What the next frame's object, indirect & route buffers hold, & what the live scene's buffers
+    // were last written with; only the runs that differ are copied over
+    std::vector<ObjectData> m_frameObjects;
+    std::vector<ObjectData> m_writtenObjects;
+    std::vector<VkDrawIndexedIndirectCommand> m_frameCommands;
+    std::vector<VkDrawIndexedIndirectCommand> m_writtenCommands;
+    std::vector<uint32_t> m_frameRoutes;
+    std::vector<uint32_t> m_writtenRoutes;
+
+    std::vector<SceneSlot> m_sceneCache;       //!< Least recently used first; never the live scene
+    VkDeviceSize m_sceneBudget{ 128ull << 20 };
+
+    // scene edit logging
+    bool m_editLogging{ false };
+    uint32_t m_editFrames{ 0 };
+    uint32_t m_editCount{ 0 };
+    uint32_t m_editRebinds{ 0 };  //!< Frames that re-recorded the geometry & shadow passes
+    size_t m_slotsWritten{ 0 };   //!< Object slots copied to the buffer
+    double m_editMs{ 0 };
+    double m_maxEditMs{ 0 };
 
     // Specific, per-swapchain-image variables
 
@@ -20,6 +20,10 @@
 #define DW_SHADER_H
 
 #include "LogicalDevice.h"
+#include "util/Utils.h"
+
+#include <functional>
+#include <string>
 
 namespace dw {
   CREATE_DEVICE_DEPENDENT(ShaderModule) 
@@ -83,6 +87,18 @@ namespace dw {
 
     MOVE_CONSTRUCT_ONLY(Shader)
   };
+
+  // Every step that loads the same file for the same stage shares one shader (e.g. fsq_vert.spv),
+  // for as long as one of them still holds onto it
+  template<ShaderStage TStage>
+  util::ptr<IShader> LoadShader(LogicalDevice& device, std::string const& filename);
+
+  namespace detail {
+    util::ptr<IShader> LoadCachedShader(LogicalDevice&                             device,
+                                        ShaderStage                                stage,
+                                        std::string const&                         filename,
+                                        std::function<util::ptr<IShader>()> const& create);
+  }
 }
 
 #include "Shader.inl"
@@ -66,6 +66,13 @@ namespace dw {
 
 #undef CREATE_GET_CREATE_INFO_FOR_SHADER
 
+  template <ShaderStage TStage>
+  util::ptr<IShader> LoadShader(LogicalDevice& device, std::string const& filename) {
+    return detail::LoadCachedShader(device, TStage, filename, [&]() -> util::ptr<IShader> {
+      return util::make_ptr<Shader<TStage>>(ShaderModule::Load(device, filename));
+    });
+  }
+
 #ifdef DW_SHADER_ALLOW_NON_MAIN_ENTRY
   template <ShaderStage TStage>
   Shader<TStage>::Shader(ShaderModule&& mod, std::string const& entryPoint)
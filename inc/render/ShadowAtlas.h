@@ -0,0 +1,59 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : ShadowAtlas.h
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 10d
+// * Last Altered: 2020y 03m 10d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description : Hands out square, power of two tiles of the shadow atlas.
+
+#ifndef DW_SHADOW_ATLAS_H
+#define DW_SHADOW_ATLAS_H
+
+#include "util/Utils.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace dw {
+  // A quadtree over the atlas: every tile is a node, and freeing the last of four siblings
+  // gives their parent back. Allocating biggest first always packs anything whose area fits.
+  class ShadowAtlas {
+  public:
+    struct Tile {
+      uint32_t x{0};
+      uint32_t y{0};
+      uint32_t size{0}; //!< Texels per side; 0 is no tile
+
+      bool operator==(Tile const& o) const { return x == o.x && y == o.y && size == o.size; }
+      bool operator!=(Tile const& o) const { return !(*this == o); }
+    };
+
+    // Frees everything. size & minTile are powers of two.
+    void reset(uint32_t size, uint32_t minTile);
+
+    // Takes the free tile nearest the atlas's corner, splitting a bigger one if it has to
+    bool allocate(uint32_t size, Tile& tile);
+    void release(Tile const& tile);
+
+    // Tile size n levels down from the whole atlas
+    NO_DISCARD uint32_t getTileSize(uint32_t level) const;
+    NO_DISCARD uint32_t getLevel(uint32_t tileSize) const;
+    NO_DISCARD uint32_t getMaxLevel() const;
+    NO_DISCARD uint32_t getSize() const;
+
+  private:
+    struct Node {
+      uint32_t x, y;
+    };
+
+    std::vector<std::vector<Node>> m_free; //!< Free tiles by level
+    uint32_t m_size{0};
+  };
+}
+
+#endif
@@ -0,0 +1,78 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : ShadowCascades.h
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 10d
+// * Last Altered: 2020y 03m 10d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description : Fits a directional light's cascaded shadow maps to the camera,
+// *               once a frame.
+
+#ifndef DW_SHADOW_CASCADES_H
+#define DW_SHADOW_CASCADES_H
+
+#include "util/MyMath.h"
+#include "util/Utils.h"
+
+#include <array>
+#include <cstdint>
+
+namespace dw {
+  class ShadowCascades {
+  public:
+    static constexpr uint32_t MAX_CASCADES = 4;
+
+    struct Cascade {
+      glm::mat4 view{1};         //!< The light's rotation; shared by every cascade
+      glm::mat4 proj{1};         //!< Orthographic, built by finish()
+      float     splitNear{0};    //!< Camera view depth range the cascade covers
+      float     splitFar{0};
+      glm::vec3 center{0};       //!< Light space center of the slice's bounding sphere, snapped to texels
+      float     radius{0};
+      float     nearDepth{0};    //!< Light space depth range: starts at the receivers, pulled in by casters
+      float     farDepth{0};
+    };
+
+    // Practical split scheme: lambda blends the logarithmic split (even texel density over depth)
+    // with the uniform one (0 = uniform, 1 = logarithmic). Writes count + 1 distances, from
+    // nearDist to farDist.
+    static void ComputeSplits(float nearDist, float farDist, uint32_t count, float lambda, float* splits);
+
+    // Splits [nearDist, farDist] of the camera's view into count slices and fits an orthographic
+    // cascade around each one's bounding sphere. The sphere only depends on the split depths &
+    // the camera's FOV, so turning the camera doesn't change a cascade's size, and its center is
+    // snapped to whole texels of its map (resolutions has one size per cascade). Together these
+    // keep the shadow edges from shimmering as the camera moves.
+    void fit(glm::vec3 const& eye,
+             glm::vec3 const& forward,
+             float            fovY,
+             float            aspect,
+             float            nearDist,
+             float            farDist,
+             glm::vec3 const& lightDir,
+             uint32_t         count,
+             float            lambda,
+             uint32_t const*  resolutions);
+
+    // Whether a world space sphere (xyz center, w radius) can cast a shadow into the cascade.
+    // If it can, the cascade's near plane is pulled back far enough to take it in.
+    bool addCaster(uint32_t cascade, glm::vec4 const& sphere);
+
+    // Builds the cascade's projection, once every caster has been added
+    void finish(uint32_t cascade);
+
+    NO_DISCARD uint32_t size() const;
+    NO_DISCARD Cascade const& operator[](uint32_t i) const;
+
+  private:
+    std::array<Cascade, MAX_CASCADES> m_cascades;
+    glm::mat4 m_lightView{1};
+    uint32_t  m_count{0};
+  };
+}
+
+#endif
@@ -32,6 +32,9 @@ namespace dw {
     operator VkSurfaceKHR() const;
 
     NO_DISCARD VkSurfaceCapabilitiesKHR const& getCapabilities() const;
+
+    // The current extent changes with the window; call before remaking the swapchain
+    void updateCapabilities();
     NO_DISCARD std::vector<VkSurfaceFormatKHR> const& getFormats() const;
     NO_DISCARD std::vector<VkPresentModeKHR> const& getPresentModes() const;
     NO_DISCARD GLFWWindow& getOwningWindow() const { return m_window; }
@@ -39,7 +42,12 @@ namespace dw {
     NO_DISCARD uint32_t getWidth() const;
     NO_DISCARD uint32_t getHeight() const;
 
-    NO_DISCARD VkPresentModeKHR choosePresentMode(bool vsync = false) const;
+    // preferred if the surface supports it, FIFO (the only one that always is) if not
+    NO_DISCARD VkPresentModeKHR choosePresentMode(VkPresentModeKHR preferred) const;
+
+    // requested clamped to what the surface allows, but at least two so one can be drawn while
+    // the other's shown. 0 asks for one more than the minimum.
+    NO_DISCARD uint32_t chooseImageCount(uint32_t requested) const;
     NO_DISCARD VkSurfaceFormatKHR const& chooseFormat() const;
     NO_DISCARD VkExtent2D chooseExtent() const;
 
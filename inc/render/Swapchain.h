@@ -30,9 +30,20 @@ namespace dw {
 
   CREATE_DEVICE_DEPENDENT(Swapchain)
   public:
-    Swapchain(LogicalDevice& device, Surface& surface, util::Ref<Queue> q);
+    // imageCount 0 takes one more than the surface's minimum; see Surface::chooseImageCount()
+    Swapchain(LogicalDevice& device,
+              Surface& surface,
+              util::Ref<Queue> q,
+              VkPresentModeKHR presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR,
+              uint32_t imageCount = 0);
     ~Swapchain();
 
+    // What restart() asks the surface for. The mode falls back to FIFO if it isn't supported.
+    void setPresentMode(VkPresentModeKHR presentMode, uint32_t imageCount = 0);
+
+    // Remakes the swapchain at the surface's current size, handing the old one over to it so the
+    // presentation engine can move between them without a gap. Everything made from the old
+    // images (views, framebuffers) goes with it, so nothing may still be using them.
     void restart();
 
     uint32_t getNextImageIndex();
@@ -52,13 +63,20 @@ namespace dw {
 
     NO_DISCARD bool isPresentReady() const;
 
+    // The surface changed under it (e.g. the window was resized) & it should be restarted. Set
+    // by getNextImageIndex(), in which case no image was acquired, & present(), instead of throwing.
+    NO_DISCARD bool isOutOfDate() const;
+
     NO_DISCARD size_t getNumImages() const;
 
+    // What it was made with, which isn't what was asked for if the surface didn't support that
+    NO_DISCARD VkPresentModeKHR getPresentMode() const;
+
     NO_DISCARD VkExtent2D getImageSize() const;
     NO_DISCARD VkFormat getImageFormat() const;
 
     void present();
-    void present(Queue const& q) const;
+    void present(Queue const& q);
 
     // creates simple framebuffers with color attachments.
     void createFramebuffers(RenderPass const& renderPass);
@@ -84,6 +102,11 @@ namespace dw {
     util::Ref<Queue> m_queue;
     VkSwapchainKHR m_swapchain{ nullptr };
     VkFormat m_imageFormat;
+    VkExtent2D m_extent{ 0, 0 };
+    VkPresentModeKHR m_requestedMode;
+    uint32_t m_requestedImages;
+    VkPresentModeKHR m_presentMode{ VK_PRESENT_MODE_FIFO_KHR };
+    bool m_outOfDate{ false };
 
     static constexpr unsigned MAX_IN_FLIGHT_IMAGE = 2;
 
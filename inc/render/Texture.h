@@ -18,6 +18,7 @@
 #include "Buffer.h"
 #include "util/Utils.h"
 #include <unordered_map>
+#include <vector>
 
 namespace dw {
   class Renderer;
@@ -27,6 +28,8 @@ namespace dw {
   public:
     using StagingBuffs = util::ptr<Buffer>;
 
+    static constexpr uint32_t NO_SLOT = ~0u;
+
     Texture() = default;
     ~Texture() = default;
 
@@ -48,6 +51,9 @@ namespace dw {
     NO_DISCARD util::ptr<DependentImage> getImage() const;
     NO_DISCARD util::ptr<ImageView> getView() const;
 
+    // Index into the geometry pass's texture table, handed out by TextureManager
+    NO_DISCARD uint32_t getSlot() const;
+
   private:
     friend class TextureManager;
 
@@ -73,6 +79,7 @@ namespace dw {
     util::ptr<RawImage>        m_raw;
     util::ptr<DependentImage>  m_image;
     util::ptr<ImageView>       m_view;
+    uint32_t                   m_slot{ NO_SLOT };
   };
 
   class TextureManager {
@@ -82,6 +89,10 @@ namespace dw {
 
     TexMap::iterator load(std::string const& filename);
 
+    // Drops the texture and recycles its slot. Only call between frames; the
+    // slot may be handed to the next texture loaded.
+    void unload(TexKey const& key);
+
     NO_DISCARD util::ptr<Texture> getTexture(TexKey);
 
     void clear();
@@ -89,8 +100,15 @@ namespace dw {
 
     TexMap const& getTextures() const;
 
+    // One past the highest slot handed out
+    NO_DISCARD uint32_t getSlotCount() const;
+
   private:
+    uint32_t allocateSlot();
+
     TexMap m_loadedTextures;
+    std::vector<uint32_t> m_freeSlots;
+    uint32_t m_nextSlot{ 0 };
   };
 }
 
@@ -0,0 +1,60 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : VertexWelder.h
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 06d
+// * Last Altered: 2020y 03m 06d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description : Merges identical (or, optionally, nearly identical) vertices
+// *               of an indexed mesh & rewrites the indices to match.
+
+#ifndef DW_VERTEX_WELDER_H
+#define DW_VERTEX_WELDER_H
+
+#include "Vertex.h"
+
+#include <iosfwd>
+#include <vector>
+
+namespace dw {
+  struct WeldOptions {
+    // Vertices whose positions are within positionEpsilon of each other, and whose normals
+    // and texture coordinates are within their epsilons, are merged into the first one seen.
+    // 0 only merges vertices that are exactly equal.
+    float positionEpsilon{0.f};
+    float normalEpsilon{0.f};
+    float texCoordEpsilon{0.f};
+
+    // triangles that collapse when welding are dropped
+    bool removeDegenerates{true};
+  };
+
+  struct WeldStats {
+    size_t inputVertices{0};
+    size_t outputVertices{0};
+    size_t exactMerges{0};
+    size_t epsilonMerges{0};
+    size_t degeneratesRemoved{0};
+
+    // of the exact table; a rough read on how well the hash spreads
+    float  averageProbeLength{0.f};
+    size_t maxProbeLength{0};
+  };
+
+  class VertexWelder {
+  public:
+    using Options = WeldOptions;
+    using Stats   = WeldStats;
+
+    // Vertices nothing indexes are kept (and welded) all the same.
+    static Stats Weld(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, Options const& options = {});
+  };
+
+  std::ostream& operator<<(std::ostream& os, WeldStats const& stats);
+}
+
+#endif
@@ -0,0 +1,74 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : Frustum.h
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 04d
+// * Last Altered: 2020y 03m 04d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+// *    View frustum planes pulled out of a view-projection matrix, for culling.
+
+#ifndef DW_FRUSTUM_H
+#define DW_FRUSTUM_H
+
+#include "util/MyMath.h"
+#include "util/Utils.h"
+
+#include <array>
+
+namespace dw::util {
+  struct Frustum {
+    // xyz = normal (pointing inwards), w = distance. left, right, bottom, top, near, far
+    std::array<glm::vec4, 6> planes;
+
+    Frustum() = default;
+
+    // Gribb/Hartmann extraction. Assumes a [0, 1] depth range (GLM_FORCE_DEPTH_ZERO_TO_ONE),
+    // so the near plane is just the third row rather than row 4 + row 3.
+    explicit Frustum(glm::mat4 const& viewProj) {
+      glm::vec4 row0 = {viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]};
+      glm::vec4 row1 = {viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]};
+      glm::vec4 row2 = {viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]};
+      glm::vec4 row3 = {viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]};
+
+      planes[0] = row3 + row0;
+      planes[1] = row3 - row0;
+      planes[2] = row3 + row1;
+      planes[3] = row3 - row1;
+      planes[4] = row2;
+      planes[5] = row3 - row2;
+
+      for (auto& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    NO_DISCARD bool intersectsSphere(glm::vec3 const& center, float radius) const {
+      for (auto& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+          return false;
+      }
+      return true;
+    }
+
+    // sphere given in model space, e.g. a mesh's bounds, moved by an affine model matrix
+    NO_DISCARD bool intersectsSphere(glm::vec4 const& modelSphere, glm::mat4 const& model) const {
+      glm::vec4 sphere = TransformSphere(modelSphere, model);
+      return intersectsSphere(glm::vec3(sphere), sphere.w);
+    }
+
+    // xyz center, w radius; the radius grows by the matrix's largest axis scale
+    NO_DISCARD static glm::vec4 TransformSphere(glm::vec4 const& modelSphere, glm::mat4 const& model) {
+      glm::vec3 center = model * glm::vec4(glm::vec3(modelSphere), 1.f);
+      float     scale  = glm::sqrt(glm::max(glm::max(glm::length2(glm::vec3(model[0])),
+                                                     glm::length2(glm::vec3(model[1]))),
+                                            glm::length2(glm::vec3(model[2]))));
+      return glm::vec4(center, modelSphere.w * scale);
+    }
+  };
+}
+
+#endif
@@ -35,9 +35,14 @@
 #include "render/Buffer.h"
 #include "render/Mesh.h"
 #include "render/MeshManager.h"
+#include "render/ObjLoader.h"
+#include "render/RenderQueue.h"
 #include "util/Trace.h"
 
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <algorithm>
 #include <unordered_map>
 #include <chrono>
@@ -69,6 +74,7 @@ namespace dw {
         //4, 5, 6, 6, 7, 4
       };
 
+      weld("ground plane", vertices, indices);
       addMesh(vertices, indices).second->calculateTangents();
     }
 
@@ -104,6 +110,7 @@ namespace dw {
         1, 3, 7, 5, 1, 7  // +X
       };
 
+      weld("smooth cube", vertices, indices);
       addMesh(vertices, indices).second->calculateTangents();;
     }
 
@@ -150,6 +157,7 @@ namespace dw {
         20, 21, 22, 21, 23, 22
       };
 
+      weld("face cube", vertices, indices);
       addMesh(vertices, indices).second->calculateTangents();;
     }
 
@@ -278,6 +286,7 @@ namespace dw {
         indices.push_back(vertices.size() - NUM_LONGITUDE_LINES - 1);
       }
 
+      weld("sphere", vertices, indices);
       vertices.shrink_to_fit();
       indices.shrink_to_fit();
 
@@ -285,14 +294,277 @@ namespace dw {
     }
   }
 
+  // --present-mode's names, which the ImGui combo shows too
+  static constexpr char const* PRESENT_MODE_NAMES[] = { "fifo", "relaxed", "mailbox", "immediate" };
+  static constexpr VkPresentModeKHR PRESENT_MODES[] = {
+    VK_PRESENT_MODE_FIFO_KHR,
+    VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+    VK_PRESENT_MODE_MAILBOX_KHR,
+    VK_PRESENT_MODE_IMMEDIATE_KHR
+  };
+
+  static constexpr int PRESENT_MODE_COUNT = static_cast<int>(sizeof(PRESENT_MODES) / sizeof(PRESENT_MODES[0]));
+
   Application::Application()
     : m_mtlManager(m_textureManager),
       m_meshManager(m_mtlManager) {}
 
-  int Application::parseCommandArgs(int, char**) {
+  int Application::parseCommandArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+      // times the OBJ loader against tinyobj on the bundled models, then carries on as normal
+      if (std::string(argv[i]) == "--benchmark-obj")
+        ObjLoader::Benchmark("data/objects/", "data/materials/");
+
+      // times the draw queue's radix sort against std::stable_sort
+      else if (std::string(argv[i]) == "--benchmark-sort") {
+        RenderQueue::Benchmark(100000);
+        RenderQueue::Benchmark(1000000);
+      }
+
+      // fills the main scene with a grid of this many extra cubes
+      else if (std::string(argv[i]) == "--stress" && i + 1 < argc)
+        m_stressObjectCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+
+      // packs the gbuffer into 12 bytes a pixel, rebuilding positions from depth
+      else if (std::string(argv[i]) == "--compact-gbuffer")
+        m_gbufferLayout = GBufferLayout::Compact;
+
+      // window size, e.g. --resolution 3840 2160
+      else if (std::string(argv[i]) == "--resolution" && i + 2 < argc) {
+        m_windowWidth  = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        m_windowHeight = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+      }
+
+      // makes the main scene's white light directional, with this many shadow cascades
+      else if (std::string(argv[i]) == "--cascades" && i + 1 < argc) {
+        m_shadowSettings.cascadeCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        m_directionalSun              = m_shadowSettings.cascadeCount > 0;
+      }
+
+      // megabytes for every shadow map together, which picks their resolution
+      else if (std::string(argv[i]) == "--shadow-budget" && i + 1 < argc)
+        m_shadowSettings.memoryBudget = static_cast<VkDeviceSize>(std::strtoull(argv[++i], nullptr, 10)) << 20;
+
+      // filters the shadow maps with a summed-area table instead of the blur: --shadow-filter sat
+      else if (std::string(argv[i]) == "--shadow-filter" && i + 1 < argc)
+        m_shadowSettings.filter = std::string(argv[++i]) == "sat"
+                                    ? Renderer::ShadowFilter::SummedArea
+                                    : Renderer::ShadowFilter::Blur;
+
+      // the summed-area filter's radius, in texels of the biggest shadow map
+      else if (std::string(argv[i]) == "--shadow-filter-radius" && i + 1 < argc)
+        m_shaderControl.global_shadowFilterRadius = std::strtof(argv[++i], nullptr);
+
+      // times the shadow filter & global lighting on the GPU with the blur, then with the summed-area
+      // table at a set of radii, redrawing every shadow map every frame so there's always something
+      // to filter, and logs them side by side
+      else if (std::string(argv[i]) == "--benchmark-shadow-filter")
+        m_benchmarkShadowFilter = true;
+
+      // runs the shadow filter on the graphics queue instead of the compute queue
+      else if (std::string(argv[i]) == "--no-async-compute")
+        m_asyncCompute = false;
+
+      // logs every pass's GPU time and how long the graphics & compute queues ran at the same time,
+      // redrawing & filtering every shadow map every frame. Compare with --no-async-compute
+      else if (std::string(argv[i]) == "--benchmark-async-compute")
+        m_benchmarkAsyncCompute = true;
+
+      // resizes the window this many times remaking everything, then as many only remaking the
+      // swapchain & the images sized to it, and logs how long the renderer took each way
+      else if (std::string(argv[i]) == "--benchmark-resize" && i + 1 < argc)
+        m_resizeBenchmark.count = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+
+      // fifo, relaxed, mailbox or immediate; falls back to fifo if the surface doesn't support it
+      else if (std::string(argv[i]) == "--present-mode" && i + 1 < argc) {
+        std::string name = argv[++i];
+        for (int mode = 0; mode < PRESENT_MODE_COUNT; ++mode) {
+          if (name == PRESENT_MODE_NAMES[mode])
+            m_presentSettings.mode = PRESENT_MODES[mode];
+        }
+      }
+
+      // how many images the swapchain asks for, clamped to what the surface allows
+      else if (std::string(argv[i]) == "--swapchain-images" && i + 1 < argc)
+        m_presentSettings.imageCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+
+      // sleeps before each frame so there are at most this many a second
+      else if (std::string(argv[i]) == "--fps-cap" && i + 1 < argc)
+        m_pacerSettings.fpsCap = std::strtof(argv[++i], nullptr);
+
+      // milliseconds from sampling input to presenting the frame that the frame pacer aims for,
+      // by sampling input later when the renderer would only have waited anyway
+      else if (std::string(argv[i]) == "--latency-budget" && i + 1 < argc)
+        m_pacerSettings.latencyBudgetMs = std::strtof(argv[++i], nullptr);
+
+      // logs the frame pacer's averages: frame time, input to present latency, time blocked in
+      // the renderer & input delay. Compare present modes with --present-mode
+      else if (std::string(argv[i]) == "--benchmark-latency")
+        m_benchmarkLatency = true;
+
+      // switches scenes this many times building each one as it's set, then as many with the
+      // next one prepared in the background, and logs how long setScene() took each way
+      else if (std::string(argv[i]) == "--benchmark-scene-switch" && i + 1 < argc)
+        m_sceneSwitchBenchmark.count = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+
+      // replaces this many of the --stress cubes a second with new ones, editing the live scene
+      // without setScene(), and logs what applying the edits costs the renderer
+      else if (std::string(argv[i]) == "--stress-churn" && i + 1 < argc)
+        m_churnRate = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    }
+
     return 0;
   }
 
+  void Application::benchmarkResize() {
+    auto& bench = m_resizeBenchmark;
+    if (bench.done >= 2 * bench.count || m_resizedWindow || ++bench.frame % ResizeBenchmark::FRAMES_APART)
+      return;
+
+    // every other resize goes back to the original size
+    if (bench.done % 2)
+      m_window->setSize(m_windowWidth, m_windowHeight);
+    else
+      m_window->setSize(m_windowWidth * 3 / 4, m_windowHeight * 3 / 4);
+  }
+
+  void Application::logResizeBenchmark() const {
+    auto const& bench = m_resizeBenchmark;
+    Trace::Info << "Resize benchmark, " << bench.count << " resizes each way:" << Trace::Stop;
+    Trace::Info << "  remaking everything:  " << bench.totalMs[0] / bench.count << "ms average, "
+                << bench.maxMs[0] << "ms worst" << Trace::Stop;
+    Trace::Info << "  only the window's:    " << bench.totalMs[1] / bench.count << "ms average, "
+                << bench.maxMs[1] << "ms worst" << Trace::Stop;
+  }
+
+  void Application::benchmarkShadowFilter() {
+    auto& bench = m_shadowFilterBenchmark;
+    if (!m_benchmarkShadowFilter || bench.step > ShadowFilterBenchmark::RADIUS_COUNT)
+      return;
+
+    // the blur, then the summed-area table; only the filter changing needs the atlas remade
+    if (bench.frame++ == 0) {
+      if (bench.step == 0)
+        bench.radius = m_shaderControl.global_shadowFilterRadius;
+
+      if (bench.step <= 1) {
+        Renderer::ShadowSettings settings = m_shadowSettings;
+        settings.filter = bench.step ? Renderer::ShadowFilter::SummedArea : Renderer::ShadowFilter::Blur;
+        m_renderer->setShadowSettings(settings);
+        m_renderer->setScene(m_curScene);
+      }
+
+      if (bench.step)
+        m_shaderControl.global_shadowFilterRadius = ShadowFilterBenchmark::RADII[bench.step - 1];
+      return;
+    }
+
+    // what was timed while the setting changed doesn't count
+    if (bench.frame == ShadowFilterBenchmark::SETTLE_FRAMES)
+      (void)m_renderer->takeShadowFilterTiming();
+
+    if (bench.frame < ShadowFilterBenchmark::SETTLE_FRAMES + ShadowFilterBenchmark::FRAMES)
+      return;
+
+    bench.timings[bench.step++] = m_renderer->takeShadowFilterTiming();
+    bench.frame = 0;
+    if (bench.step <= ShadowFilterBenchmark::RADIUS_COUNT)
+      return;
+
+    logShadowFilterBenchmark();
+
+    // back to what the command line asked for
+    m_shaderControl.global_shadowFilterRadius = bench.radius;
+    m_renderer->setShadowSettings(m_shadowSettings);
+    m_renderer->setScene(m_curScene);
+  }
+
+  void Application::logShadowFilterBenchmark() const {
+    auto const& bench = m_shadowFilterBenchmark;
+    auto filterMs     = [](Renderer::ShadowFilterTiming const& t) { return t.filteredFrames ? t.filterMs / t.filteredFrames : 0.; };
+    auto lightingMs   = [](Renderer::ShadowFilterTiming const& t) { return t.timedFrames ? t.lightingMs / t.timedFrames : 0.; };
+
+    // the blur's kernel doesn't depend on the radius, so it's timed once & compared with every radius
+    auto const& blur = bench.timings[0];
+    Trace::Info << "Shadow filter benchmark, " << ShadowFilterBenchmark::FRAMES << " frames each"
+                << (m_shaderControl.global_variablePenumbra ? ", variable penumbra" : "") << ":" << Trace::Stop;
+    Trace::Info << "  blur:      filter " << filterMs(blur) << "ms, global lighting " << lightingMs(blur)
+                << "ms, together " << filterMs(blur) + lightingMs(blur) << "ms" << Trace::Stop;
+
+    for (uint32_t i = 0; i < ShadowFilterBenchmark::RADIUS_COUNT; ++i) {
+      auto const& sat = bench.timings[i + 1];
+      Trace::Info << "  radius " << ShadowFilterBenchmark::RADII[i] << ": summed-area table " << filterMs(sat)
+                  << "ms, global lighting " << lightingMs(sat) << "ms, together " << filterMs(sat) + lightingMs(sat)
+                  << "ms vs the blur's " << filterMs(blur) + lightingMs(blur) << "ms" << Trace::Stop;
+    }
+  }
+
+  void Application::benchmarkSceneSwitch() {
+    auto& bench = m_sceneSwitchBenchmark;
+    if (bench.done >= 2 * bench.count || ++bench.frame % SceneSwitchBenchmark::FRAMES_APART)
+      return;
+
+    const bool prepared = bench.done >= bench.count;
+    const auto start    = ClockType::now();
+
+    m_curScene = m_curScene == m_mainScene ? m_switchScene : m_mainScene;
+    m_renderer->setScene(m_curScene);
+
+    double ms = std::chrono::duration<double, std::milli>(ClockType::now() - start).count();
+    bench.totalMs[prepared ? 1 : 0] += ms;
+    bench.maxMs[prepared ? 1 : 0] = std::max(bench.maxMs[prepared ? 1 : 0], ms);
+
+    // from here on the scene switched away from stays resident, & the other's built meanwhile
+    if (++bench.done == bench.count) {
+      m_renderer->setSceneBudget(bench.budget);
+      m_renderer->prepareScene(m_curScene == m_mainScene ? m_switchScene : m_mainScene);
+    }
+    else if (bench.done == 2 * bench.count)
+      logSceneSwitchBenchmark();
+  }
+
+  void Application::logSceneSwitchBenchmark() const {
+    auto const& bench = m_sceneSwitchBenchmark;
+    Trace::Info << "Scene switch benchmark, " << bench.count << " switches each way:" << Trace::Stop;
+    Trace::Info << "  built in setScene():  " << bench.totalMs[0] / bench.count << "ms average, "
+                << bench.maxMs[0] << "ms worst" << Trace::Stop;
+    Trace::Info << "  prepared & resident: " << bench.totalMs[1] / bench.count << "ms average, "
+                << bench.maxMs[1] << "ms worst" << Trace::Stop;
+  }
+
+  // Replacements are dynamic, so they don't keep invalidating the cached static shadow layers
+  void Application::churnStressObjects(float dt) {
+    if (!m_churnRate || m_stressHandles.empty())
+      return;
+
+    static std::mt19937                          random(1234);
+    static std::uniform_real_distribution<float> spot(-8.f, 8.f);
+
+    m_churnDue += m_churnRate * static_cast<double>(dt);
+    for (; m_churnDue >= 1.0; m_churnDue -= 1.0) {
+      m_mainScene->removeObject(m_stressHandles.front());
+      m_stressHandles.pop_front();
+
+      auto obj_stress = util::make_ptr<obj::Object>(1, util::make_ptr<Graphics>(m_meshManager.getMesh(2)));
+      obj_stress->getTransform()->setPosition({ spot(random), spot(random), 0.05f });
+      obj_stress->getTransform()->setScale({ 0.05f, 0.05f, 0.05f });
+      m_stressHandles.push_back(m_mainScene->insertObject(obj_stress));
+    }
+  }
+
+  // FIFO & mailbox hold a finished image for the vblank, half a refresh on average. Immediate
+  // shows it right away, tearing.
+  void Application::updatePresentDelay() {
+    double delayMs = 0;
+    if (m_renderer->getPresentMode() != VK_PRESENT_MODE_IMMEDIATE_KHR) {
+      GLFWvidmode const* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+      if (videoMode && videoMode->refreshRate > 0)
+        delayMs = 500.0 / videoMode->refreshRate;
+    }
+
+    m_framePacer.setPresentDelay(delayMs);
+  }
+
   int Application::run() {
     if (initialize() == 1 || loop() == 1 || shutdown() == 1)
       return 1;
@@ -319,6 +591,7 @@ namespace dw {
       o->getTransform()->setPosition({ 0, 0, 0 });
     });
 
+    obj_groundPlane->getTransform()->setStatic();
     scene->addObject(obj_groundPlane);
 
     // Random objects
@@ -407,6 +680,9 @@ namespace dw {
       .setDirection(glm::normalize(glm::vec3(-1, -1, -1)))
       .setColor({ 1.f, 1.0f, 1.0f });
 
+    if (m_directionalSun)
+      globalLight.setType(Light::Type::Directional);
+
     ShadowedLight globalLight2;
     globalLight2.setPosition({ -5, -5, 5 })
       .setDirection(glm::normalize(glm::vec3(1, 1, -1)))
@@ -565,16 +841,19 @@ namespace dw {
     GLFWControl::Init();
     // open window
 
-    static constexpr unsigned WINDOW_WIDTH = 1600;
-    static constexpr unsigned WINDOW_HEIGHT = 800;
-    static constexpr float    WINDOW_ASPECT = static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT;
+    const float windowAspect = static_cast<float>(m_windowWidth) / m_windowHeight;
 
-    m_window = new GLFWWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "GPROJ - Loading Your Experience...");
+    m_window = new GLFWWindow(m_windowWidth, m_windowHeight, "GPROJ - Loading Your Experience...");
     m_inputHandler = new InputHandler(*m_window);
     m_window->setInputHandler(m_inputHandler);
     m_window->setOnResizeCB([this](GLFWWindow* window, int nx, int ny) {
       m_resizedWindow = true;
+      if (ny == 0)
+        return; // minimized
+
       m_mainScene->getCamera()->setAspect((float)nx / ny);
+      if (m_switchScene)
+        m_switchScene->getCamera()->setAspect((float)nx / ny);
       //m_secondScene->getCamera()->setAspect((float)nx / ny);
       //m_thirdScene->getCamera()->setAspect((float)nx / ny);
     });
@@ -592,8 +871,20 @@ namespace dw {
 
     m_renderer = util::make_ptr<Renderer>();
 
+    m_renderer->setGBufferLayout(m_gbufferLayout);
+    m_renderer->setShadowSettings(m_shadowSettings);
+    m_renderer->setShadowFilterTiming(m_benchmarkShadowFilter);
+    m_renderer->setShadowCachingEnabled(!m_benchmarkShadowFilter && !m_benchmarkAsyncCompute);
+    m_renderer->setAsyncComputeEnabled(m_asyncCompute);
+    m_renderer->setFrameTiming(m_benchmarkAsyncCompute);
+    m_renderer->setPresentSettings(m_presentSettings);
+    m_renderer->setSceneEditLogging(m_churnRate > 0);
     m_renderer->init(m_window);
 
+    m_framePacer.setSettings(m_pacerSettings);
+    m_framePacer.setLogging(m_benchmarkLatency);
+    updatePresentDelay();
+
     // load the objects that i want
     m_meshManager.loadBasicMeshes();
 
@@ -648,6 +939,31 @@ namespace dw {
     m_mainScene = createPushScene();
     m_mainScene->addObject(obj_skydome);
 
+    // added last, the behaviors above index the scene's first objects directly
+    if (m_stressObjectCount) {
+      const auto  side    = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(m_stressObjectCount))));
+      const float spacing = 0.25f;
+      const float offset  = -0.5f * spacing * (side - 1);
+
+      for (uint32_t i = 0; i < m_stressObjectCount; ++i) {
+        auto obj_stress = util::make_ptr<obj::Object>(1, util::make_ptr<Graphics>(m_meshManager.getMesh(2)));
+        obj_stress->getTransform()->setPosition({ offset + spacing * (i % side), offset + spacing * (i / side), 0.05f });
+        obj_stress->getTransform()->setScale({ 0.05f, 0.05f, 0.05f });
+        obj_stress->getTransform()->setStatic();
+        m_stressHandles.push_back(m_mainScene->insertObject(obj_stress));
+      }
+
+      Trace::Info << "Stress test: added " << m_stressObjectCount << " cubes, "
+        << m_mainScene->getObjects().size() << " objects in the scene" << Trace::Stop;
+    }
+
+    // a second push scene without the stress objects, for the scene switch benchmark
+    if (m_sceneSwitchBenchmark.count) {
+      m_switchScene = createPushScene();
+      m_switchScene->addObject(obj_skydome);
+      m_switchScene->getCamera()->setAspect(windowAspect);
+    }
+
     // Secondary scene
     //m_secondScene = createSecondaryScene();
     //m_secondScene->addObject(obj_skydome);
@@ -660,9 +976,9 @@ namespace dw {
     m_shaderControl.geometry_defaultMetallic = 0.07f;
     m_curScene = m_mainScene;
 
-    m_mainScene->getCamera()->setAspect(WINDOW_ASPECT);
-    //m_secondScene->getCamera()->setAspect(WINDOW_ASPECT);
-    //m_thirdScene->getCamera()->setAspect(WINDOW_ASPECT);
+    m_mainScene->getCamera()->setAspect(windowAspect);
+    //m_secondScene->getCamera()->setAspect(windowAspect);
+    //m_thirdScene->getCamera()->setAspect(windowAspect);
 
     //continueDisplayingLogo.store(false);
     //displayLogoThread.join();
@@ -673,6 +989,12 @@ namespace dw {
     m_renderer->setScene(m_curScene);
     m_renderer->setShaderControl(&m_shaderControl);
 
+    // nothing's kept prepared for the benchmark's first half
+    if (m_sceneSwitchBenchmark.count) {
+      m_sceneSwitchBenchmark.budget = m_renderer->getSceneBudget();
+      m_renderer->setSceneBudget(0);
+    }
+
     m_startTime = ClockType::now();
 
     m_inputHandler->registerKeyFunction(GLFW_KEY_ESCAPE, [this]() {
@@ -698,14 +1020,43 @@ namespace dw {
 
 
     while (!m_renderer->done()) {
+      // input's sampled as late as the pacer thinks it can be; everything after it is the frame
+      m_framePacer.beginFrame();
       GLFWControl::Poll();
-      if (m_resizedWindow) {
-        m_resizedWindow = false;
+      if (m_restartWindow) {
+        m_restartWindow = m_resizedWindow = false;
         m_renderer->restartWindow();
+        updatePresentDelay();
+      }
+      else if (m_resizedWindow) {
+        const bool full  = m_resizeBenchmark.done < m_resizeBenchmark.count;
+        const auto start = ClockType::now();
+
+        if (full) {
+          m_renderer->restartWindow();
+          m_resizedWindow = false;
+        }
+        else
+          m_resizedWindow = !m_renderer->resizeWindow(); // still minimized
+
+        if (!m_resizedWindow)
+          updatePresentDelay();
+
+        if (m_resizeBenchmark.count && !m_resizedWindow) {
+          double ms = std::chrono::duration<double, std::milli>(ClockType::now() - start).count();
+          m_resizeBenchmark.totalMs[full ? 0 : 1] += ms;
+          m_resizeBenchmark.maxMs[full ? 0 : 1] = std::max(m_resizeBenchmark.maxMs[full ? 0 : 1], ms);
+          if (++m_resizeBenchmark.done == 2 * m_resizeBenchmark.count)
+            logResizeBenchmark();
+        }
       }
 
+      benchmarkResize();
+      benchmarkSceneSwitch();
+      benchmarkShadowFilter();
+
       auto changeToSecondStage = [this]() {
-        m_shaderControl.global_momentBias = 0.00000445f;
+        m_shaderControl.global_momentBias = 0.000045f;
         m_shaderControl.geometry_defaultRoughness = 0.46f;
         m_shaderControl.geometry_defaultMetallic = 0.76f;
         //m_curScene = m_secondScene;
@@ -713,7 +1064,7 @@ namespace dw {
       };
 
       auto changeToThirdStage = [this]() {
-        m_shaderControl.global_momentBias = 0.00000215f;
+        m_shaderControl.global_momentBias = 0.00003f;
         m_shaderControl.geometry_defaultRoughness = 0.16f;
         m_shaderControl.geometry_defaultMetallic = 0.08f;
         m_curScene = m_mainScene;
@@ -727,7 +1078,7 @@ namespace dw {
 
       if (showImGuiControls && currentStage >= 2) {
         ImGui::Begin("Shader Control (Press Enter to toggle visibility)");
-        ImGui::DragFloat("Moment Bias", &m_shaderControl.global_momentBias, 0.00000005f, 0, .0001, "%.8f");
+        ImGui::DragFloat("Moment Bias", &m_shaderControl.global_momentBias, 0.000001f, 0, .001, "%.6f");
         ImGui::DragFloat("Depth Bias", &m_shaderControl.global_depthBias, 0.0001f, 0.1f, 0.1f, "%.4f");
         ImGui::DragFloat("Default Roughness", &m_shaderControl.geometry_defaultRoughness, 0.01, 0, 1);
         ImGui::DragFloat("Default Metallic", &m_shaderControl.geometry_defaultMetallic, 0.01, 0, 1);
@@ -737,6 +1088,7 @@ namespace dw {
 
         static bool enableGlobalLight = true;
         static bool enableShadowMapBlur = true;
+        static bool enableShadowCaching = !m_benchmarkShadowFilter && !m_benchmarkAsyncCompute;
         ImGui::Begin("Render Step Control");
         ImGui::Checkbox("Global Lighting", reinterpret_cast<bool*>(&m_shaderControl.global_doGlobalLighting));
         ImGui::Checkbox("Shadows", reinterpret_cast<bool*>(&m_shaderControl.global_enableShadows));
@@ -747,6 +1099,47 @@ namespace dw {
           m_renderer->setShadowMapBlurEnabled(enableShadowMapBlur);
         if (ImGui::Checkbox("Submit Global Lighting (warning: weird)", &enableGlobalLight))
           m_renderer->setGlobalLightingEnabled(enableGlobalLight);
+        if (ImGui::Checkbox("Cache Static Shadows", &enableShadowCaching))
+          m_renderer->setShadowCachingEnabled(enableShadowCaching);
+
+        if (m_shadowSettings.filter == Renderer::ShadowFilter::SummedArea) {
+          ImGui::DragFloat("Shadow Filter Radius", &m_shaderControl.global_shadowFilterRadius, 0.1f, 0, 64);
+          ImGui::Checkbox("Variable Penumbra", reinterpret_cast<bool*>(&m_shaderControl.global_variablePenumbra));
+        }
+
+        bool compactGBuffer = m_gbufferLayout == GBufferLayout::Compact;
+        if (ImGui::Checkbox("Compact G-Buffer", &compactGBuffer)) {
+          m_gbufferLayout = compactGBuffer ? GBufferLayout::Compact : GBufferLayout::Full;
+          m_renderer->setGBufferLayout(m_gbufferLayout);
+          m_restartWindow = true; // rebuilds the gbuffer & steps next frame
+        }
+
+        ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+        ImGui::End();
+
+        // the swapchain's remade with the resize handling next frame
+        ImGui::Begin("Frame Pacing");
+        int presentMode = 0;
+        while (presentMode < PRESENT_MODE_COUNT - 1 && PRESENT_MODES[presentMode] != m_presentSettings.mode)
+          ++presentMode;
+
+        int imageCount = static_cast<int>(m_presentSettings.imageCount);
+        bool presentChanged = ImGui::Combo("Present Mode", &presentMode, PRESENT_MODE_NAMES, PRESENT_MODE_COUNT);
+        presentChanged |= ImGui::SliderInt("Swapchain Images (0 = auto)", &imageCount, 0, 8);
+        if (presentChanged) {
+          m_presentSettings.mode       = PRESENT_MODES[presentMode];
+          m_presentSettings.imageCount = static_cast<uint32_t>(imageCount);
+          m_renderer->setPresentSettings(m_presentSettings);
+          m_resizedWindow = true;
+        }
+
+        bool pacerChanged = ImGui::DragFloat("FPS Cap (0 = off)", &m_pacerSettings.fpsCap, 1, 0, 1000, "%.0f");
+        pacerChanged |= ImGui::DragFloat("Latency Budget (ms, 0 = off)", &m_pacerSettings.latencyBudgetMs, 0.1f, 0, 100, "%.1f");
+        if (pacerChanged)
+          m_framePacer.setSettings(m_pacerSettings);
+
+        ImGui::Text("~%.2f ms input to present", m_framePacer.getLatencyMs());
+        ImGui::Text("%.2f ms blocked in drawFrame, %.2f ms input delay", m_framePacer.getBlockedMs(), m_framePacer.getDelayMs());
         ImGui::End();
       }
 
@@ -772,7 +1165,7 @@ namespace dw {
 
         /*ImGui::Begin("Scene Switcher");
         if (ImGui::Button("Intro Scene") && m_curScene != m_thirdScene) {
-          m_shaderControl.global_momentBias = 0.00000005f;
+          m_shaderControl.global_momentBias = 0.00003f;
           m_shaderControl.geometry_defaultRoughness = 0.8f;
           m_shaderControl.geometry_defaultMetallic = 0.07f;
           m_curScene = m_thirdScene;
@@ -839,6 +1232,9 @@ namespace dw {
       else
         sprintf(titleBuff, "GPROJ - Scared of Burning Out at %.0f FPS", fps);
 
+      if (m_framePacer.hasLatency())
+        sprintf(titleBuff + strlen(titleBuff), ", ~%.1f ms Input to Present", m_framePacer.getLatencyMs());
+
       glfwSetWindowTitle(m_window->getHandle(), titleBuff);
 
       // TODO: moving camera
@@ -887,6 +1283,8 @@ namespace dw {
       }
 
       if (m_curScene == m_mainScene) {
+        churnStressObjects(dt);
+
         m_curScene->getLights()[0]->setPosition({ 2 * sqrt(2) * cos(3 * timeCount), 2 * sqrt(2) * sin(3 * timeCount), 2 });
         m_curScene->getLights()[1]->setPosition({ -2 * sqrt(2) * cos(3 * timeCount), -2 * sqrt(2) * sin(3 * timeCount), 2 });
 
@@ -933,6 +1331,7 @@ namespace dw {
       //}
 
       m_renderer->drawFrame();
+      m_framePacer.endFrame(m_renderer->getFrameWaits());
     }
 
     return 0;
@@ -0,0 +1,116 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : FramePacer.cpp
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 18d
+// * Last Altered: 2020y 03m 18d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+
+#include "app/FramePacer.h"
+#include "util/Trace.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace dw {
+  void FramePacer::beginFrame() {
+    const auto now   = Clock::now();
+    auto       start = now;
+
+    // a frame that ran over its slot starts right away and the next slot counts from it, so a
+    // slow frame isn't followed by a burst of fast ones catching up
+    if (m_settings.fpsCap > 0) {
+      auto period = std::chrono::duration_cast<Clock::duration>(Ms(1000.0 / m_settings.fpsCap));
+      m_slot = std::max(m_slot + period, now);
+      start  = m_slot;
+    }
+
+    SleepUntil(start + std::chrono::duration_cast<Clock::duration>(Ms(m_delayMs)));
+
+    const auto input = Clock::now();
+    if (m_inputTime != Clock::time_point{})
+      m_frameMs = Ms(input - m_inputTime).count();
+
+    m_inputTime = input;
+  }
+
+  void FramePacer::endFrame(Renderer::FrameWaits const& waits) {
+    m_blockedMs = waits.blockedMs;
+
+    if (waits.submitted != m_submitted) {
+      m_submitted = waits.submitted;
+      m_inputTimes[m_submitted % INPUT_HISTORY] = m_inputTime;
+    }
+
+    // The GPU being done is as close to the present as the CPU can see; the display's share is
+    // m_presentDelayMs. The done time's late when the frame finished before anything waited on
+    // it, but then there was no slack to take up either.
+    bool newLatency = false;
+    if (waits.done != m_done && m_submitted - waits.done < INPUT_HISTORY) {
+      m_done       = waits.done;
+      m_latencyMs  = Ms(waits.doneTime - m_inputTimes[m_done % INPUT_HISTORY]).count() + m_presentDelayMs;
+      m_hasLatency = true;
+      newLatency   = true;
+    }
+
+    // Over budget, the delay grows into whatever slack there is. Under it, or with the frame
+    // blocking less than the margin (it started too late to keep the GPU busy), it shrinks.
+    if (m_settings.latencyBudgetMs > 0 && m_hasLatency) {
+      double slack = m_blockedMs - MARGIN_MS;
+      double over  = m_latencyMs - m_settings.latencyBudgetMs;
+      m_delayMs    = std::clamp(m_delayMs + GAIN * std::min(over, slack), 0.0, MAX_DELAY_MS);
+    }
+    else
+      m_delayMs = 0;
+
+    if (!m_logging)
+      return;
+
+    m_totalFrameMs += m_frameMs;
+    m_totalBlockedMs += m_blockedMs;
+    m_totalDelayMs += m_delayMs;
+    if (newLatency) {
+      m_totalLatencyMs += m_latencyMs;
+      m_maxLatencyMs = std::max(m_maxLatencyMs, m_latencyMs);
+      ++m_latencyFrames;
+    }
+
+    if (++m_loggedFrames == LOG_FRAMES)
+      log();
+  }
+
+  // Sleeps are only as fine as the OS's scheduler, a millisecond or worse on Windows, so the
+  // last SPIN_MS are yielded away instead
+  void FramePacer::SleepUntil(Clock::time_point when) {
+    for (auto now = Clock::now(); now < when; now = Clock::now()) {
+      if (Ms(when - now).count() > SPIN_MS)
+        std::this_thread::sleep_for(std::chrono::duration_cast<Clock::duration>(when - now - Ms(SPIN_MS)));
+      else
+        std::this_thread::yield();
+    }
+  }
+
+  void FramePacer::log() {
+    Trace::Info << "Frame pacing over " << m_loggedFrames << " frames: "
+                << m_totalFrameMs / m_loggedFrames << "ms/frame, "
+                << m_totalBlockedMs / m_loggedFrames << "ms blocked in drawFrame, "
+                << m_totalDelayMs / m_loggedFrames << "ms input delay" << Trace::Stop;
+
+    if (m_latencyFrames)
+      Trace::Info << "  ~" << m_totalLatencyMs / m_latencyFrames << "ms input to present, "
+                  << m_maxLatencyMs << "ms worst" << Trace::Stop;
+
+    m_loggedFrames   = 0;
+    m_latencyFrames  = 0;
+    m_totalFrameMs   = 0;
+    m_totalLatencyMs = 0;
+    m_maxLatencyMs   = 0;
+    m_totalBlockedMs = 0;
+    m_totalDelayMs   = 0;
+  }
+}
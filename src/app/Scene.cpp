@@ -18,20 +18,69 @@
 
 namespace dw {
   Scene& Scene::addObject(ObjContainer::value_type const& object) {
-    m_objects.push_back(object);
+    (void)insertObject(object);
     return *this;
   }
 
   Scene& Scene::addLight(LightContainer::value_type const& light) {
-    m_lights.push_back(light);
+    (void)insertLight(light);
     return *this;
   }
 
   Scene& Scene::addGlobalLight(ShadowedLight const& light) {
     m_globalLights.push_back(light);
+    journal({ Edit::Type::GlobalLights });
     return *this;
   }
 
+  Scene::Handle Scene::insertObject(ObjContainer::value_type const& object) {
+    Handle handle = m_objectHandles.insert();
+    m_objects.push_back(object);
+    journal({ Edit::Type::AddObject, handle, object });
+    return handle;
+  }
+
+  void Scene::removeObject(Handle handle) {
+    if (m_objectHandles.find(handle) == HandleTable::NONE)
+      return;
+
+    uint32_t index = m_objectHandles.remove(handle);
+    journal({ Edit::Type::RemoveObject, handle, m_objects[index] });
+
+    m_objects[index] = std::move(m_objects.back());
+    m_objects.pop_back();
+  }
+
+  void Scene::updateObject(Handle handle) {
+    uint32_t index = m_objectHandles.find(handle);
+    if (index != HandleTable::NONE)
+      journal({ Edit::Type::UpdateObject, handle, m_objects[index] });
+  }
+
+  // Local lights are read every frame as they are; there's nothing to journal
+  Scene::Handle Scene::insertLight(LightContainer::value_type const& light) {
+    Handle handle = m_lightHandles.insert();
+    m_lights.push_back(light);
+    return handle;
+  }
+
+  void Scene::removeLight(Handle handle) {
+    if (m_lightHandles.find(handle) == HandleTable::NONE)
+      return;
+
+    uint32_t index = m_lightHandles.remove(handle);
+    m_lights[index] = std::move(m_lights.back());
+    m_lights.pop_back();
+  }
+
+  void Scene::removeGlobalLight(size_t index) {
+    if (index >= m_globalLights.size())
+      return;
+
+    m_globalLights.erase(m_globalLights.begin() + index);
+    journal({ Edit::Type::GlobalLights });
+  }
+
   Scene& Scene::setCamera(std::shared_ptr<obj::Camera> camera) {
     m_camera = camera;
     return *this;
@@ -66,6 +115,82 @@ namespace dw {
   std::shared_ptr<obj::Camera> Scene::getCamera() const {
     return m_camera;
   }
+
+  Scene::ObjContainer::value_type Scene::getObject(Handle handle) const {
+    uint32_t index = m_objectHandles.find(handle);
+    return index == HandleTable::NONE ? nullptr : m_objects[index];
+  }
+
+  Scene::Handle Scene::getObjectHandle(size_t index) const {
+    uint32_t slot = m_objectHandles.slots[index];
+    return Handle(m_objectHandles.generations[slot]) << 32 | slot;
+  }
+
+  uint32_t Scene::getObjectSlots() const {
+    return static_cast<uint32_t>(m_objectHandles.indices.size());
+  }
+
+  uint64_t Scene::getRevision() const {
+    return m_revision;
+  }
+
+  std::vector<Scene::Edit> Scene::takeEdits() {
+    std::vector<Edit> edits;
+    edits.swap(m_edits);
+    return edits;
+  }
+
+  void Scene::setJournaling(bool journaling) {
+    m_journaling = journaling;
+    m_edits.clear();
+    m_edits.shrink_to_fit();
+  }
+
+  void Scene::journal(Edit const& edit) {
+    if (m_journaling)
+      m_edits.push_back(edit);
+    ++m_revision;
+  }
+
+  Scene::Handle Scene::HandleTable::insert() {
+    uint32_t slot;
+    if (free.empty()) {
+      slot = static_cast<uint32_t>(indices.size());
+      indices.push_back(0);
+      generations.push_back(0);
+    }
+    else {
+      slot = free.back();
+      free.pop_back();
+    }
+
+    indices[slot] = static_cast<uint32_t>(slots.size());
+    slots.push_back(slot);
+    return Handle(generations[slot]) << 32 | slot;
+  }
+
+  uint32_t Scene::HandleTable::find(Handle handle) const {
+    uint32_t slot = GetSlot(handle);
+    if (slot >= indices.size() || generations[slot] != static_cast<uint32_t>(handle >> 32))
+      return NONE;
+
+    return indices[slot];
+  }
+
+  // A removed slot's generation moves on, so its old handles stop finding it
+  uint32_t Scene::HandleTable::remove(Handle handle) {
+    uint32_t slot  = GetSlot(handle);
+    uint32_t index = indices[slot];
+
+    slots[index]          = slots.back();
+    indices[slots[index]] = index;
+    slots.pop_back();
+
+    indices[slot] = NONE;
+    ++generations[slot];
+    free.push_back(slot);
+    return index;
+  }
   util::ptr<Texture> Scene::getBackground() const {
     return m_background;
   }
@@ -45,7 +45,7 @@ namespace dw {
       auto iter = m_loadedMtls.try_emplace(DEFAULT_MTL_NAME, util::make_ptr<Material>());
       auto& mtl = *iter.first->second;
 
-      mtl.m_id = m_curID++;
+      mtl.m_id = allocateID();
 
       mtl.m_kd = { 1, 1, 1 };
       mtl.m_ks = { 1, 1, 1 };
@@ -74,7 +74,7 @@ namespace dw {
       auto iter = m_loadedMtls.try_emplace(SKYBOX_MTL_NAME, util::make_ptr<Material>());
       auto& mtl = *iter.first->second;
 
-      mtl.m_id = m_curID++;
+      mtl.m_id = allocateID();
 
       mtl.m_kd = { 1, 1, 1 };
       mtl.m_ks = { 1, 1, 1 };
@@ -110,7 +110,7 @@ namespace dw {
       material.m_ks = glm::vec3(mtl.specular[0], mtl.specular[1], mtl.specular[2]);
       material.m_metallic = 1 - mtl.metallic;   // TODO: not
       material.m_roughness = 1 - mtl.roughness;
-      material.m_id = m_curID++;
+      material.m_id = allocateID();
       // load textures
       assert(Material::MTL_MAP_COUNT == 4);
 
@@ -137,8 +137,28 @@ namespace dw {
     return iter.first->first;
   }
 
+  void MaterialManager::unload(MtlKey const& key) {
+    auto iter = m_loadedMtls.find(key);
+    if (iter == m_loadedMtls.end())
+      return;
+
+    m_freeIDs.push_back(iter->second->m_id);
+    m_loadedMtls.erase(iter);
+  }
+
+  uint32_t MaterialManager::allocateID() {
+    if (m_freeIDs.empty())
+      return m_curID++;
+
+    uint32_t id = m_freeIDs.back();
+    m_freeIDs.pop_back();
+    return id;
+  }
+
   void MaterialManager::clear() {
     m_loadedMtls.clear();
+    m_freeIDs.clear();
+    m_curID = 0;
   }
 
   MaterialManager::MtlMap const& MaterialManager::getMaterials() const {
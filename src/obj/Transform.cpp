@@ -71,4 +71,13 @@ namespace dw::obj {
     m_dirty = true;
     return *this;
   }
+
+  Transform& Transform::setStatic(bool isStatic) {
+    m_static = isStatic;
+    return *this;
+  }
+
+  bool Transform::isStatic() const {
+    return m_static;
+  }
 }
\ No newline at end of file
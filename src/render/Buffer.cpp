@@ -37,7 +37,10 @@ namespace dw {
 
   Buffer Buffer::CreateVertex(LogicalDevice& device, VkDeviceSize size, bool fromStaging) {
     VkFlags flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (fromStaging ? VK_BUFFER_USAGE_TRANSFER_DST_BIT : 0);
-    return Buffer(device, size, flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    // not from staging -> written by the host directly, e.g. per-instance data
+    return Buffer(device, size, flags, fromStaging
+      ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+      : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
   }
 
   Buffer Buffer::CreateUniform(LogicalDevice& device, VkDeviceSize size, bool fromStaging) {
@@ -47,6 +50,20 @@ namespace dw {
       : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
   }
 
+  Buffer Buffer::CreateIndirect(LogicalDevice& device, VkDeviceSize size, bool fromStaging) {
+    VkFlags flags = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | (fromStaging ? VK_BUFFER_USAGE_TRANSFER_DST_BIT : 0);
+    return Buffer(device, size, flags, fromStaging
+      ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+      : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  }
+
+  Buffer Buffer::CreateStorage(LogicalDevice& device, VkDeviceSize size, bool fromStaging) {
+    VkFlags flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | (fromStaging ? VK_BUFFER_USAGE_TRANSFER_DST_BIT : 0);
+    return Buffer(device, size, flags, fromStaging
+      ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+      : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  }
+
   Buffer::operator VkBuffer() const {
     return m_info.buffer;
   }
@@ -236,9 +236,11 @@ namespace dw {
     return ret;
   }
 
-  void CommandBuffer::submit(Queue& q) {
+  uint64_t CommandBuffer::submit(Queue& q) {
     if(isReady()) {
-      q.submitOne(*this);
+      return q.submitOne(*this);
     }
+
+    return 0;
   }
 }
@@ -51,7 +51,8 @@ namespace dw {
     : m_device(o.m_device),
       m_framebuffer(o.m_framebuffer),
       m_images(std::move(o.m_images)),
-      m_views(std::move(o.m_views))
+      m_views(std::move(o.m_views)),
+      m_viewAspects(std::move(o.m_viewAspects))
   {
     o.m_framebuffer = nullptr;
     o.m_images.clear();
@@ -92,6 +93,10 @@ namespace dw {
   }
 
   void Framebuffer::finalize(const RenderPass& pass) {
+    // transient images have been bound by now
+    for (size_t i = m_views.size(); i < m_images.size(); ++i)
+      m_views.emplace_back(m_images[i].createView(m_viewAspects[i]));
+
     std::vector<VkImageView> imageViews{ m_views.begin(), m_views.end() };
 
     VkFramebufferCreateInfo createInfo = {
@@ -69,6 +69,11 @@ namespace dw {
       glfwSetWindowShouldClose(m_window, close);
   }
 
+  void GLFWWindow::setSize(unsigned width, unsigned height) const {
+    if (m_window)
+      glfwSetWindowSize(m_window, static_cast<int>(width), static_cast<int>(height));
+  }
+
 
   GLFWWindow::~GLFWWindow() {
     if (m_window)
@@ -0,0 +1,352 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : GeometryArena.cpp
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 02d
+// * Last Altered: 2020y 03m 02d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+
+#include "render/GeometryArena.h"
+#include "render/CommandBuffer.h"
+#include "util/Trace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace dw {
+  /////////////////////////////////////////////////////////////////////////////
+  //// RANGE ALLOCATOR
+  /////////////////////////////////////////////////////////////////////////////
+
+  RangeAllocator::RangeAllocator(uint32_t capacity) {
+    grow(capacity);
+  }
+
+  uint32_t RangeAllocator::allocate(uint32_t count) {
+    if (count == 0)
+      return INVALID;
+
+    for (auto iter = m_free.begin(); iter != m_free.end(); ++iter) {
+      if (iter->second < count)
+        continue;
+
+      uint32_t offset    = iter->first;
+      uint32_t remaining = iter->second - count;
+      m_free.erase(iter);
+
+      if (remaining)
+        m_free.emplace(offset + count, remaining);
+
+      m_used += count;
+      return offset;
+    }
+
+    return INVALID;
+  }
+
+  void RangeAllocator::release(uint32_t offset, uint32_t count) {
+    if (offset == INVALID || count == 0)
+      return;
+
+    assert(offset + count <= m_capacity);
+    m_used -= count;
+
+    auto next = m_free.lower_bound(offset);
+
+    // merge with the block after
+    if (next != m_free.end() && offset + count == next->first) {
+      count += next->second;
+      next = m_free.erase(next);
+    }
+
+    // merge with the block before
+    if (next != m_free.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == offset) {
+        prev->second += count;
+        return;
+      }
+    }
+
+    m_free.emplace(offset, count);
+  }
+
+  void RangeAllocator::grow(uint32_t newCapacity) {
+    if (newCapacity <= m_capacity)
+      return;
+
+    uint32_t oldCapacity = m_capacity;
+    m_capacity           = newCapacity;
+
+    // the new tail is free; release() merges it with a free block at the old end
+    m_used += newCapacity - oldCapacity;
+    release(oldCapacity, newCapacity - oldCapacity);
+  }
+
+  uint32_t RangeAllocator::getCapacity() const {
+    return m_capacity;
+  }
+
+  uint32_t RangeAllocator::getUsed() const {
+    return m_used;
+  }
+
+  uint32_t RangeAllocator::getLargestFree() const {
+    uint32_t largest = 0;
+    for (auto& block : m_free)
+      largest = std::max(largest, block.second);
+    return largest;
+  }
+
+  size_t RangeAllocator::getNumFreeBlocks() const {
+    return m_free.size();
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  //// GEOMETRY ARENA
+  /////////////////////////////////////////////////////////////////////////////
+
+  GeometryArena::GeometryArena(LogicalDevice& device, uint32_t vertexCapacity, uint32_t indexCapacity)
+    : m_device(device) {
+    reserve(vertexCapacity, indexCapacity);
+  }
+
+  GeometryArena::GeometryArena(GeometryArena&& o) noexcept
+    : m_device(o.m_device),
+      m_vertexBuff(std::move(o.m_vertexBuff)),
+      m_indexBuff(std::move(o.m_indexBuff)),
+      m_oldVertexBuff(std::move(o.m_oldVertexBuff)),
+      m_oldIndexBuff(std::move(o.m_oldIndexBuff)),
+      m_oldVertexCount(o.m_oldVertexCount),
+      m_oldIndexCount(o.m_oldIndexCount),
+      m_vertexRanges(std::move(o.m_vertexRanges)),
+      m_indexRanges(std::move(o.m_indexRanges)),
+      m_pending(std::move(o.m_pending)),
+      m_retired(std::move(o.m_retired)),
+      m_frame(o.m_frame),
+      m_generation(o.m_generation) {
+  }
+
+  void GeometryArena::reserve(uint32_t vertexCapacity, uint32_t indexCapacity) {
+    if (vertexCapacity > m_vertexRanges.getCapacity()) {
+      // If a grow is already waiting on a flush, that older buffer is still the one
+      // holding the uploaded data. The one being replaced now has had nothing written.
+      if (!m_oldVertexBuff && m_vertexBuff) {
+        m_oldVertexBuff  = m_vertexBuff;
+        m_oldVertexCount = m_vertexRanges.getCapacity();
+      }
+
+      // TRANSFER_SRC so it can be copied out of when it is outgrown
+      m_vertexBuff = util::make_ptr<Buffer>(m_device,
+                                            VkDeviceSize(vertexCapacity) * sizeof(Vertex),
+                                            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      m_vertexRanges.grow(vertexCapacity);
+      ++m_generation;
+    }
+
+    if (indexCapacity > m_indexRanges.getCapacity()) {
+      if (!m_oldIndexBuff && m_indexBuff) {
+        m_oldIndexBuff  = m_indexBuff;
+        m_oldIndexCount = m_indexRanges.getCapacity();
+      }
+
+      m_indexBuff = util::make_ptr<Buffer>(m_device,
+                                           VkDeviceSize(indexCapacity) * sizeof(uint32_t),
+                                           VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      m_indexRanges.grow(indexCapacity);
+      ++m_generation;
+    }
+  }
+
+  GeometryArena::Allocation GeometryArena::allocate(std::vector<Vertex> const&   vertices,
+                                                    std::vector<uint32_t> const& indices) {
+    Allocation alloc;
+    if (vertices.empty() || indices.empty())
+      return alloc;
+
+    const auto vertCount  = static_cast<uint32_t>(vertices.size());
+    const auto indexCount = static_cast<uint32_t>(indices.size());
+
+    alloc.vertexOffset = m_vertexRanges.allocate(vertCount);
+    alloc.firstIndex   = m_indexRanges.allocate(indexCount);
+
+    // Out of room: grow geometrically, then try again. The free tail merges with
+    // whatever was free at the old end so the request always fits afterwards.
+    if (alloc.vertexOffset == RangeAllocator::INVALID || alloc.firstIndex == RangeAllocator::INVALID) {
+      uint32_t newVertCap  = m_vertexRanges.getCapacity();
+      uint32_t newIndexCap = m_indexRanges.getCapacity();
+
+      if (alloc.vertexOffset == RangeAllocator::INVALID)
+        newVertCap = std::max(newVertCap * 2, m_vertexRanges.getCapacity() + vertCount);
+      if (alloc.firstIndex == RangeAllocator::INVALID)
+        newIndexCap = std::max(newIndexCap * 2, m_indexRanges.getCapacity() + indexCount);
+
+      Trace::Warn << "Geometry arena growing to " << newVertCap << " vertices / "
+        << newIndexCap << " indices" << Trace::Stop;
+
+      reserve(newVertCap, newIndexCap);
+
+      if (alloc.vertexOffset == RangeAllocator::INVALID)
+        alloc.vertexOffset = m_vertexRanges.allocate(vertCount);
+      if (alloc.firstIndex == RangeAllocator::INVALID)
+        alloc.firstIndex = m_indexRanges.allocate(indexCount);
+
+      if (alloc.vertexOffset == RangeAllocator::INVALID || alloc.firstIndex == RangeAllocator::INVALID)
+        throw std::runtime_error("Could not allocate mesh range in geometry arena");
+    }
+
+    alloc.vertexCount = vertCount;
+    alloc.indexCount  = indexCount;
+
+    PendingCopy copy;
+    copy.dest         = alloc;
+    copy.vertStaging  = util::make_ptr<Buffer>(Buffer::CreateStaging(m_device, vertCount * sizeof(Vertex)));
+    copy.indexStaging = util::make_ptr<Buffer>(Buffer::CreateStaging(m_device, indexCount * sizeof(uint32_t)));
+
+    void* data = copy.vertStaging->map();
+    memcpy(data, vertices.data(), vertCount * sizeof(Vertex));
+    copy.vertStaging->unMap();
+
+    data = copy.indexStaging->map();
+    memcpy(data, indices.data(), indexCount * sizeof(uint32_t));
+    copy.indexStaging->unMap();
+
+    m_pending.push_back(std::move(copy));
+    return alloc;
+  }
+
+  void GeometryArena::release(Allocation const& alloc) {
+    if (!alloc.isValid())
+      return;
+
+    // drop the copy if it was never flushed so it can't land on the next owner's data
+    m_pending.erase(std::remove_if(m_pending.begin(),
+                                   m_pending.end(),
+                                   [&alloc](PendingCopy const& p) {
+                                     return p.dest.vertexOffset == alloc.vertexOffset;
+                                   }),
+                    m_pending.end());
+
+    m_retired.push_back({m_frame, alloc, nullptr});
+  }
+
+  void GeometryArena::setFrame(uint64_t submitted) {
+    m_frame = submitted;
+  }
+
+  void GeometryArena::retire(uint64_t done) {
+    auto keep = std::partition(m_retired.begin(), m_retired.end(), [done](Retired const& r) {
+      return r.frame > done;
+    });
+
+    for (auto iter = keep; iter != m_retired.end(); ++iter) {
+      if (iter->range.isValid()) {
+        m_vertexRanges.release(iter->range.vertexOffset, iter->range.vertexCount);
+        m_indexRanges.release(iter->range.firstIndex, iter->range.indexCount);
+      }
+    }
+
+    m_retired.erase(keep, m_retired.end());
+  }
+
+  std::vector<util::ptr<Buffer>> GeometryArena::flush(CommandBuffer& cmdBuff) {
+    std::vector<util::ptr<Buffer>> keepAlive;
+    keepAlive.reserve(m_pending.size() * 2 + 2);
+
+    // Frames recorded before the grow still bind the old buffers, so they're retired with the frame
+    std::vector<VkBufferMemoryBarrier> grown;
+
+    if (m_oldVertexBuff) {
+      VkBufferCopy copy = {0, 0, VkDeviceSize(m_oldVertexCount) * sizeof(Vertex)};
+      vkCmdCopyBuffer(cmdBuff, *m_oldVertexBuff, *m_vertexBuff, 1, &copy);
+      grown.push_back({VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT,
+                       VK_ACCESS_TRANSFER_WRITE_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                       *m_vertexBuff, 0, copy.size});
+      m_retired.push_back({m_frame, {}, m_oldVertexBuff});
+      keepAlive.push_back(std::move(m_oldVertexBuff));
+      m_oldVertexCount = 0;
+    }
+
+    if (m_oldIndexBuff) {
+      VkBufferCopy copy = {0, 0, VkDeviceSize(m_oldIndexCount) * sizeof(uint32_t)};
+      vkCmdCopyBuffer(cmdBuff, *m_oldIndexBuff, *m_indexBuff, 1, &copy);
+      grown.push_back({VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT,
+                       VK_ACCESS_TRANSFER_WRITE_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                       *m_indexBuff, 0, copy.size});
+      m_retired.push_back({m_frame, {}, m_oldIndexBuff});
+      keepAlive.push_back(std::move(m_oldIndexBuff));
+      m_oldIndexCount = 0;
+    }
+
+    // the old contents cover ranges allocated before the grow, whose uploads are still pending;
+    // those have to land after the old bytes do, not race them
+    if (!grown.empty() && !m_pending.empty())
+      vkCmdPipelineBarrier(cmdBuff,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           0,
+                           0,
+                           nullptr,
+                           static_cast<uint32_t>(grown.size()),
+                           grown.data(),
+                           0,
+                           nullptr);
+
+    for (auto& pending : m_pending) {
+      VkBufferCopy vertCopy = {
+        0,
+        VkDeviceSize(pending.dest.vertexOffset) * sizeof(Vertex),
+        VkDeviceSize(pending.dest.vertexCount) * sizeof(Vertex)
+      };
+
+      VkBufferCopy indexCopy = {
+        0,
+        VkDeviceSize(pending.dest.firstIndex) * sizeof(uint32_t),
+        VkDeviceSize(pending.dest.indexCount) * sizeof(uint32_t)
+      };
+
+      vkCmdCopyBuffer(cmdBuff, *pending.vertStaging, *m_vertexBuff, 1, &vertCopy);
+      vkCmdCopyBuffer(cmdBuff, *pending.indexStaging, *m_indexBuff, 1, &indexCopy);
+
+      keepAlive.push_back(std::move(pending.vertStaging));
+      keepAlive.push_back(std::move(pending.indexStaging));
+    }
+
+    m_pending.clear();
+    return keepAlive;
+  }
+
+  void GeometryArena::bind(VkCommandBuffer cmdBuff) const {
+    const VkBuffer     buff   = *m_vertexBuff;
+    const VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmdBuff, 0, 1, &buff, &offset);
+    vkCmdBindIndexBuffer(cmdBuff, *m_indexBuff, 0, VK_INDEX_TYPE_UINT32);
+  }
+
+  bool GeometryArena::hasPending() const {
+    return !m_pending.empty() || m_oldVertexBuff || m_oldIndexBuff;
+  }
+
+  uint32_t GeometryArena::getGeneration() const {
+    return m_generation;
+  }
+
+  RangeAllocator const& GeometryArena::getVertexRanges() const {
+    return m_vertexRanges;
+  }
+
+  RangeAllocator const& GeometryArena::getIndexRanges() const {
+    return m_indexRanges;
+  }
+}
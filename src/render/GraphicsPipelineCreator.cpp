@@ -291,6 +291,15 @@ namespace dw {
     return *this;
   }
 
+  // DYNAMIC
+
+  GraphicsPipelineCreator& GraphicsPipelineCreator::setDynamicStates(std::vector<VkDynamicState> const& states) {
+    m_dynamicStates = states;
+    m_dynamic.dynamicStateCount = static_cast<uint32_t>(m_dynamicStates.size());
+    m_dynamic.pDynamicStates = m_dynamicStates.data();
+    return *this;
+  }
+
   // SHADERS
 
   GraphicsPipelineCreator& GraphicsPipelineCreator::addShaderStage(VkPipelineShaderStageCreateInfo const& info) {
@@ -358,8 +367,8 @@ namespace dw {
 
     GraphicsPipeline pipeline(device);
 
-    // TODO: Pipeline cache, simultaneous graphics pipeline creates
-    if (vkCreateGraphicsPipelines(device, nullptr, 1, &createInfo, nullptr, &pipeline.m_pipeline) != VK_SUCCESS || !
+    // the cache is internally synchronized, so steps can create their pipelines on separate threads
+    if (vkCreateGraphicsPipelines(device, device.getPipelineCache(), 1, &createInfo, nullptr, &pipeline.m_pipeline) != VK_SUCCESS || !
         pipeline.m_pipeline)
       throw std::runtime_error("Could not create pipeline");
 
@@ -409,6 +409,19 @@ namespace dw {
       throw std::runtime_error("Could not bind device memory to image");
   }
 
+  void DependentImage::bind(VkDeviceMemory memory, VkDeviceSize offset) {
+    assert(m_image && !m_memory);
+
+    if (vkBindImageMemory(m_device, m_image, memory, offset) != VK_SUCCESS)
+      throw std::runtime_error("Could not bind device memory to image");
+  }
+
+  VkMemoryRequirements DependentImage::getMemoryRequirements() const {
+    VkMemoryRequirements requirements = {};
+    vkGetImageMemoryRequirements(m_device, m_image, &requirements);
+    return requirements;
+  }
+
   void* DependentImage::map() {
     void* data = nullptr;
     if(m_memory && !m_isMapped) {
@@ -24,6 +24,8 @@
 #include "util/Trace.h"
 
 #include <cassert>
+#include <stdexcept>
+#include <string>
 
 namespace dw {
   Queue LogicalDevice::m_badQueue = Queue(std::numeric_limits<uint32_t>::max());
@@ -53,7 +55,9 @@ namespace dw {
   LogicalDevice::LogicalDevice(LogicalDevice&& o) noexcept
     : m_physical(o.m_physical),
       m_device(o.m_device),
-      m_queues(std::move(o.m_queues)) {
+      m_queues(std::move(o.m_queues)),
+      m_waitSemaphores(o.m_waitSemaphores),
+      m_getSemaphoreCounterValue(o.m_getSemaphoreCounterValue) {
   }
 
   LogicalDevice::LogicalDevice(PhysicalDevice&                 physical,
@@ -62,7 +66,8 @@ namespace dw {
                                QueueList const&                queues,
                                VkPhysicalDeviceFeatures        requiredFeatures,
                                VkPhysicalDeviceFeatures const& requestedFeatures,
-                               bool                            useRequested)
+                               bool                            useRequested,
+                               const void*                     next)
     : m_physical(physical){
     Trace::Info << "Creating new logical device with " << queues.size() << " queue families in use " << Trace::Stop;
     
@@ -97,7 +102,7 @@ namespace dw {
 
     VkDeviceCreateInfo devCreate = {
       VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-      nullptr,
+      next,
       0,
       static_cast<uint32_t>(devQCreates.size()),
       devQCreates.data(),
@@ -114,6 +119,16 @@ namespace dw {
       std::abort();
     }
 
+    // the queues make their timelines with these
+    for (auto extension : extensions) {
+      if (std::string(extension) == VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) {
+        m_waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+          vkGetDeviceProcAddr(m_device, "vkWaitSemaphoresKHR"));
+        m_getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+          vkGetDeviceProcAddr(m_device, "vkGetSemaphoreCounterValueKHR"));
+      }
+    }
+
     m_queues.resize(queues.size());
     for (uint32_t i = 0; i < queues.size(); ++i) {
       m_queues[i].reserve(queues[i].second.size());
@@ -164,4 +179,47 @@ namespace dw {
     return m_badQueue;
   }
 
+  void LogicalDevice::setPipelineCache(VkPipelineCache cache) {
+    m_pipelineCache = cache;
+  }
+
+  VkPipelineCache LogicalDevice::getPipelineCache() const {
+    return m_pipelineCache;
+  }
+
+  bool LogicalDevice::hasTimelineSemaphores() const {
+    return m_waitSemaphores && m_getSemaphoreCounterValue;
+  }
+
+  uint64_t LogicalDevice::getTimelineValue(VkSemaphore timeline) const {
+    assert(hasTimelineSemaphores());
+
+    uint64_t value = 0;
+    if (m_getSemaphoreCounterValue(m_device, timeline, &value) != VK_SUCCESS)
+      throw std::runtime_error("Could not read a timeline semaphore");
+
+    return value;
+  }
+
+  bool LogicalDevice::waitTimelines(uint32_t           count,
+                                    VkSemaphore const* timelines,
+                                    uint64_t const*    values,
+                                    uint64_t           timeout) const {
+    assert(hasTimelineSemaphores());
+
+    VkSemaphoreWaitInfoKHR waitInfo = {
+      VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+      nullptr,
+      0,
+      count,
+      timelines,
+      values
+    };
+
+    VkResult result = m_waitSemaphores(m_device, &waitInfo, timeout);
+    if (result != VK_SUCCESS && result != VK_TIMEOUT)
+      throw std::runtime_error("Could not wait on timeline semaphores");
+
+    return result == VK_SUCCESS;
+  }
 }
@@ -29,4 +29,15 @@ namespace dw {
 
     throw std::runtime_error("failed to find suitable memory type!");
   }
+
+  bool MemoryAllocator::HasAppropriateMemType(uint32_t filter, VkMemoryPropertyFlags memProps) const {
+    auto& props = m_physical.getMemoryProperties();
+    for (uint32_t i = 0; i < props.memoryTypeCount; i++) {
+      if ((filter & (1 << i)) && (props.memoryTypes[i].propertyFlags & memProps) == memProps) {
+        return true;
+      }
+    }
+
+    return false;
+  }
 }
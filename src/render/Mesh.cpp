@@ -3,7 +3,7 @@
 // * Copyright (C) DigiPen Institute of Technology 2019
 // * 
 // * Created     : 2019y 09m 26d
-// * Last Altered: 2019y 12m 26d
+// * Last Altered: 2020y 03m 02d
 // * 
 // * Author      : David Walker
 // * E-mail      : d.walker\@digipen.edu
@@ -12,33 +12,48 @@
 // * Description :
 
 #include "render/Mesh.h"
-#include "render/CommandBuffer.h"
-#include "render/Queue.h"
+
+#include <algorithm>
+#include <cassert>
 
 
 namespace dw {
   Mesh::Mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices)
     : m_vertices(std::move(vertices)),
       m_indices(std::move(indices)) {
+    if (m_vertices.empty())
+      return;
+
+    // sphere around the AABB; loose, but cheap & good enough for culling
+    glm::vec3 min = m_vertices.front().pos;
+    glm::vec3 max = min;
+    for (auto& vert : m_vertices) {
+      min = glm::min(min, vert.pos);
+      max = glm::max(max, vert.pos);
+    }
+
+    glm::vec3 center = (min + max) * 0.5f;
+    float     radius = 0.f;
+    for (auto& vert : m_vertices)
+      radius = std::max(radius, length2(vert.pos - center));
+
+    m_bounds = glm::vec4(center, sqrt(radius));
   }
 
   Mesh::Mesh(Mesh&& o) noexcept
     : m_vertices(std::move(o.m_vertices)),
       m_indices(std::move(o.m_indices)),
-      m_vertexBuff(std::move(o.m_vertexBuff)),
-      m_indexBuff(std::move(o.m_indexBuff)),
+      m_range(o.m_range),
+      m_arena(std::move(o.m_arena)),
+      m_bounds(o.m_bounds),
       m_material(std::move(o.m_material)) {
-    o.m_vertexBuff = nullptr;
-    o.m_indexBuff  = nullptr;
-    o.m_material   = nullptr;
+    o.m_range    = {};
+    o.m_arena.reset();
+    o.m_material = nullptr;
   }
 
   Mesh::~Mesh() {
-    if (m_vertexBuff)
-      m_vertexBuff.reset();
-
-    if (m_indexBuff)
-      m_indexBuff.reset();
+    release();
 
     if (m_material)
       m_material.reset();
@@ -58,20 +73,26 @@ namespace dw {
     return m_material;
   }
 
-  Buffer& Mesh::getIndexBuffer() const {
-    return *m_indexBuff;
+  glm::vec4 const& Mesh::getBoundingSphere() const {
+    return m_bounds;
   }
 
-  Buffer& Mesh::getVertexBuffer() const {
-    return *m_vertexBuff;
+  GeometryArena::Allocation const& Mesh::getRange() const {
+    return m_range;
   }
 
   Mesh& Mesh::operator=(Mesh&& o) noexcept {
-    m_vertices   = std::move(o.m_vertices);
-    m_indices    = std::move(o.m_indices);
-    m_vertexBuff = std::move(o.m_vertexBuff);
-    m_indexBuff  = std::move(o.m_indexBuff);
-    m_material   = std::move(m_material);
+    release();
+
+    m_vertices = std::move(o.m_vertices);
+    m_indices  = std::move(o.m_indices);
+    m_range    = o.m_range;
+    m_arena    = std::move(o.m_arena);
+    m_bounds   = o.m_bounds;
+    m_material = std::move(o.m_material);
+
+    o.m_range = {};
+    o.m_arena.reset();
     return *this;
   }
 
@@ -99,62 +120,22 @@ namespace dw {
     return m_vertices.size();
   }
 
-  void Mesh::createBuffers(LogicalDevice& device) {
-    auto vertSize  = getSizeOfVertices();
-    auto indexSize = getSizeOfIndices();
+  void Mesh::upload(util::ptr<GeometryArena> const& arena) {
+    assert(arena);
+    if (m_range.isValid())
+      return;
 
-    m_vertexBuff = std::make_unique<Buffer>(Buffer::CreateVertex(device, vertSize));
-    m_indexBuff  = std::make_unique<Buffer>(Buffer::CreateIndex(device, indexSize));
+    m_range = arena->allocate(m_vertices, m_indices);
+    m_arena = arena;
   }
 
-  void Mesh::uploadStaging(StagingBuffs& buffs) {
-    void* data = buffs.first.map();
-    memcpy(data, m_vertices.data(), getSizeOfVertices());
-    buffs.first.unMap();
+  void Mesh::release() {
+    // the arena may already be gone if the renderer shut down first
+    if (auto arena = m_arena.lock())
+      arena->release(m_range);
 
-    data = buffs.second.map();
-    memcpy(data, m_indices.data(), getSizeOfIndices());
-    buffs.second.unMap();
-  }
-
-  Mesh::StagingBuffs Mesh::createStaging(LogicalDevice& device) const {
-    return std::make_pair(
-                          Buffer::CreateStaging(device, getSizeOfVertices()),
-                          Buffer::CreateStaging(device, getSizeOfIndices())
-                         );
-  }
-
-  void Mesh::uploadCmds(CommandBuffer& cmdBuff, StagingBuffs& buffs) const {
-    VkBufferCopy vertCopy  = {0, 0, getSizeOfVertices()};
-    VkBufferCopy indexCopy = {0, 0, getSizeOfIndices()};
-
-    assert(m_vertexBuff);
-    assert(m_indexBuff);
-
-    vkCmdCopyBuffer(cmdBuff, buffs.first, *m_vertexBuff, 1, &vertCopy);
-    vkCmdCopyBuffer(cmdBuff, buffs.second, *m_indexBuff, 1, &indexCopy);
-  }
-
-  Mesh::StagingBuffs Mesh::upload(CommandBuffer& cmdBuff) {
-    LogicalDevice& device    = cmdBuff.getOwningPool().getOwningDevice();
-    auto           vertSize  = getSizeOfVertices();
-    auto           indexSize = getSizeOfIndices();
-
-    createBuffers(device);
-    auto staging = createStaging(device);
-    uploadStaging(staging);
-    uploadCmds(cmdBuff, staging);
-
-    return staging;
-  }
-
-  void Mesh::upload(CommandBuffer& buffer, Queue& queue) {
-    buffer.start(true);
-    auto staging = upload(buffer);
-    buffer.end();
-
-    queue.submitOne(buffer);
-    queue.waitSubmit();
+    m_range = {};
+    m_arena.reset();
   }
 
   void Mesh::clearCache() {
@@ -197,10 +178,14 @@ namespace dw {
 
 
   bool Mesh::isDrawable() const {
-    return m_vertexBuff != nullptr;
+    return m_range.isValid();
   }
 
   bool Mesh::operator==(Mesh const& o) const {
-    return m_vertexBuff == o.m_vertexBuff;
+    // a mesh that isn't resident has no range to compare, so it only matches itself
+    if (!m_range.isValid() || !o.m_range.isValid())
+      return this == &o;
+
+    return m_range.vertexOffset == o.m_range.vertexOffset && m_range.firstIndex == o.m_range.firstIndex;
   }
 }
@@ -11,43 +11,16 @@
 // * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
 // * Description :
 
-#include <tiny_obj_loader.h>
-
 #include "render/MeshManager.h"
+#include "render/ObjLoader.h"
 #include "render/Renderer.h"
 #include "util/Trace.h"
 #include <algorithm>
+#include <cassert>
 #include <filesystem>
-#include <unordered_set>
+#include <limits>
 namespace fs = std::filesystem;
 
-bool operator==(tinyobj::index_t const& a, tinyobj::index_t const& b) {
-  return a.vertex_index == b.vertex_index && a.texcoord_index == b.texcoord_index && a.normal_index == b.normal_index;
-}
-
-namespace std {
-  template <>
-  struct equal_to<tinyobj::index_t> { // functor for operator==
-    _CXX17_DEPRECATE_ADAPTOR_TYPEDEFS typedef tinyobj::index_t first_argument_type;
-    _CXX17_DEPRECATE_ADAPTOR_TYPEDEFS typedef tinyobj::index_t second_argument_type;
-    _CXX17_DEPRECATE_ADAPTOR_TYPEDEFS typedef bool             result_type;
-
-    constexpr bool operator()(const tinyobj::index_t& _Left, const tinyobj::index_t& _Right) const {
-      return _Left.vertex_index == _Right.vertex_index && _Left.texcoord_index == _Right.texcoord_index && _Left.
-             normal_index == _Right.normal_index;
-    }
-  };
-
-  template <>
-  struct hash<tinyobj::index_t> {
-    size_t operator()(const tinyobj::index_t& i) const noexcept {
-      return (hash<int>()(i.vertex_index) << 32)
-             ^ (hash<int>()(i.texcoord_index) << 16)
-             ^ (hash<int>()(i.normal_index));
-    }
-  };
-}
-
 namespace dw {
   MeshManager::MeshManager(MaterialManager& mtlLoader)
     : m_materialLoader(mtlLoader){
@@ -72,12 +45,25 @@ namespace dw {
     return m_loadedMeshes.at(key);
   }
 
+  void MeshManager::unload(MeshKey key) {
+    // ~Mesh gives the range back once the last reference goes away; the arena hands it out
+    // again once the frames that might still draw it are done
+    m_loadedMeshes.erase(key);
+  }
+
   void MeshManager::uploadMeshes(Renderer& renderer) {
     renderer.uploadMeshes(m_loadedMeshes);
   }
 
-  MeshManager::MeshKey MeshManager::load(std::string const& filename, bool flipWinding) {
-    using namespace tinyobj;
+  void MeshManager::weld(std::string const&           name,
+                         std::vector<Vertex>&         verts,
+                         std::vector<uint32_t>&       indices,
+                         VertexWelder::Options const& options) {
+    auto stats = VertexWelder::Weld(verts, indices, options);
+    Trace::All << "Mesh welding (" << name << "): " << stats << Trace::Stop;
+  }
+
+  MeshManager::MeshKey MeshManager::load(std::string const& filename, bool flipWinding, VertexWelder::Options const& weldOptions) {
     /* Attributes:
      *  - Contains vertices, normals, texture coords, (colors)
      *    ALL IN SEPERATE VECTORS
@@ -114,98 +100,48 @@ namespace dw {
      *    - Also includes maps for rough/metallic/sheen, and emissive maps/normal maps
      *    - And texture options
      */
-    attrib_t                attributes;
-    std::vector<shape_t>    shapes;
-    std::vector<material_t> materials;
-    std::string             warnString;
-    std::string             errString;
+    ObjData     data;
+    std::string warnString;
+    std::string errString;
 
+    // tinyobj's base directory is prefixed as-is, so this is kept exactly as it was
     fs::path mtlPath = fs::current_path() / "data" / "materials";
-    bool     worked  = LoadObj(&attributes,
-                               &shapes,
-                               &materials,
-                               &warnString,
-                               &errString,
-                               filename.c_str(),
-                               mtlPath.generic_string().c_str());
+    bool     worked  = ObjLoader::Load(filename, mtlPath.generic_string(), data, &warnString, &errString);
 
     if (!errString.empty())
       Trace::Error << "Model Loading Error: " << errString << Trace::Stop;
     if (!warnString.empty())
       Trace::Warn << "Model Loading Warning: " << warnString << Trace::Stop;
 
-    if (!worked) {
+    if (!worked || data.vertices.empty()) {
       return std::numeric_limits<MeshKey>::max();
     }
 
-    bool computeNormals  = attributes.normals.empty();
-    bool computeTangents = !attributes.texcoords.empty();
-
-    assert(attributes.vertices.size() % 3 == 0);
-    const size_t                        vertexCount = attributes.vertices.size() / 3;
-    std::vector<Vertex>                 vertices;
-    std::vector<uint32_t>               indices;
-    std::unordered_map<index_t, size_t> vertexIndexCombos;
-
-    // Getting a vertex of index i : attributes.vertices[i * 3] attributes.vertices[i * 3 + 1] attributes.vertices[i * 3 + 2]
-    // Vertex info:
-    //  - Position
-    //  - Normal
-    //  - Tangent
-    //  - Bitangent
-    //  - Texcoord
-    //  - Color
-    // A vertex is created for each UNIQUE COMBINATION of data
-    // If a face has 8/2 3/1 4/2 as its vi/ti, and another has 8/1 3/1 4/2, then we'll end up with
-    // four total vertices: 8/1, 8/2, 3/1, 4/2.
-    size_t duplicates_saved = 0;
-    util::ptr<Material> loadedMtl = nullptr;
-    for (auto& shape : shapes) {
-      auto& mesh = shape.mesh;
-      if (mesh.material_ids.front() > 0) {
-        loadedMtl = m_materialLoader.get().getMtl(m_materialLoader.get().load(materials[mesh.material_ids.front()]));
-      }
-
-      for (uint32_t i = 0; i < mesh.indices.size(); ++i) {
-        auto& index = mesh.indices[i];
-
-        // if this combination is already a part of the data
-        auto val = vertexIndexCombos.find(index);
-        if (val != vertexIndexCombos.end()) {
-          indices.push_back(val->second);
-          ++duplicates_saved;
-        }
-        else {
-          // new unique combination
-          auto& vi = index.vertex_index;
-          auto& ti = index.texcoord_index;
-          auto& ni = index.normal_index;
-
-          Vertex v;
-          v.pos = {attributes.vertices[vi * 3], attributes.vertices[vi * 3 + 1], attributes.vertices[vi * 3 + 2]};
-
-          if (!attributes.normals.empty())
-            v.normal = {attributes.normals[ni * 3], attributes.normals[ni * 3 + 1], attributes.normals[ni * 3 + 2]};
-
-          if (!attributes.texcoords.empty())
-            v.texCoord = glm::vec2{attributes.texcoords[ti * 2], attributes.texcoords[ti * 2 + 1]};
-
-          if (!attributes.colors.empty())
-            v.color = {attributes.colors[vi * 3], attributes.colors[vi * 3 + 1], attributes.colors[vi * 3 + 2]};
+    bool computeNormals  = !data.hasNormals;
+    bool computeTangents = data.hasTexCoords;
 
-          indices.push_back(vertices.size());
-          vertexIndexCombos.try_emplace(index, vertices.size());
+    // The loader hands back one vertex for each UNIQUE COMBINATION of position/uv/normal
+    // indices, so if a face has 8/2 3/1 4/2 as its vi/ti, and another has 8/1 3/1 4/2,
+    // there are four vertices: 8/1, 8/2, 3/1, 4/2.
+    std::vector<Vertex>&   vertices         = data.vertices;
+    std::vector<uint32_t>& indices          = data.indices;
+    size_t                 duplicates_saved = data.duplicatesSaved;
 
-          vertices.push_back(v);
-        }
+    util::ptr<Material> loadedMtl = nullptr;
+    for (auto& shape : data.shapes) {
+      if (shape.materialID > 0) {
+        loadedMtl = m_materialLoader.get().getMtl(m_materialLoader.get().load(data.materials[shape.materialID]));
       }
     }
 
+    Trace::All << "Mesh Loading Duplicates (" << filename << "): " << duplicates_saved << Trace::Stop;
+
+    // the loader only shares vertices the file shares indices for; this catches the rest
+    weld(filename, vertices, indices, weldOptions);
+
     vertices.shrink_to_fit();
     indices.shrink_to_fit();
 
-    Trace::All << "Mesh Loading Duplicates (" << filename << "): " << duplicates_saved << Trace::Stop;
-
     // We now have a complete list of VERTICES and INDICES for a complete mesh.
     // Compute normals / tangents / bitangents
 
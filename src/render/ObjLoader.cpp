@@ -0,0 +1,929 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : ObjLoader.cpp
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 05d
+// * Last Altered: 2020y 03m 05d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+
+#include "render/ObjLoader.h"
+#include "util/Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace dw {
+  namespace {
+    /////////////////////////////////////////////////////////////////////////////
+    //// MAPPED FILE
+    /////////////////////////////////////////////////////////////////////////////
+
+    // Read-only view of a whole file. Empty files open fine with a null data pointer.
+    class MappedFile {
+    public:
+      explicit MappedFile(std::string const& filename) {
+#ifdef _WIN32
+        m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+          return;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size))
+          return;
+
+        m_size   = static_cast<size_t>(size.QuadPart);
+        m_opened = true;
+        if (m_size == 0)
+          return;
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping) {
+          m_opened = false;
+          return;
+        }
+
+        m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        m_opened = m_data != nullptr;
+#else
+        m_file = open(filename.c_str(), O_RDONLY);
+        if (m_file < 0)
+          return;
+
+        struct stat info {};
+        if (fstat(m_file, &info) != 0)
+          return;
+
+        m_size   = static_cast<size_t>(info.st_size);
+        m_opened = true;
+        if (m_size == 0)
+          return;
+
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+        if (data == MAP_FAILED) {
+          m_opened = false;
+          return;
+        }
+
+        madvise(data, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(data);
+#endif
+      }
+
+      ~MappedFile() {
+#ifdef _WIN32
+        if (m_data)
+          UnmapViewOfFile(m_data);
+        if (m_mapping)
+          CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+          CloseHandle(m_file);
+#else
+        if (m_data)
+          munmap(const_cast<char*>(m_data), m_size);
+        if (m_file >= 0)
+          close(m_file);
+#endif
+      }
+
+      MappedFile(MappedFile const&) = delete;
+      MappedFile& operator=(MappedFile const&) = delete;
+
+      NO_DISCARD bool        isOpen() const { return m_opened; }
+      NO_DISCARD const char* begin() const { return m_data; }
+      NO_DISCARD const char* end() const { return m_data + m_size; }
+      NO_DISCARD size_t      size() const { return m_size; }
+
+    private:
+      const char* m_data{nullptr};
+      size_t      m_size{0};
+      bool        m_opened{false};
+#ifdef _WIN32
+      HANDLE m_file{INVALID_HANDLE_VALUE};
+      HANDLE m_mapping{nullptr};
+#else
+      int m_file{-1};
+#endif
+    };
+
+    /////////////////////////////////////////////////////////////////////////////
+    //// TOKENIZING
+    /////////////////////////////////////////////////////////////////////////////
+
+    // '\r' counts as a space so CRLF files need no special handling
+    inline bool IsSpace(char c) {
+      return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline bool IsDigit(char c) {
+      return static_cast<unsigned>(c - '0') < 10u;
+    }
+
+    inline const char* SkipSpace(const char* p, const char* end) {
+      while (p < end && IsSpace(*p))
+        ++p;
+      return p;
+    }
+
+    inline const char* TokenEnd(const char* p, const char* end) {
+      while (p < end && !IsSpace(*p))
+        ++p;
+      return p;
+    }
+
+    inline const char* LineEnd(const char* p, const char* end) {
+      auto found = static_cast<const char*>(memchr(p, '\n', end - p));
+      return found ? found : end;
+    }
+
+    inline bool TokenIs(const char* p, const char* tokEnd, const char* keyword) {
+      const size_t len = strlen(keyword);
+      return static_cast<size_t>(tokEnd - p) == len && memcmp(p, keyword, len) == 0;
+    }
+
+    // rest of the line with the surrounding whitespace stripped
+    inline std::string RestOfLine(const char* p, const char* end) {
+      p = SkipSpace(p, end);
+      while (end > p && IsSpace(end[-1]))
+        --end;
+      return std::string(p, end);
+    }
+
+    // Decimal float without going through strtod or the locale. The mantissa is gathered
+    // exactly into an integer (up to 19 significant digits) and then scaled once by an
+    // exact power of ten, which is well within float precision.
+    bool ParseFloat(const char*& p, const char* end, float& out) {
+      static constexpr double POW10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+      };
+
+      const char* s = SkipSpace(p, end);
+      bool negative = false;
+      if (s < end && (*s == '-' || *s == '+'))
+        negative = *s++ == '-';
+
+      uint64_t mantissa    = 0;
+      int      exponent    = 0;
+      int      significant = 0;
+      bool     anyDigits   = false;
+
+      for (; s < end && IsDigit(*s); ++s) {
+        anyDigits = true;
+        if (significant < 19) {
+          mantissa = mantissa * 10 + (*s - '0');
+          significant += mantissa != 0;
+        }
+        else
+          ++exponent;
+      }
+
+      if (s < end && *s == '.') {
+        for (++s; s < end && IsDigit(*s); ++s) {
+          anyDigits = true;
+          if (significant < 19) {
+            mantissa = mantissa * 10 + (*s - '0');
+            significant += mantissa != 0;
+            --exponent;
+          }
+        }
+      }
+
+      if (!anyDigits)
+        return false;
+
+      if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* e       = s + 1;
+        bool        negExp  = false;
+        int         expPart = 0;
+
+        if (e < end && (*e == '-' || *e == '+'))
+          negExp = *e++ == '-';
+
+        if (e < end && IsDigit(*e)) {
+          for (; e < end && IsDigit(*e); ++e)
+            expPart = std::min(expPart * 10 + (*e - '0'), 9999);
+          exponent += negExp ? -expPart : expPart;
+          s = e;
+        }
+      }
+
+      double value = static_cast<double>(mantissa);
+      if (exponent < 0)
+        value = exponent >= -22 ? value / POW10[-exponent] : value * std::pow(10.0, exponent);
+      else if (exponent > 0)
+        value = exponent <= 22 ? value * POW10[exponent] : value * std::pow(10.0, exponent);
+
+      out = static_cast<float>(negative ? -value : value);
+      p   = s;
+      return true;
+    }
+
+    bool ParseInt(const char*& p, const char* end, int64_t& out) {
+      const char* s        = p;
+      bool        negative = false;
+      if (s < end && (*s == '-' || *s == '+'))
+        negative = *s++ == '-';
+
+      if (s >= end || !IsDigit(*s))
+        return false;
+
+      int64_t value = 0;
+      for (; s < end && IsDigit(*s); ++s)
+        value = std::min<int64_t>(value * 10 + (*s - '0'), std::numeric_limits<int32_t>::max());
+
+      out = negative ? -value : value;
+      p   = s;
+      return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////
+    //// CHUNKS
+    /////////////////////////////////////////////////////////////////////////////
+
+    constexpr int32_t  NO_INDEX       = std::numeric_limits<int32_t>::min();
+    constexpr uint32_t INVALID_VERTEX = ~0u;
+
+    // which of a corner's indices are still relative to the chunk rather than the file
+    enum : uint8_t {
+      RELATIVE_POS      = 1,
+      RELATIVE_TEXCOORD = 2,
+      RELATIVE_NORMAL   = 4
+    };
+
+    struct Corner {
+      int32_t v{NO_INDEX};
+      int32_t t{NO_INDEX};
+      int32_t n{NO_INDEX};
+      uint8_t relative{0};
+    };
+
+    // g/o/usemtl, applying from the corner index onwards
+    struct Marker {
+      enum class Type { Group, Material };
+
+      uint32_t    corner;
+      Type        type;
+      std::string name;
+    };
+
+    struct Chunk {
+      const char* begin{nullptr};
+      const char* end{nullptr};
+
+      std::vector<float>       positions; // xyz
+      std::vector<float>       colors;    // rgb, empty unless some vertex in the chunk has one
+      std::vector<float>       normals;   // xyz
+      std::vector<float>       texCoords; // uv
+      std::vector<Corner>      corners;   // already triangulated
+      std::vector<Marker>      markers;
+      std::vector<std::string> mtlLibs;
+
+      size_t      lineCount{0};
+      size_t      skippedFaces{0};
+      size_t      errorLine{0};
+      std::string error;
+    };
+
+    // Converts an OBJ index (1-based, or negative = relative to the last element so far)
+    // into a 0-based one. Negative indices can only be resolved against this chunk's own
+    // count here; they're flagged & offset once every chunk's size is known.
+    inline bool ConvertIndex(int64_t index, size_t localCount, int32_t& out, uint8_t& relative, uint8_t bit) {
+      if (index > 0) {
+        out = static_cast<int32_t>(index - 1);
+        return true;
+      }
+
+      if (index < 0) {
+        out = static_cast<int32_t>(static_cast<int64_t>(localCount) + index);
+        relative |= bit;
+        return true;
+      }
+
+      return false;
+    }
+
+    bool ParseCorner(const char*& p, const char* end, Chunk& chunk, Corner& corner) {
+      int64_t index;
+      if (!ParseInt(p, end, index))
+        return false;
+
+      if (!ConvertIndex(index, chunk.positions.size() / 3, corner.v, corner.relative, RELATIVE_POS))
+        return false;
+
+      if (p < end && *p == '/') {
+        ++p;
+        if (p < end && *p != '/') {
+          if (!ParseInt(p, end, index)
+              || !ConvertIndex(index, chunk.texCoords.size() / 2, corner.t, corner.relative, RELATIVE_TEXCOORD))
+            return false;
+        }
+
+        if (p < end && *p == '/') {
+          ++p;
+          if (!ParseInt(p, end, index)
+              || !ConvertIndex(index, chunk.normals.size() / 3, corner.n, corner.relative, RELATIVE_NORMAL))
+            return false;
+        }
+      }
+
+      // anything else glued onto the token is malformed
+      return p >= end || IsSpace(*p);
+    }
+
+    void ParseChunk(Chunk& chunk) {
+      // rough guess from the average line length of common files, saves most regrowth
+      const size_t guess = static_cast<size_t>(chunk.end - chunk.begin) / 32;
+      chunk.positions.reserve(guess * 3 / 2);
+      chunk.corners.reserve(guess * 3);
+
+      std::vector<Corner> face;
+
+      for (const char* line = chunk.begin; line < chunk.end; ++chunk.lineCount) {
+        const char* lineEnd = LineEnd(line, chunk.end);
+        const char* p       = SkipSpace(line, lineEnd);
+        line                = lineEnd + 1;
+
+        if (p == lineEnd || *p == '#')
+          continue;
+
+        const char* tokEnd = TokenEnd(p, lineEnd);
+
+        if (TokenIs(p, tokEnd, "v")) {
+          float values[7];
+          int   count = 0;
+          p           = tokEnd;
+          while (count < 7 && ParseFloat(p, lineEnd, values[count]))
+            ++count;
+
+          if (count < 3) {
+            chunk.error = "vertex position needs 3 components";
+            break;
+          }
+
+          chunk.positions.insert(chunk.positions.end(), values, values + 3);
+
+          // v x y z r g b; a lone 4th component is a weight, which isn't used
+          if (count >= 6) {
+            if (chunk.colors.empty())
+              chunk.colors.resize(chunk.positions.size() - 3, 1.f);
+            chunk.colors.insert(chunk.colors.end(), values + 3, values + 6);
+          }
+          else if (!chunk.colors.empty())
+            chunk.colors.insert(chunk.colors.end(), {1.f, 1.f, 1.f});
+        }
+        else if (TokenIs(p, tokEnd, "vn")) {
+          float values[3];
+          p = tokEnd;
+          if (!ParseFloat(p, lineEnd, values[0]) || !ParseFloat(p, lineEnd, values[1])
+              || !ParseFloat(p, lineEnd, values[2])) {
+            chunk.error = "normal needs 3 components";
+            break;
+          }
+
+          chunk.normals.insert(chunk.normals.end(), values, values + 3);
+        }
+        else if (TokenIs(p, tokEnd, "vt")) {
+          float values[2] = {0, 0};
+          p               = tokEnd;
+          if (!ParseFloat(p, lineEnd, values[0])) {
+            chunk.error = "texture coordinate needs at least 1 component";
+            break;
+          }
+
+          ParseFloat(p, lineEnd, values[1]);
+          chunk.texCoords.insert(chunk.texCoords.end(), values, values + 2);
+        }
+        else if (TokenIs(p, tokEnd, "f")) {
+          face.clear();
+          p = SkipSpace(tokEnd, lineEnd);
+
+          while (p < lineEnd) {
+            Corner corner;
+            if (!ParseCorner(p, lineEnd, chunk, corner)) {
+              chunk.error = "malformed face index";
+              break;
+            }
+
+            face.push_back(corner);
+            p = SkipSpace(p, lineEnd);
+          }
+
+          if (!chunk.error.empty())
+            break;
+
+          if (face.size() < 3) {
+            ++chunk.skippedFaces;
+            continue;
+          }
+
+          // triangle fan
+          for (size_t i = 1; i + 1 < face.size(); ++i) {
+            chunk.corners.push_back(face[0]);
+            chunk.corners.push_back(face[i]);
+            chunk.corners.push_back(face[i + 1]);
+          }
+        }
+        else if (TokenIs(p, tokEnd, "g") || TokenIs(p, tokEnd, "o")) {
+          chunk.markers.push_back({static_cast<uint32_t>(chunk.corners.size()),
+                                   Marker::Type::Group,
+                                   RestOfLine(tokEnd, lineEnd)});
+        }
+        else if (TokenIs(p, tokEnd, "usemtl")) {
+          chunk.markers.push_back({static_cast<uint32_t>(chunk.corners.size()),
+                                   Marker::Type::Material,
+                                   RestOfLine(tokEnd, lineEnd)});
+        }
+        else if (TokenIs(p, tokEnd, "mtllib")) {
+          for (p = SkipSpace(tokEnd, lineEnd); p < lineEnd; p = SkipSpace(tokEnd, lineEnd)) {
+            tokEnd = TokenEnd(p, lineEnd);
+            chunk.mtlLibs.emplace_back(p, tokEnd);
+          }
+        }
+
+        // s, l, p, vp and anything unknown are ignored
+      }
+
+      if (!chunk.error.empty())
+        chunk.errorLine = chunk.lineCount + 1;
+    }
+
+    // Runs fn(i) for i in [0, count), each on its own thread. 0 runs on the caller's.
+    template <typename Fn>
+    void ParallelFor(size_t count, Fn const& fn) {
+      std::vector<std::thread> threads;
+      threads.reserve(count ? count - 1 : 0);
+
+      for (size_t i = 1; i < count; ++i)
+        threads.emplace_back(fn, i);
+
+      if (count)
+        fn(0);
+
+      for (auto& thread : threads)
+        thread.join();
+    }
+
+    std::vector<Chunk> SplitChunks(MappedFile const& file) {
+      const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+      const size_t numChunks  = std::clamp<size_t>(file.size() / ObjLoader::MIN_CHUNK_SIZE, 1, maxThreads);
+
+      std::vector<Chunk> chunks(numChunks);
+      const char*        begin = file.begin();
+
+      // each boundary is pushed forward past the next newline so no line is split
+      for (size_t i = 0; i < numChunks; ++i) {
+        const char* end = file.end();
+        if (i + 1 < numChunks) {
+          end = std::max(begin, file.begin() + file.size() * (i + 1) / numChunks);
+          end = end < file.end() ? LineEnd(end, file.end()) : end;
+          end = end < file.end() ? end + 1 : end;
+        }
+
+        chunks[i].begin = begin;
+        chunks[i].end   = end;
+        begin           = end;
+      }
+
+      return chunks;
+    }
+
+    void SetDefaults(tinyobj::material_t& mtl) {
+      // same as tinyobj's, which leaves everything else zeroed
+      mtl           = tinyobj::material_t();
+      mtl.dissolve  = 1.f;
+      mtl.shininess = 1.f;
+      mtl.ior       = 1.f;
+    }
+
+    // texture statements may carry options (-bm 1, -clamp on, ...); the file name is the last token
+    std::string TextureName(const char* p, const char* end) {
+      std::string rest = RestOfLine(p, end);
+      auto        pos  = rest.find_last_of(" \t");
+      return pos == std::string::npos ? rest : rest.substr(pos + 1);
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  //// LOADER
+  /////////////////////////////////////////////////////////////////////////////
+
+  bool ObjLoader::Load(std::string const& filename,
+                       std::string const& mtlDirectory,
+                       ObjData&           out,
+                       std::string*       warn,
+                       std::string*       err) {
+    out = ObjData();
+
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+      if (err)
+        *err += "Could not open " + filename + "\n";
+      return false;
+    }
+
+    if (file.size() == 0)
+      return true;
+
+    // 1. parse every chunk on its own
+    auto chunks = SplitChunks(file);
+    ParallelFor(chunks.size(), [&chunks](size_t i) { ParseChunk(chunks[i]); });
+
+    size_t line = 0;
+    for (auto& chunk : chunks) {
+      if (!chunk.error.empty()) {
+        if (err)
+          *err += filename + ":" + std::to_string(line + chunk.errorLine) + ": " + chunk.error + "\n";
+        return false;
+      }
+
+      line += chunk.lineCount;
+    }
+
+    // 2. materials, so usemtl names can be turned into IDs. The directory is prefixed
+    // as-is, the same as tinyobj does with its base directory.
+    std::unordered_map<std::string, int> materialIDs;
+    for (auto& chunk : chunks) {
+      for (auto& lib : chunk.mtlLibs) {
+        size_t first = out.materials.size();
+        if (!LoadMtl(mtlDirectory + lib, out.materials, warn))
+          continue;
+
+        for (size_t i = first; i < out.materials.size(); ++i)
+          materialIDs.try_emplace(out.materials[i].name, static_cast<int>(i));
+      }
+    }
+
+    // 3. where each chunk's elements start in the file-wide arrays
+    struct Bases {
+      size_t positions, normals, texCoords, corners;
+    };
+
+    std::vector<Bases> bases(chunks.size());
+    Bases              totals = {0, 0, 0, 0};
+    bool               anyColors = false;
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      bases[i] = totals;
+      totals.positions += chunks[i].positions.size() / 3;
+      totals.normals += chunks[i].normals.size() / 3;
+      totals.texCoords += chunks[i].texCoords.size() / 2;
+      totals.corners += chunks[i].corners.size();
+      anyColors |= !chunks[i].colors.empty();
+    }
+
+    out.hasNormals   = totals.normals > 0;
+    out.hasTexCoords = totals.texCoords > 0;
+
+    // 4. make every index file-relative & check it
+    std::vector<std::string> indexErrors(chunks.size());
+    ParallelFor(chunks.size(), [&](size_t i) {
+      auto const& base = bases[i];
+
+      for (auto& corner : chunks[i].corners) {
+        if (corner.relative & RELATIVE_POS)
+          corner.v += static_cast<int32_t>(base.positions);
+        if (corner.t != NO_INDEX && (corner.relative & RELATIVE_TEXCOORD))
+          corner.t += static_cast<int32_t>(base.texCoords);
+        if (corner.n != NO_INDEX && (corner.relative & RELATIVE_NORMAL))
+          corner.n += static_cast<int32_t>(base.normals);
+
+        if (corner.v < 0 || static_cast<size_t>(corner.v) >= totals.positions
+            || (corner.t != NO_INDEX && (corner.t < 0 || static_cast<size_t>(corner.t) >= totals.texCoords))
+            || (corner.n != NO_INDEX && (corner.n < 0 || static_cast<size_t>(corner.n) >= totals.normals))) {
+          indexErrors[i] = "face references an element that doesn't exist";
+          return;
+        }
+      }
+    });
+
+    for (auto& indexError : indexErrors) {
+      if (!indexError.empty()) {
+        if (err)
+          *err += filename + ": " + indexError + "\n";
+        return false;
+      }
+    }
+
+    // 5. stitch the attribute arrays together
+    std::vector<float> positions, normals, texCoords, colors;
+    positions.reserve(totals.positions * 3);
+    normals.reserve(totals.normals * 3);
+    texCoords.reserve(totals.texCoords * 2);
+    if (anyColors)
+      colors.reserve(totals.positions * 3);
+
+    for (auto& chunk : chunks) {
+      positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+      normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+      texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+
+      if (anyColors) {
+        if (chunk.colors.empty())
+          colors.resize(colors.size() + chunk.positions.size(), 1.f);
+        else
+          colors.insert(colors.end(), chunk.colors.begin(), chunk.colors.end());
+      }
+    }
+
+    // 6. one walk over the faces: de-duplicate (position, uv, normal) combinations & cut shapes.
+    // Every vertex made from a position is chained off of it, so a lookup only ever looks
+    // at the handful of vertices that share that position.
+    std::vector<uint32_t> firstWithPos(totals.positions, INVALID_VERTEX);
+    std::vector<uint32_t> nextWithPos;
+    std::vector<std::pair<int32_t, int32_t>> vertexTN;
+
+    out.vertices.reserve(totals.positions);
+    out.indices.reserve(totals.corners);
+    nextWithPos.reserve(totals.positions);
+    vertexTN.reserve(totals.positions);
+
+    std::unordered_set<std::string> missingMaterials;
+
+    ObjShape shape;
+    auto     closeShape = [&out, &shape]() {
+      shape.indexCount = static_cast<uint32_t>(out.indices.size()) - shape.firstIndex;
+      if (shape.indexCount)
+        out.shapes.push_back(shape);
+      shape.firstIndex = static_cast<uint32_t>(out.indices.size());
+    };
+
+    for (auto& chunk : chunks) {
+      auto marker = chunk.markers.begin();
+
+      for (uint32_t c = 0; c <= chunk.corners.size(); ++c) {
+        for (; marker != chunk.markers.end() && marker->corner == c; ++marker) {
+          closeShape();
+
+          if (marker->type == Marker::Type::Group)
+            shape.name = marker->name;
+          else {
+            auto found       = materialIDs.find(marker->name);
+            shape.materialID = found != materialIDs.end() ? found->second : -1;
+
+            if (found == materialIDs.end() && warn && missingMaterials.insert(marker->name).second)
+              *warn += "material '" + marker->name + "' not found\n";
+          }
+        }
+
+        if (c == chunk.corners.size())
+          break;
+
+        auto const& corner = chunk.corners[c];
+        uint32_t    vertex = firstWithPos[corner.v];
+
+        while (vertex != INVALID_VERTEX && vertexTN[vertex] != std::make_pair(corner.t, corner.n))
+          vertex = nextWithPos[vertex];
+
+        if (vertex != INVALID_VERTEX) {
+          out.indices.push_back(vertex);
+          ++out.duplicatesSaved;
+          continue;
+        }
+
+        vertex = static_cast<uint32_t>(out.vertices.size());
+
+        Vertex v;
+        const size_t pi = static_cast<size_t>(corner.v) * 3;
+        v.pos = {positions[pi], positions[pi + 1], positions[pi + 2]};
+
+        if (corner.n != NO_INDEX) {
+          const size_t ni = static_cast<size_t>(corner.n) * 3;
+          v.normal = {normals[ni], normals[ni + 1], normals[ni + 2]};
+        }
+
+        if (corner.t != NO_INDEX) {
+          const size_t ti = static_cast<size_t>(corner.t) * 2;
+          v.texCoord = {texCoords[ti], texCoords[ti + 1]};
+        }
+
+        if (anyColors)
+          v.color = {colors[pi], colors[pi + 1], colors[pi + 2]};
+
+        out.vertices.push_back(v);
+        out.indices.push_back(vertex);
+        vertexTN.emplace_back(corner.t, corner.n);
+        nextWithPos.push_back(firstWithPos[corner.v]);
+        firstWithPos[corner.v] = vertex;
+      }
+    }
+
+    closeShape();
+
+    size_t skipped = 0;
+    for (auto& chunk : chunks)
+      skipped += chunk.skippedFaces;
+
+    if (skipped && warn)
+      *warn += std::to_string(skipped) + " faces with fewer than 3 vertices skipped\n";
+
+    return true;
+  }
+
+  bool ObjLoader::LoadMtl(std::string const&                filename,
+                          std::vector<tinyobj::material_t>& materials,
+                          std::string*                      warn) {
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+      if (warn)
+        *warn += "Material file " + filename + " not found\n";
+      return false;
+    }
+
+    tinyobj::material_t* mtl = nullptr;
+
+    auto readColor = [](const char* p, const char* end, tinyobj::real_t* dest) {
+      float values[3];
+      if (!ParseFloat(p, end, values[0]))
+        return;
+
+      // a single value means grey
+      values[1] = values[2] = values[0];
+      if (ParseFloat(p, end, values[1]))
+        ParseFloat(p, end, values[2]);
+
+      dest[0] = values[0];
+      dest[1] = values[1];
+      dest[2] = values[2];
+    };
+
+    auto readFloat = [](const char* p, const char* end, tinyobj::real_t& dest) {
+      float value;
+      if (ParseFloat(p, end, value))
+        dest = value;
+    };
+
+    for (const char* line = file.begin(); line < file.end();) {
+      const char* lineEnd = LineEnd(line, file.end());
+      const char* p       = SkipSpace(line, lineEnd);
+      line                = lineEnd + 1;
+
+      if (p == lineEnd || *p == '#')
+        continue;
+
+      const char* tokEnd = TokenEnd(p, lineEnd);
+
+      if (TokenIs(p, tokEnd, "newmtl")) {
+        materials.emplace_back();
+        mtl = &materials.back();
+        SetDefaults(*mtl);
+        mtl->name = RestOfLine(tokEnd, lineEnd);
+        continue;
+      }
+
+      // anything before the first newmtl has nothing to apply to
+      if (!mtl)
+        continue;
+
+      if (TokenIs(p, tokEnd, "Ka"))
+        readColor(tokEnd, lineEnd, mtl->ambient);
+      else if (TokenIs(p, tokEnd, "Kd"))
+        readColor(tokEnd, lineEnd, mtl->diffuse);
+      else if (TokenIs(p, tokEnd, "Ks"))
+        readColor(tokEnd, lineEnd, mtl->specular);
+      else if (TokenIs(p, tokEnd, "Kt") || TokenIs(p, tokEnd, "Tf"))
+        readColor(tokEnd, lineEnd, mtl->transmittance);
+      else if (TokenIs(p, tokEnd, "Ke"))
+        readColor(tokEnd, lineEnd, mtl->emission);
+      else if (TokenIs(p, tokEnd, "Ni"))
+        readFloat(tokEnd, lineEnd, mtl->ior);
+      else if (TokenIs(p, tokEnd, "Ns"))
+        readFloat(tokEnd, lineEnd, mtl->shininess);
+      else if (TokenIs(p, tokEnd, "illum")) {
+        int64_t value;
+        const char* s = SkipSpace(tokEnd, lineEnd);
+        if (ParseInt(s, lineEnd, value))
+          mtl->illum = static_cast<int>(value);
+      }
+      else if (TokenIs(p, tokEnd, "d"))
+        readFloat(tokEnd, lineEnd, mtl->dissolve);
+      else if (TokenIs(p, tokEnd, "Tr")) {
+        tinyobj::real_t tr = 0;
+        readFloat(tokEnd, lineEnd, tr);
+        mtl->dissolve = 1.f - tr;
+      }
+      else if (TokenIs(p, tokEnd, "Pr"))
+        readFloat(tokEnd, lineEnd, mtl->roughness);
+      else if (TokenIs(p, tokEnd, "Pm"))
+        readFloat(tokEnd, lineEnd, mtl->metallic);
+      else if (TokenIs(p, tokEnd, "Ps"))
+        readFloat(tokEnd, lineEnd, mtl->sheen);
+      else if (TokenIs(p, tokEnd, "Pc"))
+        readFloat(tokEnd, lineEnd, mtl->clearcoat_thickness);
+      else if (TokenIs(p, tokEnd, "Pcr"))
+        readFloat(tokEnd, lineEnd, mtl->clearcoat_roughness);
+      else if (TokenIs(p, tokEnd, "aniso"))
+        readFloat(tokEnd, lineEnd, mtl->anisotropy);
+      else if (TokenIs(p, tokEnd, "anisor"))
+        readFloat(tokEnd, lineEnd, mtl->anisotropy_rotation);
+      else if (TokenIs(p, tokEnd, "map_Ka"))
+        mtl->ambient_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "map_Kd"))
+        mtl->diffuse_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "map_Ks"))
+        mtl->specular_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "map_Ns"))
+        mtl->specular_highlight_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "map_bump") || TokenIs(p, tokEnd, "map_Bump") || TokenIs(p, tokEnd, "bump"))
+        mtl->bump_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "map_d"))
+        mtl->alpha_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "disp"))
+        mtl->displacement_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "refl"))
+        mtl->reflection_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "map_Pr"))
+        mtl->roughness_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "map_Pm"))
+        mtl->metallic_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "map_Ps"))
+        mtl->sheen_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "map_Ke"))
+        mtl->emissive_texname = TextureName(tokEnd, lineEnd);
+      else if (TokenIs(p, tokEnd, "norm"))
+        mtl->normal_texname = TextureName(tokEnd, lineEnd);
+      else
+        mtl->unknown_parameter.emplace(std::string(p, tokEnd), RestOfLine(tokEnd, lineEnd));
+    }
+
+    return true;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  //// BENCHMARK
+  /////////////////////////////////////////////////////////////////////////////
+
+  void ObjLoader::Benchmark(std::string const& directory, std::string const& mtlDirectory, int iterations) {
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms    = std::chrono::duration<double, std::milli>;
+
+    Trace::Info << "OBJ loading, best of " << iterations << " (tinyobj is timed without the vertex "
+      "de-duplication MeshManager used to do after it):" << Trace::Stop;
+
+    double totalTiny = 0, totalOurs = 0;
+
+    for (auto& entry : fs::directory_iterator(directory)) {
+      if (!entry.is_regular_file() || entry.path().extension() != ".obj")
+        continue;
+
+      const std::string filename = entry.path().generic_string();
+      double            bestTiny = std::numeric_limits<double>::max();
+      double            bestOurs = std::numeric_limits<double>::max();
+      size_t            vertexCount = 0;
+
+      for (int i = 0; i < iterations; ++i) {
+        tinyobj::attrib_t                attributes;
+        std::vector<tinyobj::shape_t>    shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string                      warnString, errString;
+
+        auto start = Clock::now();
+        tinyobj::LoadObj(&attributes, &shapes, &materials, &warnString, &errString,
+                         filename.c_str(), mtlDirectory.c_str());
+        bestTiny = std::min(bestTiny, Ms(Clock::now() - start).count());
+
+        ObjData data;
+        start = Clock::now();
+        Load(filename, mtlDirectory, data, nullptr, nullptr);
+        bestOurs = std::min(bestOurs, Ms(Clock::now() - start).count());
+
+        vertexCount = data.vertices.size();
+      }
+
+      totalTiny += bestTiny;
+      totalOurs += bestOurs;
+
+      Trace::Info << "  " << entry.path().filename().generic_string() << ": tinyobj " << bestTiny
+        << " ms, ObjLoader " << bestOurs << " ms (" << bestTiny / std::max(bestOurs, 1e-6) << "x), "
+        << vertexCount << " vertices" << Trace::Stop;
+    }
+
+    Trace::Info << "  total: tinyobj " << totalTiny << " ms, ObjLoader " << totalOurs << " ms ("
+      << totalTiny / std::max(totalOurs, 1e-6) << "x)" << Trace::Stop;
+  }
+}
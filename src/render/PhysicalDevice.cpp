@@ -18,6 +18,7 @@
 
 #include "render/PhysicalDevice.h"
 #include "util/Trace.h"
+#include <algorithm>
 #include <cassert>
 
 namespace dw {
@@ -50,6 +51,34 @@ namespace dw {
     return m_queueFamilies;
   }
   
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT const& PhysicalDevice::getDescriptorIndexingFeatures() const {
+    return m_indexingFeatures;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT const& PhysicalDevice::getDescriptorIndexingProperties() const {
+    return m_indexingProperties;
+  }
+
+  bool PhysicalDevice::hasExtension(const char* name) const {
+    return std::find(m_extensions.begin(), m_extensions.end(), name) != m_extensions.end();
+  }
+
+  bool PhysicalDevice::supportsBindlessTextures() const {
+    return hasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+           && m_indexingFeatures.shaderSampledImageArrayNonUniformIndexing
+           && m_indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+           && m_indexingFeatures.descriptorBindingPartiallyBound
+           && m_indexingFeatures.runtimeDescriptorArray;
+  }
+
+  bool PhysicalDevice::supportsTimelineSemaphores() const {
+    return hasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) && m_timelineFeatures.timelineSemaphore;
+  }
+
+  bool PhysicalDevice::supportsIndirectDraws() const {
+    return m_features.multiDrawIndirect && m_features.drawIndirectFirstInstance;
+  }
+
   VkFormatProperties PhysicalDevice::getFormatProperties(VkFormat format) const {
     VkFormatProperties ret = {};
     vkGetPhysicalDeviceFormatProperties(m_device, format, &ret);
@@ -81,13 +110,53 @@ namespace dw {
       exts.resize(numExt);
       vkEnumerateDeviceExtensionProperties(m_device, nullptr, &numExt, exts.data());
 
-      m_layers.reserve(numExt);
+      m_extensions.reserve(numExt);
       for (auto& ext : exts) {
-        m_layers.emplace_back(ext.extensionName);
+        m_extensions.emplace_back(ext.extensionName);
       }
     }
   }
 
+  void PhysicalDevice::queryDescriptorIndexing() {
+    // features2/properties2 are core in 1.1, which is what the instance is created with
+    if (!hasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+      return;
+
+    VkPhysicalDeviceFeatures2 features = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      &m_indexingFeatures
+    };
+
+    VkPhysicalDeviceProperties2 properties = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      &m_indexingProperties
+    };
+
+    vkGetPhysicalDeviceFeatures2(m_device, &features);
+    vkGetPhysicalDeviceProperties2(m_device, &properties);
+  }
+
+  void PhysicalDevice::queryTimelineSemaphores() {
+    if (!hasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+      return;
+
+    VkPhysicalDeviceFeatures2 features = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      &m_timelineFeatures
+    };
+
+    vkGetPhysicalDeviceFeatures2(m_device, &features);
+  }
+
+  void PhysicalDevice::queryIDProperties() {
+    VkPhysicalDeviceProperties2 properties = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      &m_idProperties
+    };
+
+    vkGetPhysicalDeviceProperties2(m_device, &properties);
+  }
+
   void PhysicalDevice::queryQueueFamilies() {
     uint32_t numExt = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(m_device, &numExt, nullptr);
@@ -139,6 +208,9 @@ namespace dw {
     queryLayers();
     queryExtensions();
     queryQueueFamilies();
+    queryDescriptorIndexing();
+    queryTimelineSemaphores();
+    queryIDProperties();
     //vkGetPhysicalDeviceFormatProperties(m_device, );
 
 #ifdef _DEBUG
@@ -159,4 +231,12 @@ namespace dw {
     return m_properties.limits;
   }
 
+  VkPhysicalDeviceProperties const& PhysicalDevice::getProperties() const {
+    return m_properties;
+  }
+
+  VkPhysicalDeviceIDProperties const& PhysicalDevice::getIDProperties() const {
+    return m_idProperties;
+  }
+
 }
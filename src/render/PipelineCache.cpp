@@ -0,0 +1,138 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : PipelineCache.cpp
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 17d
+// * Last Altered: 2020y 03m 17d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+
+#include "render/PipelineCache.h"
+#include "util/Trace.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace dw {
+  PipelineCache::PipelineCache(LogicalDevice& device, std::filesystem::path path)
+    : m_device(device),
+      m_path(std::move(path)) {
+    std::vector<char> data = readFile();
+
+    VkPipelineCacheCreateInfo createInfo = {
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      nullptr,
+      0,
+      data.size(),
+      data.empty() ? nullptr : data.data()
+    };
+
+    if (vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_cache) != VK_SUCCESS || !m_cache)
+      throw std::runtime_error("Could not create pipeline cache");
+
+    m_loadedBytes = data.size();
+  }
+
+  PipelineCache::PipelineCache(PipelineCache&& o) noexcept
+    : m_device(o.m_device),
+      m_path(std::move(o.m_path)),
+      m_cache(o.m_cache),
+      m_loadedBytes(o.m_loadedBytes) {
+    o.m_cache = nullptr;
+  }
+
+  PipelineCache::~PipelineCache() {
+    if (m_cache)
+      vkDestroyPipelineCache(m_device, m_cache, nullptr);
+  }
+
+  PipelineCache::operator VkPipelineCache() const {
+    return m_cache;
+  }
+
+  std::filesystem::path const& PipelineCache::getPath() const {
+    return m_path;
+  }
+
+  size_t PipelineCache::getLoadedBytes() const {
+    return m_loadedBytes;
+  }
+
+  PipelineCache::FileHeader PipelineCache::makeHeader(uint64_t dataSize) const {
+    auto const& props = getOwningPhysical().getProperties();
+    auto const& ids   = getOwningPhysical().getIDProperties();
+
+    FileHeader header = {
+      MAGIC,
+      props.vendorID,
+      props.deviceID,
+      props.driverVersion,
+      {},
+      {},
+      dataSize
+    };
+
+    std::memcpy(header.deviceUUID, ids.deviceUUID, VK_UUID_SIZE);
+    std::memcpy(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+  }
+
+  std::vector<char> PipelineCache::readFile() const {
+    std::ifstream file(m_path, std::ios_base::in | std::ios_base::binary);
+    if (!file.is_open()) {
+      Trace::Info << "No pipeline cache at " << m_path << ", starting empty" << Trace::Stop;
+      return {};
+    }
+
+    FileHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    const FileHeader expected = makeHeader(header.dataSize);
+    if (!file || std::memcmp(&header, &expected, sizeof(header)) != 0) {
+      Trace::Warn << "Pipeline cache " << m_path
+                  << " is from another device or driver version, starting empty" << Trace::Stop;
+      return {};
+    }
+
+    std::vector<char> data(static_cast<size_t>(header.dataSize));
+    file.read(data.data(), data.size());
+
+    if (!file) {
+      Trace::Warn << "Pipeline cache " << m_path << " is cut short, starting empty" << Trace::Stop;
+      return {};
+    }
+
+    Trace::Info << "Loaded " << data.size() << " bytes of pipeline cache from " << m_path << Trace::Stop;
+    return data;
+  }
+
+  void PipelineCache::save() const {
+    size_t size = 0;
+    vkGetPipelineCacheData(m_device, m_cache, &size, nullptr);
+
+    std::vector<char> data(size);
+    if (size && vkGetPipelineCacheData(m_device, m_cache, &size, data.data()) != VK_SUCCESS)
+      throw std::runtime_error("Could not get pipeline cache data");
+
+    // the data's own header only has the device's IDs & cache UUID; ours adds the device UUID
+    // & driver version, and a size so a half-written file is caught
+    const FileHeader header = makeHeader(size);
+
+    std::ofstream file(m_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file.is_open())
+      throw std::runtime_error("Could not open file " + m_path.string() + " for write");
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(data.data(), size);
+
+    if (!file)
+      throw std::runtime_error("Could not write pipeline cache to " + m_path.string());
+
+    Trace::Info << "Saved " << size << " bytes of pipeline cache to " << m_path << Trace::Stop;
+  }
+}
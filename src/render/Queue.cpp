@@ -21,6 +21,7 @@
 #include "render/Swapchain.h"
 #include "util/Utils.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <cassert>
 
@@ -63,80 +64,107 @@ namespace dw {
     if (!m_device)
       throw std::runtime_error("QUEUE DOES NOT HAVE OWNING LOGICAL DEVICE");
 
-    VkFenceCreateInfo fenceInfo = {
-      VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    if (!m_device->hasTimelineSemaphores())
+      throw std::runtime_error("Could not create a queue's timeline: VK_KHR_timeline_semaphore isn't enabled");
+
+    VkSemaphoreTypeCreateInfoKHR typeInfo = {
+      VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
       nullptr,
+      VK_SEMAPHORE_TYPE_TIMELINE_KHR,
       0
     };
 
-    vkCreateFence(*m_device, &fenceInfo, nullptr, &m_submitFence);
+    VkSemaphoreCreateInfo createInfo = {
+      VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      &typeInfo,
+      0
+    };
+
+    if (vkCreateSemaphore(*m_device, &createInfo, nullptr, &m_timeline) != VK_SUCCESS)
+      throw std::runtime_error("Could not create a queue's timeline");
   }
 
   void Queue::stop(const VkAllocationCallbacks* callbacks) {
     if (!m_device)
       throw std::runtime_error("QUEUE DOES NOT HAVE OWNING LOGICAL DEVICE");
 
-    if (m_submitFence) {
-      vkDestroyFence(*m_device, m_submitFence, callbacks);
-      m_submitFence = nullptr;
+    // Dropped without running them; the device is going away, and whatever they'd give back
+    // (command buffers & the like) went with it
+    if (m_queue)
+      vkQueueWaitIdle(m_queue);
+    m_retiring.clear();
+
+    if (m_timeline) {
+      vkDestroySemaphore(*m_device, m_timeline, callbacks);
+      m_timeline = nullptr;
     }
   }
 
-  bool Queue::isSubmitting() const {
-    return m_submitting;
+  uint64_t Queue::nextValue() {
+    return ++m_submitted;
   }
 
-  bool Queue::isSubmitFinished() {
-    if (!m_device)
-      throw std::runtime_error("QUEUE DOES NOT HAVE OWNING LOGICAL DEVICE");
+  VkSemaphore Queue::getTimeline() const {
+    return m_timeline;
+  }
 
-    if (m_submitFence && vkGetFenceStatus(*m_device, m_submitFence) == VK_SUCCESS) {
-      reset();
-      return true;
-    }
-    return false;
+  uint64_t Queue::getSubmitted() const {
+    return m_submitted;
   }
 
-  void Queue::submitMulti(std::vector<VkSubmitInfo> const& infos) {
-    if (m_submitting)
-      if (!isSubmitFinished())
-        return;
+  uint64_t Queue::getCompleted() const {
+    return m_device->getTimelineValue(m_timeline);
+  }
+
+  bool Queue::wait(uint64_t value, uint64_t timeout) const {
+    assert(value <= m_submitted);
+    return m_device->waitTimelines(1, &m_timeline, &value, timeout);
+  }
+
+  // The timeline's signal goes on the end of the info's own signals
+  uint64_t Queue::submit(VkSubmitInfo const& info) {
+    assert(!info.pNext);
 
     if (!m_queue)
-      return;
+      return 0;
 
-    if (vkQueueSubmit(m_queue, infos.size(), infos.data(), m_submitFence) != VK_SUCCESS)
-      throw std::runtime_error("Could not multi-submit queue");
+    uint64_t value = nextValue();
 
-    m_submitting = true;
-  }
+    std::vector<VkSemaphore> signals(info.pSignalSemaphores, info.pSignalSemaphores + info.signalSemaphoreCount);
+    signals.push_back(m_timeline);
 
-  void Queue::submitOne(VkSubmitInfo const& info, VkFence fence) {
-    if (m_submitting)
-      if (!isSubmitFinished())
-        return;
+    std::vector<uint64_t> waitValues(info.waitSemaphoreCount, 0); // binary ones ignore them
+    std::vector<uint64_t> signalValues(signals.size(), 0);
+    signalValues.back() = value;
 
-    if (!m_queue)
-      return;
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {
+      VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+      nullptr,
+      static_cast<uint32_t>(waitValues.size()),
+      waitValues.data(),
+      static_cast<uint32_t>(signalValues.size()),
+      signalValues.data()
+    };
+
+    VkSubmitInfo timelineSubmit         = info;
+    timelineSubmit.pNext                = &timelineInfo;
+    timelineSubmit.signalSemaphoreCount = static_cast<uint32_t>(signals.size());
+    timelineSubmit.pSignalSemaphores    = signals.data();
 
-    if (vkQueueSubmit(m_queue, 1, &info, fence) != VK_SUCCESS)
+    if (vkQueueSubmit(m_queue, 1, &timelineSubmit, nullptr) != VK_SUCCESS)
       throw std::runtime_error("Could not submit queue");
 
-    m_submitting = true;
+    return value;
   }
 
 
-  void Queue::submitOne(CommandBuffer const&                     buffer,
-                        std::vector<VkSemaphore> const&          waitSemaphores,
-                        std::vector<VkPipelineStageFlags> const& waitSemStages,
-                        std::vector<VkSemaphore> const&          signalSemaphores
+  uint64_t Queue::submitOne(CommandBuffer const&                     buffer,
+                            std::vector<VkSemaphore> const&          waitSemaphores,
+                            std::vector<VkPipelineStageFlags> const& waitSemStages,
+                            std::vector<VkSemaphore> const&          signalSemaphores
   ) {
-    if (m_submitting)
-      if (!isSubmitFinished())
-        return;
-
     if (!m_queue || !buffer.isReady())
-      return;
+      return 0;
 
     assert(waitSemaphores.size() == waitSemStages.size());
 
@@ -152,22 +180,26 @@ namespace dw {
       signalSemaphores.data()
     };
 
-    return submitOne(submitInfo);
+    return submit(submitInfo);
   }
 
-  void Queue::submitOne(VkSubmitInfo const& info) {
-    submitOne(info, m_submitFence);
-  }
+  void Queue::retire(uint64_t value, std::function<void()> release) {
+    auto at = std::upper_bound(m_retiring.begin(), m_retiring.end(), value, [](uint64_t v, auto const& r) {
+      return v < r.first;
+    });
 
-  void Queue::waitSubmit() {
-    if (!m_device)
-      throw std::runtime_error("QUEUE DOES NOT HAVE OWNING LOGICAL DEVICE");
+    m_retiring.emplace(at, value, std::move(release));
+  }
 
-    if (m_submitFence && m_submitting) {
-      vkWaitForFences(*m_device, 1, &m_submitFence, true, 100);
+  void Queue::collect() {
+    if (m_retiring.empty())
+      return;
 
-      if (vkGetFenceStatus(*m_device, m_submitFence) == VK_SUCCESS)
-        reset();
+    uint64_t completed = getCompleted();
+    while (!m_retiring.empty() && m_retiring.front().first <= completed) {
+      if (m_retiring.front().second)
+        m_retiring.front().second();
+      m_retiring.pop_front();
     }
   }
 
@@ -178,21 +210,7 @@ namespace dw {
     assert(m_queue);
 
     vkQueueWaitIdle(m_queue);
-
-    if (m_submitFence) {
-      if (vkGetFenceStatus(*m_device, m_submitFence) == VK_SUCCESS)
-        reset();
-    }
-  }
-
-  void Queue::reset() {
-    if (!m_device)
-      throw std::runtime_error("QUEUE DOES NOT HAVE OWNING LOGICAL DEVICE");
-
-    if (m_submitFence) {
-      m_submitting = false;
-      vkResetFences(*m_device, 1, &m_submitFence);
-    }
+    collect();
   }
 
   //void Queue::present(Swapchain const& swapchain) {
@@ -0,0 +1,790 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : RenderGraph.cpp
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 14d
+// * Last Altered: 2020y 03m 14d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+
+#include "render/RenderGraph.h"
+#include "render/CommandBuffer.h"
+#include "render/Image.h"
+#include "render/MemoryAllocator.h"
+#include "render/PhysicalDevice.h"
+#include "render/Queue.h"
+#include "util/Trace.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace dw {
+  namespace {
+    uint32_t passBit(RenderGraph::Handle pass) {
+      return 1u << pass;
+    }
+  }
+
+  RenderGraph::RenderGraph(LogicalDevice& device)
+    : m_device(device) {
+    // the submit infos point into these, so they can't grow mid-frame
+    m_submitBuffers.reserve(3 * MAX_PASSES);
+    m_submitSyncs.resize(MAX_PASSES);
+  }
+
+  RenderGraph::RenderGraph(RenderGraph&& o) noexcept
+    : m_device(o.m_device),
+      m_passes(std::move(o.m_passes)),
+      m_resources(std::move(o.m_resources)),
+      m_order(std::move(o.m_order)),
+      m_queues(std::move(o.m_queues)),
+      m_frameValues(std::move(o.m_frameValues)),
+      m_compiled(o.m_compiled),
+      m_memory(std::move(o.m_memory)),
+      m_transientBytes(o.m_transientBytes),
+      m_aliasedBytes(o.m_aliasedBytes),
+      m_submits(std::move(o.m_submits)),
+      m_submitBuffers(std::move(o.m_submitBuffers)),
+      m_submitSyncs(std::move(o.m_submitSyncs)),
+      m_queries(o.m_queries),
+      m_timing(o.m_timing),
+      m_busyMs(std::move(o.m_busyMs)) {
+    o.m_passes.clear();
+    o.m_memory.clear();
+    o.m_queries = nullptr;
+  }
+
+  RenderGraph::~RenderGraph() {
+    for (auto& pass : m_passes) {
+      if (pass.pre)
+        pass.pool->freeCommandBuffer(*pass.pre);
+      if (pass.post)
+        pass.pool->freeCommandBuffer(*pass.post);
+    }
+
+    if (m_queries)
+      vkDestroyQueryPool(m_device, m_queries, nullptr);
+
+    // the transient images don't free what they're bound to
+    for (auto memory : m_memory)
+      vkFreeMemory(m_device, memory, nullptr);
+  }
+
+  RenderGraph::Handle RenderGraph::addImage(std::string name, Image const& image, VkImageAspectFlags aspect) {
+    assert(!m_compiled);
+
+    Resource resource;
+    resource.name   = std::move(name);
+    resource.image  = image;
+    resource.aspect = aspect;
+
+    m_resources.push_back(std::move(resource));
+    return static_cast<Handle>(m_resources.size() - 1);
+  }
+
+  RenderGraph::Handle RenderGraph::addTransientImage(std::string name, DependentImage& image, VkImageAspectFlags aspect) {
+    Handle handle                  = addImage(std::move(name), image, aspect);
+    m_resources[handle].transient = &image;
+    return handle;
+  }
+
+  RenderGraph::Handle RenderGraph::addPass(std::string name, Queue& queue, CommandPool& pool) {
+    assert(!m_compiled);
+    if (m_passes.size() == MAX_PASSES)
+      throw std::runtime_error("Could not add render graph pass " + name + ": too many passes");
+
+    Pass pass;
+    pass.name  = std::move(name);
+    pass.queue = &queue;
+    pass.pool  = &pool;
+
+    m_passes.push_back(std::move(pass));
+    return static_cast<Handle>(m_passes.size() - 1);
+  }
+
+  void RenderGraph::read(Handle pass, Handle image, VkImageLayout layout, VkPipelineStageFlags stages) {
+    addAccess(pass, {image, layout, layout, stages, false});
+  }
+
+  void RenderGraph::write(Handle               pass,
+                          Handle               image,
+                          VkImageLayout        layout,
+                          VkImageLayout        leaves,
+                          VkPipelineStageFlags stages) {
+    addAccess(pass, {image, layout, leaves, stages, true});
+  }
+
+  // Using an image twice in a pass is one access: the first layout & the last one it's left in
+  void RenderGraph::addAccess(Handle pass, Access const& access) {
+    assert(!m_compiled && pass < m_passes.size() && access.image < m_resources.size());
+    auto& p = m_passes[pass];
+
+    auto existing = std::find_if(p.accesses.begin(), p.accesses.end(), [&access](Access const& a) {
+      return a.image == access.image;
+    });
+
+    if (existing == p.accesses.end())
+      p.accesses.push_back(access);
+    else {
+      existing->leaves = access.leaves;
+      existing->stages |= access.stages;
+      existing->writes |= access.writes;
+    }
+
+    p.stages |= access.stages;
+    m_resources[access.image].users |= passBit(pass);
+  }
+
+  void RenderGraph::compile() {
+    assert(!m_compiled && !m_passes.empty());
+    auto passCount = static_cast<Handle>(m_passes.size());
+
+    // Two passes depend on each other wherever one writes what the other touches, changes its
+    // layout, or has it on another queue family
+    std::vector<uint32_t> next(passCount, 0);
+    for (Handle i = 0; i < passCount; ++i) {
+      for (auto const& access : m_passes[i].accesses) {
+        for (Handle p = 0; p < i; ++p) {
+          for (auto const& earlier : m_passes[p].accesses) {
+            if (earlier.image != access.image)
+              continue;
+
+            if (earlier.writes || access.writes || earlier.leaves != access.layout
+                || getFamily(m_passes[p]) != getFamily(m_passes[i]))
+              next[p] |= passBit(i);
+          }
+        }
+      }
+    }
+
+    for (Handle i = passCount; i-- > 0;) {
+      auto& pass = m_passes[i];
+      pass.reach = next[i];
+
+      for (Handle n = i + 1; n < passCount; ++n)
+        if (next[i] & passBit(n))
+          pass.reach |= m_passes[n].reach;
+    }
+
+    // Passes on the same VkQueue share a slot; the compute queue can be the graphics one
+    for (auto& pass : m_passes) {
+      auto slot = std::find_if(m_queues.begin(), m_queues.end(), [&pass](Queue const* queue) {
+        return static_cast<VkQueue>(*queue) == static_cast<VkQueue>(*pass.queue);
+      });
+
+      pass.queueSlot = static_cast<uint32_t>(slot - m_queues.begin());
+      if (slot == m_queues.end())
+        m_queues.push_back(pass.queue);
+    }
+
+    m_frameValues.assign(m_queues.size(), 0);
+
+    // Of the passes whose dependencies are all in, the first one something on another queue waits
+    // for goes next, or else the first one declared. Getting that work going early is what lets the
+    // other queue run alongside this one instead of waiting on it.
+    std::vector<uint32_t> waitsOn(passCount, 0);
+    std::vector<bool>     feedsOtherQueue(passCount, false);
+    for (Handle i = 0; i < passCount; ++i) {
+      for (Handle n = 0; n < passCount; ++n) {
+        if (next[i] & passBit(n))
+          waitsOn[n] |= passBit(i);
+        if ((m_passes[i].reach & passBit(n)) && m_passes[n].queueSlot != m_passes[i].queueSlot)
+          feedsOtherQueue[i] = true;
+      }
+    }
+
+    uint32_t scheduled = 0;
+    while (m_order.size() < passCount) {
+      Handle pick = NONE;
+      for (Handle i = 0; i < passCount; ++i) {
+        if ((scheduled & passBit(i)) || (waitsOn[i] & ~scheduled))
+          continue;
+
+        if (pick == NONE || (feedsOtherQueue[i] && !feedsOtherQueue[pick]))
+          pick = i;
+      }
+
+      scheduled |= passBit(pick);
+      m_order.push_back(pick);
+    }
+
+    for (auto& pass : m_passes) {
+      pass.pre  = &pass.pool->allocateCommandBuffer();
+      pass.post = &pass.pool->allocateCommandBuffer();
+    }
+
+    if (m_timing) {
+      auto const& physical   = getOwningPhysical();
+      bool        timestamps = physical.getLimits().timestampComputeAndGraphics;
+
+      for (auto queue : m_queues)
+        timestamps = timestamps && physical.getQueueFamilyProperties()[queue->getFamily()].timestampValidBits;
+
+      if (!timestamps) {
+        Trace::Warn << "Render graph timing: the device can't timestamp every queue" << Trace::Stop;
+        m_timing = false;
+      }
+      else {
+        VkQueryPoolCreateInfo queryCreate = {
+          VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+          nullptr,
+          0,
+          VK_QUERY_TYPE_TIMESTAMP,
+          2 * passCount,
+          0
+        };
+
+        if (vkCreateQueryPool(m_device, &queryCreate, nullptr, &m_queries) != VK_SUCCESS)
+          throw std::runtime_error("Could not create the render graph's query pool");
+
+        m_busyMs.assign(m_queues.size(), 0);
+      }
+    }
+
+    allocateTransients();
+    m_compiled = true;
+
+    auto& out = Trace::Info << "Render graph order:";
+    for (Handle i : m_order)
+      out << " " << m_passes[i].name << " (queue family " << getFamily(m_passes[i]) << ")";
+    out << Trace::Stop;
+  }
+
+  void RenderGraph::setTiming(bool enabled) {
+    assert(!m_compiled);
+    m_timing = enabled;
+  }
+
+  // Biggest first, each image goes in with the first group whose images it's never in use at the
+  // same time as: every pass using one of them has to come before every pass using the other.
+  void RenderGraph::allocateTransients() {
+    struct Group {
+      VkDeviceSize        size{0};
+      uint32_t            memoryTypes{~0u};
+      std::vector<Handle> images;
+    };
+
+    std::vector<Handle>               order;
+    std::vector<VkMemoryRequirements> requirements(m_resources.size());
+
+    for (Handle i = 0; i < m_resources.size(); ++i) {
+      if (!m_resources[i].transient)
+        continue;
+
+      requirements[i] = m_resources[i].transient->getMemoryRequirements();
+      m_transientBytes += requirements[i].size;
+      order.push_back(i);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&requirements](Handle a, Handle b) {
+      return requirements[a].size > requirements[b].size;
+    });
+
+    auto before = [this](uint32_t first, uint32_t then) {
+      for (Handle p = 0; p < m_passes.size(); ++p)
+        if ((first & passBit(p)) && (m_passes[p].reach & then) != then)
+          return false;
+      return true;
+    };
+
+    auto apart = [this, &before](Handle a, Handle b) {
+      uint32_t usersA = m_resources[a].users;
+      uint32_t usersB = m_resources[b].users;
+      return !(usersA & usersB) && (before(usersA, usersB) || before(usersB, usersA));
+    };
+
+    std::vector<Group> groups;
+    for (Handle image : order) {
+      auto const& req = requirements[image];
+
+      auto group = std::find_if(groups.begin(), groups.end(), [&](Group const& g) {
+        return (g.memoryTypes & req.memoryTypeBits)
+               && std::all_of(g.images.begin(), g.images.end(), [&](Handle other) { return apart(image, other); });
+      });
+
+      if (group == groups.end()) {
+        groups.emplace_back();
+        group = groups.end() - 1;
+      }
+
+      // everything's bound at 0, which any alignment is happy with
+      group->size = std::max(group->size, req.size);
+      group->memoryTypes &= req.memoryTypeBits;
+      group->images.push_back(image);
+    }
+
+    MemoryAllocator allocator(getOwningPhysical());
+    for (auto& group : groups) {
+      VkMemoryAllocateInfo allocInfo = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        nullptr,
+        group.size,
+        allocator.GetAppropriateMemType(group.memoryTypes, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+      };
+
+      VkDeviceMemory memory = nullptr;
+      if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS || !memory)
+        throw std::runtime_error("Could not allocate transient image memory");
+
+      m_memory.push_back(memory);
+      m_aliasedBytes += group.size;
+
+      for (Handle image : group.images)
+        m_resources[image].transient->bind(memory, 0);
+    }
+
+    // transient images live through the whole frame, so their peak is all of them at once
+    Trace::Info << "Render graph: " << m_passes.size() << " passes, " << order.size() << " transient images in "
+      << groups.size() << " allocations, peak " << (m_transientBytes >> 20) << "MB before aliasing, "
+      << (m_aliasedBytes >> 20) << "MB after" << Trace::Stop;
+  }
+
+  void RenderGraph::setCommandBuffer(Handle pass, VkCommandBuffer cmdBuff) {
+    assert(pass < m_passes.size());
+    m_passes[pass].cmdBuff = cmdBuff;
+  }
+
+  void RenderGraph::addWait(Handle pass, VkSemaphore semaphore, VkPipelineStageFlags stage, uint64_t value) {
+    assert(pass < m_passes.size());
+    m_passes[pass].waits.push_back(semaphore);
+    m_passes[pass].waitStages.push_back(stage);
+    m_passes[pass].waitValues.push_back(value);
+  }
+
+  void RenderGraph::addSignal(Handle pass, VkSemaphore semaphore) {
+    assert(pass < m_passes.size());
+    m_passes[pass].signals.push_back(semaphore);
+  }
+
+  void RenderGraph::execute() {
+    assert(m_compiled);
+    auto passCount = static_cast<Handle>(m_passes.size());
+
+    uint32_t active = 0;
+    for (Handle i = 0; i < passCount; ++i)
+      if (m_passes[i].cmdBuff)
+        active |= passBit(i);
+
+    if (!active)
+      return;
+
+    for (auto& resource : m_resources) {
+      if (resource.transient) {
+        resource.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        resource.family = VK_QUEUE_FAMILY_IGNORED;
+      }
+    }
+
+    for (uint32_t n = 0; n < passCount; ++n) {
+      Handle i = m_order[n];
+      if (!(active & passBit(i)))
+        continue;
+
+      auto&    pass   = m_passes[i];
+      uint32_t family = getFamily(pass);
+
+      // Everything running this frame that it has to wait for, skipped passes or not. The same
+      // queue is a barrier; another queue is a wait on its timeline, unless it's already waited on
+      // through something in between.
+      uint32_t preds = 0;
+      for (Handle p = 0; p < passCount; ++p)
+        if ((active & passBit(p)) && (m_passes[p].reach & passBit(i)))
+          preds |= passBit(p);
+
+      for (Handle p = 0; p < passCount; ++p) {
+        if (!(preds & passBit(p)))
+          continue;
+
+        auto& pred = m_passes[p];
+        if (pred.queueSlot == pass.queueSlot)
+          pass.srcStages |= pred.stages;
+        else if (!(preds & pred.reach)) {
+          pred.awaited = true;
+          pass.waitsOn |= passBit(p);
+
+          // the pass's own barriers come after the wait
+          pass.srcStages |= pass.stages;
+        }
+      }
+
+      for (auto const& access : pass.accesses) {
+        auto& resource = m_resources[access.image];
+
+        // undefined doesn't care what was there, or who had it
+        bool transfer = access.layout != VK_IMAGE_LAYOUT_UNDEFINED
+                        && resource.family != VK_QUEUE_FAMILY_IGNORED
+                        && resource.family != family;
+
+        if (transfer || (access.layout != VK_IMAGE_LAYOUT_UNDEFINED && resource.layout != access.layout)) {
+          VkImageMemoryBarrier barrier = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            nullptr,
+            VK_ACCESS_MEMORY_WRITE_BIT,
+            VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+            resource.layout,
+            access.layout,
+            transfer ? resource.family : VK_QUEUE_FAMILY_IGNORED,
+            transfer ? family : VK_QUEUE_FAMILY_IGNORED,
+            resource.image,
+            {
+              resource.aspect,
+              0,
+              VK_REMAINING_MIP_LEVELS,
+              0,
+              VK_REMAINING_ARRAY_LAYERS
+            }
+          };
+
+          // The other family lets go of it at the end of the last pass it runs before this one.
+          // Whatever else used it there came before that, or comes after this.
+          if (transfer) {
+            Handle releaser = NONE;
+            for (uint32_t k = 0; k < n; ++k)
+              if ((preds & passBit(m_order[k])) && getFamily(m_passes[m_order[k]]) == resource.family)
+                releaser = m_order[k];
+
+            if (releaser == NONE)
+              throw std::runtime_error("Could not hand " + resource.name + " over to " + pass.name
+                                       + ": it doesn't wait on anything from the queue that has it");
+
+            VkImageMemoryBarrier release = barrier;
+            release.dstAccessMask        = 0;
+            m_passes[releaser].releases.push_back(release);
+
+            barrier.srcAccessMask = 0;
+          }
+
+          pass.barriers.push_back(barrier);
+        }
+
+        resource.layout = access.leaves;
+        resource.family = family;
+      }
+    }
+
+    for (Handle i = 0; i < passCount; ++i)
+      if (active & passBit(i))
+        recordBarriers(i);
+
+    submit(active);
+
+    if (m_queries)
+      m_timedPasses = active;
+
+    for (auto& pass : m_passes) {
+      pass.cmdBuff   = nullptr;
+      pass.srcStages = 0;
+      pass.waitsOn   = 0;
+      pass.awaited   = false;
+      pass.waits.clear();
+      pass.waitStages.clear();
+      pass.waitValues.clear();
+      pass.signals.clear();
+      pass.barriers.clear();
+      pass.releases.clear();
+    }
+  }
+
+  // When timing, the pass's start is stamped after its barriers and its end before its releases
+  void RenderGraph::recordBarriers(Handle passHandle) {
+    auto& pass     = m_passes[passHandle];
+    bool  barriers = pass.srcStages || !pass.barriers.empty();
+
+    pass.hasPre  = barriers || m_queries;
+    pass.hasPost = !pass.releases.empty() || m_queries;
+
+    if (pass.hasPre) {
+      VkMemoryBarrier memoryBarrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        nullptr,
+        VK_ACCESS_MEMORY_WRITE_BIT,
+        VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT
+      };
+
+      pass.pre->reset();
+      pass.pre->start(true);
+
+      if (m_queries)
+        vkCmdResetQueryPool(*pass.pre, m_queries, 2 * passHandle, 2);
+
+      if (barriers)
+        vkCmdPipelineBarrier(*pass.pre,
+                             pass.srcStages ? pass.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             pass.stages,
+                             0,
+                             pass.srcStages ? 1 : 0,
+                             &memoryBarrier,
+                             0,
+                             nullptr,
+                             static_cast<uint32_t>(pass.barriers.size()),
+                             pass.barriers.data());
+
+      if (m_queries)
+        vkCmdWriteTimestamp(*pass.pre, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queries, 2 * passHandle);
+
+      pass.pre->end();
+    }
+
+    if (pass.hasPost) {
+      pass.post->reset();
+      pass.post->start(true);
+
+      if (m_queries)
+        vkCmdWriteTimestamp(*pass.post, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queries, 2 * passHandle + 1);
+
+      if (!pass.releases.empty())
+        vkCmdPipelineBarrier(*pass.post,
+                             pass.stages,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             static_cast<uint32_t>(pass.releases.size()),
+                             pass.releases.data());
+
+      pass.post->end();
+    }
+  }
+
+  // A submit info runs from a pass that waits on something to one that something waits on, and
+  // signals its queue's timeline when it's done; one vkQueueSubmit takes every submit info in a
+  // row on the same queue. Nothing's submitted before what it waits for, so the value of every
+  // wait is known by the time it's submitted.
+  void RenderGraph::submit(uint32_t active) {
+    m_submits.clear();
+    m_submitBuffers.clear();
+    std::fill(m_frameValues.begin(), m_frameValues.end(), 0);
+
+    uint32_t slot  = NONE;
+    auto     flush = [this, &slot]() {
+      if (vkQueueSubmit(*m_queues[slot], static_cast<uint32_t>(m_submits.size()), m_submits.data(), nullptr)
+          != VK_SUCCESS)
+        throw std::runtime_error("Could not submit the frame");
+      m_submits.clear();
+    };
+
+    uint32_t syncs = 0;
+    bool     split = true;
+    for (Handle i : m_order) {
+      if (!(active & passBit(i)))
+        continue;
+
+      auto& pass = m_passes[i];
+
+      if (slot != NONE && pass.queueSlot != slot)
+        flush();
+
+      if (pass.queueSlot != slot || split || pass.waitsOn || !pass.waits.empty()) {
+        auto& sync = m_submitSyncs[syncs++];
+        sync.waits.assign(pass.waits.begin(), pass.waits.end());
+        sync.waitStages.assign(pass.waitStages.begin(), pass.waitStages.end());
+        sync.waitValues.assign(pass.waitValues.begin(), pass.waitValues.end());
+
+        for (Handle p = 0; p < m_passes.size(); ++p) {
+          if (pass.waitsOn & passBit(p)) {
+            sync.waits.push_back(m_passes[p].queue->getTimeline());
+            sync.waitStages.push_back(pass.stages);
+            sync.waitValues.push_back(m_passes[p].value);
+          }
+        }
+
+        sync.timeline = {
+          VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+          nullptr,
+          static_cast<uint32_t>(sync.waitValues.size()),
+          sync.waitValues.data(),
+          0,
+          nullptr
+        };
+
+        m_submits.push_back({
+          VK_STRUCTURE_TYPE_SUBMIT_INFO,
+          &sync.timeline,
+          static_cast<uint32_t>(sync.waits.size()),
+          sync.waits.data(),
+          sync.waitStages.data(),
+          0,
+          m_submitBuffers.data() + m_submitBuffers.size(),
+          0,
+          nullptr
+        });
+
+        pass.value = pass.queue->nextValue();
+      }
+      else
+        pass.value = m_frameValues[pass.queueSlot];
+
+      slot                = pass.queueSlot;
+      m_frameValues[slot] = pass.value;
+
+      if (pass.hasPre)
+        m_submitBuffers.push_back(*pass.pre);
+      m_submitBuffers.push_back(pass.cmdBuff);
+      if (pass.hasPost)
+        m_submitBuffers.push_back(*pass.post);
+
+      // only the last pass of an info can have signals of its own
+      auto& info = m_submits.back();
+      auto& sync = m_submitSyncs[syncs - 1];
+
+      sync.signals.assign(pass.signals.begin(), pass.signals.end());
+      sync.signals.push_back(pass.queue->getTimeline());
+      sync.signalValues.assign(sync.signals.size(), 0); // binary ones ignore theirs
+      sync.signalValues.back() = pass.value;
+
+      info.commandBufferCount = static_cast<uint32_t>(m_submitBuffers.data() + m_submitBuffers.size()
+                                                      - info.pCommandBuffers);
+      info.signalSemaphoreCount = static_cast<uint32_t>(sync.signals.size());
+      info.pSignalSemaphores    = sync.signals.data();
+
+      sync.timeline.signalSemaphoreValueCount = static_cast<uint32_t>(sync.signalValues.size());
+      sync.timeline.pSignalSemaphoreValues    = sync.signalValues.data();
+
+      split = pass.awaited || !pass.signals.empty();
+    }
+
+    flush();
+  }
+
+  void RenderGraph::wait() const {
+    std::vector<VkSemaphore> timelines;
+    std::vector<uint64_t>    values;
+
+    for (uint32_t slot = 0; slot < m_queues.size(); ++slot) {
+      if (m_frameValues[slot]) {
+        timelines.push_back(m_queues[slot]->getTimeline());
+        values.push_back(m_frameValues[slot]);
+      }
+    }
+
+    if (!timelines.empty())
+      getOwningDevice().waitTimelines(static_cast<uint32_t>(timelines.size()), timelines.data(), values.data());
+  }
+
+  // Sweeps over every pass's start & end, adding up the time each queue had something running and
+  // the time more than one did. A frame with a pass that hasn't got its timestamps yet is skipped.
+  void RenderGraph::readTiming() {
+    if (!m_queries || !m_timedPasses)
+      return;
+
+    struct Event {
+      uint64_t tick;
+      uint32_t slot;
+      int      delta;
+    };
+
+    auto const& physical  = getOwningPhysical();
+    double      msPerTick = physical.getLimits().timestampPeriod * 1e-6;
+
+    std::vector<Event>  events;
+    std::vector<Handle> timed;
+    for (Handle i = 0; i < m_passes.size(); ++i) {
+      if (!(m_timedPasses & passBit(i)))
+        continue;
+
+      std::array<uint64_t, 2> ticks{};
+      if (vkGetQueryPoolResults(m_device,
+                                m_queries,
+                                2 * i,
+                                static_cast<uint32_t>(ticks.size()),
+                                sizeof(ticks),
+                                ticks.data(),
+                                sizeof(uint64_t),
+                                VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
+
+      uint32_t bits = physical.getQueueFamilyProperties()[getFamily(m_passes[i])].timestampValidBits;
+      uint64_t mask = bits < 64 ? (uint64_t(1) << bits) - 1 : ~uint64_t(0);
+
+      // the counter wrapped
+      if ((ticks[1] & mask) < (ticks[0] & mask))
+        return;
+
+      timed.push_back(i);
+      events.push_back({ticks[0] & mask, m_passes[i].queueSlot, 1});
+      events.push_back({ticks[1] & mask, m_passes[i].queueSlot, -1});
+    }
+
+    m_timedPasses = 0;
+
+    for (size_t e = 0; e < events.size(); e += 2) {
+      auto& pass = m_passes[timed[e / 2]];
+      pass.timedMs += (events[e + 1].tick - events[e].tick) * msPerTick;
+      ++pass.timedFrames;
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](Event const& a, Event const& b) {
+      return a.tick < b.tick;
+    });
+
+    std::vector<int> running(m_busyMs.size(), 0);
+    uint32_t         busyQueues = 0;
+    for (size_t e = 0; e < events.size(); ++e) {
+      if (e) {
+        double ms = (events[e].tick - events[e - 1].tick) * msPerTick;
+        for (uint32_t slot = 0; slot < running.size(); ++slot)
+          if (running[slot])
+            m_busyMs[slot] += ms;
+
+        if (busyQueues > 1)
+          m_overlapMs += ms;
+      }
+
+      int& count = running[events[e].slot];
+      busyQueues -= count ? 1 : 0;
+      count += events[e].delta;
+      busyQueues += count ? 1 : 0;
+    }
+
+    m_frameMs += (events.back().tick - events.front().tick) * msPerTick;
+
+    if (++m_timedFrames == TIMING_FRAMES)
+      logTiming();
+  }
+
+  void RenderGraph::logTiming() {
+    auto& out = Trace::Info << "Render graph timing over " << m_timedFrames << " frames: "
+      << m_frameMs / m_timedFrames << "ms a frame";
+
+    for (uint32_t slot = 0; slot < m_busyMs.size(); ++slot)
+      out << ", queue family " << m_queues[slot]->getFamily() << " busy " << m_busyMs[slot] / m_timedFrames << "ms";
+
+    out << ", " << m_overlapMs / m_timedFrames << "ms with more than one busy. Passes:";
+
+    for (Handle i : m_order) {
+      auto& pass = m_passes[i];
+      if (pass.timedFrames)
+        out << " " << pass.name << " " << pass.timedMs / pass.timedFrames << "ms";
+
+      pass.timedMs     = 0;
+      pass.timedFrames = 0;
+    }
+
+    out << Trace::Stop;
+
+    std::fill(m_busyMs.begin(), m_busyMs.end(), 0.);
+    m_frameMs     = 0;
+    m_overlapMs   = 0;
+    m_timedFrames = 0;
+  }
+
+  uint32_t RenderGraph::getFamily(Pass const& pass) const {
+    return pass.queue->getFamily();
+  }
+
+  VkDeviceSize RenderGraph::getTransientBytes() const {
+    return m_transientBytes;
+  }
+
+  VkDeviceSize RenderGraph::getAliasedBytes() const {
+    return m_aliasedBytes;
+  }
+}
@@ -0,0 +1,210 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : RenderQueue.cpp
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 08d
+// * Last Altered: 2020y 03m 08d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+
+#include "render/RenderQueue.h"
+#include "util/Trace.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <random>
+
+namespace dw {
+  namespace {
+    constexpr uint32_t RADIX_BITS   = 8;
+    constexpr uint32_t RADIX_SIZE   = 1u << RADIX_BITS;
+    constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+    constexpr uint64_t Mask(uint32_t bits) {
+      return (uint64_t(1) << bits) - 1;
+    }
+
+    constexpr uint32_t Field(uint64_t key, uint32_t shift, uint32_t bits) {
+      return static_cast<uint32_t>((key >> shift) & Mask(bits));
+    }
+  }
+
+  uint64_t RenderQueue::MakeKey(uint32_t pass,
+                                uint32_t pipeline,
+                                uint32_t mobility,
+                                uint32_t mesh,
+                                uint32_t material,
+                                uint32_t depth) {
+    return (uint64_t(pass) & Mask(PASS_BITS)) << PASS_SHIFT
+           | (uint64_t(pipeline) & Mask(PIPELINE_BITS)) << PIPELINE_SHIFT
+           | (uint64_t(mobility) & Mask(MOBILITY_BITS)) << MOBILITY_SHIFT
+           | (uint64_t(mesh) & Mask(MESH_BITS)) << MESH_SHIFT
+           | (uint64_t(material) & Mask(MATERIAL_BITS)) << MATERIAL_SHIFT
+           | (uint64_t(depth) & Mask(DEPTH_BITS)) << DEPTH_SHIFT;
+  }
+
+  uint32_t RenderQueue::QuantizeDepth(float viewDepth, float nearDist, float farDist) {
+    float t = (viewDepth - nearDist) / (farDist - nearDist);
+    t       = std::min(std::max(t, 0.f), 1.f);
+    return static_cast<uint32_t>(t * static_cast<float>(Mask(DEPTH_BITS)));
+  }
+
+  uint32_t RenderQueue::GetPass(uint64_t key) {
+    return Field(key, PASS_SHIFT, PASS_BITS);
+  }
+
+  uint32_t RenderQueue::GetPipeline(uint64_t key) {
+    return Field(key, PIPELINE_SHIFT, PIPELINE_BITS);
+  }
+
+  uint32_t RenderQueue::GetMobility(uint64_t key) {
+    return Field(key, MOBILITY_SHIFT, MOBILITY_BITS);
+  }
+
+  uint32_t RenderQueue::GetMesh(uint64_t key) {
+    return Field(key, MESH_SHIFT, MESH_BITS);
+  }
+
+  uint32_t RenderQueue::GetMaterial(uint64_t key) {
+    return Field(key, MATERIAL_SHIFT, MATERIAL_BITS);
+  }
+
+  uint32_t RenderQueue::GetDepth(uint64_t key) {
+    return Field(key, DEPTH_SHIFT, DEPTH_BITS);
+  }
+
+  void RenderQueue::clear() {
+    m_entries.clear();
+  }
+
+  void RenderQueue::reserve(size_t count) {
+    m_entries.reserve(count);
+    m_scratch.reserve(count);
+  }
+
+  void RenderQueue::push(uint64_t key, uint32_t value) {
+    m_entries.push_back({key, value});
+  }
+
+  void RenderQueue::sort() {
+    if (m_entries.size() < 2)
+      return;
+
+    // every digit's histogram in one read of the keys
+    std::array<std::array<size_t, RADIX_SIZE>, RADIX_PASSES> counts{};
+    for (auto const& entry : m_entries) {
+      for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+        ++counts[pass][(entry.key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)];
+    }
+
+    m_scratch.resize(m_entries.size());
+
+    for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+      auto& count = counts[pass];
+      uint32_t shift = pass * RADIX_BITS;
+
+      // all in one bucket, this digit wouldn't move anything
+      if (count[(m_entries.front().key >> shift) & (RADIX_SIZE - 1)] == m_entries.size())
+        continue;
+
+      size_t offset = 0;
+      for (auto& c : count) {
+        size_t n = c;
+        c = offset;
+        offset += n;
+      }
+
+      for (auto const& entry : m_entries)
+        m_scratch[count[(entry.key >> shift) & (RADIX_SIZE - 1)]++] = entry;
+
+      m_entries.swap(m_scratch);
+    }
+  }
+
+  size_t RenderQueue::size() const {
+    return m_entries.size();
+  }
+
+  bool RenderQueue::empty() const {
+    return m_entries.empty();
+  }
+
+  uint64_t RenderQueue::getKey(size_t i) const {
+    return m_entries[i].key;
+  }
+
+  uint32_t RenderQueue::getValue(size_t i) const {
+    return m_entries[i].value;
+  }
+
+  DrawStateChanges RenderQueue::countStateChanges() const {
+    DrawStateChanges changes;
+
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+      uint64_t key = m_entries[i].key;
+      bool     first = i == 0;
+      uint64_t prev = first ? 0 : m_entries[i - 1].key;
+
+      changes.passes += first || GetPass(key) != GetPass(prev);
+      changes.pipelines += first || GetPipeline(key) != GetPipeline(prev);
+      changes.meshes += first || GetMesh(key) != GetMesh(prev);
+      changes.materials += first || GetMaterial(key) != GetMaterial(prev);
+    }
+
+    return changes;
+  }
+
+  void RenderQueue::Benchmark(size_t count, int iterations) {
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms    = std::chrono::duration<double, std::milli>;
+
+    // realistic-ish keys: few meshes & materials, depth all over the place
+    std::mt19937_64                         rng(count);
+    std::uniform_int_distribution<uint32_t> mesh(0, 63);
+    std::uniform_int_distribution<uint32_t> material(0, 255);
+    std::uniform_int_distribution<uint32_t> depth(0, static_cast<uint32_t>(Mask(DEPTH_BITS)));
+
+    std::vector<Entry> input(count);
+    for (size_t i = 0; i < count; ++i)
+      input[i] = {MakeKey(pGeometry, 0, mDynamic, mesh(rng), material(rng), depth(rng)), static_cast<uint32_t>(i)};
+
+    double      radixTime = 0, stdTime = 0;
+    RenderQueue queue;
+    queue.reserve(count);
+
+    for (int it = 0; it < iterations; ++it) {
+      queue.m_entries = input;
+      auto start      = Clock::now();
+      queue.sort();
+      radixTime += Ms(Clock::now() - start).count();
+
+      std::vector<Entry> reference = input;
+      start                        = Clock::now();
+      std::stable_sort(reference.begin(), reference.end(), [](Entry const& a, Entry const& b) {
+        return a.key < b.key;
+      });
+      stdTime += Ms(Clock::now() - start).count();
+
+      for (size_t i = 0; i < count; ++i) {
+        if (reference[i].key != queue.m_entries[i].key || reference[i].value != queue.m_entries[i].value) {
+          Trace::Error << "RenderQueue: radix sort disagrees with std::stable_sort at " << i << Trace::Stop;
+          return;
+        }
+      }
+    }
+
+    Trace::Info << "RenderQueue sort of " << count << " keys: radix " << radixTime / iterations << "ms, std::stable_sort "
+      << stdTime / iterations << "ms (" << stdTime / radixTime << "x)" << Trace::Stop;
+  }
+
+  std::ostream& operator<<(std::ostream& os, DrawStateChanges const& changes) {
+    return os << changes.pipelines << " pipeline, " << changes.meshes << " mesh, " << changes.materials
+           << " material changes";
+  }
+}
@@ -17,51 +17,60 @@
 #include "render/CommandBuffer.h"
 #include "render/Shader.h"
 #include "render/Image.h"
+#include "render/GeometryArena.h"
 
 #include <stdexcept>
 #include <array>
 #include "obj/Graphics.h"
 
 namespace dw {
-  void RenderStep::renderScene(CommandBuffer&             commandBuff,
-                               VkRenderPassBeginInfo&     beginInfo,
-                               Scene::ObjContainer const& scene,
-                               uint32_t                   alignment,
-                               VkPipelineLayout           layout,
-                               VkDescriptorSet            descriptorSet) {
+  void RenderStep::setViewport(CommandBuffer& commandBuff, VkRect2D const& area, bool flipY) {
+    const float height = static_cast<float>(area.extent.height);
+
+    VkViewport viewport = {
+      static_cast<float>(area.offset.x),
+      static_cast<float>(area.offset.y) + (flipY ? height : 0.f),
+      static_cast<float>(area.extent.width),
+      flipY ? -height : height,
+      0,
+      1
+    };
+
+    vkCmdSetViewport(commandBuff, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuff, 0, 1, &area);
+  }
+
+  void RenderStep::renderScene(CommandBuffer&         commandBuff,
+                               VkRenderPassBeginInfo& beginInfo,
+                               GeometryArena const&   arena,
+                               Buffer const&          indirect,
+                               uint32_t               firstDraw,
+                               uint32_t               drawCount,
+                               VkPipelineLayout       layout,
+                               VkDescriptorSet        descriptorSet) {
 
     vkCmdBeginRenderPass(commandBuff, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    Mesh* curMesh = nullptr;
-
-    for (uint32_t j = 0; j < scene.size(); ++j) {
-      auto obj = scene.at(j);
-
-      if (!obj->get<Graphics>())
-        continue;
-
-      if (!curMesh || !(*obj->get<obj::Graphics>()->getMesh() == *curMesh)) {
-        curMesh = obj->get<obj::Graphics>()->getMesh().get();
-
-        const VkBuffer&    buff   = curMesh->getVertexBuffer();
-        const VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(commandBuff, 0, 1, &buff, &offset);
-        vkCmdBindIndexBuffer(commandBuff, curMesh->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-      }
-      
-      // One dynamic offset per dynamic descriptor to offset into the ubo containing all model matrices
-      uint32_t dynamicOffset = j * alignment;
-      vkCmdBindDescriptorSets(commandBuff,
-                              VK_PIPELINE_BIND_POINT_GRAPHICS,
-                              layout,
-                              0,
-                              1,
-                              &descriptorSet,
-                              1,
-                              &dynamicOffset);
-
-      vkCmdDrawIndexed(commandBuff, curMesh->getNumIndices(), 1, 0, 0, 0);
-    }
+    // every mesh lives in the same pair of buffers & all per-object data is read out of the
+    // object buffer in the descriptor set, so binding happens once for the whole pass
+    arena.bind(commandBuff);
+
+    vkCmdBindDescriptorSets(commandBuff,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            layout,
+                            0,
+                            1,
+                            &descriptorSet,
+                            0,
+                            nullptr);
+
+    // The draws themselves live in the indirect buffer, which the renderer rewrites as
+    // objects are culled; this command buffer doesn't need to change when they are.
+    vkCmdDrawIndexedIndirect(commandBuff,
+                             indirect,
+                             VkDeviceSize(firstDraw) * sizeof(VkDrawIndexedIndirectCommand),
+                             drawCount,
+                             sizeof(VkDrawIndexedIndirectCommand));
 
     vkCmdEndRenderPass(commandBuff);
   }
@@ -24,6 +24,7 @@
 #include "render/Vertex.h"
 #include "render/Buffer.h"
 #include "render/Mesh.h"
+#include "render/GeometryArena.h"
 #include "render/Framebuffer.h"  // ReSharper likes to think this isn't used. IT IS!!!
 #include "render/MemoryAllocator.h"
 #include "render/Image.h"
@@ -33,36 +34,23 @@
 #include "obj/Camera.h"
 
 #include "util/Trace.h"
+#include "util/Frustum.h"
 #include "app/ImGui.h"
 
 #include <array>
 #include <cassert>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <thread>
 #include "obj/Graphics.h"
 
 
-// Wrapper functions for aligned memory allocation
-// There is currently no standard for this in C++ that works across all platforms and vendors, so we abstract this
-void* alignedAlloc(size_t size, size_t alignment) {
-  void* data = nullptr;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-  data = _aligned_malloc(size, alignment);
-#else
-  int res = posix_memalign(&data, alignment, size);
-  if (res != 0)
-    data = nullptr;
-#endif
-  return data;
-}
-
-void alignedFree(void* data) {
-#if	defined(_MSC_VER) || defined(__MINGW32__)
-  _aligned_free(data);
-#else
-  free(data);
-#endif
-}
-
 static void transitionImageLayout(dw::CommandBuffer& cmdBuff,
                                   dw::Image const&   image,
                                   VkImageLayout      oldLayout,
@@ -87,7 +75,7 @@ static void transitionImageLayout(dw::CommandBuffer& cmdBuff,
   };
   VkPipelineStageFlags sourceStage, destinationStage;
 
-  if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
+  if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL || dw::util::IsFormatDepthOrStencil(image.getFormat())) {
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 
     if (dw::util::IsFormatStencil(image.getFormat())) {
@@ -122,6 +110,25 @@ static void transitionImageLayout(dw::CommandBuffer& cmdBuff,
     sourceStage      = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
     destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
   }
+  else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && (
+             newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL || newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                              ? VK_ACCESS_TRANSFER_READ_BIT
+                              : VK_ACCESS_SHADER_READ_BIT;
+
+    sourceStage      = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    destinationStage = newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                         ? VK_PIPELINE_STAGE_TRANSFER_BIT
+                         : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  }
+  else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_GENERAL) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    sourceStage      = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    destinationStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  }
 
   else {
     throw std::invalid_argument("unsupported layout transition!");
@@ -139,9 +146,76 @@ static void transitionImageLayout(dw::CommandBuffer& cmdBuff,
                        &barrier);
 }
 
+// Runs every job on its own thread & waits for them all. The first exception thrown is rethrown.
+static void runParallel(std::vector<std::function<void()>> const& jobs) {
+  std::vector<std::exception_ptr> errors(jobs.size());
+  std::vector<std::thread>        threads;
+  threads.reserve(jobs.size());
+
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    threads.emplace_back([&jobs, &errors, i]() {
+      try {
+        jobs[i]();
+      }
+      catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+
+  for (auto& error : errors) {
+    if (error)
+      std::rethrow_exception(error);
+  }
+}
+
+// Copies the runs of next that differ from written into the mapped buffer, & brings written up
+// to date. Anything past written's end counts as changed. Returns how many elements were copied.
+template <typename T>
+static size_t writeChanged(dw::Buffer& buffer, std::vector<T>& written, std::vector<T> const& next) {
+  size_t known = std::min(written.size(), next.size());
+  written.resize(next.size());
+
+  auto changed = [&](size_t i) {
+    return i >= known || memcmp(&written[i], &next[i], sizeof(T)) != 0;
+  };
+
+  T*     mapped = nullptr;
+  size_t copied = 0;
+  for (size_t i = 0; i < next.size(); ++i) {
+    if (!changed(i))
+      continue;
+
+    size_t end = i + 1;
+    while (end < next.size() && changed(end))
+      ++end;
+
+    if (!mapped)
+      mapped = reinterpret_cast<T*>(buffer.map());
+
+    memcpy(mapped + i, next.data() + i, (end - i) * sizeof(T));
+    std::copy(next.begin() + i, next.begin() + end, written.begin() + i);
+    copied += end - i;
+    i = end;
+  }
+
+  if (mapped)
+    buffer.unMap();
+
+  return copied;
+}
+
 namespace dw {
-  Renderer::ShadowMappedLight::ShadowMappedLight(ShadowedLight const& light)
-    : m_light(light) {
+  Renderer::ShadowMappedLight::ShadowMappedLight(ShadowedLight const& light, uint32_t cascadeSet, uint32_t cascade)
+    : m_light(light), m_cascadeSet(cascadeSet), m_cascade(cascade), m_ubo(m_light.getAsShadowUBO()) {
+    // cascades are orthographic, their depths are already [0, 1]
+    if (m_cascadeSet != NO_CASCADE) {
+      m_ubo.nearDist = 0.f;
+      m_ubo.farDist  = 1.f;
+    }
   }
 
   obj::Camera Renderer::s_defaultCamera;
@@ -159,38 +233,12 @@ namespace dw {
     setupInstance();
     setupHelpers();
     setupDevice();
-
-    VkSemaphoreCreateInfo semaphoreCreateInfo = {
-      VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-      nullptr,
-      0
-    };
-
-    // TODO:: make better
-    if (vkCreateSemaphore(*m_device, &semaphoreCreateInfo, nullptr, &m_deferredSemaphore) != VK_SUCCESS)
-      throw std::runtime_error("Could not create deferred rendering semaphore");
-
-    if (vkCreateSemaphore(*m_device, &semaphoreCreateInfo, nullptr, &m_shadowSemaphore) != VK_SUCCESS)
-      throw std::runtime_error("Could not create shadow map rendering semaphore");
-
-    if (vkCreateSemaphore(*m_device, &semaphoreCreateInfo, nullptr, &m_blurSemaphore) != VK_SUCCESS)
-      throw std::runtime_error("Could not create blur semaphore");
-
-    if (vkCreateSemaphore(*m_device, &semaphoreCreateInfo, nullptr, &m_globalLightSemaphore) != VK_SUCCESS)
-      throw std::runtime_error("Could not create global lighting rendering semaphore");
-
-    if (vkCreateSemaphore(*m_device, &semaphoreCreateInfo, nullptr, &m_localLightSemaphore) != VK_SUCCESS)
-      throw std::runtime_error("Could not create local lighting semaphore");
-
-    if (vkCreateSemaphore(*m_device, &semaphoreCreateInfo, nullptr, &m_ambientSemaphore) != VK_SUCCESS)
-      throw std::runtime_error("Could not create ambient pass semaphore");
-
-    if (vkCreateSemaphore(*m_device, &semaphoreCreateInfo, nullptr, &m_finalSemaphore) != VK_SUCCESS)
-      throw std::runtime_error("Could not create post process semaphore");
-
     setupCommandPools();
     setupUniformBuffers();
     setupSamplers();
+    setupDefaultTexture();
+
+    m_geometryArena = util::make_ptr<GeometryArena>(*m_device);
 
     setupWindow();
 
@@ -205,7 +253,7 @@ namespace dw {
     setupSwapChain();
     setupFrameBufferImages();
     setupRenderSteps();
-    setupFrameBuffers();
+    resizeShadowMaps(m_shadowAtlasExtent.width); // builds the frame graph & the swapchain's framebuffers
     transitionRenderImages();
   }
 
@@ -213,14 +261,23 @@ namespace dw {
     m_gbuffer.reset();
     m_blurIntermediateView.reset();
     m_blurIntermediate.reset();
+    m_shadowSATView.reset();
+    m_shadowSAT.reset();
+    m_shadowAtlas.reset();
+    m_staticShadowAtlas.reset();
     m_globalLitFrameBuffer.reset();
-    m_localLitFramebuffer.reset();
-    m_ambientFramebuffer.reset();
+    m_localLitView.reset();
+    m_localLitImage.reset();
+    m_ambientView.reset();
+    m_ambientImage.reset();
+    m_frameGraph.reset();
+    m_splashFramebuffers.clear();
 
     m_splashScreenStep.reset();
     m_geometryStep.reset();
     m_shadowMapStep.reset();
     m_blurStep.reset();
+    m_summedAreaStep.reset();
     m_globalLightStep.reset();
     m_localLightStep.reset();
     m_ambientStep.reset();
@@ -234,6 +291,7 @@ namespace dw {
   }
 
   void Renderer::restartWindow() {
+    waitFrame();
     vkDeviceWaitIdle(*m_device);
 
     shutdownWindow();
@@ -241,10 +299,58 @@ namespace dw {
     setScene(m_scene);
   }
 
+  // Render passes & pipelines don't depend on the window's size (viewports & scissors are dynamic),
+  // so only the swapchain & the images the frame graph binds are made again
+  bool Renderer::resizeWindow() {
+    if (m_window->getWidth() == 0 || m_window->getHeight() == 0)
+      return false;
+
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms    = std::chrono::duration<double, std::milli>;
+    const auto start = Clock::now();
+
+    waitFrame();
+    vkDeviceWaitIdle(*m_device);
+
+    m_geometryStep->getCommandBuffer().reset();
+    m_globalLightStep->getCommandBuffer().reset();
+    for (uint32_t i = 0; i < m_swapchain->getNumImages(); ++i)
+      m_finalStep->getCommandBuffer(i).reset();
+
+    m_swapchain->setPresentMode(m_presentSettings.mode, m_presentSettings.imageCount);
+    m_swapchain->restart();
+
+    // the final & splash steps have a command buffer per image
+    if (m_swapchain->getNumImages() != m_finalStep->m_imageCount) {
+      Trace::Warn << "Swapchain went from " << m_finalStep->m_imageCount << " to " << m_swapchain->getNumImages()
+                  << " images, remaking every step" << Trace::Stop;
+      restartWindow();
+      return true;
+    }
+
+    // makes the g-buffer & lighting images at the new size, & the framebuffers. The rebuilt graph
+    // starts the shadow atlases out undefined, so every map's drawn again.
+    setupFrameGraph();
+    transitionRenderImages();
+    m_staticCastersMoved = true;
+
+    if (m_scene) {
+      recordShadowCommands(); // the blur's intermediate image is remade with the graph
+      recordWindowCommands();
+    }
+
+    VkExtent2D extent = m_swapchain->getImageSize();
+    Trace::Info << "Resized to " << extent.width << "x" << extent.height << " in "
+                << Ms(Clock::now() - start).count() << "ms" << Trace::Stop;
+    return true;
+  }
+
   void Renderer::shutdown(bool shutdownImgui) {
     vkDeviceWaitIdle(*m_device);
+    waitFrame(); // everything's done, so everything retires
 
     m_materials = nullptr;
+    m_textures  = nullptr;
 
 #ifdef DW_USE_IMGUI
     if (shutdownImgui)
@@ -253,41 +359,49 @@ namespace dw {
 
     shutdownWindow();
 
-    vkDestroySemaphore(*m_device, m_deferredSemaphore, nullptr);
-    vkDestroySemaphore(*m_device, m_shadowSemaphore, nullptr);
-    vkDestroySemaphore(*m_device, m_blurSemaphore, nullptr);
-    vkDestroySemaphore(*m_device, m_globalLightSemaphore, nullptr);
-    vkDestroySemaphore(*m_device, m_localLightSemaphore, nullptr);
-    vkDestroySemaphore(*m_device, m_ambientSemaphore, nullptr);
-    vkDestroySemaphore(*m_device, m_finalSemaphore, nullptr);
-    m_deferredSemaphore    = nullptr;
-    m_shadowSemaphore      = nullptr;
-    m_blurSemaphore        = nullptr;
-    m_globalLightSemaphore = nullptr;
-    m_localLightSemaphore  = nullptr;
-    m_ambientSemaphore     = nullptr;
-    m_finalSemaphore       = nullptr;
-
     vkDestroySampler(*m_device, m_sampler, nullptr);
     m_sampler = nullptr;
 
-    m_globalLights.clear();
-    m_scene.reset();
+    m_defaultTextureView.reset();
+    m_defaultTexture.reset();
 
-    if (m_modelUBOdata) {
-      alignedFree(m_modelUBOdata);
-      m_modelUBOdata = nullptr;
+    if (m_filterQueries) {
+      vkDestroyQueryPool(*m_device, m_filterQueries, nullptr);
+      m_filterQueries = nullptr;
     }
 
-    m_modelUBOdata = nullptr;
+    m_sceneCache.clear(); // waits for any still building
+    m_globalLights.clear();
+    if (m_scene)
+      m_scene->setJournaling(false);
+    m_scene.reset();
+    m_sceneKey   = {};
+    m_sceneBytes = 0;
+
+    m_drawGroups.clear();
+    m_instanceObjects.clear();
+    m_instanceHandles.clear();
+    m_instanceKeys.clear();
+    m_instanceGroups.clear();
+    m_handleInstances.clear();
+    m_groupOfKey.clear();
+    m_meshIndices.clear();
+    m_slotEnd         = 0;
+    m_staticInstances = 0;
 
     vkDestroySampler(*m_device, m_sampler, nullptr);
-    m_modelUBO.reset();
+    m_objectBuffer.reset();
+    m_indirectBuffer.reset();
+    m_shadowRoutes.reset();
+    m_writtenObjects.clear();
+    m_writtenCommands.clear();
+    m_writtenRoutes.clear();
     m_cameraUBO.reset();
     m_globalLightsUBO.reset();
     m_localLightsUBO.reset();
     m_globalImportanceUBO.reset();
-    m_materialsUBO.reset();
+    m_materialBuffer.reset();
+    m_geometryArena.reset();
 
     m_shaderControlBuffer.reset();
     m_shaderControl = nullptr;
@@ -305,6 +419,18 @@ namespace dw {
     delete m_computeQueue;
     m_computeQueue = nullptr;
 
+    if (m_pipelineCache) {
+      try {
+        m_pipelineCache->save();
+      }
+      catch (std::exception const& e) {
+        Trace::Warn << e.what() << Trace::Stop;
+      }
+
+      m_device->setPipelineCache(nullptr);
+      m_pipelineCache.reset();
+    }
+
     delete m_device;
     m_device = nullptr;
 
@@ -356,10 +482,10 @@ namespace dw {
       *m_device,
       m_graphicsQueue->get().getFamily(),
       m_graphicsQueue->get(),
-      nullptr,
+      m_device->getPipelineCache(),
       m_imguiDescriptorPool,
-      m_surface->getCapabilities().minImageCount + 1, // TODO make this easier / based on swapchain
-      m_swapchain->getNumImages(),
+      static_cast<uint32_t>(m_swapchain->getNumImages()), // never less than 2, see Surface::chooseImageCount()
+      static_cast<uint32_t>(m_swapchain->getNumImages()),
       VK_SAMPLE_COUNT_1_BIT,
       nullptr,
       checkResultFn
@@ -390,8 +516,8 @@ namespace dw {
       nullptr
     };
 
-    vkQueueSubmit(m_graphicsQueue->get(), 1, &submitInfo, nullptr);
-    vkQueueWaitIdle(m_graphicsQueue->get()); // TODO: not this
+    auto& graphicsQueue = m_graphicsQueue->get();
+    graphicsQueue.wait(graphicsQueue.submit(submitInfo));
   }
 
   void Renderer::shutdownImGui() const {
@@ -415,97 +541,138 @@ namespace dw {
     return m_window->shouldClose();
   }
 
-  void Renderer::drawFrame() const {
+  // The CPU gets a frame ahead: the wait for the last one is at the start of this one, so whatever
+  // the application does between frames overlaps the GPU's work on it
+  void Renderer::drawFrame() {
     assert(m_swapchain->isPresentReady());
-    if (!m_scene || m_scene->getObjects().empty())
+    m_frameWaits.blockedMs = 0;
+    if (!m_scene)
       return;
 
-    uint32_t     nextImageIndex = m_swapchain->getNextImageIndex();
-    Image const& nextImage      = m_swapchain->getNextImage();
+    // the window changed without a resize callback, or it was minimized; the frame's skipped
+    if (m_swapchain->isOutOfDate() && !resizeWindow())
+      return;
 
-    auto&           graphicsQueue      = m_graphicsQueue->get();
-    auto&           computeQueue       = m_computeQueue->get();
-    VkCommandBuffer deferredCmdBuff    = m_geometryStep->getCommandBuffer();
-    VkCommandBuffer shadowCmdBuff      = m_shadowMapStep->getCommandBuffer();
-    VkCommandBuffer blurCmdBuff        = m_blurStep->getCommandBuffer();
-    VkCommandBuffer globalLightCmdBuff = m_globalLightStep->getCommandBuffer();
-    VkCommandBuffer localLightCmdBuff  = m_localLightStep->getCommandBuffer();
-    VkCommandBuffer ambientCmdBuff     = m_ambientStep->getCommandBuffer();
-    VkCommandBuffer finalCmdBuff       = m_finalStep->getCommandBuffer(nextImageIndex);
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms    = std::chrono::duration<double, std::milli>;
+    const auto waitStart = Clock::now();
 
-    updateUniformBuffers(nextImageIndex);
+    waitFrame();
 
-    VkPipelineStageFlags semaphoreWaitFlag = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    VkSubmitInfo         submitInfo        = {
-      VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      nullptr,
-      1,
-      &m_swapchain->getNextImageSemaphore(),
-      &semaphoreWaitFlag,
-      1,
-      &deferredCmdBuff,
-      1,
-      &m_deferredSemaphore
-    };
-
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, nullptr);
+    uint32_t nextImageIndex = m_swapchain->getNextImageIndex();
+    m_frameWaits.blockedMs = Ms(Clock::now() - waitStart).count();
+    if (m_swapchain->isOutOfDate())
+      return;
 
-    submitInfo.pWaitSemaphores   = &m_deferredSemaphore;
-    submitInfo.pSignalSemaphores = &m_shadowSemaphore;
-    submitInfo.pCommandBuffers   = &shadowCmdBuff;
+    Image const& nextImage = m_swapchain->getNextImage();
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, nullptr);
+    applySceneEdits();
+    updateUniformBuffers(nextImageIndex);
 
-    submitInfo.pWaitSemaphores = &m_shadowSemaphore;
+    // Every pass that runs this frame; the graph works out what waits on what. Shadow maps that
+    // are all still good from last frame skip the shadow & filter passes.
+    auto& graph = *m_frameGraph;
+    graph.setCommandBuffer(m_geometryPass, m_geometryStep->getCommandBuffer());
 
-    if (m_blurEnabled) {
-      submitInfo.pSignalSemaphores = &m_blurSemaphore;
-      submitInfo.pCommandBuffers   = &blurCmdBuff;
+    m_frameFiltered = false;
+    if (m_shadowWork) {
+      graph.setCommandBuffer(m_shadowPass, m_shadowMapStep->getCommandBuffer());
 
-      vkQueueSubmit(computeQueue, 1, &submitInfo, nullptr);
+      bool summedArea = m_atlasFilter == ShadowFilter::SummedArea;
+      m_frameFiltered = summedArea || m_blurEnabled;
 
-      submitInfo.pWaitSemaphores = &m_blurSemaphore;
+      if (m_frameFiltered)
+        graph.setCommandBuffer(m_filterPass,
+                               summedArea ? m_summedAreaStep->getCommandBuffer() : m_blurStep->getCommandBuffer());
     }
 
-    if (m_globalLightEnabled) {
-      submitInfo.pSignalSemaphores = &m_globalLightSemaphore;
-      submitInfo.pCommandBuffers   = &globalLightCmdBuff;
+    if (m_globalLightEnabled)
+      graph.setCommandBuffer(m_globalLightPass, m_globalLightStep->getCommandBuffer());
 
-      vkQueueSubmit(graphicsQueue, 1, &submitInfo, nullptr);
+#ifdef DW_USE_IMGUI
+    // this updates the last subpass, which is defined for imgui rendering
+    m_finalStep->writeCmdBuff(m_swapchain->getFrameBuffers(), *m_localLightStep, *m_ambientStep, {}, nextImageIndex);
+#endif
 
-      submitInfo.pWaitSemaphores = &m_globalLightSemaphore;
+    // only the final pass needs the swapchain's image
+    graph.setCommandBuffer(m_finalPass, m_finalStep->getCommandBuffer(nextImageIndex));
+    graph.addWait(m_finalPass, m_swapchain->getNextImageSemaphore(), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    graph.addSignal(m_finalPass, m_swapchain->getImageRenderReadySemaphore());
+
+    // whatever draws meshes waits on their upload; it's long done, unless they just came in
+    if (m_meshUpload) {
+      VkSemaphore transferTimeline = m_transferQueue->get().getTimeline();
+      graph.addWait(m_geometryPass, transferTimeline, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, m_meshUpload);
+      if (m_shadowWork)
+        graph.addWait(m_shadowPass, transferTimeline, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, m_meshUpload);
     }
 
-    submitInfo.pSignalSemaphores = &m_localLightSemaphore;
-    submitInfo.pCommandBuffers   = &localLightCmdBuff;
+    graph.execute();
+    m_framePending = true;
+    ++m_frameWaits.submitted;
+    m_geometryArena->setFrame(m_frameWaits.submitted);
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, nullptr);
+    // FIFO can block here as well as in the acquire, depending on the driver
+    const auto presentStart = Clock::now();
+    m_swapchain->present();
+    m_frameWaits.blockedMs += Ms(Clock::now() - presentStart).count();
+  }
 
-    submitInfo.pWaitSemaphores = &m_localLightSemaphore;
+  VkPresentModeKHR Renderer::getPresentMode() const {
+    return m_swapchain->getPresentMode();
+  }
 
-    submitInfo.pSignalSemaphores = &m_ambientSemaphore;
-    submitInfo.pCommandBuffers   = &ambientCmdBuff;
+  void Renderer::waitFrame() {
+    if (m_framePending) {
+      m_frameGraph->wait();
+      m_framePending = false;
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, nullptr);
+      // if it was done before the wait this is late, by however long the CPU was behind
+      m_frameWaits.done     = m_frameWaits.submitted;
+      m_frameWaits.doneTime = std::chrono::high_resolution_clock::now();
 
-    submitInfo.pWaitSemaphores = &m_ambientSemaphore;
+      if (m_filterQueries)
+        readFilterTimestamps(m_frameFiltered);
 
-#ifdef DW_USE_IMGUI
-    // this updates the second subpass that is defined for imgui rendering
-    m_finalStep->writeCmdBuff(m_swapchain->getFrameBuffers(),
-                              m_globalLitFrameBuffer->getImages().front(),
-                              {},
-                              nextImageIndex);
-#endif
+      m_frameGraph->readTiming();
+    }
 
-    submitInfo.pSignalSemaphores = &m_swapchain->getImageRenderReadySemaphore();
-    submitInfo.pCommandBuffers   = &finalCmdBuff;
+    m_graphicsQueue->get().collect();
+    m_transferQueue->get().collect();
+    m_computeQueue->get().collect();
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, nullptr);
+    // mesh ranges & arena buffers the frames might have drawn from
+    if (m_geometryArena)
+      m_geometryArena->retire(m_frameWaits.done);
+  }
 
-    m_swapchain->present();
-    graphicsQueue.waitIdle(); // todo: not wait
+  // Only called once the frame's done. The filter's timestamps only count on frames that filtered
+  // something; it's global lighting that pays for the summed-area table's wide boxes.
+  void Renderer::readFilterTimestamps(bool filtered) {
+    double msPerTick = m_device->getOwningPhysical().getLimits().timestampPeriod * 1e-6;
+
+    // a pair that was never written isn't ready; skip it
+    auto readPair = [this, msPerTick](uint32_t first, double& ms) {
+      std::array<uint64_t, 2> ticks{};
+      if (vkGetQueryPoolResults(*m_device,
+                                m_filterQueries,
+                                first,
+                                static_cast<uint32_t>(ticks.size()),
+                                sizeof(ticks),
+                                ticks.data(),
+                                sizeof(uint64_t),
+                                VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return false;
+
+      ms += (ticks[1] - ticks[0]) * msPerTick;
+      return true;
+    };
+
+    if (filtered && readPair(0, m_filterTimes.filterMs))
+      ++m_filterTimes.filteredFrames;
 
+    if (m_globalLightEnabled && readPair(2, m_filterTimes.lightingMs))
+      ++m_filterTimes.timedFrames;
   }
 
   void Renderer::displayLogo(util::ptr<ImageView> logoView) const {
@@ -516,7 +683,7 @@ namespace dw {
     auto& graphicsQueue = m_graphicsQueue->get();
 
     m_splashScreenStep->updateDescriptorSets(nextImageIndex, *logoView, m_sampler);
-    m_splashScreenStep->writeCmdBuff(nextImageIndex, m_swapchain->getFrameBuffers()[nextImageIndex]);
+    m_splashScreenStep->writeCmdBuff(nextImageIndex, m_splashFramebuffers[nextImageIndex]);
 
     VkCommandBuffer splashCmdBuff = m_splashScreenStep->getCommandBuffer(nextImageIndex);
 
@@ -533,36 +700,50 @@ namespace dw {
       &m_swapchain->getImageRenderReadySemaphore()
     };
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, nullptr);
+    uint64_t shown = graphicsQueue.submit(submitInfo);
 
     m_swapchain->present();
-    graphicsQueue.waitIdle(); // todo: not wait
+    graphicsQueue.wait(shown);
   }
 
-  void Renderer::uploadMeshes(MeshManager::MeshMap& meshes) const {
-    std::vector<Mesh::StagingBuffs> stagingBuffers;
+  void Renderer::uploadMeshes(MeshManager::MeshMap& meshes) {
+    waitFrame();
 
-    stagingBuffers.reserve(meshes.size());
-    for (auto& mesh : meshes) {
-      stagingBuffers.push_back(mesh.second->createAllBuffs(*m_device));
-      mesh.second->uploadStaging(stagingBuffers.back());
-    }
+    // meshes that are already resident keep their range & aren't copied again
+    for (auto& mesh : meshes)
+      mesh.second->upload(m_geometryArena);
+
+    if (!m_geometryArena->hasPending())
+      return;
 
     CommandBuffer& moveBuff = m_transferCmdPool->allocateCommandBuffer();
 
     moveBuff.start(true);
-    for (size_t i = 0; i < meshes.size(); ++i) {
-      meshes[i]->uploadCmds(moveBuff, stagingBuffers[i]);
-    }
+    auto staging = m_geometryArena->flush(moveBuff);
     moveBuff.end();
 
-    m_transferQueue->get().submitOne(moveBuff);
-    m_transferQueue->get().waitIdle();
-
-    m_transferCmdPool->freeCommandBuffer(moveBuff);
+    // the staging buffers, & the old ones if the arena grew, go once the copy's done; the frames
+    // wait on it on the GPU
+    auto& transferQueue = m_transferQueue->get();
+    m_meshUpload        = transferQueue.submitOne(moveBuff);
+    transferQueue.retire(m_meshUpload, [pool = m_transferCmdPool, &moveBuff, staging = std::move(staging)] {
+      pool->freeCommandBuffer(moveBuff);
+    });
+
+    auto const& vertRanges  = m_geometryArena->getVertexRanges();
+    auto const& indexRanges = m_geometryArena->getIndexRanges();
+    Trace::All << "Geometry arena: " << vertRanges.getUsed() << "/" << vertRanges.getCapacity() << " vertices, "
+      << indexRanges.getUsed() << "/" << indexRanges.getCapacity() << " indices" << Trace::Stop;
+
+    // the scene's command buffers were recorded against the old ranges (or old buffers, if
+    // the arena grew), so they need to be written again
+    if (m_scene)
+      setScene(m_scene);
   }
 
-  void Renderer::uploadTextures(TextureManager::TexMap& textures) const {
+  void Renderer::uploadTextures(TextureManager::TexMap& textures) {
+    waitFrame();
+
     std::unordered_map<TextureManager::TexMap::key_type, Texture::StagingBuffs> stagingBuffers;
 
     for (auto& tex : textures) {
@@ -582,31 +763,58 @@ namespace dw {
     }
     moveBuff.end();
 
-    m_graphicsQueue->get().submitOne(moveBuff);
-    m_graphicsQueue->get().waitIdle();
-    m_graphicsCmdPool->freeCommandBuffer(moveBuff);
+    // the frames come after it on the same queue, behind the upload's own barriers
+    auto&    graphicsQueue = m_graphicsQueue->get();
+    uint64_t uploaded      = graphicsQueue.submitOne(moveBuff);
+    graphicsQueue.retire(uploaded,
+                         [pool = m_graphicsCmdPool, &moveBuff, staging = std::move(stagingBuffers)] {
+                           pool->freeCommandBuffer(moveBuff);
+                         });
+
+    m_textures = &textures;
+
+    // Bindless, the new slots can be written under the recorded geometry pass. The fallback
+    // table isn't update-after-bind, so writing it means recording the pass again.
+    if (m_geometryStep) {
+      m_geometryStep->updateTextureTable(textures, m_sampler, *m_defaultTextureView);
+
+      if (!m_bindless && m_scene)
+        setScene(m_scene);
+    }
   }
 
   void Renderer::uploadMaterials(MaterialManager::MtlMap& materials) {
-    //std::unordered_map<MaterialManager::MtlMap::key_type, Material::StagingBuffs> stagingBuffers;
-
+    waitFrame();
     m_materials = &materials;
 
-    if (m_materialsUBO)
-      m_materialsUBO.reset();
+    // IDs are recycled, so the highest one in use sizes the buffer rather than the count
+    uint32_t idCount = 1;
+    for (auto& mtl : materials)
+      idCount = std::max(idCount, mtl.second->getID() + 1);
 
-    m_materialsUBO = util::make_ptr<Buffer>(Buffer::CreateUniform(*m_device,
-                                                                  materials.size() * sizeof(Material::MaterialUBO)));
+    // grown by doubling, and only then does anything need re-recording
+    VkDeviceSize size = idCount * sizeof(Material::MaterialData);
+    if (!m_materialBuffer || m_materialBuffer->getSize() < size) {
+      VkDeviceSize capacity = m_materialBuffer ? m_materialBuffer->getSize() : size;
+      while (capacity < size)
+        capacity *= 2;
+
+      m_materialBuffer.reset();
+      m_materialBuffer = util::make_ptr<Buffer>(Buffer::CreateStorage(*m_device, capacity));
+
+      if (m_scene)
+        setScene(m_scene);
+    }
 
-    auto data = reinterpret_cast<Material::MaterialUBO*>(m_materialsUBO->map());
+    auto data = reinterpret_cast<Material::MaterialData*>(m_materialBuffer->map());
     for (auto& mtl : materials) {
-      data[mtl.second->getID()] = mtl.second->getAsUBO();
+      data[mtl.second->getID()] = mtl.second->getAsData();
     }
-    m_materialsUBO->unMap();
+    m_materialBuffer->unMap();
   }
 
-  void Renderer::updateUniformBuffers(uint32_t imageIndex) const {
-    // NOTE: Global lights are NOT dynamic
+  void Renderer::updateUniformBuffers(uint32_t imageIndex) {
+    // NOTE: Global lights are NOT dynamic, though their cascades follow the camera
     auto camera = m_scene->getCamera();
     CameraUniform cam    = {
       camera->worldToCamera(),
@@ -614,43 +822,124 @@ namespace dw {
       camera->getWorldPos(),
       camera->getForward(),
       camera->getFar(),
-      camera->getNear()
+      camera->getNear(),
+      glm::inverse(camera->cameraToNDC() * camera->worldToCamera())
     };
 
     void* data = m_cameraUBO->map();
     memcpy(data, &cam, sizeof(cam));
     m_cameraUBO->unMap();
 
-    assert(m_modelUBOdata);
+    // Cull against the camera, then sort what's left by (mesh, material) & view depth. Visible
+    // instances are packed at the front of their group's range nearest first, culled ones at
+    // the back, and the geometry commands are laid out nearest group first. The recorded
+    // command buffers stay valid. Shadow casters are culled per map in updateShadowMaps(), as
+    // casters out of view can shadow what's in it. All of it goes into CPU copies first; only
+    // what differs from the last frame is written to the buffers.
+    util::Frustum frustum(camera->cameraToNDC() * camera->worldToCamera());
+    glm::vec3     eye     = camera->getWorldPos();
+    glm::vec3     forward = camera->getForward();
+
+    m_frameObjects.resize(m_slotEnd);
+    m_frameCommands.resize(m_drawGroups.size() + m_numStaticShadowDraws + m_numShadowDraws);
+    auto objData  = m_frameObjects.data();
+    auto commands = m_frameCommands.data();
+
+    auto writeObject = [this, objData](uint32_t slot, uint32_t i) {
+      glm::mat4 const& model = m_frameModels[i];
+      for (int row = 0; row < 3; ++row)
+        objData[slot].modelRows[row] = {model[0][row], model[1][row], model[2][row], model[3][row]};
+      objData[slot].mtlIndex = m_drawGroups[m_instanceGroups[i]].mtlID;
+      m_slotSpheres[slot]    = m_frameBounds[i];
+    };
+
+    for (uint32_t g = 0; g < m_drawGroups.size(); ++g)
+      m_groupBack[g] = m_drawGroups[g].firstInstance + m_drawGroups[g].instanceCount;
+
+    m_frameQueue.clear();
+    for (uint32_t i = 0; i < m_instanceObjects.size(); ++i) {
+      auto const& sphere = m_instanceObjects[i]->get<obj::Graphics>()->getMesh()->getBoundingSphere();
+
+      glm::mat4 const& model = m_instanceObjects[i]->getTransform()->getMatrix();
+      if (RenderQueue::GetMobility(m_instanceKeys[i]) == RenderQueue::mStatic && model != m_frameModels[i])
+        m_staticCastersMoved = true;
+
+      m_frameModels[i] = model;
+      m_frameBounds[i] = util::Frustum::TransformSphere(sphere, m_frameModels[i]);
+
+      glm::vec3 center = m_frameBounds[i];
+      if (!frustum.intersectsSphere(center, m_frameBounds[i].w)) {
+        writeObject(--m_groupBack[m_instanceGroups[i]], i);
+        continue;
+      }
+
+      uint32_t depth = RenderQueue::QuantizeDepth(glm::dot(center - eye, forward), camera->getNear(), camera->getFar());
+
+      m_frameQueue.push(m_instanceKeys[i] | RenderQueue::MakeKey(RenderQueue::pGeometry, 0, 0, 0, 0, depth), i);
+    }
+
+    m_frameQueue.sort();
+
+    // a group's first entry is its nearest, which is what orders the groups
+    m_groupQueue.clear();
+    uint32_t front = 0;
+    for (size_t k = 0; k < m_frameQueue.size(); ++k) {
+      uint32_t i = m_frameQueue.getValue(k);
+      uint32_t g = m_instanceGroups[i];
+
+      if (k == 0 || g != m_instanceGroups[m_frameQueue.getValue(k - 1)]) {
+        m_groupQueue.push(RenderQueue::GetDepth(m_frameQueue.getKey(k)), g);
+        front = m_drawGroups[g].firstInstance;
+      }
+
+      writeObject(front++, i);
+    }
 
-    for (uint32_t i = 0; i < m_scene->getObjects().size(); ++i) {
-      auto objData = reinterpret_cast<ObjectUniform*>(
-        reinterpret_cast<char*>(m_modelUBOdata) + i * m_modelUBOdynamicAlignment);
+    m_groupQueue.sort();
 
-      auto obj = m_scene->getObjects()[i];
+    uint32_t c = 0;
+    auto writeCommand = [&](uint32_t g, uint32_t instanceCount) {
+      auto const& group = m_drawGroups[g];
+      commands[c++] = {group.range.indexCount, instanceCount, group.range.firstIndex,
+                       static_cast<int32_t>(group.range.vertexOffset), group.firstInstance};
+    };
 
-      objData->model    = m_scene->getObjects()[i]->getTransform()->getMatrix();
-      objData->mtlIndex = obj->get<Graphics>() ? obj->get<obj::Graphics>()->getMesh()->getMaterial()->getID() : 0;
+    for (size_t k = 0; k < m_groupQueue.size(); ++k) {
+      uint32_t g = m_groupQueue.getValue(k);
+      writeCommand(g, m_groupBack[g] - m_drawGroups[g].firstInstance);
     }
 
-    data = m_modelUBO->map();
-    memcpy(data, m_modelUBOdata, m_modelUBO->getSize());
-    m_modelUBO->unMap();
+    // nothing visible, but the recorded draw count still covers them
+    for (uint32_t g = 0; g < m_drawGroups.size(); ++g) {
+      if (m_groupBack[g] == m_drawGroups[g].firstInstance)
+        writeCommand(g, 0);
+    }
+
+    updateShadowMaps();
+
+    // a still camera over still objects writes nothing; edits write about the slots they touch
+    size_t slotsWritten = writeChanged(*m_objectBuffer, m_writtenObjects, m_frameObjects);
+    writeChanged(*m_indirectBuffer, m_writtenCommands, m_frameCommands);
+    writeChanged(*m_shadowRoutes, m_writtenRoutes, m_frameRoutes);
+
+    if (m_editLogging)
+      m_slotsWritten += slotsWritten;
 
+    // lights can be inserted at any time; any past the UBO's room aren't drawn
     data                   = m_localLightsUBO->map();
     LightUBO* lightUBOdata = reinterpret_cast<LightUBO*>(data);
-    for (size_t i     = 0; i < m_scene->getLights().size(); ++i)
+    size_t    lightCount   = std::min<size_t>(m_scene->getLights().size(), LocalLightingStep::MAX_LOCAL_LIGHTS);
+    for (size_t i     = 0; i < lightCount; ++i)
       lightUBOdata[i] = m_scene->getLights()[i]->getAsUBO();
 
-    *reinterpret_cast<int32_t*>(lightUBOdata + LocalLightingStep::MAX_LOCAL_LIGHTS) = static_cast<uint32_t>(m_scene->
-                                                                                                            getLights().
-                                                                                                            size());
+    *reinterpret_cast<int32_t*>(lightUBOdata + LocalLightingStep::MAX_LOCAL_LIGHTS) = static_cast<uint32_t>(lightCount);
     m_localLightsUBO->unMap();
 
     // shader control:
     assert(m_shaderControl);
     data                                    = m_shaderControlBuffer->map();
     *reinterpret_cast<ShaderControl*>(data) = *m_shaderControl;
+    reinterpret_cast<ShaderControl*>(data)->global_summedAreaShadows = m_atlasFilter == ShadowFilter::SummedArea;
     m_shaderControlBuffer->unMap();
 
     // generate new random samples:
@@ -692,6 +981,345 @@ namespace dw {
     //vkFlushMappedMemoryRanges(device, 1, &memoryRange);
   }
 
+  void Renderer::updateShadowMaps() {
+    using Update = ShadowMappedLight::Update;
+    static_assert(GlobalLightStep::MAX_SHADOW_MAPS <= 32 && GlobalLightStep::MAX_SHADOW_MAPS <= 1u << SHADOW_ROUTE_MAP_BITS,
+                  "caster masks & routes hold a map in a bit & SHADOW_ROUTE_MAP_BITS bits");
+
+    auto  camera     = m_scene->getCamera();
+    float cascadeEnd = std::min(camera->getFar(), m_shadowSettings.maxDistance);
+
+    // every map's blurred state has to follow the toggle
+    bool blurChanged = m_blurEnabled != m_shadowsBlurred;
+    bool rerecord    = false;
+    m_shadowsBlurred = m_blurEnabled;
+    m_shadowWork     = false;
+
+    assignShadowTiles();
+
+    auto lightData = reinterpret_cast<ShadowedUBO*>(m_globalLightsUBO->map());
+
+    // which maps each slot's instance casts into, one bit a map
+    std::fill(m_casterMasks.begin(), m_casterMasks.end(), 0u);
+
+    for (uint32_t m = 0; m < m_globalLights.size(); ++m) {
+      auto&           map      = m_globalLights[m];
+      ShadowCascades* cascades = nullptr;
+
+      if (map.m_cascadeSet != ShadowMappedLight::NO_CASCADE) {
+        cascades = &m_shadowCascades[map.m_cascadeSet];
+
+        // a light's cascades are next to each other, first to last
+        std::array<uint32_t, ShadowCascades::MAX_CASCADES> resolutions{};
+        for (uint32_t c = 0; map.m_cascade == 0 && c < m_cascadesPerLight; ++c)
+          resolutions[c] = m_globalLights[m + c].m_tile.size;
+
+        if (map.m_cascade == 0)
+          cascades->fit(camera->getWorldPos(),
+                        camera->getForward(),
+                        camera->getFOV(),
+                        camera->getAspect(),
+                        camera->getNear(),
+                        cascadeEnd,
+                        map.m_light.getDirection(),
+                        m_cascadesPerLight,
+                        m_shadowSettings.splitLambda,
+                        resolutions.data());
+      }
+
+      // Maps without a tile draw nothing
+      util::Frustum frustum(map.m_ubo.proj * map.m_ubo.view);
+      bool          hasDynamic = false;
+      bool          drawn      = map.m_tile.size != 0;
+
+      for (uint32_t d = 0; drawn && d < m_numShadowDraws; ++d) {
+        VkDrawIndexedIndirectCommand const& command = m_shadowDraws[d];
+
+        for (uint32_t slot = command.firstInstance; slot < command.firstInstance + command.instanceCount; ++slot) {
+          glm::vec4 const& sphere = m_slotSpheres[slot];
+
+          bool casts = cascades
+                         ? cascades->addCaster(map.m_cascade, sphere)
+                         : frustum.intersectsSphere(glm::vec3(sphere), sphere.w);
+          if (casts) {
+            m_casterMasks[slot] |= 1u << m;
+            hasDynamic |= d >= m_numStaticShadowDraws;
+          }
+        }
+      }
+
+      // the last cascade also takes everything past it, lit without shadows once out of its map
+      if (cascades) {
+        cascades->finish(map.m_cascade);
+
+        auto const& cascade = (*cascades)[map.m_cascade];
+        map.m_ubo.view      = cascade.view;
+        map.m_ubo.proj      = cascade.proj;
+        map.m_ubo.splitNear = map.m_cascade == 0 ? 0.f : cascade.splitNear;
+        map.m_ubo.splitFar  = map.m_cascade + 1 == cascades->size()
+                                ? std::numeric_limits<float>::max()
+                                : cascade.splitFar;
+      }
+
+      // The static layer is good as long as no static caster moved & it's seen the same way. A
+      // cascade's matrices follow the camera, so moving the camera redraws it.
+      bool staticValid = map.m_staticValid
+                         && !m_staticCastersMoved
+                         && map.m_staticView == map.m_ubo.view
+                         && map.m_staticProj == map.m_ubo.proj;
+
+      if (!drawn)
+        map.m_update = Update::None;
+      else if (!m_shadowCaching)
+        map.m_update = Update::Uncached;
+      else if (!staticValid)
+        map.m_update = Update::Full;
+      else if (hasDynamic || map.m_hasDynamic || blurChanged)
+        map.m_update = Update::Dynamic;
+      else
+        map.m_update = Update::None;
+
+      map.m_staticValid = m_shadowCaching && drawn;
+      map.m_staticView  = map.m_ubo.view;
+      map.m_staticProj  = map.m_ubo.proj;
+      map.m_hasDynamic  = hasDynamic;
+
+      rerecord |= map.m_update != map.m_recordedUpdate || map.m_tile != map.m_recordedTile;
+      m_shadowWork |= map.m_update != Update::None;
+
+      lightData[m] = map.m_ubo;
+    }
+
+    m_staticCastersMoved = false;
+
+    *reinterpret_cast<uint32_t*>(lightData + GlobalLightStep::MAX_SHADOW_MAPS) = static_cast<uint32_t>(m_globalLights.
+                                                                                                        size());
+    m_globalLightsUBO->unMap();
+
+    // Which maps each pass draws into: the static pass redraws the static layers that are out
+    // of date, the live pass draws dynamic casters over the copied layers, and every caster
+    // into maps that aren't cached
+    uint32_t staticMaps = 0, dynamicMaps = 0, uncachedMaps = 0;
+    for (uint32_t m = 0; m < m_globalLights.size(); ++m) {
+      Update update = m_globalLights[m].m_update;
+      staticMaps |= uint32_t(update == Update::Full) << m;
+      dynamicMaps |= uint32_t(update == Update::Full || update == Update::Dynamic) << m;
+      uncachedMaps |= uint32_t(update == Update::Uncached) << m;
+    }
+
+    // Each mesh is drawn once a pass, instanced over (slot, map) routes, so an instance casting
+    // into three maps is three instances of one draw. The routes of a draw are contiguous and
+    // its firstInstance points at them.
+    m_frameRoutes.resize((m_staticInstances + m_instanceObjects.size()) * m_globalLights.size());
+    auto routes   = m_frameRoutes.data();
+    auto out      = m_frameCommands.data() + m_drawGroups.size();
+    uint32_t routeCount = 0;
+
+    auto routeDraw = [&](uint32_t d, uint32_t maps) {
+      VkDrawIndexedIndirectCommand command = m_shadowDraws[d];
+      uint32_t                     first   = routeCount;
+
+      for (uint32_t slot = command.firstInstance; slot < command.firstInstance + command.instanceCount; ++slot) {
+        uint32_t mask = m_casterMasks[slot] & maps;
+        for (uint32_t m = 0; mask && m < m_globalLights.size(); ++m) {
+          if (mask >> m & 1u)
+            routes[routeCount++] = slot << SHADOW_ROUTE_MAP_BITS | m;
+        }
+      }
+
+      command.firstInstance = first;
+      command.instanceCount = routeCount - first;
+      return command;
+    };
+
+    for (uint32_t d = 0; d < m_numStaticShadowDraws; ++d)
+      *out++ = routeDraw(d, staticMaps);
+
+    for (uint32_t d = 0; d < m_numShadowDraws; ++d)
+      *out++ = routeDraw(d, d < m_numStaticShadowDraws ? uncachedMaps : dynamicMaps | uncachedMaps);
+
+    m_frameRoutes.resize(routeCount);
+
+    // the last frame finished with the queue, so the buffers are free to record
+    if (rerecord)
+      recordShadowCommands();
+  }
+
+  // Sizes each map's tile by how much of the screen its light covers, then packs them. Sizes only
+  // change once the wanted size is well past the current one, as a new tile means redrawing the
+  // map's static layer. If they don't all fit the least important maps shrink first, then lose
+  // their tile & shadows altogether.
+  void Renderer::assignShadowTiles() {
+    auto camera = m_scene->getCamera();
+
+    util::Frustum frustum(camera->cameraToNDC() * camera->worldToCamera());
+    glm::vec3     eye      = camera->getWorldPos();
+    float         tanHalf  = std::tan(camera->getFOV() * 0.5f);
+    uint32_t      maxLevel = m_atlasTiles.getMaxLevel();
+
+    // the level each map wants, maxLevel + 1 being no tile
+    std::vector<uint32_t> levels(m_globalLights.size());
+
+    for (uint32_t m = 0; m < m_globalLights.size(); ++m) {
+      auto& map      = m_globalLights[m];
+      float coverage = 1.f;
+
+      if (map.m_cascadeSet != ShadowMappedLight::NO_CASCADE)
+        map.m_importance = 1.f - 0.125f * static_cast<float>(map.m_cascade);
+      else if (map.m_light.getType() == Light::Type::Directional)
+        map.m_importance = 1.f;
+      else {
+        // the light's reach as a sphere, measured against the screen's height
+        glm::vec3 pos    = map.m_light.getPosition();
+        float     radius = map.m_light.getFar();
+        float     dist   = glm::length(pos - eye);
+
+        if (!frustum.intersectsSphere(pos, radius))
+          coverage = 0.f;
+        else if (dist > radius)
+          coverage = std::min(radius / (dist * tanHalf), 1.f);
+
+        map.m_importance = coverage;
+      }
+
+      if (coverage <= 0.f) {
+        levels[m] = maxLevel + 1;
+        continue;
+      }
+
+      // level 1, half the atlas, covers the whole screen; every halving of coverage is a level down
+      float    wanted  = std::min(std::max(1.f - std::log2(coverage), 1.f), static_cast<float>(maxLevel));
+      uint32_t current = map.m_tile.size ? m_atlasTiles.getLevel(map.m_tile.size) : 0;
+
+      levels[m] = current && std::abs(wanted - static_cast<float>(current)) < 0.75f
+                    ? current
+                    : static_cast<uint32_t>(std::lround(wanted));
+    }
+
+    // squeeze until the tiles' area fits
+    auto area = [&]() {
+      uint64_t total = 0;
+      for (uint32_t level : levels) {
+        if (level <= maxLevel)
+          total += uint64_t(1) << (2 * (maxLevel - level));
+      }
+      return total;
+    };
+
+    // ties go against the later map, so the scene's first lights keep theirs
+    auto lessImportant = [this](uint32_t a, uint32_t b) {
+      float ia = m_globalLights[a].m_importance, ib = m_globalLights[b].m_importance;
+      return ia != ib ? ia < ib : a > b;
+    };
+
+    uint64_t atlasArea = uint64_t(1) << (2 * maxLevel);
+    while (area() > atlasArea) {
+      uint32_t shrink = ~0u, drop = ~0u;
+      for (uint32_t m = 0; m < levels.size(); ++m) {
+        if (levels[m] > maxLevel)
+          continue;
+        if (levels[m] < maxLevel && (shrink == ~0u || lessImportant(m, shrink)))
+          shrink = m;
+        if (drop == ~0u || lessImportant(m, drop))
+          drop = m;
+      }
+
+      ++levels[shrink != ~0u ? shrink : drop];
+    }
+
+    // maps whose tile changes give theirs back first, so the new ones can merge
+    std::vector<uint32_t> moving;
+    for (uint32_t m = 0; m < m_globalLights.size(); ++m) {
+      auto&    map  = m_globalLights[m];
+      uint32_t size = levels[m] <= maxLevel ? m_atlasTiles.getTileSize(levels[m]) : 0;
+
+      if (map.m_tile.size != size) {
+        m_atlasTiles.release(map.m_tile);
+        map.m_tile = {};
+        if (size)
+          moving.push_back(m);
+      }
+    }
+
+    auto biggestFirst = [&levels](uint32_t a, uint32_t b) { return levels[a] < levels[b]; };
+    std::stable_sort(moving.begin(), moving.end(), biggestFirst);
+
+    bool packed = true;
+    for (uint32_t m : moving)
+      packed = packed && m_atlasTiles.allocate(m_atlasTiles.getTileSize(levels[m]), m_globalLights[m].m_tile);
+
+    // fragmented: start over, biggest first always fits
+    if (!packed) {
+      m_atlasTiles.reset(m_atlasTiles.getSize(), MIN_SHADOW_TILE_SIZE);
+      moving.clear();
+
+      for (uint32_t m = 0; m < m_globalLights.size(); ++m) {
+        m_globalLights[m].m_tile = {};
+        if (levels[m] <= maxLevel)
+          moving.push_back(m);
+      }
+
+      std::stable_sort(moving.begin(), moving.end(), biggestFirst);
+      for (uint32_t m : moving)
+        m_atlasTiles.allocate(m_atlasTiles.getTileSize(levels[m]), m_globalLights[m].m_tile);
+
+      Trace::Info << "Shadow atlas: repacked " << moving.size() << " tiles" << Trace::Stop;
+    }
+
+    float size = static_cast<float>(m_atlasTiles.getSize());
+    for (uint32_t m = 0; m < m_globalLights.size(); ++m) {
+      auto& map  = m_globalLights[m];
+      auto  tile = map.m_tile;
+
+      glm::vec4 rect = tile.size
+                         ? glm::vec4(tile.x, tile.y, tile.size, tile.size) / size
+                         : glm::vec4(0.f);
+
+      // a new tile, the static layer has to be redrawn into it
+      if (rect != map.m_ubo.atlasRect)
+        map.m_staticValid = false;
+
+      map.m_ubo.atlasRect = rect;
+    }
+  }
+
+  // What each map's commands do depends on its m_update & tile, so this follows updateShadowMaps()
+  // whenever one of them changes.
+  void Renderer::recordShadowCommands() {
+    m_shadowMapStep->getCommandBuffer().reset();
+    m_blurStep->getCommandBuffer().reset();
+    m_summedAreaStep->getCommandBuffer().reset();
+
+    m_shadowMapStep->writeCmdBuff(m_globalLights,
+                                  *m_shadowAtlas,
+                                  *m_staticShadowAtlas,
+                                  *m_geometryArena,
+                                  *m_indirectBuffer,
+                                  static_cast<uint32_t>(m_drawGroups.size()),
+                                  m_numStaticShadowDraws,
+                                  m_numShadowDraws);
+
+    if (m_atlasFilter == ShadowFilter::SummedArea)
+      m_summedAreaStep->writeCmdBuff(m_globalLights,
+                                     m_shadowAtlas->getImages().front(),
+                                     m_shadowAtlas->getImageViews().front(),
+                                     *m_shadowSAT,
+                                     *m_shadowSATView,
+                                     m_filterQueries);
+    else
+      m_blurStep->writeCmdBuff(m_globalLights,
+                               m_shadowAtlas->getImages().front(),
+                               m_shadowAtlas->getImageViews().front(),
+                               *m_blurIntermediate,
+                               *m_blurIntermediateView,
+                               m_filterQueries);
+
+    for (auto& map : m_globalLights) {
+      map.m_recordedUpdate = map.m_update;
+      map.m_recordedTile   = map.m_tile;
+    }
+  }
+
   /////////////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////////////
@@ -708,23 +1336,72 @@ namespace dw {
     if (!scene)
       return;
 
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms    = std::chrono::duration<double, std::milli>;
+    const auto start = Clock::now();
+
+    // the live scene's state is kept & has its edits applied; anything else is swapped in
+    util::ptr<PreparedScene> prepared;
+    bool                     built = false;
+    if (!keepsLive(scene)) {
+      prepared = takePreparedScene(scene);
+
+      if (!prepared) {
+        prepared = buildScene(TakeSnapshot(scene), m_shadowSettings);
+        built    = true;
+      }
+    }
+
+    waitFrame();
+
+    if (!prepared)
+      applySceneEdits();
+
     if (m_scene) {
       m_geometryStep->getCommandBuffer().reset();
       m_shadowMapStep->getCommandBuffer().reset();
       m_blurStep->getCommandBuffer().reset();
+      m_summedAreaStep->getCommandBuffer().reset();
       m_globalLightStep->getCommandBuffer().reset();
-      m_localLightStep->getCommandBuffer().reset();
-      m_ambientStep->getCommandBuffer().reset();
 
       for (uint32_t i = 0; i < m_swapchain->getNumImages(); ++i)
         m_finalStep->getCommandBuffer(i).reset();
       //vkResetCommandPool(*m_device, *m_graphicsCmdPool, 0/*VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT*/);
     }
 
-    m_scene = scene;
+    if (prepared) {
+      // what a build made is only logged the first time it's swapped in
+      if (!prepared->swapped) {
+        if (!built)
+          Trace::Info << "Scene was built in the background in " << prepared->buildMs << "ms" << Trace::Stop;
+
+        Trace::Info << "Geometry pass state changes: scene order " << prepared->sceneOrder << ", sorted "
+          << prepared->sorted << Trace::Stop;
+
+        uint32_t drawCount = prepared->numStaticShadowDraws + prepared->numShadowDraws;
+        Trace::Info << "Geometry pass draw calls: " << prepared->instanceObjects.size() << " -> "
+          << prepared->drawGroups.size() << " (instanced, 1 indirect call)" << Trace::Stop;
+        Trace::Info << "Shadow pass draw calls  : " << prepared->instanceObjects.size() * prepared->globalLights.size()
+          << " -> " << drawCount << " (instanced over " << prepared->globalLights.size()
+          << " shadow maps, casters culled per map, 2 passes), " << prepared->numStaticShadowDraws
+          << " cached as static" << Trace::Stop;
+        Trace::Info << "Object buffer          : " << prepared->slotEnd << " x " << sizeof(ObjectData)
+          << " bytes" << Trace::Stop;
+      }
+
+      swapScene(*prepared);
+      prepared->swapped = true;
 
-    Scene::LightContainer const& lights       = scene->getLights();
-    std::vector<ShadowedLight>   shadowLights = scene->getGlobalLights();
+      // it was built with every edit so far. What was live keeps no journal while it's not, its
+      // revision alone says whether what's cached for it is still good.
+      if (prepared->scene)
+        prepared->scene->setJournaling(false);
+      m_scene->setJournaling(true);
+
+      // what was live stays resident to switch back to, as long as it's still good
+      if (prepared->scene && prepared->key == getSceneKey(*prepared->scene))
+        m_sceneCache.push_back({ prepared->scene, prepared, {} });
+    }
 
     // Local lights
     if (!m_localLightsUBO) {
@@ -736,99 +1413,346 @@ namespace dw {
                                                                                    ))); // the light count is at the very end of the buffer
     }
 
-    // Global lights
-    size_t uboSize = sizeof(ShadowedUBO) * GlobalLightStep::MAX_GLOBAL_LIGHTS + sizeof(uint32_t);
+    // one cascade set per cascaded directional light
+    uint32_t mapCount    = static_cast<uint32_t>(m_globalLights.size());
+    uint32_t directional = static_cast<uint32_t>(m_shadowCascades.size());
+    uint32_t cascades    = m_cascadesPerLight;
+
+    if (directional && cascades < m_shadowSettings.cascadeCount)
+      Trace::Warn << "Shadow maps: only room for " << cascades << " cascades per directional light" << Trace::Stop;
+
+    // The atlas is the largest power of two that fits in the budget with its static copy, the
+    // blur's intermediate image and, if it filters with one, its summed-area table; how it's split
+    // between the maps is decided every frame
+    bool summedArea  = m_shadowSettings.filter == ShadowFilter::SummedArea;
+    auto shadowBytes = [summedArea](VkDeviceSize size) {
+      return size * size * (2 * SHADOW_TEXEL_BYTES + SHADOW_MOMENT_BYTES + (summedArea ? SHADOW_SAT_BYTES : 0));
+    };
+
+    uint32_t atlasSize = MAX_SHADOW_ATLAS_SIZE;
+    while (atlasSize > MIN_SHADOW_ATLAS_SIZE && shadowBytes(atlasSize) > m_shadowSettings.memoryBudget)
+      atlasSize >>= 1;
+
+    if (!m_shadowAtlas || atlasSize != m_shadowAtlasExtent.width || m_shadowSettings.filter != m_atlasFilter)
+      resizeShadowMaps(atlasSize);
+
+    if (m_filterTiming && !m_filterQueries) {
+      if (!m_device->getOwningPhysical().getLimits().timestampComputeAndGraphics)
+        Trace::Warn << "Shadow filter timing: the device can't timestamp its queues" << Trace::Stop;
+      else {
+        VkQueryPoolCreateInfo queryCreate = {
+          VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+          nullptr,
+          0,
+          VK_QUERY_TYPE_TIMESTAMP,
+          4,
+          0
+        };
+
+        if (vkCreateQueryPool(*m_device, &queryCreate, nullptr, &m_filterQueries) != VK_SUCCESS)
+          throw std::runtime_error("Could not create the shadow filter's query pool");
+      }
+    }
+
+    m_atlasTiles.reset(atlasSize, MIN_SHADOW_TILE_SIZE);
+
+    Trace::Info << "Shadow maps: " << mapCount << " in a " << atlasSize << "x" << atlasSize << " atlas ("
+      << directional << " directional lights x " << (directional ? cascades : 0) << " cascades), "
+      << (shadowBytes(atlasSize) >> 20) << "MB of " << (m_shadowSettings.memoryBudget >> 20) << "MB" << Trace::Stop;
+
+    // Written every frame, as cascades follow the camera
     if (!m_globalLightsUBO) {
-      // +sizeof(uint32_t) because light count 
-      m_globalLightsUBO = util::make_ptr<Buffer>(Buffer::CreateUniform(*m_device, uboSize, true));
+      // +sizeof(uint32_t) because light count
+      size_t uboSize    = sizeof(ShadowedUBO) * GlobalLightStep::MAX_SHADOW_MAPS + sizeof(uint32_t);
+      m_globalLightsUBO = util::make_ptr<Buffer>(Buffer::CreateUniform(*m_device, uboSize));
     }
 
-    // Stage memory
-    {
-      // NOTE: Global lights are NOT dynamic, hence they are updated here.
-      Buffer staging = Buffer::CreateStaging(*m_device, uboSize);
-      auto   data    = reinterpret_cast<ShadowedUBO*>(staging.map());
-      for (size_t i = 0; i < shadowLights.size(); ++i)
-        data[i]     = shadowLights[i].getAsShadowUBO();
+    // the atlas starts over, so every map does too: no tile, & its static layer to draw
+    for (auto& map : m_globalLights)
+      map = ShadowMappedLight(map.m_light, map.m_cascadeSet, map.m_cascade);
+
+    m_staticCastersMoved = true;
 
-      *reinterpret_cast<uint32_t*>(data + GlobalLightStep::MAX_GLOBAL_LIGHTS) = shadowLights.size();
-      staging.unMap();
+    // Descriptors
+    m_geometryStep->updateDescriptorSets(*m_cameraUBO, *m_objectBuffer, *m_materialBuffer, *m_shaderControlBuffer);
+    m_geometryStep->updateTextureTable(m_textures ? *m_textures : TextureManager::TexMap{},
+                                       m_sampler,
+                                       *m_defaultTextureView);
 
-      CommandBuffer& cmdBuff = m_transferCmdPool->allocateCommandBuffer();
-      cmdBuff.start(true);
+    m_shadowMapStep->updateDescriptorSets(*m_globalLightsUBO, *m_objectBuffer, *m_shadowRoutes);
+    recordShadowCommands();
+    recordWindowCommands();
 
-      VkBufferCopy copy = {0, 0, uboSize};
-      vkCmdCopyBuffer(cmdBuff, staging, *m_globalLightsUBO, 1, &copy);
+    evictScenes();
 
-      cmdBuff.end();
-      m_transferQueue->get().submitOne(cmdBuff);
-      m_transferQueue->get().waitIdle();
+    char const* from = built ? "built" : prepared ? "prepared" : "kept live";
+    Trace::Info << "Scene set in " << Ms(Clock::now() - start).count() << "ms (" << from << ", "
+      << (m_sceneBytes >> 10) << "KB of buffers)" << Trace::Stop;
+  }
 
-      m_transferCmdPool->freeCommandBuffer(cmdBuff);
+  void Renderer::prepareScene(util::ptr<Scene> scene) {
+    if (!scene || keepsLive(scene))
+      return;
+
+    auto slot = std::find_if(m_sceneCache.begin(), m_sceneCache.end(), [&scene](SceneSlot const& s) {
+      return s.scene == scene;
+    });
+
+    if (slot != m_sceneCache.end()) {
+      // building, or built for what the scene still is: it's only used more recently
+      if (!slot->prepared || slot->prepared->key == getSceneKey(*scene)) {
+        std::rotate(slot, slot + 1, m_sceneCache.end());
+        return;
+      }
+
+      m_sceneCache.erase(slot);
     }
 
-    m_globalLights.clear();
-    m_globalLights.reserve(shadowLights.size());
+    // the scene & settings are copied, they can change before it's done
+    m_sceneCache.push_back({ scene, nullptr, std::async(std::launch::async,
+                                                        [this, snapshot = TakeSnapshot(scene), settings = m_shadowSettings]() {
+                                                          return buildScene(snapshot, settings);
+                                                        }) });
 
-    // TODO: instead of remaking depth buffers from scratch, instead reuse them and only allocate new ones
-    // TODO: as needed
+    evictScenes();
+  }
 
-    for (auto& light : shadowLights) {
-      util::ptr<Framebuffer> depthBuff = util::make_ptr<Framebuffer>(*m_device, SHADOW_DEPTH_MAP_EXTENT);
-
-      depthBuff->addImage(VK_IMAGE_ASPECT_COLOR_BIT,
-                          VK_IMAGE_TYPE_2D,
-                          VK_IMAGE_VIEW_TYPE_2D,
-                          VK_FORMAT_R32G32B32A32_SFLOAT,
-                          SHADOW_DEPTH_MAP_EXTENT,
-                          VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-                          1,
-                          1,
-                          false,
-                          false,
-                          false,
-                          false);
-
-      depthBuff->addImage(VK_IMAGE_ASPECT_DEPTH_BIT,
-                          VK_IMAGE_TYPE_2D,
-                          VK_IMAGE_VIEW_TYPE_2D,
-                          VK_FORMAT_D24_UNORM_S8_UINT,
-                          SHADOW_DEPTH_MAP_EXTENT,
-                          VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                          1,
-                          1,
-                          false,
-                          false,
-                          false,
-                          false);
-
-      depthBuff->finalize(m_shadowMapStep->getRenderPass());
-
-      m_globalLights.emplace_back(light).m_depthBuffer = depthBuff;
+  bool Renderer::isScenePrepared(util::ptr<Scene> const& scene) const {
+    if (!scene)
+      return false;
+
+    if (keepsLive(scene))
+      return true;
+
+    SceneKey key = getSceneKey(*scene);
+
+    for (auto const& slot : m_sceneCache) {
+      if (slot.scene != scene)
+        continue;
+
+      if (slot.prepared)
+        return slot.prepared->key == key;
+
+      return slot.building.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    return false;
+  }
+
+  void Renderer::setSceneBudget(VkDeviceSize bytes) {
+    m_sceneBudget = bytes;
+    evictScenes();
+  }
+
+  Renderer::SceneKey Renderer::getSceneKey(Scene const& scene) const {
+    return { scene.getRevision(), m_shadowSettings.cascadeCount };
+  }
+
+  // The live scene's edits are applied as they come; only new cascade settings build it again
+  bool Renderer::keepsLive(util::ptr<Scene> const& scene) const {
+    return scene == m_scene && m_sceneKey.cascadeCount == m_shadowSettings.cascadeCount;
+  }
+
+  // Null if it was never prepared, or the scene's changed since. One still building is waited on,
+  // and anything it threw is thrown here.
+  util::ptr<Renderer::PreparedScene> Renderer::takePreparedScene(util::ptr<Scene> const& scene) {
+    auto slot = std::find_if(m_sceneCache.begin(), m_sceneCache.end(), [&scene](SceneSlot const& s) {
+      return s.scene == scene;
+    });
+
+    if (slot == m_sceneCache.end())
+      return nullptr;
+
+    util::ptr<PreparedScene> prepared = slot->prepared ? slot->prepared : slot->building.get();
+    m_sceneCache.erase(slot);
+
+    return prepared->key == getSceneKey(*scene) ? prepared : nullptr;
+  }
+
+  // Only what the build needs: the containers & each drawable object's mesh, material & mobility
+  Renderer::SceneSnapshot Renderer::TakeSnapshot(util::ptr<Scene> const& scene) {
+    SceneSnapshot snapshot;
+    snapshot.scene        = scene;
+    snapshot.revision     = scene->getRevision();
+    snapshot.objectSlots  = scene->getObjectSlots();
+    snapshot.globalLights = scene->getGlobalLights();
+
+    auto const& objects = scene->getObjects();
+    snapshot.instances.reserve(objects.size());
+
+    for (size_t i = 0; i < objects.size(); ++i) {
+      auto graphics = objects[i]->get<obj::Graphics>();
+      if (!graphics || !graphics->getMesh() || !graphics->getMesh()->isDrawable())
+        continue;
+
+      auto mesh = graphics->getMesh();
+      snapshot.instances.push_back({
+        objects[i],
+        scene->getObjectHandle(i),
+        mesh->getRange(),
+        mesh->getMaterial()->getID(),
+        objects[i]->getTransform()->isStatic()
+      });
     }
 
+    return snapshot;
+  }
+
+  util::ptr<Renderer::PreparedScene> Renderer::buildScene(SceneSnapshot const& snapshot, ShadowSettings settings) const {
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms    = std::chrono::duration<double, std::milli>;
+    const auto start = Clock::now();
+
+    auto prepared   = util::make_ptr<PreparedScene>();
+    prepared->scene = snapshot.scene;
+    prepared->key   = { snapshot.revision, settings.cascadeCount };
+
+    BuildShadowMaps(snapshot.globalLights,
+                    settings.cascadeCount,
+                    prepared->globalLights,
+                    prepared->shadowCascades,
+                    prepared->cascadesPerLight);
+
     // Object list
-    if (m_modelUBOdata)
-      alignedFree(m_modelUBOdata);
+    prepareDrawGroups(*prepared, snapshot);
 
-    prepareDynamicUniformBuffers();
+    prepared->buildMs = Ms(Clock::now() - start).count();
+    return prepared;
+  }
 
-    // Descriptors
-    m_geometryStep->updateDescriptorSets(*m_modelUBO,
-                                         *m_cameraUBO,
-                                         *m_materialsUBO,
-                                         *m_shaderControlBuffer,
-                                         *m_materials,
-                                         m_sampler);
-    m_geometryStep->writeCmdBuff(*m_gbuffer, scene->getObjects(), m_modelUBOdynamicAlignment);
+  // Global lights: one shadow map each, or one per cascade for directional ones while cascades are on
+  void Renderer::BuildShadowMaps(std::vector<ShadowedLight> const& shadowLights,
+                                 uint32_t                          cascadeCount,
+                                 std::vector<ShadowMappedLight>&   maps,
+                                 std::vector<ShadowCascades>&      cascadeSets,
+                                 uint32_t&                         cascadesPerLight) {
+    uint32_t directional = 0;
+    if (cascadeCount > 0)
+      directional = static_cast<uint32_t>(std::count_if(shadowLights.begin(), shadowLights.end(), [](auto const& light) {
+        return light.getType() == Light::Type::Directional;
+      }));
+
+    uint32_t others   = static_cast<uint32_t>(shadowLights.size()) - directional;
+    uint32_t cascades = std::min(cascadeCount, ShadowCascades::MAX_CASCADES);
+    while (cascades > 1 && others + directional * cascades > GlobalLightStep::MAX_SHADOW_MAPS)
+      --cascades;
+
+    uint32_t mapCount = others + directional * cascades;
+    if (mapCount > GlobalLightStep::MAX_SHADOW_MAPS)
+      throw std::runtime_error("Could not fit a shadow map for every global light");
+
+    cascadesPerLight = cascades;
+    maps.clear();
+    maps.reserve(mapCount);
+    cascadeSets.clear();
+
+    for (auto& light : shadowLights) {
+      bool     cascaded   = directional && light.getType() == Light::Type::Directional;
+      uint32_t cascadeSet = ShadowMappedLight::NO_CASCADE;
+
+      if (cascaded) {
+        cascadeSet = static_cast<uint32_t>(cascadeSets.size());
+        cascadeSets.emplace_back();
+      }
+
+      for (uint32_t cascade = 0; cascade < (cascaded ? cascades : 1); ++cascade) {
+        maps.emplace_back(light, cascadeSet, cascade);
+      }
+    }
+  }
+
+  // Between frames only: the renderer's members are what the frame draws from
+  void Renderer::swapScene(PreparedScene& prepared) {
+    using std::swap;
+    swap(m_scene, prepared.scene);
+    swap(m_sceneKey, prepared.key);
+    swap(m_sceneBytes, prepared.bytes);
+
+    swap(m_globalLights, prepared.globalLights);
+    swap(m_shadowCascades, prepared.shadowCascades);
+    swap(m_cascadesPerLight, prepared.cascadesPerLight);
+    swap(m_drawGroups, prepared.drawGroups);
+    swap(m_shadowDraws, prepared.shadowDraws);
+    swap(m_numShadowDraws, prepared.numShadowDraws);
+    swap(m_numStaticShadowDraws, prepared.numStaticShadowDraws);
+    swap(m_instanceObjects, prepared.instanceObjects);
+    swap(m_instanceHandles, prepared.instanceHandles);
+    swap(m_instanceKeys, prepared.instanceKeys);
+    swap(m_instanceGroups, prepared.instanceGroups);
+    swap(m_handleInstances, prepared.handleInstances);
+    swap(m_groupOfKey, prepared.groupOfKey);
+    swap(m_meshIndices, prepared.meshIndices);
+    swap(m_slotEnd, prepared.slotEnd);
+    swap(m_staticInstances, prepared.staticInstances);
+
+    swap(m_frameQueue, prepared.frameQueue);
+    swap(m_groupQueue, prepared.groupQueue);
+    swap(m_frameModels, prepared.frameModels);
+    swap(m_frameBounds, prepared.frameBounds);
+    swap(m_slotSpheres, prepared.slotSpheres);
+    swap(m_casterMasks, prepared.casterMasks);
+    swap(m_groupBack, prepared.groupBack);
+
+    swap(m_objectBuffer, prepared.objectBuffer);
+    swap(m_indirectBuffer, prepared.indirectBuffer);
+    swap(m_shadowRoutes, prepared.shadowRoutes);
+
+    // what the buffers hold is only tracked for the live scene; the first frame writes them all
+    m_writtenObjects.clear();
+    m_writtenCommands.clear();
+    m_writtenRoutes.clear();
+  }
+
+  // Scenes that finished building are counted as they're found; ones still building can't be
+  // evicted until they're done. Nothing in the cache is used by a frame, the live scene's
+  // buffers are the renderer's own.
+  void Renderer::evictScenes() {
+    VkDeviceSize total = m_sceneBytes;
+    for (auto slot = m_sceneCache.begin(); slot != m_sceneCache.end();) {
+      if (!slot->prepared && slot->building.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        // setScene() builds it again, & throws there
+        try {
+          slot->prepared = slot->building.get();
+        }
+        catch (std::exception const& e) {
+          Trace::Warn << "Could not prepare a scene: " << e.what() << Trace::Stop;
+          slot = m_sceneCache.erase(slot);
+          continue;
+        }
+      }
+
+      if (slot->prepared)
+        total += slot->prepared->bytes;
+
+      ++slot;
+    }
 
-    m_shadowMapStep->updateDescriptorSets(*m_modelUBO, *m_globalLightsUBO);
-    m_shadowMapStep->writeCmdBuff(m_globalLights, scene->getObjects(), m_modelUBOdynamicAlignment);
+    for (auto slot = m_sceneCache.begin(); slot != m_sceneCache.end() && total > m_sceneBudget;) {
+      if (!slot->prepared) {
+        ++slot;
+        continue;
+      }
 
-    m_blurStep->writeCmdBuff(m_globalLights, *m_blurIntermediate, *m_blurIntermediateView);
+      Trace::Info << "Evicted a prepared scene (" << (slot->prepared->bytes >> 10) << "KB), "
+        << ((total - slot->prepared->bytes) >> 10) << "KB of " << (m_sceneBudget >> 10) << "KB left resident"
+        << Trace::Stop;
+
+      total -= slot->prepared->bytes;
+      slot = m_sceneCache.erase(slot);
+    }
+  }
+
+  // With the command buffers reset
+  void Renderer::recordWindowCommands() {
+    m_geometryStep->writeCmdBuff(*m_gbuffer,
+                                 *m_geometryArena,
+                                 *m_indirectBuffer,
+                                 0,
+                                 static_cast<uint32_t>(m_drawGroups.size()));
 
     m_globalLightStep->updateDescriptorSets(m_gbuffer->getImageViews(),
-                                            m_globalLights,
+                                            m_shadowAtlas->getImageViews().front(),
+                                            *m_shadowSATView,
                                             *m_scene->getBackground()->getView(),
                                             *m_scene->getIrradiance()->getView(),
                                             *m_cameraUBO,
@@ -837,7 +1761,7 @@ namespace dw {
                                             *m_shaderControlBuffer,
                                             m_sampler);
 
-    m_globalLightStep->writeCmdBuff(*m_globalLitFrameBuffer);
+    m_globalLightStep->writeCmdBuff(*m_globalLitFrameBuffer, {}, m_filterQueries);
 
     m_localLightStep->updateDescriptorSets(m_gbuffer->getImageViews(),
                                            m_globalLitFrameBuffer->getImageViews().front(),
@@ -845,39 +1769,493 @@ namespace dw {
                                            *m_localLightsUBO,
                                            *m_shaderControlBuffer,
                                            m_sampler);
-    m_localLightStep->writeCmdBuff(*m_localLitFramebuffer, m_globalLitFrameBuffer->getImages().front());
+    m_ambientStep->updateDescriptorSets(m_gbuffer->getImageViews(), *m_cameraUBO, m_sampler);
 
-    m_ambientStep->updateDescriptorSets(m_gbuffer->getImageViews()[0], m_gbuffer->getImageViews()[1], m_sampler);
-    m_ambientStep->writeCmdBuff(*m_ambientFramebuffer);
+    m_finalStep->updateDescriptorSets(*m_localLitView, m_sampler);
+    m_finalStep->writeCmdBuff(m_swapchain->getFrameBuffers(), *m_localLightStep, *m_ambientStep);
+  }
 
-    m_finalStep->updateDescriptorSets(m_localLitFramebuffer->getImageViews().front(), m_sampler);
-    m_finalStep->writeCmdBuff(m_swapchain->getFrameBuffers(), m_localLitFramebuffer->getImages().front());
+  // The atlas & its static copy: each map's static layer is copied into its tile before the
+  // dynamic casters are drawn over it. Only called with the window & from setScene(), between
+  // frames, with the command buffers reset. The frame graph refers to every image here, so it's
+  // rebuilt too.
+  void Renderer::resizeShadowMaps(uint32_t size) {
+    m_shadowAtlasExtent = {size, size, 1};
+    m_atlasFilter       = m_shadowSettings.filter;
+
+    auto makeAtlas = [this](VkImageUsageFlags colorUsage, VkImageUsageFlags depthUsage) {
+      util::ptr<Framebuffer> buffer = util::make_ptr<Framebuffer>(*m_device, m_shadowAtlasExtent);
+
+      buffer->addImage(VK_IMAGE_ASPECT_COLOR_BIT,
+                       VK_IMAGE_TYPE_2D,
+                       VK_IMAGE_VIEW_TYPE_2D,
+                       ShadowMapStep::MOMENT_FORMAT,
+                       m_shadowAtlasExtent,
+                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | colorUsage,
+                       1,
+                       1,
+                       false,
+                       false,
+                       false,
+                       false);
+
+      buffer->addImage(VK_IMAGE_ASPECT_DEPTH_BIT,
+                       VK_IMAGE_TYPE_2D,
+                       VK_IMAGE_VIEW_TYPE_2D,
+                       VK_FORMAT_D24_UNORM_S8_UINT,
+                       m_shadowAtlasExtent,
+                       VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | depthUsage,
+                       1,
+                       1,
+                       false,
+                       false,
+                       false,
+                       false);
+
+      buffer->finalize(m_shadowMapStep->getRenderPass());
+      return buffer;
+    };
+
+    m_shadowAtlas.reset();
+    m_staticShadowAtlas.reset();
+    m_shadowAtlas = makeAtlas(VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                              VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    m_staticShadowAtlas = makeAtlas(VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    // global lighting always binds a table; the blur only needs a stand-in
+    VkExtent3D tableExtent = m_atlasFilter == ShadowFilter::SummedArea ? m_shadowAtlasExtent : VkExtent3D{1, 1, 1};
+
+    MemoryAllocator allocator(m_device->getOwningPhysical());
+    m_shadowSATView.reset();
+    m_shadowSAT = util::make_ptr<DependentImage>(*m_device);
+    m_shadowSAT->initImage(VK_IMAGE_TYPE_2D,
+                           VK_IMAGE_VIEW_TYPE_2D,
+                           SummedAreaStep::TABLE_FORMAT,
+                           tableExtent,
+                           VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                           1,
+                           1,
+                           false,
+                           false,
+                           false,
+                           false);
+
+    m_shadowSAT->back(allocator, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_shadowSATView = util::make_ptr<ImageView>(m_shadowSAT->createView());
+
+    setupFrameGraph();
   }
 
-  void Renderer::prepareDynamicUniformBuffers() {
-    const size_t minUboAlignment = m_device->getOwningPhysical().getLimits().minUniformBufferOffsetAlignment;
+  void Renderer::prepareDrawGroups(PreparedScene& prepared, SceneSnapshot const& snapshot) const {
+    auto const& instances = snapshot.instances;
+
+    // meshes are numbered by their place in the arena for the sort keys
+    std::vector<uint32_t> meshStarts;
+    for (auto& instance : instances)
+      meshStarts.push_back(instance.range.firstIndex);
+
+    std::sort(meshStarts.begin(), meshStarts.end());
+    meshStarts.erase(std::unique(meshStarts.begin(), meshStarts.end()), meshStarts.end());
+
+    if (meshStarts.size() > (1u << RenderQueue::MESH_BITS))
+      throw std::runtime_error("Could not fit every mesh in the draw sort keys");
+
+    // meshes added later are numbered after these
+    for (uint32_t m = 0; m < meshStarts.size(); ++m)
+      prepared.meshIndices[meshStarts[m]] = m;
 
-    m_modelUBOdynamicAlignment = sizeof(ObjectUniform);
-    if (minUboAlignment > 0) {
-      m_modelUBOdynamicAlignment = (m_modelUBOdynamicAlignment + (minUboAlignment - 1)) & ~(minUboAlignment - 1);
+    // Queue every object that can actually be drawn by (mesh, material); depth is added per frame.
+    // Sorted, each group is one contiguous run of instances, and all instances of a mesh are
+    // next to each other, which lets the shadow pass ignore materials & draw each mesh once.
+    RenderQueue queue;
+    queue.reserve(instances.size());
+
+    for (uint32_t i = 0; i < instances.size(); ++i) {
+      uint32_t meshIndex = prepared.meshIndices[instances[i].range.firstIndex];
+      uint32_t mtlID     = instances[i].materialID;
+
+      if (mtlID >= (1u << RenderQueue::MATERIAL_BITS))
+        throw std::runtime_error("Could not fit material ID in the draw sort keys");
+
+      uint32_t mobility = instances[i].isStatic ? RenderQueue::mStatic : RenderQueue::mDynamic;
+
+      queue.push(RenderQueue::MakeKey(RenderQueue::pGeometry, 0, mobility, meshIndex, mtlID), i);
+    }
+
+    DrawStateChanges sceneOrder = queue.countStateChanges();
+    queue.sort();
+
+    // groups start out with no room to spare; the first one added to moves to the end
+    prepared.handleInstances.assign(snapshot.objectSlots, NO_INSTANCE);
+
+    for (uint32_t i = 0; i < queue.size(); ++i) {
+      auto const& instance = instances[queue.getValue(i)];
+
+      if (i == 0 || queue.getKey(i) != queue.getKey(i - 1)) {
+        prepared.groupOfKey[queue.getKey(i)] = static_cast<uint32_t>(prepared.drawGroups.size());
+        prepared.drawGroups.push_back({instance.range, instance.materialID, i, 0, 0, queue.getKey(i)});
+      }
+
+      ++prepared.drawGroups.back().instanceCount;
+      ++prepared.drawGroups.back().capacity;
+
+      prepared.handleInstances[Scene::GetSlot(instance.handle)] = i;
+
+      prepared.instanceObjects.push_back(instance.object);
+      prepared.instanceHandles.push_back(instance.handle);
+      prepared.instanceKeys.push_back(queue.getKey(i));
+      prepared.instanceGroups.push_back(static_cast<uint32_t>(prepared.drawGroups.size() - 1));
+      prepared.staticInstances += RenderQueue::GetMobility(queue.getKey(i)) == RenderQueue::mStatic;
     }
 
-    size_t modelUBOsize = m_modelUBOdynamicAlignment * m_scene->getObjects().size();
+    prepared.slotEnd = static_cast<uint32_t>(prepared.instanceObjects.size());
+
+    prepared.frameQueue.reserve(prepared.instanceObjects.size());
+    prepared.groupQueue.reserve(prepared.drawGroups.size());
+    prepared.frameModels.resize(prepared.instanceObjects.size());
+    prepared.frameBounds.resize(prepared.instanceObjects.size());
+    prepared.slotSpheres.resize(prepared.slotEnd);
+    prepared.groupBack.resize(prepared.drawGroups.size());
 
-    Trace::Warn << "Minimum UBO Align  : " << minUboAlignment << Trace::Stop;
-    Trace::Warn << "Size of Object UBO : " << sizeof(ObjectUniform) << Trace::Stop;
-    Trace::Warn << "Model UBO Alignment: " << m_modelUBOdynamicAlignment << Trace::Stop;
-    Trace::Warn << "(2^N) Alignment    : " << (m_modelUBOdynamicAlignment & -m_modelUBOdynamicAlignment) << Trace::Stop;
+    prepared.sceneOrder = sceneOrder;
+    prepared.sorted     = queue.countStateChanges();
 
-    m_modelUBOdata = static_cast<ObjectUniform*>(alignedAlloc(modelUBOsize,
-                                                              m_modelUBOdynamicAlignment & -m_modelUBOdynamicAlignment)
-    );
-    assert(m_modelUBOdata);
+    BuildShadowDraws(prepared.drawGroups, prepared.shadowDraws, prepared.numStaticShadowDraws);
+    prepared.numShadowDraws = static_cast<uint32_t>(prepared.shadowDraws.size());
 
-    size_t numImages = m_swapchain->getNumImages();
+    std::vector<VkDrawIndexedIndirectCommand> commands;
+    for (auto& group : prepared.drawGroups)
+      commands.push_back({group.range.indexCount, group.instanceCount, group.range.firstIndex,
+                          static_cast<int32_t>(group.range.vertexOffset), group.firstInstance});
 
-    m_modelUBO.reset();
-    m_modelUBO = util::make_ptr<Buffer>(Buffer::CreateUniform(*m_device, modelUBOsize));
+    commands.insert(commands.end(),
+                    prepared.shadowDraws.begin(),
+                    prepared.shadowDraws.begin() + prepared.numStaticShadowDraws);
+    commands.insert(commands.end(), prepared.shadowDraws.begin(), prepared.shadowDraws.end());
+
+    prepared.casterMasks.assign(prepared.slotEnd, 0u);
+
+    // at least one of each so the buffers always exist to be bound. They're the scene's own, so the
+    // one that's live can be drawn from while another's prepared.
+    VkDeviceSize objectSize = sizeof(ObjectData) * std::max<size_t>(prepared.slotEnd, 1);
+    prepared.objectBuffer   = util::make_ptr<Buffer>(Buffer::CreateStorage(*m_device, objectSize));
+
+    // every slot casting into every map, static ones twice
+    VkDeviceSize routeSize = sizeof(uint32_t) * std::max<size_t>((prepared.staticInstances + prepared.instanceObjects.size())
+                                                                 * prepared.globalLights.size(), 1);
+    prepared.shadowRoutes  = util::make_ptr<Buffer>(Buffer::CreateStorage(*m_device, routeSize));
+
+    VkDeviceSize indirectSize = sizeof(VkDrawIndexedIndirectCommand) * std::max<size_t>(commands.size(), 1);
+    prepared.indirectBuffer   = util::make_ptr<Buffer>(Buffer::CreateIndirect(*m_device, indirectSize));
+    prepared.bytes            = objectSize + routeSize + indirectSize;
+
+    void* data = prepared.indirectBuffer->map();
+    memcpy(data, commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+    prepared.indirectBuffer->unMap();
+  }
+
+  // Shadow commands: materials don't matter there, so a mesh's groups collapse into a single
+  // command wherever their slots are contiguous, once for its static instances & once for its
+  // dynamic ones. Groups are taken in key order, so static ones come first. The static pass gets
+  // a copy of the static commands & the live pass a copy of all of them; updateShadowMaps()
+  // points each at the maps its instances cast into.
+  void Renderer::BuildShadowDraws(std::vector<DrawGroup> const&              groups,
+                                  std::vector<VkDrawIndexedIndirectCommand>& draws,
+                                  uint32_t&                                  numStatic) {
+    std::vector<uint32_t> order(groups.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&groups](uint32_t a, uint32_t b) {
+      return groups[a].key < groups[b].key;
+    });
+
+    draws.clear();
+    numStatic = 0;
+
+    uint32_t lastMobility = RenderQueue::mStatic;
+    for (uint32_t g : order) {
+      auto const& group = groups[g];
+      if (!group.instanceCount)
+        continue;
+
+      uint32_t mobility = RenderQueue::GetMobility(group.key);
+      bool     adjacent = !draws.empty() && draws.back().firstInstance + draws.back().instanceCount == group.firstInstance;
+
+      if (adjacent && draws.back().firstIndex == group.range.firstIndex && mobility == lastMobility)
+        draws.back().instanceCount += group.instanceCount;
+      else {
+        draws.push_back({group.range.indexCount, group.instanceCount, group.range.firstIndex,
+                         static_cast<int32_t>(group.range.vertexOffset), group.firstInstance});
+        numStatic += mobility == RenderQueue::mStatic;
+      }
+
+      lastMobility = mobility;
+    }
+  }
+
+  // Each instance's object data is laid out in its group's slots every frame, so nothing kept per
+  // instance is in any order, and moving a group costs nothing but its range: an edit is O(1) on
+  // the instances, & O(groups) for the shadow draws of the frame it's applied. Only slots whose
+  // contents changed are written to the buffer, so an edit uploads about what it touched. Buffers that
+  // outgrow the scene are made again twice the size they need to be, which rebinds them & so
+  // re-records the passes that draw with them; so do draw counts that change.
+  void Renderer::applySceneEdits() {
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms    = std::chrono::duration<double, std::milli>;
+
+    if (m_editLogging && ++m_editFrames == EDIT_LOG_FRAMES)
+      logSceneEdits();
+
+    if (!m_scene || m_sceneKey.revision == m_scene->getRevision())
+      return;
+
+    const auto start = Clock::now();
+
+    std::vector<Scene::Edit> edits = m_scene->takeEdits();
+    const auto groupCount  = m_drawGroups.size();
+    bool       lightsEdited = false;
+
+    for (auto const& edit : edits) {
+      switch (edit.type) {
+        case Scene::Edit::Type::AddObject:
+          addInstance(edit.handle, edit.object);
+          break;
+        case Scene::Edit::Type::RemoveObject:
+          removeInstance(edit.handle);
+          break;
+        case Scene::Edit::Type::UpdateObject:
+          removeInstance(edit.handle);
+          addInstance(edit.handle, edit.object);
+          break;
+        case Scene::Edit::Type::GlobalLights:
+          lightsEdited = true;
+          break;
+      }
+    }
+
+    m_sceneKey.revision = m_scene->getRevision();
+
+    // the maps are few, they're all made again & start over in the atlas
+    if (lightsEdited) {
+      BuildShadowMaps(m_scene->getGlobalLights(),
+                      m_sceneKey.cascadeCount,
+                      m_globalLights,
+                      m_shadowCascades,
+                      m_cascadesPerLight);
+
+      m_atlasTiles.reset(m_shadowAtlasExtent.width, MIN_SHADOW_TILE_SIZE);
+      m_staticCastersMoved = true;
+    }
+
+    if (m_slotEnd > SLOT_SLACK * m_instanceObjects.size() + MIN_GROUP_CAPACITY * m_drawGroups.size())
+      compactSlots();
+
+    const uint32_t staticDraws = m_numStaticShadowDraws;
+    const uint32_t shadowDraws = m_numShadowDraws;
+    BuildShadowDraws(m_drawGroups, m_shadowDraws, m_numStaticShadowDraws);
+    m_numShadowDraws = static_cast<uint32_t>(m_shadowDraws.size());
+
+    m_slotSpheres.resize(m_slotEnd);
+    m_casterMasks.resize(m_slotEnd);
+    m_groupBack.resize(m_drawGroups.size());
+
+    auto grow = [this](util::ptr<Buffer>& buffer, VkDeviceSize needed, bool indirect) {
+      if (needed <= buffer->getSize())
+        return false;
+
+      m_sceneBytes -= buffer->getSize();
+      buffer = util::make_ptr<Buffer>(indirect
+                                        ? Buffer::CreateIndirect(*m_device, 2 * needed)
+                                        : Buffer::CreateStorage(*m_device, 2 * needed));
+      m_sceneBytes += buffer->getSize();
+      return true;
+    };
+
+    bool rebind = grow(m_objectBuffer, sizeof(ObjectData) * m_slotEnd, false);
+    rebind |= grow(m_shadowRoutes,
+                   sizeof(uint32_t) * (m_staticInstances + m_instanceObjects.size()) * m_globalLights.size(),
+                   false);
+
+    bool rerecord = grow(m_indirectBuffer,
+                         sizeof(VkDrawIndexedIndirectCommand) * (m_drawGroups.size() + m_numStaticShadowDraws + m_numShadowDraws),
+                         true);
+
+    // a new buffer starts out empty, so the next frame writes all of it
+    if (rebind || rerecord) {
+      m_writtenObjects.clear();
+      m_writtenCommands.clear();
+      m_writtenRoutes.clear();
+    }
+
+    rerecord |= rebind || lightsEdited || m_drawGroups.size() != groupCount
+      || m_numStaticShadowDraws != staticDraws || m_numShadowDraws != shadowDraws;
+
+    // the frame's been waited on, so nothing in flight uses the descriptors or command buffers
+    if (rebind) {
+      m_geometryStep->updateDescriptorSets(*m_cameraUBO, *m_objectBuffer, *m_materialBuffer, *m_shaderControlBuffer);
+      m_geometryStep->updateTextureTable(m_textures ? *m_textures : TextureManager::TexMap{},
+                                         m_sampler,
+                                         *m_defaultTextureView);
+
+      m_shadowMapStep->updateDescriptorSets(*m_globalLightsUBO, *m_objectBuffer, *m_shadowRoutes);
+    }
+
+    if (rerecord) {
+      m_geometryStep->getCommandBuffer().reset();
+      m_geometryStep->writeCmdBuff(*m_gbuffer,
+                                   *m_geometryArena,
+                                   *m_indirectBuffer,
+                                   0,
+                                   static_cast<uint32_t>(m_drawGroups.size()));
+      recordShadowCommands();
+    }
+
+    double ms = Ms(Clock::now() - start).count();
+    m_editCount += static_cast<uint32_t>(edits.size());
+    m_editRebinds += rerecord;
+    m_editMs += ms;
+    m_maxEditMs = std::max(m_maxEditMs, ms);
+  }
+
+  // Objects that can't be drawn have no instance. A group that's full moves to the end of the
+  // slots with twice the room.
+  void Renderer::addInstance(Scene::Handle handle, util::ptr<obj::Object> const& object) {
+    auto graphics = object->get<obj::Graphics>();
+    if (!graphics || !graphics->getMesh() || !graphics->getMesh()->isDrawable())
+      return;
+
+    auto mesh      = graphics->getMesh();
+    auto meshIndex = m_meshIndices.emplace(mesh->getRange().firstIndex, static_cast<uint32_t>(m_meshIndices.size()));
+    if (meshIndex.first->second >= (1u << RenderQueue::MESH_BITS))
+      throw std::runtime_error("Could not fit every mesh in the draw sort keys");
+
+    uint32_t mtlID = mesh->getMaterial()->getID();
+    if (mtlID >= (1u << RenderQueue::MATERIAL_BITS))
+      throw std::runtime_error("Could not fit material ID in the draw sort keys");
+
+    uint32_t mobility = object->getTransform()->isStatic() ? RenderQueue::mStatic : RenderQueue::mDynamic;
+    uint64_t key      = RenderQueue::MakeKey(RenderQueue::pGeometry, 0, mobility, meshIndex.first->second, mtlID);
+
+    auto group = m_groupOfKey.emplace(key, static_cast<uint32_t>(m_drawGroups.size()));
+    if (group.second)
+      m_drawGroups.push_back({mesh->getRange(), mtlID, m_slotEnd, 0, 0, key});
+
+    // The arena hands a released mesh's range to whatever mesh it fits next, which then finds the
+    // old mesh's group by its first index. Every instance of the old mesh is gone or moved by the
+    // end of these edits, so the group draws the new one.
+    uint32_t g        = group.first->second;
+    auto&    drawGroup = m_drawGroups[g];
+    drawGroup.range    = mesh->getRange();
+    if (drawGroup.instanceCount == drawGroup.capacity) {
+      drawGroup.capacity      = std::max(2 * drawGroup.capacity, MIN_GROUP_CAPACITY);
+      drawGroup.firstInstance = m_slotEnd;
+      m_slotEnd += drawGroup.capacity;
+    }
+
+    ++drawGroup.instanceCount;
+
+    uint32_t slot = Scene::GetSlot(handle);
+    if (slot >= m_handleInstances.size())
+      m_handleInstances.resize(std::max<size_t>(slot + 1, 2 * m_handleInstances.size()), NO_INSTANCE);
+
+    m_handleInstances[slot] = static_cast<uint32_t>(m_instanceObjects.size());
+    m_instanceObjects.push_back(object);
+    m_instanceHandles.push_back(handle);
+    m_instanceKeys.push_back(key);
+    m_instanceGroups.push_back(g);
+    m_frameModels.push_back(object->getTransform()->getMatrix());
+    m_frameBounds.emplace_back();
+
+    if (mobility == RenderQueue::mStatic) {
+      ++m_staticInstances;
+      m_staticCastersMoved = true;
+    }
+  }
+
+  // The last instance takes the removed one's place
+  void Renderer::removeInstance(Scene::Handle handle) {
+    uint32_t slot = Scene::GetSlot(handle);
+    if (slot >= m_handleInstances.size() || m_handleInstances[slot] == NO_INSTANCE)
+      return;
+
+    uint32_t i = m_handleInstances[slot];
+    m_handleInstances[slot] = NO_INSTANCE;
+    --m_drawGroups[m_instanceGroups[i]].instanceCount;
+
+    if (RenderQueue::GetMobility(m_instanceKeys[i]) == RenderQueue::mStatic) {
+      --m_staticInstances;
+      m_staticCastersMoved = true;
+    }
+
+    size_t last = m_instanceObjects.size() - 1;
+    if (i != last) {
+      m_instanceObjects[i] = std::move(m_instanceObjects[last]);
+      m_instanceHandles[i] = m_instanceHandles[last];
+      m_instanceKeys[i]    = m_instanceKeys[last];
+      m_instanceGroups[i]  = m_instanceGroups[last];
+      m_frameModels[i]     = m_frameModels[last];
+      m_frameBounds[i]     = m_frameBounds[last];
+      m_handleInstances[Scene::GetSlot(m_instanceHandles[i])] = i;
+    }
+
+    m_instanceObjects.pop_back();
+    m_instanceHandles.pop_back();
+    m_instanceKeys.pop_back();
+    m_instanceGroups.pop_back();
+    m_frameModels.pop_back();
+    m_frameBounds.pop_back();
+  }
+
+  // Once moved groups have left too many slots behind, the groups are laid out back to back again
+  // in key order, with half as many slots again as they have instances, and empty ones dropped.
+  // O(instances), but only after O(instances) edits.
+  void Renderer::compactSlots() {
+    std::vector<uint32_t> order;
+    for (uint32_t g = 0; g < m_drawGroups.size(); ++g) {
+      if (m_drawGroups[g].instanceCount)
+        order.push_back(g);
+    }
+
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+      return m_drawGroups[a].key < m_drawGroups[b].key;
+    });
+
+    std::vector<uint32_t>  remap(m_drawGroups.size(), 0);
+    std::vector<DrawGroup> groups;
+    groups.reserve(order.size());
+    m_groupOfKey.clear();
+    m_slotEnd = 0;
+
+    for (uint32_t g : order) {
+      DrawGroup group     = m_drawGroups[g];
+      group.firstInstance = m_slotEnd;
+      group.capacity      = group.instanceCount + group.instanceCount / 2;
+      m_slotEnd += group.capacity;
+
+      remap[g]                = static_cast<uint32_t>(groups.size());
+      m_groupOfKey[group.key] = remap[g];
+      groups.push_back(group);
+    }
+
+    for (auto& g : m_instanceGroups)
+      g = remap[g];
+
+    m_drawGroups = std::move(groups);
+  }
+
+  void Renderer::logSceneEdits() {
+    if (m_editCount)
+      Trace::Info << "Scene edits over " << m_editFrames << " frames: " << m_editCount << " applied in "
+        << m_editMs << "ms (" << m_maxEditMs << "ms worst frame, " << m_editRebinds << " frames re-recorded), "
+        << m_instanceObjects.size() << " instances in " << m_slotEnd << " slots, " << m_drawGroups.size()
+        << " draw groups, " << m_slotsWritten / std::max(m_editFrames, 1u) << " slots written a frame"
+        << Trace::Stop;
+
+    m_editFrames   = 0;
+    m_editCount    = 0;
+    m_editRebinds  = 0;
+    m_editMs       = 0;
+    m_maxEditMs    = 0;
+    m_slotsWritten = 0;
   }
 
   /////////////////////////////////////////////////////////////////////////////
@@ -984,6 +2362,16 @@ namespace dw {
     deviceExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
     //deviceExtensions.push_back(VK_KHR_MAINTENANCE1_EXTENSION_NAME);
 
+    // Every queue keeps a timeline that its submissions signal
+    if (!physical.supportsTimelineSemaphores())
+      throw std::runtime_error("Could not find timeline semaphores on this device");
+    deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+    // The geometry & shadow passes draw many groups per vkCmdDrawIndexedIndirect, each
+    // finding its instances through firstInstance
+    if (!physical.supportsIndirectDraws())
+      throw std::runtime_error("Could not find multi-draw indirect with firstInstance on this device");
+
     VkPhysicalDeviceFeatures features               = {};
     features.robustBufferAccess                     = 1;  // vulkan does bounds checking on buffer access for us
     features.fillModeNonSolid                       = 1;  // wireframe
@@ -996,6 +2384,69 @@ namespace dw {
     features.shaderTessellationAndGeometryPointSize = 1;  // enable tess/geometry shaders to have big point sizes
     features.wideLines                              = 1;  // enable lines wider than 1.0
     features.largePoints                            = 1;  // enable points bigger than 1.0
+    features.multiDrawIndirect                      = 1;  // enable more than one draw per indirect call
+    features.drawIndirectFirstInstance              = 1;  // enable firstInstance != 0 in indirect draws
+    features.shaderClipDistance                     = 1;  // shadow casters are clipped to their atlas tile
+    features.shaderStorageImageExtendedFormats      = 1;  // the blur's rgba16 shadow moments
+
+    // Shadow moments are drawn, sampled, & blurred in place as RGBA16
+    VkFormatFeatureFlags momentFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+                                          | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+                                          | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+    if (!physical.getFeatures().shaderStorageImageExtendedFormats
+        || (physical.getFormatProperties(ShadowMapStep::MOMENT_FORMAT).optimalTilingFeatures & momentFeatures)
+        != momentFeatures)
+      throw std::runtime_error("Could not use RGBA16 shadow moments on this device");
+
+    // Without clip distances, casters drawn into one atlas tile would spill into its neighbours
+    if (!physical.getFeatures().shaderClipDistance)
+      throw std::runtime_error("Could not clip shadow casters to their atlas tile on this device");
+
+    // Bindless texture table if descriptor indexing is there, fixed-size table otherwise
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT
+    };
+
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+      nullptr,
+      VK_TRUE
+    };
+
+    m_bindless = physical.supportsBindlessTextures();
+    if (m_bindless) {
+      timelineFeatures.pNext = &indexingFeatures;
+
+      auto const& props = physical.getDescriptorIndexingProperties();
+
+      if (physical.hasExtension(VK_KHR_MAINTENANCE3_EXTENSION_NAME))
+        deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+      deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+      indexingFeatures.shaderSampledImageArrayNonUniformIndexing    = 1;
+      indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = 1;
+      indexingFeatures.descriptorBindingPartiallyBound              = 1;
+      indexingFeatures.runtimeDescriptorArray                       = 1;
+
+      m_textureSlots = std::min({
+        RenderStep::MAX_BINDLESS_TEXTURE_SLOTS,
+        props.maxDescriptorSetUpdateAfterBindSampledImages,
+        props.maxDescriptorSetUpdateAfterBindSamplers,
+        props.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        props.maxPerStageDescriptorUpdateAfterBindSamplers
+      });
+    }
+    else {
+      auto const& limits = physical.getLimits();
+      if (limits.maxPerStageDescriptorSamplers < RenderStep::FALLBACK_TEXTURE_SLOTS
+          || limits.maxPerStageDescriptorSampledImages < RenderStep::FALLBACK_TEXTURE_SLOTS)
+        throw std::runtime_error("Could not fit the texture table in the device's sampler limits");
+
+      m_textureSlots = RenderStep::FALLBACK_TEXTURE_SLOTS;
+    }
+
+    Trace::Info << "Texture table: " << m_textureSlots << " slots, "
+      << (m_bindless ? "bindless (descriptor indexing)" : "fallback (no descriptor indexing)") << Trace::Stop;
 
     uint32_t graphicsFamily = physical.pickQueueFamily(VK_QUEUE_GRAPHICS_BIT);
     uint32_t transferFamily = physical.pickQueueFamily(VK_QUEUE_TRANSFER_BIT);
@@ -1010,7 +2461,14 @@ namespace dw {
     if (computeFamily != graphicsFamily && computeFamily != transferFamily)
       queueList.push_back(std::make_pair(computeFamily, std::vector<float>({1})));
 
-    m_device = new LogicalDevice(physical, deviceLayers, deviceExtensions, queueList, features, features, false);
+    m_device = new LogicalDevice(physical,
+                                 deviceLayers,
+                                 deviceExtensions,
+                                 queueList,
+                                 features,
+                                 features,
+                                 false,
+                                 &timelineFeatures);
 
     m_graphicsQueue = new util::Ref<Queue>(m_device->getBestQueue(VK_QUEUE_GRAPHICS_BIT));
     if (!m_graphicsQueue->get().isValid())
@@ -1022,6 +2480,10 @@ namespace dw {
     m_computeQueue = new util::Ref<Queue>(m_device->getBestQueue(VK_QUEUE_COMPUTE_BIT));
     if (!m_computeQueue->get().isValid())
       throw std::runtime_error("no compute queue available");
+
+    namespace fs = std::filesystem;
+    m_pipelineCache = util::make_ptr<PipelineCache>(*m_device, fs::current_path() / "data" / "pipeline_cache.bin");
+    m_device->setPipelineCache(*m_pipelineCache);
   }
 
   /////////////////////////////////////////////////////////////////////////////
@@ -1038,7 +2500,11 @@ namespace dw {
   }
 
   void Renderer::setupSwapChain() {
-    m_swapchain = std::make_unique<Swapchain>(*m_device, *m_surface, *m_presentQueue);
+    m_swapchain = std::make_unique<Swapchain>(*m_device,
+                                              *m_surface,
+                                              *m_presentQueue,
+                                              m_presentSettings.mode,
+                                              m_presentSettings.imageCount);
   }
 
   void Renderer::setupCommandPools() {
@@ -1073,6 +2539,46 @@ namespace dw {
       throw std::runtime_error("Could not create sampler");
   }
 
+  void Renderer::setupDefaultTexture() {
+    MemoryAllocator allocator(m_device->getOwningPhysical());
+    m_defaultTexture = util::make_ptr<DependentImage>(*m_device);
+    m_defaultTexture->initImage(VK_IMAGE_TYPE_2D,
+                                VK_IMAGE_VIEW_TYPE_2D,
+                                VK_FORMAT_R8G8B8A8_UNORM,
+                                {1, 1, 1},
+                                VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                1,
+                                1,
+                                false,
+                                false,
+                                false,
+                                false);
+
+    m_defaultTexture->back(allocator, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_defaultTextureView = util::make_ptr<ImageView>(m_defaultTexture->createView());
+
+    CommandBuffer& clearBuff = m_graphicsCmdPool->allocateCommandBuffer();
+    clearBuff.start(true);
+
+    VkClearColorValue       white = {{1.f, 1.f, 1.f, 1.f}};
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    transitionImageLayout(clearBuff, *m_defaultTexture, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    vkCmdClearColorImage(clearBuff, *m_defaultTexture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &white, 1, &range);
+    transitionImageLayout(clearBuff,
+                          *m_defaultTexture,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    clearBuff.end();
+
+    // the frames come after it on the same queue
+    auto& graphicsQueue = m_graphicsQueue->get();
+    graphicsQueue.retire(graphicsQueue.submitOne(clearBuff), [pool = m_graphicsCmdPool, &clearBuff] {
+      pool->freeCommandBuffer(clearBuff);
+    });
+  }
+
   void Renderer::setupUniformBuffers() {
     VkDeviceSize cameraUniformSize = sizeof(CameraUniform);
 
@@ -1087,72 +2593,39 @@ namespace dw {
 
     m_gbuffer = util::make_ptr<Framebuffer>(*m_device, gbuffExtent);
 
-    for (uint32_t i = 0; i < RenderStep::NUM_EXPECTED_GBUFFER_IMAGES; ++i)
-      m_gbuffer->addImage(VK_IMAGE_ASPECT_COLOR_BIT,
-                          VK_IMAGE_TYPE_2D,
-                          VK_IMAGE_VIEW_TYPE_2D,
-                          VK_FORMAT_R32G32B32A32_SFLOAT,
-                          gbuffExtent,
-                          VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                          1,
-                          1,
-                          false,
-                          false,
-                          false,
-                          false);
-
-    m_gbuffer->addImage(VK_IMAGE_ASPECT_DEPTH_BIT,
-                        VK_IMAGE_TYPE_2D,
-                        VK_IMAGE_VIEW_TYPE_2D,
-                        VK_FORMAT_D32_SFLOAT,
-                        gbuffExtent,
-                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                        1,
-                        1,
-                        false,
-                        false,
-                        false,
-                        false);
+    // see gbuffer.glsl for what goes where
+    std::array<VkFormat, RenderStep::NUM_EXPECTED_GBUFFER_IMAGES> gbuffFormats = {
+      VK_FORMAT_R32G32B32A32_SFLOAT,
+      VK_FORMAT_R32G32B32A32_SFLOAT,
+      VK_FORMAT_R32G32B32A32_SFLOAT
+    };
+    uint32_t gbuffPixelBytes = 3 * 16;
+
+    if (m_gbufferLayout == GBufferLayout::Compact) {
+      // RG16 unorm can't be rendered to everywhere, half floats always can
+      VkFormat normalFormat = VK_FORMAT_R16G16_UNORM;
+      if (!(m_device->getOwningPhysical().getFormatProperties(normalFormat).optimalTilingFeatures
+            & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT))
+        normalFormat = VK_FORMAT_R16G16_SFLOAT;
 
-    m_globalLitFrameBuffer = util::make_ptr<Framebuffer>(*m_device, gbuffExtent);
+      gbuffFormats    = {VK_FORMAT_R8G8B8A8_UNORM, normalFormat, VK_FORMAT_R8G8B8A8_SRGB};
+      gbuffPixelBytes = 4 + 4 + 4;
+    }
+
+    Trace::Info << "G-buffer: " << (m_gbufferLayout == GBufferLayout::Compact ? "compact" : "full") << " layout, "
+      << gbuffPixelBytes << " + 4 depth bytes a pixel, "
+      << (static_cast<uint64_t>(gbuffPixelBytes + 4) * gbuffExtent.width * gbuffExtent.height >> 20) << "MB at "
+      << gbuffExtent.width << "x" << gbuffExtent.height << Trace::Stop;
 
-    m_globalLitFrameBuffer->addImage(VK_IMAGE_ASPECT_COLOR_BIT,
-                                     VK_IMAGE_TYPE_2D,
-                                     VK_IMAGE_VIEW_TYPE_2D,
-                                     VK_FORMAT_R8G8B8A8_UNORM,
-                                     gbuffExtent,
-                                     VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
-                                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                                     1,
-                                     1,
-                                     false,
-                                     false,
-                                     false,
-                                     false);
-
-    m_localLitFramebuffer = util::make_ptr<Framebuffer>(*m_device, gbuffExtent);
-    m_localLitFramebuffer->addImage(VK_IMAGE_ASPECT_COLOR_BIT,
-                                    VK_IMAGE_TYPE_2D,
-                                    VK_IMAGE_VIEW_TYPE_2D,
-                                    VK_FORMAT_R8G8B8A8_UNORM,
-                                    gbuffExtent,
-                                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
-                                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                                    1,
-                                    1,
-                                    false,
-                                    false,
-                                    false,
-                                    false);
-
-    m_ambientFramebuffer = util::make_ptr<Framebuffer>(*m_device, gbuffExtent);
-    m_ambientFramebuffer->addImage(VK_IMAGE_ASPECT_COLOR_BIT,
+    // Every image here is transient: the frame graph binds their memory, sharing it where their
+    // passes don't overlap
+    for (auto format : gbuffFormats)
+      m_gbuffer->addTransientImage(VK_IMAGE_ASPECT_COLOR_BIT,
                                    VK_IMAGE_TYPE_2D,
                                    VK_IMAGE_VIEW_TYPE_2D,
-                                   VK_FORMAT_R8G8B8A8_UNORM,
+                                   format,
                                    gbuffExtent,
-                                   VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
-                                   VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                                   VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
                                    1,
                                    1,
                                    false,
@@ -1160,12 +2633,89 @@ namespace dw {
                                    false,
                                    false);
 
+    m_gbuffer->addTransientImage(VK_IMAGE_ASPECT_DEPTH_BIT,
+                                 VK_IMAGE_TYPE_2D,
+                                 VK_IMAGE_VIEW_TYPE_2D,
+                                 VK_FORMAT_D32_SFLOAT,
+                                 gbuffExtent,
+                                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                 1,
+                                 1,
+                                 false,
+                                 false,
+                                 false,
+                                 false);
+
+    m_globalLitFrameBuffer = util::make_ptr<Framebuffer>(*m_device, gbuffExtent);
+
+    m_globalLitFrameBuffer->addTransientImage(VK_IMAGE_ASPECT_COLOR_BIT,
+                                              VK_IMAGE_TYPE_2D,
+                                              VK_IMAGE_VIEW_TYPE_2D,
+                                              VK_FORMAT_R8G8B8A8_UNORM,
+                                              gbuffExtent,
+                                              VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                                              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                                              1,
+                                              1,
+                                              false,
+                                              false,
+                                              false,
+                                              false);
+
+    // Local lighting's & ambient's are only attachments of the final step's render pass. FXAA
+    // samples local lighting's, so it's transient in the frame graph's sense. Nothing outside the
+    // pass touches ambient's, so on a tiler it never needs memory at all.
+    m_localLitView.reset();
+    m_localLitImage = util::make_ptr<DependentImage>(*m_device);
+    m_localLitImage->initImage(VK_IMAGE_TYPE_2D,
+                               VK_IMAGE_VIEW_TYPE_2D,
+                               VK_FORMAT_R8G8B8A8_UNORM,
+                               gbuffExtent,
+                               VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                               VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                               1,
+                               1,
+                               false,
+                               false,
+                               false,
+                               false);
+
+    m_ambientView.reset();
+    m_ambientImage = util::make_ptr<DependentImage>(*m_device);
+    m_ambientImage->initImage(VK_IMAGE_TYPE_2D,
+                              VK_IMAGE_VIEW_TYPE_2D,
+                              VK_FORMAT_R8G8B8A8_UNORM,
+                              gbuffExtent,
+                              VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                              1,
+                              1,
+                              false,
+                              false,
+                              false,
+                              false);
+
     MemoryAllocator allocator(m_device->getOwningPhysical());
+    VkMemoryPropertyFlags ambientMemory = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    if (!allocator.HasAppropriateMemType(m_ambientImage->getMemoryRequirements().memoryTypeBits, ambientMemory))
+      ambientMemory = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    m_ambientImage->back(allocator, ambientMemory);
+    m_ambientView = util::make_ptr<ImageView>(m_ambientImage->createView());
+  }
+
+  // The blur's scratch image, atlas-sized. It's transient, so the frame graph backs it & makes its
+  // view; the summed-area table doesn't need one.
+  void Renderer::setupBlurIntermediate() {
+    m_blurIntermediateView.reset();
+    m_blurIntermediate.reset();
+    if (m_atlasFilter == ShadowFilter::SummedArea)
+      return;
+
     m_blurIntermediate = util::make_ptr<DependentImage>(*m_device);
     m_blurIntermediate->initImage(VK_IMAGE_TYPE_2D,
                                   VK_IMAGE_VIEW_TYPE_2D,
-                                  VK_FORMAT_R32G32B32A32_SFLOAT,
-                                  SHADOW_DEPTH_MAP_EXTENT,
+                                  ShadowMapStep::MOMENT_FORMAT,
+                                  m_shadowAtlasExtent,
                                   VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
                                   1,
                                   1,
@@ -1173,28 +2723,31 @@ namespace dw {
                                   false,
                                   false,
                                   false);
-
-    m_blurIntermediate->back(allocator, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    m_blurIntermediateView = util::make_ptr<ImageView>(m_blurIntermediate->createView());
   }
 
   void Renderer::setupRenderSteps() {
+    // render passes & layouts are made here in order, the pipelines all at once at the end
+    std::vector<std::function<void()>> pipelines;
+
     m_splashScreenStep = util::make_ptr<SplashScreenStep>(*m_device, *m_graphicsCmdPool, m_swapchain->getNumImages());
 
     m_splashScreenStep->setupShaders();
     m_splashScreenStep->setupDescriptors();
     m_splashScreenStep->setupRenderPass({m_swapchain->getImages()[0]});
     m_splashScreenStep->setupPipelineLayout();
-    m_splashScreenStep->setupPipeline(m_swapchain->getImageSize());
+    pipelines.emplace_back([this]() { m_splashScreenStep->setupPipeline(m_swapchain->getImageSize()); });
 
-    m_geometryStep = util::make_ptr<GeometryStep>(*m_device, *m_graphicsCmdPool);
+    m_geometryStep = util::make_ptr<GeometryStep>(*m_device,
+                                                  *m_graphicsCmdPool,
+                                                  m_bindless,
+                                                  m_textureSlots,
+                                                  m_gbufferLayout);
 
     m_geometryStep->setupShaders();
     m_geometryStep->setupDescriptors();
     m_geometryStep->setupRenderPass({m_gbuffer->getImages().begin(), m_gbuffer->getImages().end()});
     m_geometryStep->setupPipelineLayout();
-    m_geometryStep->setupPipeline(m_swapchain->getImageSize());
+    pipelines.emplace_back([this]() { m_geometryStep->setupPipeline(m_swapchain->getImageSize()); });
 
     m_shadowMapStep = util::make_ptr<ShadowMapStep>(*m_device, *m_graphicsCmdPool);
 
@@ -1202,54 +2755,229 @@ namespace dw {
     m_shadowMapStep->setupDescriptors();
     m_shadowMapStep->setupRenderPass({}); // no images on purpose
     m_shadowMapStep->setupPipelineLayout();
-    m_shadowMapStep->setupPipeline({SHADOW_DEPTH_MAP_EXTENT.width, SHADOW_DEPTH_MAP_EXTENT.height});
+    pipelines.emplace_back([this]() { m_shadowMapStep->setupPipeline({m_shadowAtlasExtent.width, m_shadowAtlasExtent.height}); }); // viewport is per tile
 
-    m_blurStep = util::make_ptr<BlurStep>(*m_device, *m_computeCmdPool);
+    // the shadow filter's compute work goes on its own queue if it can, to run alongside graphics
+    CommandPool& filterPool = m_asyncCompute ? *m_computeCmdPool : *m_graphicsCmdPool;
+
+    m_blurStep = util::make_ptr<BlurStep>(*m_device, filterPool);
 
     m_blurStep->setupShaders();
     m_blurStep->setupDescriptors();
     m_blurStep->setupPipelineLayout();
-    m_blurStep->setupPipeline({});
+    pipelines.emplace_back([this]() { m_blurStep->setupPipeline({}); });
+
+    m_summedAreaStep = util::make_ptr<SummedAreaStep>(*m_device, filterPool);
+
+    m_summedAreaStep->setupShaders();
+    m_summedAreaStep->setupDescriptors();
+    m_summedAreaStep->setupPipelineLayout();
+    pipelines.emplace_back([this]() { m_summedAreaStep->setupPipeline({}); });
 
-    m_globalLightStep = util::make_ptr<GlobalLightStep>(*m_device, *m_graphicsCmdPool);
+    m_globalLightStep = util::make_ptr<GlobalLightStep>(*m_device, *m_graphicsCmdPool, m_gbufferLayout);
 
     m_globalLightStep->setupShaders();
     m_globalLightStep->setupDescriptors();
     m_globalLightStep->setupRenderPass({m_globalLitFrameBuffer->getImages()[0]});
     m_globalLightStep->setupPipelineLayout();
-    m_globalLightStep->setupPipeline(m_globalLitFrameBuffer->getExtent());
+    pipelines.emplace_back([this]() { m_globalLightStep->setupPipeline(m_globalLitFrameBuffer->getExtent()); });
 
-    m_localLightStep = util::make_ptr<LocalLightingStep>(*m_device, *m_graphicsCmdPool);
+    // local lighting & ambient are subpasses of the final step's render pass
+    m_finalStep = util::make_ptr<FinalStep>(*m_device, *m_graphicsCmdPool, m_swapchain->getNumImages());
+
+    m_finalStep->setupShaders();
+    m_finalStep->setupDescriptors();
+    m_finalStep->setupRenderPass({m_swapchain->getImages()[0],
+                                  m_globalLitFrameBuffer->getImages()[0],
+                                  *m_localLitImage,
+                                  *m_ambientImage});
+    m_finalStep->setupPipelineLayout();
+    pipelines.emplace_back([this]() { m_finalStep->setupPipeline(m_swapchain->getImageSize()); });
+
+    m_localLightStep = util::make_ptr<LocalLightingStep>(*m_device, m_gbufferLayout);
 
     m_localLightStep->setupShaders();
     m_localLightStep->setupDescriptors();
-    m_localLightStep->setupRenderPass({m_localLitFramebuffer->getImages()[0]});
+    m_localLightStep->setupRenderPass(m_finalStep->m_pass, FinalStep::LOCAL_LIGHTING_SUBPASS);
     m_localLightStep->setupPipelineLayout();
-    m_localLightStep->setupPipeline(m_localLitFramebuffer->getExtent());
+    pipelines.emplace_back([this]() { m_localLightStep->setupPipeline(m_swapchain->getImageSize()); });
 
-    m_ambientStep = util::make_ptr<AmbientStep>(*m_device, *m_graphicsCmdPool);
+    m_ambientStep = util::make_ptr<AmbientStep>(*m_device, m_gbufferLayout);
 
     m_ambientStep->setupShaders();
     m_ambientStep->setupDescriptors();
-    m_ambientStep->setupRenderPass({m_ambientFramebuffer->getImages()[0]});
+    m_ambientStep->setupRenderPass(m_finalStep->m_pass, FinalStep::AMBIENT_SUBPASS);
     m_ambientStep->setupPipelineLayout();
-    m_ambientStep->setupPipeline(m_ambientFramebuffer->getExtent());
+    pipelines.emplace_back([this]() { m_ambientStep->setupPipeline(m_swapchain->getImageSize()); });
 
-    m_finalStep = util::make_ptr<FinalStep>(*m_device, *m_graphicsCmdPool, m_swapchain->getNumImages());
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms    = std::chrono::duration<double, std::milli>;
 
-    m_finalStep->setupShaders();
-    m_finalStep->setupDescriptors();
-    m_finalStep->setupRenderPass({m_swapchain->getImages()[0]});
-    m_finalStep->setupPipelineLayout();
-    m_finalStep->setupPipeline(m_swapchain->getImageSize());
+    const auto start = Clock::now();
+    runParallel(pipelines);
+
+    Trace::Info << "Created " << pipelines.size() << " steps' pipelines in "
+                << Ms(Clock::now() - start).count() << "ms ("
+                << m_pipelineCache->getLoadedBytes() << " bytes of pipeline cache loaded)" << Trace::Stop;
   }
 
-  void Renderer::setupFrameBuffers() const {
+  // What each pass reads & writes, in an order they could run in; the graph submits the shadow
+  // maps & filter first so the compute queue filters while graphics fills the g-buffer. Memory can
+  // only be bound to an image once, so rebuilding the graph makes new transient images, and
+  // framebuffers for them.
+  void Renderer::setupFrameGraph() {
+    if (m_frameGraph) {
+      setupFrameBufferImages();
+      m_frameGraph.reset();
+    }
+
+    setupBlurIntermediate();
+
+    m_frameGraph = util::make_ptr<RenderGraph>(*m_device);
+    auto& graph  = *m_frameGraph;
+    graph.setTiming(m_frameTiming);
+
+    Queue&       graphics    = m_graphicsQueue->get();
+    Queue&       compute     = m_asyncCompute ? m_computeQueue->get() : graphics;
+    CommandPool& computePool = m_asyncCompute ? *m_computeCmdPool : *m_graphicsCmdPool;
+
+    constexpr VkPipelineStageFlags attachment = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    constexpr VkPipelineStageFlags depthTests = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+                                                | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    constexpr VkPipelineStageFlags fragment   = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    constexpr VkPipelineStageFlags shadows    = VK_PIPELINE_STAGE_TRANSFER_BIT | depthTests | attachment;
+    constexpr VkPipelineStageFlags filter     = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    // Images
+    auto& gbuffImages = m_gbuffer->getImages();
+
+    std::vector<RenderGraph::Handle> gbuffer;
+    for (size_t i = 0; i + 1 < gbuffImages.size(); ++i)
+      gbuffer.push_back(graph.addTransientImage("g-buffer " + std::to_string(i),
+                                                gbuffImages[i],
+                                                VK_IMAGE_ASPECT_COLOR_BIT));
+
+    auto gbuffDepth = graph.addTransientImage("g-buffer depth", gbuffImages.back(), VK_IMAGE_ASPECT_DEPTH_BIT);
+    auto globalLit  = graph.addTransientImage("global lighting",
+                                              m_globalLitFrameBuffer->getImages().front(),
+                                              VK_IMAGE_ASPECT_COLOR_BIT);
+    auto localLit   = graph.addTransientImage("local lighting", *m_localLitImage, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    auto atlas       = graph.addImage("shadow atlas", m_shadowAtlas->getImages().front(), VK_IMAGE_ASPECT_COLOR_BIT);
+    auto atlasDepth  = graph.addImage("shadow atlas depth",
+                                      m_shadowAtlas->getImages().back(),
+                                      VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
+    auto staticAtlas = graph.addImage("static shadow atlas",
+                                      m_staticShadowAtlas->getImages().front(),
+                                      VK_IMAGE_ASPECT_COLOR_BIT);
+    auto staticDepth = graph.addImage("static shadow atlas depth",
+                                      m_staticShadowAtlas->getImages().back(),
+                                      VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
+    auto table       = graph.addImage("summed-area table", *m_shadowSAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    auto readGBuffer = [&](RenderGraph::Handle pass) {
+      for (auto image : gbuffer)
+        graph.read(pass, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, fragment);
+      graph.read(pass, gbuffDepth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, fragment);
+    };
+
+    // Passes; every render pass clears what it draws to
+    m_geometryPass = graph.addPass("geometry", graphics, *m_graphicsCmdPool);
+    for (auto image : gbuffer)
+      graph.write(m_geometryPass,
+                  image,
+                  VK_IMAGE_LAYOUT_UNDEFINED,
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                  attachment);
+    graph.write(m_geometryPass,
+                gbuffDepth,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                depthTests);
+
+    // copies each map's static layer over from its copy, then draws over it
+    m_shadowPass = graph.addPass("shadow maps", graphics, *m_graphicsCmdPool);
+    graph.write(m_shadowPass,
+                atlas,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                shadows);
+    graph.write(m_shadowPass,
+                atlasDepth,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                shadows);
+    graph.write(m_shadowPass,
+                staticAtlas,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                shadows);
+    graph.write(m_shadowPass,
+                staticDepth,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                shadows);
+
+    // both filters take the atlas to general & back themselves
+    bool summedArea = m_atlasFilter == ShadowFilter::SummedArea;
+    m_filterPass    = graph.addPass(summedArea ? "summed-area table" : "blur", compute, computePool);
+    graph.write(m_filterPass,
+                atlas,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                filter);
+
+    if (summedArea)
+      graph.write(m_filterPass, table, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, filter);
+    else
+      graph.write(m_filterPass,
+                  graph.addTransientImage("blur intermediate", *m_blurIntermediate, VK_IMAGE_ASPECT_COLOR_BIT),
+                  VK_IMAGE_LAYOUT_UNDEFINED,
+                  VK_IMAGE_LAYOUT_GENERAL,
+                  filter);
+
+    m_globalLightPass = graph.addPass("global lighting", graphics, *m_graphicsCmdPool);
+    readGBuffer(m_globalLightPass);
+    graph.read(m_globalLightPass, atlas, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, fragment);
+    graph.read(m_globalLightPass, table, VK_IMAGE_LAYOUT_GENERAL, fragment);
+    graph.write(m_globalLightPass,
+                globalLit,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                attachment);
+
+    // local lighting, ambient & FXAA in one render pass, which takes global lighting's image to
+    // an input attachment & local lighting's through to shader read itself. Ambient's image
+    // never leaves it, so the graph doesn't know about it.
+    m_finalPass = graph.addPass("final", graphics, *m_graphicsCmdPool);
+    readGBuffer(m_finalPass);
+    graph.write(m_finalPass,
+                globalLit,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                fragment);
+    graph.write(m_finalPass,
+                localLit,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                attachment | fragment);
+
+    graph.compile();
+
     m_gbuffer->finalize(m_geometryStep->getRenderPass());
     m_globalLitFrameBuffer->finalize(m_globalLightStep->getRenderPass());
-    m_localLitFramebuffer->finalize(m_localLightStep->getRenderPass());
-    m_ambientFramebuffer->finalize(m_ambientStep->getRenderPass());
+    m_localLitView = util::make_ptr<ImageView>(m_localLitImage->createView());
+
+    if (m_blurIntermediate)
+      m_blurIntermediateView = util::make_ptr<ImageView>(m_blurIntermediate->createView());
+
+    setupFrameBuffers();
+  }
 
+  // The swapchain's, for the final step & the splash screen. The final step's render pass has
+  // global & local lighting's and ambient's images too, so these are made by setupFrameGraph(),
+  // once they have memory.
+  void Renderer::setupFrameBuffers() {
     // this is preferred when we are only using a color attachment on the output
     // framebuffers, e.g., when you are just rendering a FSQ to do the final lighting pass
     // and the backbuffer is just the final location in the rendering chain.
@@ -1259,11 +2987,24 @@ namespace dw {
     std::vector<Framebuffer> framebuffers;
     framebuffers.reserve(m_swapchain->getNumImages());
 
+    m_splashFramebuffers.clear();
+    m_splashFramebuffers.reserve(m_swapchain->getNumImages());
+
+    VkExtent2D imageSize = m_swapchain->getImageSize();
+    VkExtent3D extent    = {imageSize.width, imageSize.height, 1};
+
     for (size_t i = 0; i < m_swapchain->getNumImages(); ++i) {
-      framebuffers.emplace_back(*m_device,
-                                m_finalStep->getRenderPass(),
-                                std::vector<VkImageView>{m_swapchain->getViews()[i]},
-                                VkExtent3D{m_surface->getWidth(), m_surface->getHeight(), 1});
+      std::vector<VkImageView> views(FinalStep::atCount);
+      views[FinalStep::atSwapchain] = m_swapchain->getViews()[i];
+      views[FinalStep::atGlobalLit] = m_globalLitFrameBuffer->getImageViews().front();
+      views[FinalStep::atLocalLit]  = *m_localLitView;
+      views[FinalStep::atAmbient]   = *m_ambientView;
+
+      framebuffers.emplace_back(*m_device, m_finalStep->getRenderPass(), views, extent);
+      m_splashFramebuffers.emplace_back(*m_device,
+                                        m_splashScreenStep->getRenderPass(),
+                                        std::vector<VkImageView>{m_swapchain->getViews()[i]},
+                                        extent);
     }
 
     m_swapchain->setFramebuffers(std::move(framebuffers));
@@ -1278,24 +3019,10 @@ namespace dw {
     }
 
     transBuff.end();
-    m_transferQueue->get().submitOne(transBuff);
-    m_transferQueue->get().waitIdle();
-
-    m_transferCmdPool->freeCommandBuffer(transBuff);
-
-    CommandBuffer& graphicsBuff = m_graphicsCmdPool->allocateCommandBuffer();
-    graphicsBuff.start(true);
-
-    const Image& depthImage = dynamic_cast<const Image&>(m_gbuffer->getImages().back());
-    transitionImageLayout(graphicsBuff,
-                          depthImage,
-                          VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-
-    graphicsBuff.end();
-    m_graphicsQueue->get().submitOne(graphicsBuff);
-    m_graphicsQueue->get().waitIdle();
 
-    m_graphicsCmdPool->freeCommandBuffer(graphicsBuff);
+    auto& transferQueue = m_transferQueue->get();
+    transferQueue.retire(transferQueue.submitOne(transBuff), [pool = m_transferCmdPool, &transBuff] {
+      pool->freeCommandBuffer(transBuff);
+    });
   }
 }
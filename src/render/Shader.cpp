@@ -21,8 +21,18 @@
 #include "util/Trace.h"
 #include <fstream>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 namespace dw {
+  namespace {
+    using ShaderKey = std::tuple<VkDevice, ShaderStage, std::string>;
+
+    std::mutex                                  s_shaderCacheLock;
+    std::map<ShaderKey, std::weak_ptr<IShader>> s_shaderCache;
+  }
+
   ShaderModule::ShaderModule(LogicalDevice& device, std::vector<char> const& spirv_binary)
     : m_device(device) {
 
@@ -55,7 +65,11 @@ namespace dw {
     namespace fs = std::filesystem;
 
     std::fstream file;
+#ifdef DW_SHADER_DIR
+    fs::path shaderFolder = DW_SHADER_DIR;
+#else
     fs::path shaderFolder = fs::current_path() / fs::path("data") / "shaders" / "spv";
+#endif
     Trace::All << "Loading shader: " << shaderFolder << " : " << shaderFolder / filename << Trace::Stop;
 
     file.open(shaderFolder / filename, std::ios_base::in | std::ios_base::ate | std::ios_base::binary);
@@ -92,5 +106,22 @@ namespace dw {
     return {};
   }
 
+  util::ptr<IShader> detail::LoadCachedShader(LogicalDevice&                             device,
+                                              ShaderStage                                stage,
+                                              std::string const&                         filename,
+                                              std::function<util::ptr<IShader>()> const& create) {
+    std::lock_guard<std::mutex> lock(s_shaderCacheLock);
+
+    auto& cached = s_shaderCache[ShaderKey{device, stage, filename}];
+    if (auto shader = cached.lock()) {
+      Trace::All << "Sharing loaded shader: " << filename << Trace::Stop;
+      return shader;
+    }
+
+    auto shader = create();
+    cached = shader;
+    return shader;
+  }
+
 
 }
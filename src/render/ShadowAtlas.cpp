@@ -0,0 +1,113 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : ShadowAtlas.cpp
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 10d
+// * Last Altered: 2020y 03m 10d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+
+#include "render/ShadowAtlas.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace dw {
+  void ShadowAtlas::reset(uint32_t size, uint32_t minTile) {
+    assert(size && minTile && minTile <= size);
+    m_size = size;
+
+    uint32_t levels = 1;
+    while ((size >> levels) >= minTile)
+      ++levels;
+
+    m_free.assign(levels, {});
+    m_free.front().push_back({0, 0});
+  }
+
+  bool ShadowAtlas::allocate(uint32_t size, Tile& tile) {
+    uint32_t level = getLevel(size);
+    if (level > getMaxLevel() || getTileSize(level) != size)
+      return false;
+
+    // the smallest free tile that it fits in
+    uint32_t from = level + 1;
+    while (from > 0 && m_free[from - 1].empty())
+      --from;
+
+    if (from == 0)
+      return false;
+    --from;
+
+    auto& candidates = m_free[from];
+    auto  nearest    = std::min_element(candidates.begin(), candidates.end(), [](Node const& a, Node const& b) {
+      return a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
+
+    Node node = *nearest;
+    candidates.erase(nearest);
+
+    // keep the first quarter each time down, free the other three
+    for (uint32_t l = from; l < level; ++l) {
+      uint32_t half = getTileSize(l + 1);
+      m_free[l + 1].push_back({node.x + half, node.y});
+      m_free[l + 1].push_back({node.x, node.y + half});
+      m_free[l + 1].push_back({node.x + half, node.y + half});
+    }
+
+    tile = {node.x, node.y, size};
+    return true;
+  }
+
+  void ShadowAtlas::release(Tile const& tile) {
+    if (!tile.size)
+      return;
+
+    uint32_t level = getLevel(tile.size);
+    Node     node  = {tile.x, tile.y};
+
+    while (level > 0) {
+      uint32_t size   = getTileSize(level);
+      Node     parent = {node.x & ~(2 * size - 1), node.y & ~(2 * size - 1)};
+      auto&    free   = m_free[level];
+
+      auto isSibling = [&](Node const& n) {
+        return (n.x == parent.x || n.x == parent.x + size)
+               && (n.y == parent.y || n.y == parent.y + size)
+               && !(n.x == node.x && n.y == node.y);
+      };
+
+      if (std::count_if(free.begin(), free.end(), isSibling) < 3)
+        break;
+
+      free.erase(std::remove_if(free.begin(), free.end(), isSibling), free.end());
+      node = parent;
+      --level;
+    }
+
+    m_free[level].push_back(node);
+  }
+
+  uint32_t ShadowAtlas::getTileSize(uint32_t level) const {
+    return m_size >> level;
+  }
+
+  uint32_t ShadowAtlas::getLevel(uint32_t tileSize) const {
+    uint32_t level = 0;
+    while (level < 31 && (m_size >> level) > tileSize)
+      ++level;
+    return level;
+  }
+
+  uint32_t ShadowAtlas::getMaxLevel() const {
+    return static_cast<uint32_t>(m_free.size()) - 1;
+  }
+
+  uint32_t ShadowAtlas::getSize() const {
+    return m_size;
+  }
+}
@@ -0,0 +1,127 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : ShadowCascades.cpp
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 10d
+// * Last Altered: 2020y 03m 10d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+
+#include "render/ShadowCascades.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace dw {
+  void ShadowCascades::ComputeSplits(float nearDist, float farDist, uint32_t count, float lambda, float* splits) {
+    for (uint32_t i = 0; i <= count; ++i) {
+      float t            = static_cast<float>(i) / count;
+      float logSplit     = nearDist * std::pow(farDist / nearDist, t);
+      float uniformSplit = nearDist + (farDist - nearDist) * t;
+      splits[i]          = lambda * logSplit + (1.f - lambda) * uniformSplit;
+    }
+
+    // exact ends, whatever the rounding above did
+    splits[0]     = nearDist;
+    splits[count] = farDist;
+  }
+
+  void ShadowCascades::fit(glm::vec3 const& eye,
+                           glm::vec3 const& forward,
+                           float            fovY,
+                           float            aspect,
+                           float            nearDist,
+                           float            farDist,
+                           glm::vec3 const& lightDir,
+                           uint32_t         count,
+                           float            lambda,
+                           uint32_t const*  resolutions) {
+    m_count = std::min(std::max(count, 1u), MAX_CASCADES);
+
+    // rotation only, so moving the camera slides the cascades over a fixed texel grid
+    glm::vec3 dir = glm::normalize(lightDir);
+    glm::vec3 up  = std::abs(dir.z) > 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(0, 0, 1);
+    m_lightView   = glm::lookAt(glm::vec3(0), dir, up);
+
+    float splits[MAX_CASCADES + 1];
+    ComputeSplits(nearDist, farDist, m_count, lambda, splits);
+
+    // a slice's corners at view depth d are d * k from the view axis
+    float k  = std::tan(fovY * 0.5f) * std::sqrt(1.f + aspect * aspect);
+    float k2 = k * k;
+
+    for (uint32_t i = 0; i < m_count; ++i) {
+      auto& cascade = m_cascades[i];
+      float dn      = splits[i];
+      float df      = splits[i + 1];
+
+      // smallest sphere centered on the view axis through all eight corners
+      float s      = std::min((dn + df) * (1.f + k2) * 0.5f, df);
+      float radius = std::max(std::sqrt((s - dn) * (s - dn) + dn * dn * k2),
+                              std::sqrt((df - s) * (df - s) + df * df * k2));
+
+      // rounded up so float noise can't resize it from frame to frame
+      radius = std::ceil(radius * 16.f) / 16.f;
+
+      glm::vec3 center = m_lightView * glm::vec4(eye + forward * s, 1.f);
+
+      float texel = 2.f * radius / static_cast<float>(std::max(resolutions[i], 1u));
+      center.x    = std::floor(center.x / texel) * texel;
+      center.y    = std::floor(center.y / texel) * texel;
+
+      cascade.view      = m_lightView;
+      cascade.splitNear = dn;
+      cascade.splitFar  = df;
+      cascade.center    = center;
+      cascade.radius    = radius;
+
+      // looking down -z; depth along the light is -z
+      cascade.nearDepth = -center.z - radius;
+      cascade.farDepth  = -center.z + radius;
+    }
+  }
+
+  bool ShadowCascades::addCaster(uint32_t cascade, glm::vec4 const& sphere) {
+    assert(cascade < m_count);
+    auto& c = m_cascades[cascade];
+
+    glm::vec3 center = m_lightView * glm::vec4(glm::vec3(sphere), 1.f);
+    float     reach  = c.radius + sphere.w;
+
+    if (std::abs(center.x - c.center.x) > reach || std::abs(center.y - c.center.y) > reach)
+      return false;
+
+    // entirely behind the receivers
+    float depth = -center.z;
+    if (depth - sphere.w > c.farDepth)
+      return false;
+
+    c.nearDepth = std::min(c.nearDepth, depth - sphere.w);
+    return true;
+  }
+
+  void ShadowCascades::finish(uint32_t cascade) {
+    assert(cascade < m_count);
+    auto& c = m_cascades[cascade];
+    c.proj  = glm::ortho(c.center.x - c.radius,
+                         c.center.x + c.radius,
+                         c.center.y - c.radius,
+                         c.center.y + c.radius,
+                         c.nearDepth,
+                         c.farDepth);
+  }
+
+  uint32_t ShadowCascades::size() const {
+    return m_count;
+  }
+
+  ShadowCascades::Cascade const& ShadowCascades::operator[](uint32_t i) const {
+    assert(i < m_count);
+    return m_cascades[i];
+  }
+}
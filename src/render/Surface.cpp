@@ -39,6 +39,10 @@ namespace dw {
     return m_capabilities;
   }
 
+  void Surface::updateCapabilities() {
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physical, m_surface, &m_capabilities);
+  }
+
   std::vector<VkSurfaceFormatKHR> const& Surface::getFormats() const {
     return m_formats;
   }
@@ -68,9 +72,9 @@ namespace dw {
     return m_formats.front();
   }
 
-  VkPresentModeKHR Surface::choosePresentMode(bool vsync) const {
+  VkPresentModeKHR Surface::choosePresentMode(VkPresentModeKHR preferred) const {
     for(auto& mode : m_presentModes) {
-      if (mode == (vsync ? VK_PRESENT_MODE_FIFO_RELAXED_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR))
+      if (mode == preferred)
         return mode;
     }
 
@@ -78,6 +82,17 @@ namespace dw {
     return VK_PRESENT_MODE_FIFO_KHR;
   }
 
+  uint32_t Surface::chooseImageCount(uint32_t requested) const {
+    uint32_t count = requested ? requested : m_capabilities.minImageCount + 1;
+    count = std::max({ count, m_capabilities.minImageCount, 2u });
+
+    // a max of 0 means there isn't one
+    if (m_capabilities.maxImageCount)
+      count = std::min(count, m_capabilities.maxImageCount);
+
+    return count;
+  }
+
   VkExtent2D Surface::chooseExtent() const {
     if (m_capabilities.currentExtent.width != UINT32_MAX) {
       return m_capabilities.currentExtent;
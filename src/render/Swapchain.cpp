@@ -15,32 +15,53 @@
 #include "render/Image.h"
 #include "render/Queue.h"
 #include "render/Framebuffer.h"
+#include "util/Trace.h"
 
 #include <stdexcept>
 
 namespace dw {
-  Swapchain::Swapchain(LogicalDevice& device, Surface& surface, util::Ref<Queue> q)
+  Swapchain::Swapchain(LogicalDevice& device,
+                       Surface& surface,
+                       util::Ref<Queue> q,
+                       VkPresentModeKHR presentMode,
+                       uint32_t imageCount)
     : m_device(device),
       m_surface(surface),
-      m_queue(q) {
+      m_queue(q),
+      m_requestedMode(presentMode),
+      m_requestedImages(imageCount) {
 
     createSemaphores();
     restart();
   }
 
+  void Swapchain::setPresentMode(VkPresentModeKHR presentMode, uint32_t imageCount) {
+    m_requestedMode   = presentMode;
+    m_requestedImages = imageCount;
+  }
+
   void Swapchain::restart() {
+    m_surface.updateCapabilities();
+
     VkSurfaceFormatKHR format = m_surface.chooseFormat();
-    VkPresentModeKHR   mode   = m_surface.choosePresentMode(false);
+    VkPresentModeKHR   mode   = m_surface.choosePresentMode(m_requestedMode);
     VkExtent2D         extent = m_surface.chooseExtent();
 
+    if (mode != m_requestedMode)
+      Trace::Warn << "Present mode " << m_requestedMode << " isn't supported, using FIFO" << Trace::Stop;
+
     m_imageFormat = format.format;
+    m_extent      = extent;
+    m_presentMode = mode;
+
+    VkSwapchainKHR oldSwapchain = m_swapchain;
 
     VkSwapchainCreateInfoKHR createInfo = {
       VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
       nullptr,
       0,
       m_surface,
-      m_surface.getCapabilities().minImageCount + 1,
+      m_surface.chooseImageCount(m_requestedImages),
       format.format,
       format.colorSpace,
       extent,
@@ -53,10 +74,22 @@ namespace dw {
       VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
       mode,
       VK_TRUE,
-      m_swapchain
+      oldSwapchain
     };
 
-    vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapchain);
+    if (vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapchain) != VK_SUCCESS || !m_swapchain)
+      throw std::runtime_error("Could not create swapchain");
+
+    // the old one's retired by the create, it only has to be destroyed along with its images
+    m_framebuffers.clear();
+    m_views.clear();
+    m_images.clear();
+
+    if (oldSwapchain)
+      vkDestroySwapchainKHR(m_device, oldSwapchain, nullptr);
+
+    m_outOfDate = false;
+    m_nextImage = 0;
 
     queryImages();
     createViews();
@@ -98,7 +131,7 @@ namespace dw {
       m_framebuffers.emplace_back(m_device,
                                   renderPass,
                                   std::vector<VkImageView>({view}),
-                                  VkExtent3D{m_surface.getWidth(), m_surface.getHeight(), 1});
+                                  VkExtent3D{m_extent.width, m_extent.height, 1});
     }
   }
 
@@ -116,7 +149,12 @@ namespace dw {
 
 
   uint32_t Swapchain::getNextImageIndex() {
-    vkAcquireNextImageKHR(m_device, m_swapchain, 100, m_nextImageSemaphore, nullptr, &m_nextImage);
+    // blocks until the presentation engine hands an image back, which under FIFO is what paces the
+    // CPU to the display. A timeout would return without one & leave the last frame's index.
+    VkResult result = vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, m_nextImageSemaphore, nullptr, &m_nextImage);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+      m_outOfDate = true; // nothing was acquired; a suboptimal image still is, and present() says so
+
     return m_nextImage;
   }
 
@@ -144,7 +182,7 @@ namespace dw {
     present(m_queue);
   }
 
-  void Swapchain::present(Queue const& q) const {
+  void Swapchain::present(Queue const& q) {
     VkResult         out_result  = VK_SUCCESS;
     VkPresentInfoKHR presentInfo = {
       VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -157,7 +195,13 @@ namespace dw {
       &out_result
     };
 
-    if (vkQueuePresentKHR(q, &presentInfo) != VK_SUCCESS || out_result != VK_SUCCESS)
+    VkResult result = vkQueuePresentKHR(q, &presentInfo);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+      m_outOfDate = true;
+      return;
+    }
+
+    if (result != VK_SUCCESS || out_result != VK_SUCCESS)
       throw std::runtime_error("Error while presenting");
   }
 
@@ -188,8 +232,12 @@ namespace dw {
     return m_images.size();
   }
 
+  VkPresentModeKHR Swapchain::getPresentMode() const {
+    return m_presentMode;
+  }
+
   VkExtent2D Swapchain::getImageSize() const {
-    return {m_surface.getWidth(), m_surface.getHeight()};
+    return m_extent;
   }
 
   VkFormat Swapchain::getImageFormat() const {
@@ -200,6 +248,10 @@ namespace dw {
     return m_views[m_nextImage];
   }
 
+  bool Swapchain::isOutOfDate() const {
+    return m_outOfDate;
+  }
+
   bool Swapchain::isPresentReady() const {
     return !m_images.empty()
            && m_views.size() == m_images.size()
@@ -27,6 +27,30 @@ namespace dw {
   // Texture Manager
   void TextureManager::clear() {
     m_loadedTextures.clear();
+    m_freeSlots.clear();
+    m_nextSlot = 0;
+  }
+
+  void TextureManager::unload(TexKey const& key) {
+    auto iter = m_loadedTextures.find(key);
+    if (iter == m_loadedTextures.end())
+      return;
+
+    m_freeSlots.push_back(iter->second->m_slot);
+    m_loadedTextures.erase(iter);
+  }
+
+  uint32_t TextureManager::getSlotCount() const {
+    return m_nextSlot;
+  }
+
+  uint32_t TextureManager::allocateSlot() {
+    if (m_freeSlots.empty())
+      return m_nextSlot++;
+
+    uint32_t slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    return slot;
   }
 
   util::ptr<Texture> TextureManager::getTexture(TexKey key) {
@@ -52,6 +76,7 @@ namespace dw {
       util::ptr<Texture> tex = util::make_ptr<Texture>();
       tex->m_raw = util::make_ptr<Texture::RawImage>();
       tex->m_raw->Load(filename);
+      tex->m_slot = allocateSlot();
 
       return m_loadedTextures.insert_or_assign(filepath.filename().generic_string(), tex).first;
     }
@@ -156,7 +181,8 @@ namespace dw {
   Texture::Texture(Texture&& o) noexcept
     : m_raw(std::move(o.m_raw)),
       m_image(std::move(o.m_image)),
-      m_view(std::move(o.m_view)){
+      m_view(std::move(o.m_view)),
+      m_slot(o.m_slot) {
     m_raw.reset();
     m_image.reset();
     m_view.reset();
@@ -170,6 +196,10 @@ namespace dw {
     return m_view;
   }
 
+  uint32_t Texture::getSlot() const {
+    return m_slot;
+  }
+
   bool Texture::isLoaded() const {
     return m_raw == nullptr;
   }
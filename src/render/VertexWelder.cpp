@@ -0,0 +1,278 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : VertexWelder.cpp
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 06d
+// * Last Altered: 2020y 03m 06d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+
+#include "render/VertexWelder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <ostream>
+
+namespace dw {
+  namespace {
+    constexpr uint32_t EMPTY = ~0u;
+
+    // hashing & comparing walks the vertex as a flat run of floats
+    constexpr size_t VERTEX_FLOATS = sizeof(Vertex) / sizeof(float);
+    static_assert(sizeof(Vertex) == VERTEX_FLOATS * sizeof(float), "Vertex must be tightly packed floats");
+
+    inline const float* Floats(Vertex const& v) {
+      return &v.pos.x;
+    }
+
+    // + 0.f turns -0 into +0, so the two hash the same like they compare the same
+    inline uint32_t Bits(float f) {
+      f += 0.f;
+      uint32_t bits;
+      memcpy(&bits, &f, sizeof(bits));
+      return bits;
+    }
+
+    // splitmix64's finalizer; every input bit reaches the low bits used as the slot
+    inline uint64_t Mix(uint64_t h) {
+      h ^= h >> 30;
+      h *= 0xbf58476d1ce4e5b9ull;
+      h ^= h >> 27;
+      h *= 0x94d049bb133111ebull;
+      h ^= h >> 31;
+      return h;
+    }
+
+    uint64_t Hash(Vertex const& v) {
+      const float* f = Floats(v);
+      uint64_t     h = 0x9e3779b97f4a7c15ull;
+
+      for (size_t i = 0; i < VERTEX_FLOATS; i += 2) {
+        uint64_t word = Bits(f[i]);
+        if (i + 1 < VERTEX_FLOATS)
+          word |= static_cast<uint64_t>(Bits(f[i + 1])) << 32;
+
+        h = Mix(h ^ word);
+      }
+
+      return h;
+    }
+
+    bool Equal(Vertex const& a, Vertex const& b) {
+      const float* fa = Floats(a);
+      const float* fb = Floats(b);
+
+      for (size_t i = 0; i < VERTEX_FLOATS; ++i) {
+        if (fa[i] != fb[i])
+          return false;
+      }
+
+      return true;
+    }
+
+    // at most half full, so probes stay short
+    size_t TableSize(size_t count) {
+      size_t size = 16;
+      while (size < count * 2)
+        size <<= 1;
+      return size;
+    }
+
+    struct Cell {
+      int32_t  x, y, z;
+      uint32_t head{EMPTY}; // first vertex in the cell, EMPTY if the slot is unused
+    };
+
+    // Spatial hash used for the epsilon weld. Cells are epsilon wide, so anything within
+    // epsilon of a vertex is in its cell or one of the 26 around it.
+    class CellTable {
+    public:
+      CellTable(size_t count, float cellSize)
+        : m_cells(TableSize(count)), m_mask(m_cells.size() - 1), m_invCellSize(1.f / cellSize) {
+      }
+
+      void cellOf(glm::vec3 const& pos, int32_t& x, int32_t& y, int32_t& z) const {
+        constexpr float LIMIT = static_cast<float>(std::numeric_limits<int32_t>::max() / 2);
+        x = static_cast<int32_t>(std::floor(std::clamp(pos.x * m_invCellSize, -LIMIT, LIMIT)));
+        y = static_cast<int32_t>(std::floor(std::clamp(pos.y * m_invCellSize, -LIMIT, LIMIT)));
+        z = static_cast<int32_t>(std::floor(std::clamp(pos.z * m_invCellSize, -LIMIT, LIMIT)));
+      }
+
+      // the cell's slot; unused (head == EMPTY) if nothing has been put in it
+      Cell& find(int32_t x, int32_t y, int32_t z) {
+        uint64_t key  = (static_cast<uint64_t>(static_cast<uint32_t>(x)) * 73856093u)
+                        ^ (static_cast<uint64_t>(static_cast<uint32_t>(y)) * 19349663u)
+                        ^ (static_cast<uint64_t>(static_cast<uint32_t>(z)) * 83492791u);
+        size_t   slot = Mix(key) & m_mask;
+
+        while (m_cells[slot].head != EMPTY
+               && (m_cells[slot].x != x || m_cells[slot].y != y || m_cells[slot].z != z))
+          slot = (slot + 1) & m_mask;
+
+        return m_cells[slot];
+      }
+
+    private:
+      std::vector<Cell> m_cells;
+      size_t            m_mask;
+      float             m_invCellSize;
+    };
+
+    bool Close(Vertex const& a, Vertex const& b, VertexWelder::Options const& options) {
+      const float posEps2  = options.positionEpsilon * options.positionEpsilon;
+      const float normEps2 = options.normalEpsilon * options.normalEpsilon;
+      const float uvEps2   = options.texCoordEpsilon * options.texCoordEpsilon;
+
+      return glm::length2(a.pos - b.pos) <= posEps2
+             && glm::length2(a.normal - b.normal) <= normEps2
+             && glm::length2(a.tangent - b.tangent) <= normEps2
+             && glm::length2(a.bitangent - b.bitangent) <= normEps2
+             && glm::length2(a.texCoord - b.texCoord) <= uvEps2
+             && a.color == b.color;
+    }
+  }
+
+  VertexWelder::Stats VertexWelder::Weld(std::vector<Vertex>&   vertices,
+                                         std::vector<uint32_t>& indices,
+                                         Options const&         options) {
+    Stats stats;
+    stats.inputVertices = vertices.size();
+
+    if (vertices.empty()) {
+      stats.outputVertices = 0;
+      return stats;
+    }
+
+    // 1. exact: open addressing with linear probing over indices into the unique array
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<Vertex>   unique;
+    std::vector<uint32_t> table(TableSize(vertices.size()), EMPTY);
+    const size_t          mask = table.size() - 1;
+    size_t                totalProbes = 0;
+
+    unique.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      size_t slot  = Hash(vertices[i]) & mask;
+      size_t probe = 0;
+
+      while (table[slot] != EMPTY && !Equal(unique[table[slot]], vertices[i])) {
+        slot = (slot + 1) & mask;
+        ++probe;
+      }
+
+      totalProbes += probe;
+      stats.maxProbeLength = std::max(stats.maxProbeLength, probe);
+
+      if (table[slot] == EMPTY) {
+        table[slot] = static_cast<uint32_t>(unique.size());
+        unique.push_back(vertices[i]);
+      }
+      else
+        ++stats.exactMerges;
+
+      remap[i] = table[slot];
+    }
+
+    stats.averageProbeLength = static_cast<float>(totalProbes) / vertices.size();
+
+    // 2. epsilon: each vertex either joins the first one close enough to it, or starts its own
+    if (options.positionEpsilon > 0.f) {
+      CellTable             cells(unique.size(), options.positionEpsilon);
+      std::vector<Vertex>   welded;
+      std::vector<uint32_t> nextInCell;
+      std::vector<uint32_t> weldRemap(unique.size());
+
+      welded.reserve(unique.size());
+      nextInCell.reserve(unique.size());
+
+      for (size_t u = 0; u < unique.size(); ++u) {
+        int32_t x, y, z;
+        cells.cellOf(unique[u].pos, x, y, z);
+
+        uint32_t found = EMPTY;
+        for (int32_t dx = -1; dx <= 1 && found == EMPTY; ++dx) {
+          for (int32_t dy = -1; dy <= 1 && found == EMPTY; ++dy) {
+            for (int32_t dz = -1; dz <= 1 && found == EMPTY; ++dz) {
+              for (uint32_t j = cells.find(x + dx, y + dy, z + dz).head; j != EMPTY; j = nextInCell[j]) {
+                if (Close(welded[j], unique[u], options)) {
+                  found = j;
+                  break;
+                }
+              }
+            }
+          }
+        }
+
+        if (found != EMPTY) {
+          weldRemap[u] = found;
+          ++stats.epsilonMerges;
+          continue;
+        }
+
+        auto& cell = cells.find(x, y, z);
+        if (cell.head == EMPTY) {
+          cell.x = x;
+          cell.y = y;
+          cell.z = z;
+        }
+
+        weldRemap[u] = static_cast<uint32_t>(welded.size());
+        nextInCell.push_back(cell.head);
+        cell.head = weldRemap[u];
+        welded.push_back(unique[u]);
+      }
+
+      for (auto& index : remap)
+        index = weldRemap[index];
+
+      unique = std::move(welded);
+    }
+
+    // 3. indices
+    if (options.removeDegenerates && indices.size() % 3 == 0) {
+      size_t out = 0;
+      for (size_t i = 0; i < indices.size(); i += 3) {
+        const uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        const uint32_t ra = remap[a], rb = remap[b], rc = remap[c];
+
+        // only triangles that welding collapsed; ones that came in degenerate are left alone
+        const bool wasDegenerate = a == b || b == c || a == c;
+        if (!wasDegenerate && (ra == rb || rb == rc || ra == rc)) {
+          ++stats.degeneratesRemoved;
+          continue;
+        }
+
+        indices[out++] = ra;
+        indices[out++] = rb;
+        indices[out++] = rc;
+      }
+
+      indices.resize(out);
+    }
+    else {
+      for (auto& index : indices)
+        index = remap[index];
+    }
+
+    vertices             = std::move(unique);
+    stats.outputVertices = vertices.size();
+    return stats;
+  }
+
+  std::ostream& operator<<(std::ostream& os, WeldStats const& stats) {
+    os << stats.inputVertices << " -> " << stats.outputVertices << " vertices ("
+      << stats.exactMerges << " exact, " << stats.epsilonMerges << " epsilon merges";
+
+    if (stats.degeneratesRemoved)
+      os << ", " << stats.degeneratesRemoved << " collapsed triangles removed";
+
+    return os << "; probe avg " << stats.averageProbeLength << ", max " << stats.maxProbeLength << ")";
+  }
+}
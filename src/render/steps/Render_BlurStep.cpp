@@ -14,10 +14,19 @@
 #include "render/RenderSteps.h"
 #include <stdexcept>
 #include <array>
+#include <cstddef>
 
 namespace dw {
   static constexpr uint32_t KERNEL_SIZE = 15;
 
+  // blur_x.comp & blur_y.comp's push constants
+  struct BlurPush {
+    std::array<float, KERNEL_SIZE> weights;
+    alignas(16) glm::ivec4 tile; //!< xy: corner, zw: size, in atlas texels
+  };
+
+  static_assert(offsetof(BlurPush, tile) == 64, "The blur shaders expect the tile at offset 64");
+
   BlurStep::BlurStep(LogicalDevice& device, CommandPool& pool)
     : RenderStep(device),
       m_cmdBuff(pool.allocateCommandBuffer()) {
@@ -70,7 +79,7 @@ namespace dw {
     VkPushConstantRange range = {
       VK_SHADER_STAGE_COMPUTE_BIT,
       0,
-      sizeof(float) * KERNEL_SIZE
+      sizeof(BlurPush)
     };
 
     VkPipelineLayoutCreateInfo layoutCreate = {
@@ -119,11 +128,11 @@ namespace dw {
       -1
     };
 
-    if (vkCreateComputePipelines(getOwningDevice(), nullptr, 1, &createInfo, nullptr, &m_compute_x) != VK_SUCCESS)
+    if (vkCreateComputePipelines(getOwningDevice(), getOwningDevice().getPipelineCache(), 1, &createInfo, nullptr, &m_compute_x) != VK_SUCCESS)
       throw std::runtime_error("Could not create compute blur X pipeline");
 
     createInfo.stage.module = m_blur_y->getCreateInfo().module;
-    if (vkCreateComputePipelines(getOwningDevice(), nullptr, 1, &createInfo, nullptr, &m_compute_y) != VK_SUCCESS)
+    if (vkCreateComputePipelines(getOwningDevice(), getOwningDevice().getPipelineCache(), 1, &createInfo, nullptr, &m_compute_y) != VK_SUCCESS)
       throw std::runtime_error("Could not create compute blur Y pipeline");
   }
 
@@ -160,7 +169,7 @@ namespace dw {
     std::vector<VkDescriptorPoolSize> poolSizes = {
       {
         VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-        4 * GlobalLightStep::MAX_GLOBAL_LIGHTS
+        4
       }
     };
 
@@ -168,7 +177,7 @@ namespace dw {
       VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
       nullptr,
       VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
-      2 * GlobalLightStep::MAX_GLOBAL_LIGHTS,
+      2,
       static_cast<uint32_t>(poolSizes.size()),
       poolSizes.data()
     };
@@ -239,47 +248,47 @@ namespace dw {
   }
 
   void BlurStep::writeCmdBuff(std::vector<Renderer::ShadowMappedLight> const& lights,
+                              DependentImage const&                           atlasImg,
+                              ImageView&                                      atlasView,
                               DependentImage&                                 intermediateImg,
-                              ImageView&                                      intermediaryView) {
-    assert(lights.size() <= GlobalLightStep::MAX_GLOBAL_LIGHTS);
+                              ImageView&                                      intermediaryView,
+                              VkQueryPool                                     timestamps) {
+    assert(lights.size() <= GlobalLightStep::MAX_SHADOW_MAPS);
 
-    if(!m_descriptorSets.empty())
-      vkFreeDescriptorSets(getOwningDevice(), m_descriptorPool, m_descriptorSets.size() * 2, &m_descriptorSets.front().x);
+    // one pair for the whole atlas: x reads it into the intermediate, y writes it back
+    if (m_descriptorSets.empty()) {
+      m_descriptorSets.resize(1);
 
-    m_descriptorSets.clear();
-    m_descriptorSets.resize(lights.size());
-
-    std::vector<VkDescriptorSetLayout> layouts = {
-      2 * lights.size(),
-      m_descSetLayout
-    };
-    VkDescriptorSetAllocateInfo descSetAllocInfo = {
-      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-      nullptr,
-      m_descriptorPool,
-      2 * lights.size(),
-      layouts.data()
-    };
-
-    // note: because m_descriptorSet_y comes right after m_descriptorSet_x, then the allocation for 2
-    // puts the second into _y
-    // and also all of these descriptors are nice and packed :)
-    VkResult result = vkAllocateDescriptorSets(getOwningDevice(),
-      &descSetAllocInfo,
-      &m_descriptorSets.front().x);
-    switch (result) {
-    case VK_ERROR_OUT_OF_POOL_MEMORY:
-      throw std::runtime_error("Could not allocate blur descriptor sets: Out of pool memory");
-    case VK_ERROR_OUT_OF_HOST_MEMORY:
-      throw std::runtime_error("Could not allocate blur descriptor sets: out of host memory");
-    case VK_ERROR_FRAGMENTED_POOL:
-      throw std::runtime_error("Could not allocate blur descriptor sets: fragmented pool");
-    case VK_ERROR_OUT_OF_DEVICE_MEMORY:
-      throw std::runtime_error("Could not allocate blur descriptor sets: out of device memory");
-    default: break;
+      std::array<VkDescriptorSetLayout, 2> layouts = {m_descSetLayout, m_descSetLayout};
+      VkDescriptorSetAllocateInfo descSetAllocInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        nullptr,
+        m_descriptorPool,
+        static_cast<uint32_t>(layouts.size()),
+        layouts.data()
+      };
+
+      // note: because y comes right after x, the allocation for 2 puts the second into y
+      VkResult result = vkAllocateDescriptorSets(getOwningDevice(),
+        &descSetAllocInfo,
+        &m_descriptorSets.front().x);
+      switch (result) {
+      case VK_ERROR_OUT_OF_POOL_MEMORY:
+        throw std::runtime_error("Could not allocate blur descriptor sets: Out of pool memory");
+      case VK_ERROR_OUT_OF_HOST_MEMORY:
+        throw std::runtime_error("Could not allocate blur descriptor sets: out of host memory");
+      case VK_ERROR_FRAGMENTED_POOL:
+        throw std::runtime_error("Could not allocate blur descriptor sets: fragmented pool");
+      case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+        throw std::runtime_error("Could not allocate blur descriptor sets: out of device memory");
+      default: break;
+      }
     }
 
-    std::array<float, KERNEL_SIZE> weights{{0}};
+    auto& descriptors = m_descriptorSets.front();
+    updateDescriptorSets(descriptors, atlasView, intermediaryView, atlasView);
+
+    BlurPush push{};
 
     float weightSum = 0.f;
     for (uint32_t i = 0; i < KERNEL_SIZE; ++i) {
@@ -287,14 +296,21 @@ namespace dw {
       constexpr int w = KERNEL_SIZE / 2;
       int           x = i - w;
       float         s = x / (static_cast<float>(w) / 2);
-      weights[i]      = glm::exp(-.5f * s * s);
-      weightSum += weights[i];
+      push.weights[i] = glm::exp(-.5f * s * s);
+      weightSum += push.weights[i];
     }
 
-    for (auto& w : weights) {
+    for (auto& w : push.weights) {
       w /= weightSum;
     }
 
+    // tiles that weren't drawn this frame are still blurred from when they were
+    std::vector<ShadowAtlas::Tile> tiles;
+    for (auto& light : lights) {
+      if (light.m_update != Renderer::ShadowMappedLight::Update::None && light.m_tile.size)
+        tiles.push_back(light.m_tile);
+    }
+
     VkImageMemoryBarrier barrier = {
       VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
       nullptr,
@@ -316,11 +332,18 @@ namespace dw {
 
     std::array<VkImageMemoryBarrier, 2> barriers{barrier, barrier};
 
-    barriers[0].image = intermediateImg;
+    barriers[0].image     = intermediateImg;
+    barriers[1].image     = atlasImg;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
     auto& cmdBuff = m_cmdBuff.get();
     cmdBuff.start(false);
 
+    if (timestamps) {
+      vkCmdResetQueryPool(cmdBuff, timestamps, 0, 2);
+      vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, 0);
+    }
+
     vkCmdPipelineBarrier(cmdBuff,
                          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
@@ -329,101 +352,55 @@ namespace dw {
                          nullptr,
                          0,
                          nullptr,
-                         1,
-                         &barriers[0]);
-    // ey broski, you were in the middle of making another compute pipeline to do the Y blur :>
+                         static_cast<uint32_t>(barriers.size()),
+                         barriers.data());
+
+    auto dispatchTiles = [&](VkPipeline pipeline, VkDescriptorSet set, bool alongX) {
+      vkCmdBindPipeline(cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+      vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &set, 0, nullptr);
+
+      for (auto const& tile : tiles) {
+        push.tile = {static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y),
+                     static_cast<int32_t>(tile.size), static_cast<int32_t>(tile.size)};
+        vkCmdPushConstants(cmdBuff, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+
+        uint32_t groups = (tile.size + 127) / 128;
+        vkCmdDispatch(cmdBuff, alongX ? groups : tile.size, alongX ? tile.size : groups, 1);
+      }
+    };
+
+    dispatchTiles(m_compute_x, descriptors.x, true);
+
+    // the intermediate's written, the atlas is done being read
     barriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-    barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    vkCmdPipelineBarrier(cmdBuff,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(barriers.size()),
+                         barriers.data());
 
-    const auto size = intermediateImg.getSize();
-    for (size_t i = 0; i < lights.size(); ++i) {
-      auto& light       = lights.at(i);
-      auto& view        = light.m_depthBuffer->getImageViews().front();
-      auto& image       = light.m_depthBuffer->getImages().front();
-      auto& descriptors = m_descriptorSets.at(i);
-      updateDescriptorSets(descriptors, view, intermediaryView, view);
-      barriers[1].image = image;
-
-      vkCmdBindPipeline(cmdBuff,
-                        VK_PIPELINE_BIND_POINT_COMPUTE,
-                        m_compute_x);
-      vkCmdBindDescriptorSets(cmdBuff,
-                              VK_PIPELINE_BIND_POINT_COMPUTE,
-                              m_layout,
-                              0,
-                              1,
-                              &descriptors.x,
-                              0,
-                              nullptr);
-      vkCmdPipelineBarrier(cmdBuff,
-                           VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                           0,
-                           0,
-                           nullptr,
-                           0,
-                           nullptr,
-                           1,
-                           &barriers[1]);
-      vkCmdPushConstants(cmdBuff,
-                         m_layout,
-                         VK_SHADER_STAGE_COMPUTE_BIT,
+    dispatchTiles(m_compute_y, descriptors.y, false);
+
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(cmdBuff,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
                          0,
-                         sizeof(float) * KERNEL_SIZE,
-                         weights.data());
-      vkCmdDispatch(cmdBuff,
-                    (size.width / 128) + size.width % 128,
-                    size.height,
-                    1);
-
-      barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-      vkCmdPipelineBarrier(cmdBuff,
-                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                           0,
-                           0,
-                           nullptr,
-                           0,
-                           nullptr,
-                           static_cast<uint32_t>(barriers.size()),
-                           barriers.data());
-
-      vkCmdBindPipeline(cmdBuff,
-                        VK_PIPELINE_BIND_POINT_COMPUTE,
-                        m_compute_y);
-      vkCmdBindDescriptorSets(cmdBuff,
-                              VK_PIPELINE_BIND_POINT_COMPUTE,
-                              m_layout,
-                              0,
-                              1,
-                              &descriptors.y,
-                              0,
-                              nullptr);
-      vkCmdPushConstants(cmdBuff,
-                         m_layout,
-                         VK_SHADER_STAGE_COMPUTE_BIT,
                          0,
-                         sizeof(float) * KERNEL_SIZE,
-                         weights.data());
-      vkCmdDispatch(cmdBuff,
-                    size.width,
-                    (size.height / 128) + size.height % 128,
-                    1);
-
-      barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      vkCmdPipelineBarrier(cmdBuff,
-                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                           VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                           0,
-                           0,
-                           nullptr,
-                           0,
-                           nullptr,
-                           1,
-                           &barriers[1]);
-      barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
-    }
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barriers[1]);
+
+    if (timestamps)
+      vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, 1);
 
     cmdBuff.end();
   }
@@ -19,13 +19,21 @@
 #include "render/Image.h"
 
 #include <stdexcept>
+#include <algorithm>
 #include <array>
 #include "util/Trace.h"
 
 namespace dw {
-  GeometryStep::GeometryStep(LogicalDevice& device, CommandPool& pool)
+  GeometryStep::GeometryStep(LogicalDevice& device,
+                             CommandPool&   pool,
+                             bool           bindless,
+                             uint32_t       textureSlots,
+                             GBufferLayout  layout)
     : RenderStep(device),
-      m_cmdBuff(pool.allocateCommandBuffer()) {
+      m_cmdBuff(pool.allocateCommandBuffer()),
+      m_bindless(bindless),
+      m_textureSlots(textureSlots),
+      m_gbufferLayout(layout) {
   }
 
   GeometryStep::GeometryStep(GeometryStep&& o) noexcept
@@ -33,7 +41,10 @@ namespace dw {
       m_vertexShader(std::move(o.m_vertexShader)),
       m_fragmentShader(std::move(o.m_fragmentShader)),
       m_cmdBuff(o.m_cmdBuff),
-      m_descriptorSet(o.m_descriptorSet) {
+      m_descriptorSet(o.m_descriptorSet),
+      m_bindless(o.m_bindless),
+      m_textureSlots(o.m_textureSlots),
+      m_gbufferLayout(o.m_gbufferLayout) {
     o.m_vertexShader   = nullptr;
     o.m_fragmentShader = nullptr;
     o.m_descriptorSet  = nullptr;
@@ -43,16 +54,18 @@ namespace dw {
     return m_cmdBuff;
   }
 
-  void GeometryStep::writeCmdBuff(Framebuffer&               fb,
-                                  Scene::ObjContainer const& scene,
-                                  uint32_t                   alignment,
-                                  VkRect2D                   renderArea) const {
+  void GeometryStep::writeCmdBuff(Framebuffer&         fb,
+                                  GeometryArena const& arena,
+                                  Buffer const&        indirect,
+                                  uint32_t             firstDraw,
+                                  uint32_t             drawCount,
+                                  VkRect2D             renderArea) const {
     // 1: deferred pass
     if (renderArea.extent.width == 0) {
       renderArea.extent = fb.getExtent();
     }
 
-    if (!scene.empty()) {
+    if (drawCount) {
       std::array<VkClearValue, NUM_EXPECTED_GBUFFER_IMAGES + 1> clearValues{};
       clearValues.back().depthStencil = {1.f, 0};
 
@@ -75,8 +88,9 @@ namespace dw {
       };
 
       vkCmdBindPipeline(commandBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pipeline);
+      setViewport(commandBuff, renderArea, true);
 
-      renderScene(commandBuff, beginInfo, scene, alignment, m_layout, m_descriptorSet);
+      renderScene(commandBuff, beginInfo, arena, indirect, firstDraw, drawCount, m_layout, m_descriptorSet);
 
       commandBuff.end();
     }
@@ -84,54 +98,65 @@ namespace dw {
   }
 
   void GeometryStep::setupDescriptors() {
-    std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
-    layoutBindings.resize(3 + Material::MTL_MAP_COUNT);
-    layoutBindings[0] = {
-      0,
-      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-      1,
-      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-      nullptr
+    // 0: camera, 1: objects, 2: materials, 3: texture table, 4: shader control
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings = {
+      {
+        0,
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        1,
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        nullptr
+      },
+      {
+        1,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1,
+        VK_SHADER_STAGE_VERTEX_BIT,
+        nullptr
+      },
+      {
+        2,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1,
+        VK_SHADER_STAGE_FRAGMENT_BIT,
+        nullptr
+      },
+      {
+        3,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        m_textureSlots,
+        VK_SHADER_STAGE_FRAGMENT_BIT,
+        nullptr
+      },
+      {
+        4,
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        1,
+        VK_SHADER_STAGE_FRAGMENT_BIT,
+        nullptr
+      }
     };
 
-    layoutBindings[1] = {
-      1,
-      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-      1,
-      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-      nullptr
+    // only the texture table is partially bound & updatable after binding
+    std::array<VkDescriptorBindingFlagsEXT, 5> bindingFlags = {
+      0,
+      0,
+      0,
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT,
+      0
     };
 
-    layoutBindings[2] = {
-      2,
-      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-      1,
-      VK_SHADER_STAGE_FRAGMENT_BIT,
-      nullptr
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+      nullptr,
+      static_cast<uint32_t>(bindingFlags.size()),
+      bindingFlags.data()
     };
 
-    for (uint32_t i = 3; i < Material::MTL_MAP_COUNT + 3; ++i) {
-      layoutBindings[i] = {
-        i,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        MAX_MATERIALS,
-        VK_SHADER_STAGE_FRAGMENT_BIT,
-        nullptr
-      };
-    }
-
-    layoutBindings.push_back({
-                               static_cast<uint32_t>(layoutBindings.size()),
-                               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                               1,
-                               VK_SHADER_STAGE_FRAGMENT_BIT,
-                               nullptr
-                             });
-
     VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {
       VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-      nullptr,
-      0, // VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR for push descriptor
+      m_bindless ? &bindingFlagsInfo : nullptr,
+      m_bindless ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT : 0u,
       static_cast<uint32_t>(layoutBindings.size()),
       layoutBindings.data()
     };
@@ -143,26 +168,25 @@ namespace dw {
     ///////////////////////////////////////////////////////
     // POOL AND SETS
 
-    // create uniform buffers - one for each swapchain image
     std::vector<VkDescriptorPoolSize> poolSizes = {
       {
         VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        2 + 1 // + shader control
+        1 + 1 // + shader control
       },
       {
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-        1
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        2
       },
       {
         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        MAX_MATERIALS * Material::MTL_MAP_COUNT
+        m_textureSlots
       }
     };
 
     VkDescriptorPoolCreateInfo poolCreateInfo = {
       VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
       nullptr,
-      0,
+      m_bindless ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0u,
       1,
       static_cast<uint32_t>(poolSizes.size()),
       poolSizes.data()
@@ -203,100 +227,139 @@ namespace dw {
       throw std::runtime_error("Could not allocate descriptor sets");
   }
 
-  void GeometryStep::updateDescriptorSets(Buffer&                  modelUBO,
-                                          Buffer&                  cameraUBO,
-                                          Buffer&                  mtlUBO,
-                                          Buffer&                  shaderControlUBO,
-                                          MaterialManager::MtlMap& materials,
-                                          VkSampler                sampler) const {
+  void GeometryStep::updateDescriptorSets(Buffer& cameraUBO,
+                                          Buffer& objectBuffer,
+                                          Buffer& materialBuffer,
+                                          Buffer& shaderControlUBO) const {
     // Descriptor sets are automatically freed once the pool is freed.
     // They can be individually freed if the pool was created with
     // VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT sets
-    VkDescriptorBufferInfo modelUBOinfo = modelUBO.getDescriptorInfo();
-    modelUBOinfo.range                  = sizeof(ObjectUniform);
+    std::array<VkWriteDescriptorSet, 4> descriptorWrites = {{
+      {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        nullptr,
+        m_descriptorSet,
+        0,
+        0,
+        1,
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        nullptr,
+        &cameraUBO.getDescriptorInfo(),
+        nullptr
+      },
+      {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        nullptr,
+        m_descriptorSet,
+        1,
+        0,
+        1,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        nullptr,
+        &objectBuffer.getDescriptorInfo(),
+        nullptr
+      },
+      {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        nullptr,
+        m_descriptorSet,
+        2,
+        0,
+        1,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        nullptr,
+        &materialBuffer.getDescriptorInfo(),
+        nullptr
+      },
+      {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        nullptr,
+        m_descriptorSet,
+        4,
+        0,
+        1,
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        nullptr,
+        &shaderControlUBO.getDescriptorInfo(),
+        nullptr
+      }
+    }};
+
+    vkUpdateDescriptorSets(getOwningDevice(),
+                           static_cast<uint32_t>(descriptorWrites.size()),
+                           descriptorWrites.data(),
+                           0,
+                           nullptr);
+  }
+
+  void GeometryStep::updateTextureTable(TextureManager::TexMap const& textures,
+                                        VkSampler                     sampler,
+                                        VkImageView                   defaultTexture) const {
+    std::vector<VkDescriptorImageInfo> imageInfos(m_textureSlots);
+    std::vector<bool>                  written(m_textureSlots, false);
+
+    for (auto& tex : textures) {
+      if (!tex.second->getView())
+        continue;
 
-    std::vector<VkDescriptorImageInfo> imageInfos;
-    std::vector<VkWriteDescriptorSet>  descriptorWrites;
-    imageInfos.resize(MAX_MATERIALS * Material::MTL_MAP_COUNT);
-    descriptorWrites.reserve(MAX_MATERIALS * Material::MTL_MAP_COUNT + 3);
+      uint32_t slot = tex.second->getSlot();
+      if (slot >= m_textureSlots)
+        throw std::runtime_error("Could not fit texture " + tex.first + " in the texture table");
 
-    for (auto& mtl : materials) {
-      auto& textures = mtl.second->getTextures();
+      imageInfos[slot] = {sampler, VkImageView(*tex.second->getView()), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+      written[slot]    = true;
+    }
 
-      for (uint32_t i = 0; i < Material::MTL_MAP_COUNT; ++i) {
-        imageInfos[i * MAX_MATERIALS + mtl.second->getID()].sampler     = sampler;
-        imageInfos[i * MAX_MATERIALS + mtl.second->getID()].imageView   = VkImageView(*textures[i]->getView());
-        imageInfos[i * MAX_MATERIALS + mtl.second->getID()].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+    if (m_bindless) {
+      // partially bound: only the slots in use are written, one write per run of them
+      for (uint32_t slot = 0; slot < m_textureSlots;) {
+        if (!written[slot]) {
+          ++slot;
+          continue;
+        }
+
+        uint32_t end = slot;
+        while (end < m_textureSlots && written[end])
+          ++end;
+
+        descriptorWrites.push_back({
+                                     VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                     nullptr,
+                                     m_descriptorSet,
+                                     3,
+                                     slot,
+                                     end - slot,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     &imageInfos[slot],
+                                     nullptr,
+                                     nullptr
+                                   });
+        slot = end;
       }
     }
+    else {
+      // every slot has to hold something valid, even with no textures loaded
+      for (uint32_t slot = 0; slot < m_textureSlots; ++slot) {
+        if (!written[slot])
+          imageInfos[slot] = {sampler, defaultTexture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+      }
 
-    descriptorWrites.push_back({
-                                 VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                                 nullptr,
-                                 m_descriptorSet,
-                                 0,
-                                 0,
-                                 1,
-                                 VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                 nullptr,
-                                 &cameraUBO.getDescriptorInfo(),
-                                 nullptr
-                               });
-
-    descriptorWrites.push_back({
-                                 VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                                 nullptr,
-                                 m_descriptorSet,
-                                 1,
-                                 0,
-                                 1,
-                                 VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-                                 nullptr,
-                                 &modelUBOinfo,
-                                 nullptr
-                               });
-
-    descriptorWrites.push_back({
-                                 VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                                 nullptr,
-                                 m_descriptorSet,
-                                 2,
-                                 0,
-                                 1,
-                                 VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                 nullptr,
-                                 &mtlUBO.getDescriptorInfo(),
-                                 nullptr
-                               });
-
-    for (uint32_t i = 0; i < Material::MTL_MAP_COUNT; ++i) {
       descriptorWrites.push_back({
                                    VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                                    nullptr,
                                    m_descriptorSet,
-                                   i + 3,
+                                   3,
                                    0,
-                                   MAX_MATERIALS,
+                                   m_textureSlots,
                                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                   &imageInfos[i * MAX_MATERIALS],
+                                   imageInfos.data(),
                                    nullptr,
                                    nullptr
                                  });
     }
 
-    descriptorWrites.push_back({
-                                 VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                                 nullptr,
-                                 m_descriptorSet,
-                                 7,
-                                 0,
-                                 1,
-                                 VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                 nullptr,
-                                 &shaderControlUBO.getDescriptorInfo(),
-                                 nullptr
-                               });
-
     vkUpdateDescriptorSets(getOwningDevice(),
                            static_cast<uint32_t>(descriptorWrites.size()),
                            descriptorWrites.data(),
@@ -304,15 +367,22 @@ namespace dw {
                            nullptr);
   }
 
+  bool GeometryStep::isBindless() const {
+    return m_bindless;
+  }
+
   void GeometryStep::setupShaders() {
     m_vertexShader = util::make_ptr<Shader<ShaderStage::Vertex>>(
                                                                  ShaderModule::Load(getOwningDevice(),
                                                                                     "object_pass_vert.spv"));
     m_fragmentShader = util::make_ptr<Shader<ShaderStage::Fragment>>(
                                                                      ShaderModule::Load(getOwningDevice(),
-                                                                                        "gbuffer_filler_frag.spv"));
+                                                                                        m_bindless
+                                                                                          ? "gbuffer_filler_bindless_frag.spv"
+                                                                                          : "gbuffer_filler_frag.spv"));
   }
 
+  // Viewport & scissor are dynamic and set in writeCmdBuff, with y up; extent only fills in the defaults
   void GeometryStep::setupPipeline(VkExtent2D extent) {
     GraphicsPipelineCreator creator;
     creator.setVertexType(Vertex::GetBindingDescriptions(), Vertex::GetBindingAttributes());
@@ -331,6 +401,8 @@ namespace dw {
                          extent
                        });
 
+    creator.setDynamicStates({VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+
     creator.setFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE);
     creator.setDepthTesting(true);
 
@@ -349,7 +421,13 @@ namespace dw {
     std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments{GBUFFER_IMAGE_COUNT, colorAttachmentInfo};
     creator.setAttachments(colorBlendAttachments);
 
-    creator.setShaderStages({m_vertexShader->getCreateInfo(), m_fragmentShader->getCreateInfo()});
+    VkBool32             compactGBuffer = m_gbufferLayout == GBufferLayout::Compact;
+    VkSpecializationInfo layoutSpec     = {1, &GBUFFER_LAYOUT_ENTRY, sizeof(VkBool32), &compactGBuffer};
+
+    auto fragmentStage                = m_fragmentShader->getCreateInfo();
+    fragmentStage.pSpecializationInfo = &layoutSpec;
+
+    creator.setShaderStages({m_vertexShader->getCreateInfo(), fragmentStage});
 
     m_pipeline = util::make_ptr<GraphicsPipeline>(
                                                   creator.finishCreate(getOwningDevice(), m_layout, *m_pass, 0, true)
@@ -374,9 +452,10 @@ namespace dw {
       m_pass->addAttachmentRef(i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, RenderPass::arfColor);
     }
 
+    // kept & left readable, the compact layout rebuilds positions from it
     m_pass->addAttachment(images.back().get().getAttachmentDesc(VK_ATTACHMENT_LOAD_OP_CLEAR,
-                                                                VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                                                                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL));
+                                                                VK_ATTACHMENT_STORE_OP_STORE,
+                                                                VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL));
     m_pass->addAttachmentRef(NUM_GBUFFER_IMAGES,
                              VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
                              RenderPass::arfDepthStencil);
@@ -395,9 +474,10 @@ namespace dw {
     m_pass->addSubpassDependency({
                                    0,
                                    VK_SUBPASS_EXTERNAL,
-                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
                                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                                   VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                   VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                                   | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
                                    VK_ACCESS_MEMORY_READ_BIT,
                                    VK_DEPENDENCY_BY_REGION_BIT
                                  });
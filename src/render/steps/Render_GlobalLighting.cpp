@@ -22,9 +22,10 @@
 #include <array>
 
 namespace dw {
-  GlobalLightStep::GlobalLightStep(LogicalDevice& device, CommandPool& pool)
+  GlobalLightStep::GlobalLightStep(LogicalDevice& device, CommandPool& pool, GBufferLayout layout)
     : RenderStep(device),
-      m_cmdBuff(pool.allocateCommandBuffer()) {
+      m_cmdBuff(pool.allocateCommandBuffer()),
+      m_gbufferLayout(layout) {
   }
 
   GlobalLightStep::GlobalLightStep(GlobalLightStep&& o) noexcept
@@ -32,7 +33,8 @@ namespace dw {
       m_vertexShader(std::move(o.m_vertexShader)),
       m_fragmentShader(std::move(o.m_fragmentShader)),
       m_cmdBuff(o.m_cmdBuff),
-      m_descriptorSet(o.m_descriptorSet) {
+      m_descriptorSet(o.m_descriptorSet),
+      m_gbufferLayout(o.m_gbufferLayout) {
     o.m_vertexShader   = nullptr;
     o.m_fragmentShader = nullptr;
     o.m_descriptorSet  = nullptr;
@@ -43,10 +45,7 @@ namespace dw {
   }
 
   void GlobalLightStep::setupShaders() {
-    m_vertexShader = util::make_ptr<Shader<ShaderStage::Vertex>>(
-                                                                 ShaderModule::Load(getOwningDevice(),
-                                                                                    "fsq_vert.spv"
-                                                                                   ));
+    m_vertexShader = LoadShader<ShaderStage::Vertex>(getOwningDevice(), "fsq_vert.spv");
 
 
     m_fragmentShader = util::make_ptr<Shader<ShaderStage::Fragment>>(
@@ -58,12 +57,14 @@ namespace dw {
   static constexpr uint32_t ADDITIONAL_TEXTURE_BINDINGS =
     1 +   // background texture
     1 +   // irradiance texture
-    1;    // shadow map array
+    1 +   // shadow atlas
+    1;    // shadow atlas's summed-area table
 
   static constexpr uint32_t ADDITIONAL_TEXTURES =
     1 + // background
     1 + // irradiance
-    GlobalLightStep::MAX_GLOBAL_LIGHTS;
+    1 + // shadow atlas
+    1;  // summed-area table
 
   static constexpr uint32_t ADDITIONAL_BUFFERS =
     1 + // camera
@@ -76,7 +77,7 @@ namespace dw {
   void GlobalLightStep::setupDescriptors() {
     std::vector<VkDescriptorSetLayoutBinding> finalBindings;
     finalBindings.resize(
-      NUM_EXPECTED_GBUFFER_IMAGES + ADDITIONAL_ITEMS); // shadow map array
+      NUM_SAMPLED_GBUFFER_IMAGES + ADDITIONAL_ITEMS);
 
     for (uint32_t i = 0; i < ADDITIONAL_BUFFERS; ++i) {
       finalBindings[i] = {
@@ -88,7 +89,7 @@ namespace dw {
       };
     }
 
-    for (uint32_t i = ADDITIONAL_BUFFERS; i < NUM_EXPECTED_GBUFFER_IMAGES + ADDITIONAL_ITEMS; ++i) {
+    for (uint32_t i = ADDITIONAL_BUFFERS; i < NUM_SAMPLED_GBUFFER_IMAGES + ADDITIONAL_ITEMS; ++i) {
       finalBindings[i] = {
         i,
         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -98,8 +99,6 @@ namespace dw {
       };
     }
 
-    finalBindings.back().descriptorCount = MAX_GLOBAL_LIGHTS;
-
     VkDescriptorSetLayoutCreateInfo finalLayoutCreate = {
       VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
       nullptr,
@@ -119,7 +118,7 @@ namespace dw {
       },
       {
         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        NUM_EXPECTED_GBUFFER_IMAGES + ADDITIONAL_TEXTURES
+        NUM_SAMPLED_GBUFFER_IMAGES + ADDITIONAL_TEXTURES
       }
     };
 
@@ -196,6 +195,8 @@ namespace dw {
       throw std::runtime_error("Could not create global light pipeline layout");
   }
 
+  // The viewport & scissor are set as it's recorded, so it outlives a resize; extent only fills in
+  // the defaults
   void GlobalLightStep::setupPipeline(VkExtent2D extent) {
     GraphicsPipelineCreator creator;
 
@@ -227,7 +228,15 @@ namespace dw {
                          extent
                        });
 
-    creator.setShaderStages({m_vertexShader->getCreateInfo(), m_fragmentShader->getCreateInfo()});
+    creator.setDynamicStates({VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+
+    VkBool32             compactGBuffer = m_gbufferLayout == GBufferLayout::Compact;
+    VkSpecializationInfo layoutSpec     = {1, &GBUFFER_LAYOUT_ENTRY, sizeof(VkBool32), &compactGBuffer};
+
+    auto fragmentStage                = m_fragmentShader->getCreateInfo();
+    fragmentStage.pSpecializationInfo = &layoutSpec;
+
+    creator.setShaderStages({m_vertexShader->getCreateInfo(), fragmentStage});
 
     m_pipeline = util::make_ptr<GraphicsPipeline>(
                                                   creator.finishCreate(getOwningDevice(), m_layout, *m_pass, 0, true)
@@ -235,7 +244,8 @@ namespace dw {
   }
 
   void GlobalLightStep::updateDescriptorSets(std::vector<ImageView> const&                   gbufferViews,
-                                             std::vector<Renderer::ShadowMappedLight> const& lights,
+                                             ImageView&                                      shadowAtlas,
+                                             ImageView&                                      shadowSAT,
                                              ImageView& backgroundImg,
                                              ImageView& irradianceImg,
                                              Buffer&                                         cameraUBO,
@@ -246,13 +256,15 @@ namespace dw {
     std::vector<VkWriteDescriptorSet>  descriptorWrites;
     std::vector<VkDescriptorImageInfo> imageInfos;
 
-    descriptorWrites.reserve(NUM_EXPECTED_GBUFFER_IMAGES + 2 + 1 + 2);
-    imageInfos.reserve(NUM_EXPECTED_GBUFFER_IMAGES + ADDITIONAL_TEXTURES);
+    descriptorWrites.reserve(NUM_SAMPLED_GBUFFER_IMAGES + 2 + 1 + 2);
+    imageInfos.reserve(NUM_SAMPLED_GBUFFER_IMAGES + ADDITIONAL_TEXTURES);
 
-    assert(gbufferViews.size() == NUM_EXPECTED_GBUFFER_IMAGES + 1); // + depth buffer
+    assert(gbufferViews.size() == NUM_SAMPLED_GBUFFER_IMAGES); // + depth buffer
     for (uint32_t i = 0; i < NUM_EXPECTED_GBUFFER_IMAGES; ++i)
       imageInfos.push_back({sampler, gbufferViews[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
 
+    imageInfos.push_back({sampler, gbufferViews.back(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL});
+
     imageInfos.push_back({
                              sampler,
                              backgroundImg,
@@ -265,13 +277,18 @@ namespace dw {
                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
       });
 
-    assert(lights.size() <= MAX_GLOBAL_LIGHTS);
-    for (uint32_t i = 0; i < lights.size(); ++i)
-      imageInfos.push_back({
-                             sampler,
-                             lights[i].m_depthBuffer->getImageViews().front(),
-                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                           });   
+    imageInfos.push_back({
+                           sampler,
+                           shadowAtlas,
+                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                         });
+
+    // only ever fetched; the summed-area pass keeps it in GENERAL
+    imageInfos.push_back({
+                           sampler,
+                           shadowSAT,
+                           VK_IMAGE_LAYOUT_GENERAL
+                         });
 
     descriptorWrites.push_back({
                                  VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -327,7 +344,7 @@ namespace dw {
                                  nullptr
       });
 
-    for (uint32_t i = 0; i < NUM_EXPECTED_GBUFFER_IMAGES + ADDITIONAL_TEXTURE_BINDINGS; ++i) {
+    for (uint32_t i = 0; i < NUM_SAMPLED_GBUFFER_IMAGES + ADDITIONAL_TEXTURE_BINDINGS; ++i) {
       descriptorWrites.push_back({
                                    VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                                    nullptr,
@@ -342,9 +359,6 @@ namespace dw {
                                  });
     }
 
-    descriptorWrites.back().descriptorCount = static_cast<uint32_t>(lights.size());
-    descriptorWrites.back().pImageInfo = &imageInfos[NUM_EXPECTED_GBUFFER_IMAGES + 2];
-    
     vkUpdateDescriptorSets(getOwningDevice(),
                            static_cast<uint32_t>(descriptorWrites.size()),
                            descriptorWrites.data(),
@@ -352,7 +366,7 @@ namespace dw {
                            nullptr);
   }
 
-  void GlobalLightStep::writeCmdBuff(Framebuffer& fb, VkRect2D renderArea) const {
+  void GlobalLightStep::writeCmdBuff(Framebuffer& fb, VkRect2D renderArea, VkQueryPool timestamps) const {
     if (renderArea.extent.width == 0)
       renderArea.extent = fb.getExtent();
 
@@ -373,7 +387,14 @@ namespace dw {
     };
 
     cmdBuff.start(false);
+
+    if (timestamps) {
+      vkCmdResetQueryPool(cmdBuff, timestamps, 2, 2);
+      vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, 2);
+    }
+
     vkCmdBindPipeline(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pipeline);
+    setViewport(cmdBuff, renderArea);
     vkCmdBindDescriptorSets(cmdBuff,
                             VK_PIPELINE_BIND_POINT_GRAPHICS,
                             m_layout,
@@ -386,6 +407,10 @@ namespace dw {
     vkCmdBeginRenderPass(cmdBuff, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
     vkCmdDraw(cmdBuff, 4, 1, 0, 0);
     vkCmdEndRenderPass(cmdBuff);
+
+    if (timestamps)
+      vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, 3);
+
     cmdBuff.end();
   }
 }
@@ -24,8 +24,8 @@
 #include "app/ImGui.h"
 
 namespace dw {
-  LocalLightingStep::LocalLightingStep(LogicalDevice& device, CommandPool& pool)
-    : RenderStep(device), m_cmdBuff(pool.allocateCommandBuffer()) {}
+  LocalLightingStep::LocalLightingStep(LogicalDevice& device, GBufferLayout layout)
+    : RenderStep(device), m_gbufferLayout(layout) {}
    /* m_imageCount(numSwapchainImages) {
     m_cmdBuffs.reserve(m_imageCount);
     for (size_t i = 0; i < m_imageCount; ++i) {
@@ -38,18 +38,15 @@ namespace dw {
     m_vertexShader(std::move(o.m_vertexShader)),
     m_fragmentShader(std::move(o.m_fragmentShader)),
     m_descriptorSet(std::move(o.m_descriptorSet)),
-    m_cmdBuff(o.m_cmdBuff)
+    m_subpass(o.m_subpass),
+    m_gbufferLayout(o.m_gbufferLayout)
   {
     o.m_descriptorSet = nullptr;
   }
 
-  CommandBuffer& LocalLightingStep::getCommandBuffer() {
-    return m_cmdBuff;
-  }
-
   void LocalLightingStep::setupDescriptors() {
-    // one sampler per gbuffer image + one sampler for previous image
-    uint32_t numSampledImages = NUM_EXPECTED_GBUFFER_IMAGES + 1;
+    // one sampler per gbuffer image & depth + one input attachment for previous image
+    uint32_t numSampledImages = NUM_SAMPLED_GBUFFER_IMAGES + 1;
 
     std::vector<VkDescriptorSetLayoutBinding> finalBindings;
     finalBindings.resize(numSampledImages + 3);
@@ -83,8 +80,10 @@ namespace dw {
       };
     }
 
+    finalBindings[numSampledImages + 1].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+
     finalBindings.back() = {
-      6,
+      numSampledImages + 2,
       VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
       1,
       VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -110,7 +109,11 @@ namespace dw {
       },
       {
         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        /*numImages */ numSampledImages
+        /*numImages */ numSampledImages - 1
+      },
+      {
+        VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+        1
       }
     };
 
@@ -156,46 +159,20 @@ namespace dw {
   }
 
   void LocalLightingStep::setupShaders() {
-    m_vertexShader = util::make_ptr<Shader<ShaderStage::Vertex>
-    >(ShaderModule::Load(getOwningDevice(), "fsq_vert.spv"));
+    m_vertexShader = LoadShader<ShaderStage::Vertex>(getOwningDevice(), "fsq_vert.spv");
     m_fragmentShader = util::make_ptr<Shader<ShaderStage::Fragment>>(ShaderModule::Load(getOwningDevice(),
       "local_lighting_frag.spv"));
   }
 
-  void LocalLightingStep::setupRenderPass(std::vector<util::Ref<Image>> const& images) {
-    assert(images.size() == 1);
-
-    m_pass = util::make_ptr<RenderPass>(getOwningDevice());
-    m_pass->addAttachment(images[0].get().getAttachmentDesc(VK_ATTACHMENT_LOAD_OP_CLEAR,
-      VK_ATTACHMENT_STORE_OP_STORE,
-      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
-    m_pass->addAttachmentRef(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, RenderPass::arfColor);
-
-    m_pass->finishSubpass();
-
-    m_pass->addSubpassDependency({
-                                   VK_SUBPASS_EXTERNAL,
-                                   0,
-                                   VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                   VK_ACCESS_MEMORY_WRITE_BIT,
-                                   VK_ACCESS_SHADER_READ_BIT,
-                                   0
-      });
-
-    m_pass->addSubpassDependency({
-                                   0,
-                                   VK_SUBPASS_EXTERNAL,
-                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                   VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                                   VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                   VK_ACCESS_MEMORY_READ_BIT,
-                                   VK_DEPENDENCY_BY_REGION_BIT
-      });
+  void LocalLightingStep::setupRenderPass(std::vector<util::Ref<Image>> const&) {
+  }
 
-    m_pass->finishRenderPass();
+  void LocalLightingStep::setupRenderPass(util::ptr<RenderPass> const& pass, uint32_t subpass) {
+    m_pass    = pass;
+    m_subpass = subpass;
   }
 
+  // The viewport & scissor are set by FinalStep as it records the render pass
   void LocalLightingStep::setupPipeline(VkExtent2D extent) {
     GraphicsPipelineCreator creator;
     creator.addAttachment({
@@ -224,58 +201,23 @@ namespace dw {
                          extent
       });
 
+    creator.setDynamicStates({VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+
     creator.setFrontFace(VK_FRONT_FACE_CLOCKWISE);
-    creator.setShaderStages({ m_vertexShader->getCreateInfo(), m_fragmentShader->getCreateInfo() });
+    VkBool32             compactGBuffer = m_gbufferLayout == GBufferLayout::Compact;
+    VkSpecializationInfo layoutSpec     = {1, &GBUFFER_LAYOUT_ENTRY, sizeof(VkBool32), &compactGBuffer};
+
+    auto fragmentStage                = m_fragmentShader->getCreateInfo();
+    fragmentStage.pSpecializationInfo = &layoutSpec;
+
+    creator.setShaderStages({ m_vertexShader->getCreateInfo(), fragmentStage });
 
     m_pipeline = util::make_ptr<GraphicsPipeline>(
-      creator.finishCreate(getOwningDevice(), m_layout, *m_pass, 0, true)
+      creator.finishCreate(getOwningDevice(), m_layout, *m_pass, m_subpass, true)
       );
   }
 
-  void LocalLightingStep::writeCmdBuff(Framebuffer& fb, Image const& previousImage, VkRect2D renderArea) {
-    if (renderArea.extent.width == 0)
-      renderArea.extent = fb.getExtent();
-
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = { {0, 0, 0, 0} };
-
-    auto& commandBuffer = m_cmdBuff.get();//s[i].get();
-
-    if (commandBuffer.canBeReset())
-      commandBuffer.reset();
-
-    VkRenderPassBeginInfo beginInfo = {
-      VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-      nullptr,
-      *m_pass,
-      fb,
-      renderArea,
-      static_cast<uint32_t>(clearValues.size()),
-      clearValues.data()
-    };
-
-    VkImageMemoryBarrier barrier = {
-      VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-      nullptr,
-      VK_ACCESS_MEMORY_WRITE_BIT,
-      VK_ACCESS_MEMORY_READ_BIT,
-      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-      VK_QUEUE_FAMILY_IGNORED,
-      VK_QUEUE_FAMILY_IGNORED,
-      previousImage,
-      {
-        VK_IMAGE_ASPECT_COLOR_BIT,
-        0,
-        1,
-        0,
-        1
-      }
-    };
-
-    commandBuffer.start(false);
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
-      1, &barrier);
+  void LocalLightingStep::writeSubpass(CommandBuffer& commandBuffer) const {
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pipeline);
     vkCmdBindDescriptorSets(commandBuffer,
       VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -285,11 +227,7 @@ namespace dw {
       &m_descriptorSet,
       0,
       nullptr);
-    vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
     vkCmdDraw(commandBuffer, 4, 1, 0, 0);
-    vkCmdEndRenderPass(commandBuffer);
-
-    commandBuffer.end();
   }
 
   void LocalLightingStep::updateDescriptorSets(std::vector<ImageView> const& gbufferViews,
@@ -298,20 +236,22 @@ namespace dw {
                                        Buffer& lightsUBO,
                                        Buffer& shaderControlUBO,
                                        VkSampler                     sampler) {
-    uint32_t numSampledImages = NUM_EXPECTED_GBUFFER_IMAGES + 1;
+    uint32_t numSampledImages = NUM_SAMPLED_GBUFFER_IMAGES + 1;
 
     std::vector<VkWriteDescriptorSet> descriptorWrites;
-    descriptorWrites.reserve(/*m_descriptorSets.size() */(NUM_EXPECTED_GBUFFER_IMAGES + 3));
+    descriptorWrites.reserve(/*m_descriptorSets.size() */(numSampledImages + 3));
     
     std::vector<VkDescriptorImageInfo> imageInfos;
     imageInfos.reserve(numSampledImages);
 
-    assert(gbufferViews.size() == NUM_EXPECTED_GBUFFER_IMAGES + 1); // + depth buffer
+    assert(gbufferViews.size() == NUM_SAMPLED_GBUFFER_IMAGES); // + depth buffer
     for (uint32_t i = 0; i < NUM_EXPECTED_GBUFFER_IMAGES; ++i) {
       imageInfos.push_back({ sampler, gbufferViews[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
     }
 
-    imageInfos.push_back({ sampler, previousImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+    imageInfos.push_back({ sampler, gbufferViews.back(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL });
+
+    imageInfos.push_back({ nullptr, previousImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
 
     //for (auto& set : m_descriptorSets) {
     descriptorWrites.push_back({
@@ -348,7 +288,8 @@ namespace dw {
                                    j + 2,
                                    0,
                                    1,
-                                   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                   j + 1 < numSampledImages ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                                            : VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
                                    &imageInfos[j],
                                    nullptr,
                                    nullptr
@@ -359,7 +300,7 @@ namespace dw {
                                  VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                                  nullptr,
                                  m_descriptorSet,
-                                 6,
+                                 numSampledImages + 2,
                                  0,
                                  1,
                                  VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
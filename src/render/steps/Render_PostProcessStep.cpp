@@ -39,33 +39,80 @@ namespace dw {
   }
 
   void FinalStep::setupRenderPass(std::vector<util::Ref<Image>> const& images) {
-    assert(images.size() == 1);
+    assert(images.size() == atCount);
 
+    // Only the swapchain's image is stored. Global lighting's comes in from its own pass, and
+    // nothing reads ambient's, so it never needs to leave the tile.
     m_pass = util::make_ptr<RenderPass>(getOwningDevice());
-    m_pass->addAttachment(images[0].get().getAttachmentDesc(VK_ATTACHMENT_LOAD_OP_CLEAR,
-                                                            VK_ATTACHMENT_STORE_OP_STORE,
-                                                            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
-    m_pass->addAttachmentRef(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, RenderPass::arfColor);
+    m_pass->addAttachment(images[atSwapchain].get().getAttachmentDesc(VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                                                      VK_ATTACHMENT_STORE_OP_STORE,
+                                                                      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
+    m_pass->addAttachment(images[atGlobalLit].get().getAttachmentDesc(VK_ATTACHMENT_LOAD_OP_LOAD,
+                                                                      VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                                                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                                      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+    m_pass->addAttachment(images[atLocalLit].get().getAttachmentDesc(VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                                                     VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                                                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+    m_pass->addAttachment(images[atAmbient].get().getAttachmentDesc(VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                                                    VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                                                                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+
+    // local lighting
+    m_pass->addInputRef(atGlobalLit, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    m_pass->addAttachmentRef(atLocalLit, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, RenderPass::arfColor);
+    m_pass->finishSubpass();
+
+    // ambient
+    m_pass->addAttachmentRef(atAmbient, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, RenderPass::arfColor);
+    m_pass->addPreserveRef(atLocalLit);
+    m_pass->finishSubpass();
 
+    // FXAA: local lighting's image is an input attachment for its own pixel, and sampled for the
+    // ones around it
+    m_pass->addInputRef(atLocalLit, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    m_pass->addAttachmentRef(atSwapchain, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, RenderPass::arfColor);
     m_pass->finishSubpass();
 
     m_pass->addSubpassDependency({
                                    VK_SUBPASS_EXTERNAL,
+                                   LOCAL_LIGHTING_SUBPASS,
+                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                   VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                   VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                   VK_DEPENDENCY_BY_REGION_BIT
+                                 });
+
+    // the swapchain image is first used here; its semaphore is waited on at attachment output
+    m_pass->addSubpassDependency({
+                                   VK_SUBPASS_EXTERNAL,
+                                   FXAA_SUBPASS,
+                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                                    0,
-                                   VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                   VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                   0
+                                 });
+
+    // not by region: FXAA samples the pixels around its own
+    m_pass->addSubpassDependency({
+                                   LOCAL_LIGHTING_SUBPASS,
+                                   FXAA_SUBPASS,
+                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                   VK_ACCESS_MEMORY_WRITE_BIT,
-                                   VK_ACCESS_SHADER_READ_BIT,
+                                   VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                   VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
                                    0
                                  });
 
 #ifdef DW_USE_IMGUI
-    m_pass->addAttachmentRef(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, RenderPass::arfColor);
+    m_pass->addAttachmentRef(atSwapchain, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, RenderPass::arfColor);
     m_pass->finishSubpass();
 
     m_pass->addSubpassDependency({
-                                   0,
-                                   1,
+                                   FXAA_SUBPASS,
+                                   IMGUI_SUBPASS,
                                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                                    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
@@ -74,7 +121,7 @@ namespace dw {
                                  });
 
     m_pass->addSubpassDependency({
-                                   1,
+                                   IMGUI_SUBPASS,
                                    VK_SUBPASS_EXTERNAL,
                                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
@@ -84,7 +131,7 @@ namespace dw {
                                  });
 #else
     m_pass->addSubpassDependency({
-                                   0,
+                                   FXAA_SUBPASS,
                                    VK_SUBPASS_EXTERNAL,
                                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
@@ -98,36 +145,45 @@ namespace dw {
   }
 
   void FinalStep::setupDescriptors() {
-    VkDescriptorSetLayoutBinding binding = {
-      0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-      1,
-      VK_SHADER_STAGE_FRAGMENT_BIT,
-      nullptr
-    };
+    // local lighting's image, sampled & as an input attachment
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {{
+      {
+        0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        1,
+        VK_SHADER_STAGE_FRAGMENT_BIT,
+        nullptr
+      },
+      {
+        1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+        1,
+        VK_SHADER_STAGE_FRAGMENT_BIT,
+        nullptr
+      }
+    }};
 
     VkDescriptorSetLayoutCreateInfo layoutCreate = {
       VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
       nullptr,
       0,
-      1,
-      &binding
+      static_cast<uint32_t>(bindings.size()),
+      bindings.data()
     };
 
     if (vkCreateDescriptorSetLayout(getOwningDevice(), &layoutCreate, nullptr, &m_descSetLayout) != VK_SUCCESS)
       throw std::runtime_error("Could not create post processing descriptor set layout");
 
-    VkDescriptorPoolSize poolSize = {
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-      m_imageCount
-    };
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+      { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_imageCount },
+      { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, m_imageCount }
+    }};
 
     VkDescriptorPoolCreateInfo poolCreate = {
       VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
       nullptr,
       0,
       m_imageCount,
-      1,
-      &poolSize
+      static_cast<uint32_t>(poolSizes.size()),
+      poolSizes.data()
     };
 
     if (vkCreateDescriptorPool(getOwningDevice(), &poolCreate, nullptr, &m_descriptorPool) != VK_SUCCESS)
@@ -148,6 +204,7 @@ namespace dw {
       throw std::runtime_error("Could not allocate post processing descriptor sets");
   }
 
+  // writeCmdBuff sets the viewport & scissor once for every subpass's pipeline, as they're all dynamic
   void FinalStep::setupPipeline(VkExtent2D extent) {
     GraphicsPipelineCreator creator;
     creator.addAttachment({
@@ -176,22 +233,25 @@ namespace dw {
                          extent
       });
 
+    creator.setDynamicStates({VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+
     creator.setFrontFace(VK_FRONT_FACE_CLOCKWISE);
     creator.setShaderStages({ m_vertexShader->getCreateInfo(), m_fragmentShader->getCreateInfo() });
 
     m_pipeline = util::make_ptr<GraphicsPipeline>(
-      creator.finishCreate(getOwningDevice(), m_layout, *m_pass, 0, true)
+      creator.finishCreate(getOwningDevice(), m_layout, *m_pass, FXAA_SUBPASS, true)
       );
   }
 
   void FinalStep::setupShaders() {
-    m_vertexShader = util::make_ptr<Shader<ShaderStage::Vertex>>(ShaderModule::Load(getOwningDevice(), "fsq_vert.spv"));
+    m_vertexShader = LoadShader<ShaderStage::Vertex>(getOwningDevice(), "fsq_vert.spv");
     m_fragmentShader = util::make_ptr<Shader<ShaderStage::Fragment>>(ShaderModule::Load(getOwningDevice(),
       "fxaa_frag.spv"));
   }
 
   void FinalStep::writeCmdBuff(std::vector<Framebuffer> const& fbs,
-                               Image const&                    previousImage,
+                               LocalLightingStep const&        localLighting,
+                               AmbientStep const&              ambient,
                                VkRect2D                        renderArea,
                                uint32_t                        image) {
     const auto count = m_imageCount;
@@ -199,8 +259,10 @@ namespace dw {
     if (renderArea.extent.width == 0)
       renderArea.extent = fbs.front().getExtent();
 
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = {{0, 0, 0, 0}};
+    // one per attachment; global & local lighting's aren't cleared
+    std::array<VkClearValue, atCount> clearValues{};
+    clearValues[atSwapchain].color = {{0, 0, 0, 0}};
+    clearValues[atAmbient].color   = {{0, 0, 0, 0}};
 
 
     auto writeCmdBuff = [&, this](uint32_t i, bool renderImGui) {
@@ -219,36 +281,15 @@ namespace dw {
         clearValues.data()
       };
 
-      VkImageMemoryBarrier barrier = {
-        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        nullptr,
-        VK_ACCESS_MEMORY_WRITE_BIT,
-        VK_ACCESS_MEMORY_READ_BIT,
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        VK_QUEUE_FAMILY_IGNORED,
-        VK_QUEUE_FAMILY_IGNORED,
-        previousImage,
-        {
-          VK_IMAGE_ASPECT_COLOR_BIT,
-          0,
-          1,
-          0,
-          1
-        }
-      };
-
       commandBuffer.start(false);
-      vkCmdPipelineBarrier(commandBuffer,
-                           VK_PIPELINE_STAGE_TRANSFER_BIT,
-                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                           0,
-                           0,
-                           nullptr,
-                           0,
-                           nullptr,
-                           1,
-                           &barrier);
+      vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+      setViewport(commandBuffer, renderArea);
+      localLighting.writeSubpass(commandBuffer);
+
+      vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+      ambient.writeSubpass(commandBuffer);
+
+      vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
       vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pipeline);
       vkCmdBindDescriptorSets(commandBuffer,
                               VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -258,7 +299,6 @@ namespace dw {
                               &m_descriptorSets[i],
                               0,
                               nullptr);
-      vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
       vkCmdDraw(commandBuffer, 4, 1, 0, 0);
 
 #ifdef DW_USE_IMGUI
@@ -285,15 +325,16 @@ namespace dw {
   void FinalStep::updateDescriptorSets(
     ImageView const& previousImage,
     VkSampler        sampler) {
-    uint32_t numSampledImages = 1;//NUM_EXPECTED_GBUFFER_IMAGES + 1;
+    uint32_t numSampledImages = 2;//NUM_EXPECTED_GBUFFER_IMAGES + 1;
 
     std::vector<VkWriteDescriptorSet> descriptorWrites;
-    descriptorWrites.reserve(m_descriptorSets.size() * (1));
+    descriptorWrites.reserve(m_descriptorSets.size() * (2));
 
     std::vector<VkDescriptorImageInfo> imageInfos;
     imageInfos.reserve(numSampledImages);
 
     imageInfos.push_back({sampler, previousImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+    imageInfos.push_back({nullptr, previousImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
 
     for (auto& set : m_descriptorSets) {
       /*descriptorWrites.push_back({
@@ -330,7 +371,8 @@ namespace dw {
                                      j,
                                      0,
                                      1,
-                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     j == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                            : VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
                                      &imageInfos[j],
                                      nullptr,
                                      nullptr
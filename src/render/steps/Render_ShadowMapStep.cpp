@@ -17,9 +17,11 @@
 #include "render/CommandBuffer.h"
 #include "render/Shader.h"
 #include "render/Image.h"
+#include "render/GeometryArena.h"
 
 #include <stdexcept>
 #include <array>
+#include <vector>
 
 namespace dw {
   ShadowMapStep::ShadowMapStep(LogicalDevice& device, CommandPool& pool)
@@ -32,7 +34,8 @@ namespace dw {
       m_vertexShader(std::move(o.m_vertexShader)),
       m_fragmentShader(std::move(o.m_fragmentShader)),
       m_cmdBuff(o.m_cmdBuff),
-      m_descriptorSet(o.m_descriptorSet) {
+      m_descriptorSet(o.m_descriptorSet),
+      m_staticPass(std::move(o.m_staticPass)) {
     o.m_vertexShader   = nullptr;
     o.m_fragmentShader = nullptr;
     o.m_descriptorSet  = nullptr;
@@ -40,29 +43,15 @@ namespace dw {
 
   void ShadowMapStep::setupPipelineLayout(VkPipelineLayout layout) {
     if (!layout) {
-      std::array<VkPushConstantRange, 2> push_constant_ranges = {
-        {
-          {
-            VK_SHADER_STAGE_VERTEX_BIT,
-            0,
-            sizeof(int)
-          },
-          {
-            VK_SHADER_STAGE_FRAGMENT_BIT,
-            sizeof(int),
-            sizeof(float) * 2
-          }
-        }
-      };
-
+      // which map each instance draws into comes from the route buffer, nothing is pushed
       VkPipelineLayoutCreateInfo pipeLayoutInfo = {
         VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         nullptr,
         0,
         1,
         &m_descSetLayout,
-        2,
-        push_constant_ranges.data()
+        0,
+        nullptr
       };
 
       vkCreatePipelineLayout(getOwningDevice(), &pipeLayoutInfo, nullptr, &m_layout);
@@ -79,60 +68,89 @@ namespace dw {
     // we dont want to pass any images to this renderpass setup, as we dont use any.
     // instead, we force the attachment descriptions.
     assert(images.size() == 0);
-    m_pass = util::make_ptr<RenderPass>(getOwningDevice());
 
-    m_pass->addAttachment({
+    // The two passes only differ in what happens to the attachments around them, which keeps
+    // them compatible: the pipeline & framebuffers are built against m_pass only. Each draws
+    // some tiles of an atlas, so neither may discard what's already in it; tiles that start
+    // over are cleared inside the pass.
+    auto makePass = [this](VkImageLayout      colorInitial,
+                           VkImageLayout      colorFinal,
+                           VkImageLayout      depthInitial,
+                           VkImageLayout      depthFinal) {
+      auto pass = util::make_ptr<RenderPass>(getOwningDevice());
+
+      pass->addAttachment({
                             0,
-                            VK_FORMAT_R32G32B32A32_SFLOAT,
+                            MOMENT_FORMAT,
                             VK_SAMPLE_COUNT_1_BIT,
-                            VK_ATTACHMENT_LOAD_OP_CLEAR,
+                            VK_ATTACHMENT_LOAD_OP_LOAD,
                             VK_ATTACHMENT_STORE_OP_STORE,
                             VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                             VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                            VK_IMAGE_LAYOUT_UNDEFINED,
-                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                            colorInitial,
+                            colorFinal
                           });
 
-    m_pass->addAttachment({
+      pass->addAttachment({
                             0,
                             VK_FORMAT_D24_UNORM_S8_UINT,
                             VK_SAMPLE_COUNT_1_BIT,
-                            VK_ATTACHMENT_LOAD_OP_CLEAR,
+                            VK_ATTACHMENT_LOAD_OP_LOAD,
                             VK_ATTACHMENT_STORE_OP_STORE,
                             VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                             VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                            VK_IMAGE_LAYOUT_UNDEFINED,
-                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                            depthInitial,
+                            depthFinal
                           });
 
-    m_pass->addAttachmentRef(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, RenderPass::arfColor);
-    m_pass->addAttachmentRef(1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, RenderPass::arfDepthStencil);
+      pass->addAttachmentRef(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, RenderPass::arfColor);
+      pass->addAttachmentRef(1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, RenderPass::arfDepthStencil);
 
-    m_pass->finishSubpass();
+      pass->finishSubpass();
 
-    m_pass->addSubpassDependency({
+      // the static layer is copied in before, and out after
+      pass->addSubpassDependency({
                                    VK_SUBPASS_EXTERNAL,
                                    0,
-                                   VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                   VK_ACCESS_MEMORY_READ_BIT,
-                                   VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                   VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+                                   | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                                   VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                                   VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                                   | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+                                   | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
                                    VK_DEPENDENCY_BY_REGION_BIT
                                  });
 
-    m_pass->addSubpassDependency({
+      pass->addSubpassDependency({
                                    0,
                                    VK_SUBPASS_EXTERNAL,
-                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                   VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                                   VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                   VK_ACCESS_MEMORY_READ_BIT,
+                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+                                   | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                   VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                                   | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                   VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
                                    VK_DEPENDENCY_BY_REGION_BIT
                                  });
 
-    m_pass->finishRenderPass();
+      pass->finishRenderPass();
+      return pass;
+    };
+
+    // the live atlas, after the static layers are copied in
+    m_pass = makePass(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+    m_staticPass = makePass(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
   }
 
+  // The viewport & scissor are set to the atlas as it's drawn, extent only fills in the defaults
   void ShadowMapStep::setupPipeline(VkExtent2D extent) {
     GraphicsPipelineCreator creator;
     creator.setVertexType(Vertex::GetBindingDescriptions(), Vertex::GetBindingAttributes());
@@ -151,6 +169,8 @@ namespace dw {
                          extent
                        });
 
+    creator.setDynamicStates({VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+
     creator.setFrontFace(VK_FRONT_FACE_CLOCKWISE);
     creator.setDepthTesting(true);
 
@@ -190,12 +210,19 @@ namespace dw {
         0,
         VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
         1,
-        VK_SHADER_STAGE_VERTEX_BIT,
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
         nullptr
       },
-      { // model
+      { // objects
         1,
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1,
+        VK_SHADER_STAGE_VERTEX_BIT,
+        nullptr
+      },
+      { // routes
+        2,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
         1,
         VK_SHADER_STAGE_VERTEX_BIT,
         nullptr
@@ -224,8 +251,8 @@ namespace dw {
         1
       },
       {
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-        1
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        2
       }
     };
 
@@ -262,56 +289,171 @@ namespace dw {
   }
 
   void ShadowMapStep::writeCmdBuff(std::vector<Renderer::ShadowMappedLight> const& lights,
-                                   Scene::ObjContainer const&                      scene,
-                                   uint32_t                                        alignment,
-                                   VkRect2D                                        renderArea) const {
-
-    if (!lights.empty()) {
-      auto& cmdBuff = m_cmdBuff.get();
+                                   Framebuffer const&                              atlas,
+                                   Framebuffer const&                              staticAtlas,
+                                   GeometryArena const&                            arena,
+                                   Buffer const&                                   indirect,
+                                   uint32_t                                        firstDraw,
+                                   uint32_t                                        staticCount,
+                                   uint32_t                                        drawCount) const {
+    using Update = Renderer::ShadowMappedLight::Update;
+
+    if (lights.empty())
+      return;
+
+    auto& cmdBuff = m_cmdBuff.get();
+    cmdBuff.start(false);
+
+    // What each pass starts over in, & what's copied between them
+    std::vector<VkClearRect> staticClears, liveClears;
+    std::vector<VkImageCopy> colorCopies, depthCopies;
+
+    for (auto const& light : lights) {
+      auto const& tile = light.m_tile;
+      if (light.m_update == Update::None || !tile.size)
+        continue;
+
+      VkRect2D rect = {{static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y)}, {tile.size, tile.size}};
+
+      if (light.m_update == Update::Uncached) {
+        liveClears.push_back({rect, 0, 1});
+        continue;
+      }
 
-      cmdBuff.start(false);
+      if (light.m_update == Update::Full)
+        staticClears.push_back({rect, 0, 1});
+
+      for (auto* copies : {&colorCopies, &depthCopies}) {
+        VkImageAspectFlags aspect = copies == &colorCopies ? VK_IMAGE_ASPECT_COLOR_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+        copies->push_back({
+                            {aspect, 0, 0, 1},
+                            {rect.offset.x, rect.offset.y, 0},
+                            {aspect, 0, 0, 1},
+                            {rect.offset.x, rect.offset.y, 0},
+                            {tile.size, tile.size, 1}
+                          });
+      }
+    }
 
+    VkExtent2D extent   = atlas.getExtent();
+    VkRect2D   area     = {{0, 0}, extent};
+    VkViewport viewport = {0, 0, static_cast<float>(extent.width), static_cast<float>(extent.height), 0, 1.f};
 
-      // for each shadow mapped light
-      for (uint32_t i = 0; i < lights.size(); ++i) {
-        vkCmdBindPipeline(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pipeline);
-        auto& light = lights.at(i);
-        assert(light.m_depthBuffer);
+    // One pass over one atlas: the tiles in clears start over, then every mesh is drawn once,
+    // instanced over the maps it casts into
+    auto drawPass = [&](RenderPass const& pass, Framebuffer const& target, std::vector<VkClearRect> const& clears,
+                        uint32_t first, uint32_t count) {
+      VkRenderPassBeginInfo beginInfo = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        nullptr,
+        pass,
+        target,
+        area,
+        0,
+        nullptr
+      };
 
-        if (renderArea.extent.width == 0) {
-          renderArea.extent = light.m_depthBuffer->getExtent();
-        }
+      vkCmdBeginRenderPass(cmdBuff, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-        std::array<VkClearValue, 2> clearValues{};
-        clearValues.front().color       = {{0}};
-        clearValues.back().depthStencil = {1.f, 0};
-
-        // render the scene
-        VkRenderPassBeginInfo beginInfo = {
-          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-          nullptr,
-          *m_pass,
-          *light.m_depthBuffer,
-          renderArea,
-          static_cast<uint32_t>(clearValues.size()),
-          clearValues.data()
+      if (!clears.empty()) {
+        std::array<VkClearAttachment, 2> attachments = {
+          {
+            {VK_IMAGE_ASPECT_COLOR_BIT, 0, {}},
+            {VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 0, {}}
+          }
         };
-
-        float depths[2] = {light.m_light.getNear(), light.m_light.getFar()};
-        vkCmdPushConstants(cmdBuff, m_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(int), &i);
-        vkCmdPushConstants(cmdBuff, m_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(int), sizeof(float) * 2, depths);
-        // TODO: have the rendering of the scene be a secondary command buffer?
-        renderScene(cmdBuff, beginInfo, scene, alignment, m_layout, m_descriptorSet);
+        attachments.front().clearValue.color       = {{MOMENT_CLEAR, 0, 0, 0}}; // moments of depth 0, encoded
+        attachments.back().clearValue.depthStencil = {1.f, 0};
+
+        vkCmdClearAttachments(cmdBuff,
+                              static_cast<uint32_t>(attachments.size()),
+                              attachments.data(),
+                              static_cast<uint32_t>(clears.size()),
+                              clears.data());
       }
 
-      cmdBuff.end();
+      vkCmdBindPipeline(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pipeline);
+      vkCmdSetViewport(cmdBuff, 0, 1, &viewport);
+      vkCmdSetScissor(cmdBuff, 0, 1, &area);
+
+      arena.bind(cmdBuff);
+      vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layout, 0, 1, &m_descriptorSet, 0, nullptr);
+
+      vkCmdDrawIndexedIndirect(cmdBuff,
+                               indirect,
+                               VkDeviceSize(first) * sizeof(VkDrawIndexedIndirectCommand),
+                               count,
+                               sizeof(VkDrawIndexedIndirectCommand));
+
+      vkCmdEndRenderPass(cmdBuff);
+    };
+
+    if (!staticClears.empty())
+      drawPass(*m_staticPass, staticAtlas, staticClears, firstDraw, staticCount);
+
+    // The whole live atlas moves to TRANSFER_DST for the copies & the pass takes it back; naming
+    // the old layouts keeps every other tile intact
+    auto const& src = staticAtlas.getImages();
+    auto const& dst = atlas.getImages();
+
+    std::array<VkImageMemoryBarrier, 2> toTransfer{};
+    for (uint32_t img = 0; img < 2; ++img) {
+      toTransfer[img] = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        nullptr,
+        img == 0 ? VkAccessFlags(VK_ACCESS_SHADER_READ_BIT)
+                 : VkAccessFlags(VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT),
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        img == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        dst[img],
+        {
+          img == 0 ? VkImageAspectFlags(VK_IMAGE_ASPECT_COLOR_BIT)
+                   : VkImageAspectFlags(VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT),
+          0,
+          1,
+          0,
+          1
+        }
+      };
+    }
+
+    vkCmdPipelineBarrier(cmdBuff,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(toTransfer.size()),
+                         toTransfer.data());
+
+    if (!colorCopies.empty()) {
+      vkCmdCopyImage(cmdBuff,
+                     src[0],
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     dst[0],
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     static_cast<uint32_t>(colorCopies.size()),
+                     colorCopies.data());
+      vkCmdCopyImage(cmdBuff,
+                     src[1],
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     dst[1],
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     static_cast<uint32_t>(depthCopies.size()),
+                     depthCopies.data());
     }
-  }
 
-  void ShadowMapStep::updateDescriptorSets(Buffer& modelUBO, Buffer& lightsUBO) const {
-    VkDescriptorBufferInfo modelUBOinfo = modelUBO.getDescriptorInfo();
-    modelUBOinfo.range                  = sizeof(ObjectUniform);
+    drawPass(*m_pass, atlas, liveClears, firstDraw + staticCount, drawCount);
+
+    cmdBuff.end();
+  }
 
+  void ShadowMapStep::updateDescriptorSets(Buffer& lightsUBO, Buffer& objectBuffer, Buffer& routes) const {
     std::vector<VkWriteDescriptorSet> descriptorWrites = {
       {
         VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -332,9 +474,21 @@ namespace dw {
         1,
         0,
         1,
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        nullptr,
+        &objectBuffer.getDescriptorInfo(),
+        nullptr
+      },
+      {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        nullptr,
+        m_descriptorSet,
+        2,
+        0,
+        1,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
         nullptr,
-        &modelUBOinfo,
+        &routes.getDescriptorInfo(),
         nullptr
       }
     };
@@ -56,6 +56,7 @@ namespace dw {
     m_pass->finishRenderPass();
   }
 
+  // The viewport (flipped) & scissor are dynamic, set by writeCmdBuff, so a resize keeps the pipeline
   void SplashScreenStep::setupPipeline(VkExtent2D extent) {
     GraphicsPipelineCreator creator;
     creator.addAttachment({
@@ -85,6 +86,8 @@ namespace dw {
                          extent
       });
 
+    creator.setDynamicStates({VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+
     creator.setFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE);
     creator.setShaderStages({ m_vertexShader->getCreateInfo(), m_fragmentShader->getCreateInfo() });
 
@@ -181,6 +184,7 @@ namespace dw {
 
     commandBuffer.start(false);
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pipeline);
+    setViewport(commandBuffer, renderArea, true);
     vkCmdBindDescriptorSets(commandBuffer,
       VK_PIPELINE_BIND_POINT_GRAPHICS,
       m_layout,
@@ -232,8 +236,7 @@ namespace dw {
   }
 
   void SplashScreenStep::setupShaders() {
-    m_vertexShader = util::make_ptr<Shader<ShaderStage::Vertex>
-    >(ShaderModule::Load(getOwningDevice(), "fsq_vert.spv"));
+    m_vertexShader = LoadShader<ShaderStage::Vertex>(getOwningDevice(), "fsq_vert.spv");
     m_fragmentShader = util::make_ptr<Shader<ShaderStage::Fragment>>(ShaderModule::Load(getOwningDevice(),
                                                                                         "logo_display_frag.spv"));
   }
@@ -0,0 +1,320 @@
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * gproj : Render_SummedAreaStep.cpp
+// * Copyright (C) DigiPen Institute of Technology 2019
+// *
+// * Created     : 2020y 03m 12d
+// * Last Altered: 2020y 03m 12d
+// *
+// * Author      : David Walker
+// * E-mail      : d.walker\@digipen.edu
+// *
+// * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+// * Description :
+
+#include "render/RenderSteps.h"
+#include <stdexcept>
+#include <array>
+
+namespace dw {
+  // sat_x.comp & sat_y.comp's push constants
+  struct SummedAreaPush {
+    glm::ivec4 tile; //!< xy: corner, zw: size, in atlas texels
+  };
+
+  SummedAreaStep::SummedAreaStep(LogicalDevice& device, CommandPool& pool)
+    : RenderStep(device),
+      m_cmdBuff(pool.allocateCommandBuffer()) {
+  }
+
+  SummedAreaStep::SummedAreaStep(SummedAreaStep&& o) noexcept
+    : RenderStep(std::move(o)),
+      m_sat_x(std::move(o.m_sat_x)),
+      m_sat_y(std::move(o.m_sat_y)),
+      m_cmdBuff(o.m_cmdBuff),
+      m_compute_x(o.m_compute_x),
+      m_compute_y(o.m_compute_y),
+      m_descriptorSet(o.m_descriptorSet) {
+    o.m_sat_x.reset();
+    o.m_sat_y.reset();
+    o.m_compute_x     = nullptr;
+    o.m_compute_y     = nullptr;
+    o.m_descriptorSet = nullptr;
+  }
+
+  SummedAreaStep::~SummedAreaStep() {
+    if (m_compute_x) {
+      vkDestroyPipeline(getOwningDevice(), m_compute_x, nullptr);
+      m_compute_x = nullptr;
+    }
+
+    if (m_compute_y) {
+      vkDestroyPipeline(getOwningDevice(), m_compute_y, nullptr);
+      m_compute_y = nullptr;
+    }
+  }
+
+  void SummedAreaStep::setupShaders() {
+    m_sat_x = util::make_ptr<Shader<ShaderStage::Compute>>(ShaderModule::Load(getOwningDevice(), "sat_x_comp.spv"));
+    m_sat_y = util::make_ptr<Shader<ShaderStage::Compute>>(ShaderModule::Load(getOwningDevice(), "sat_y_comp.spv"));
+  }
+
+  void SummedAreaStep::setupRenderPass(std::vector<util::Ref<Image>> const&) {
+  }
+
+  void SummedAreaStep::setupPipelineLayout(VkPipelineLayout layout) {
+    VkPushConstantRange range = {
+      VK_SHADER_STAGE_COMPUTE_BIT,
+      0,
+      sizeof(SummedAreaPush)
+    };
+
+    VkPipelineLayoutCreateInfo layoutCreate = {
+      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      nullptr,
+      0,
+      1,
+      &m_descSetLayout,
+      1,
+      &range
+    };
+
+    if (vkCreatePipelineLayout(getOwningDevice(), &layoutCreate, nullptr, &m_layout) != VK_SUCCESS)
+      throw std::runtime_error("Could not create summed-area table pipeline layout");
+  }
+
+  void SummedAreaStep::setupPipeline(VkExtent2D extent) {
+    VkComputePipelineCreateInfo createInfo = {
+      VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      nullptr,
+      0,
+      {
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        nullptr,
+        0,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        m_sat_x->getCreateInfo().module,
+        "main",
+        nullptr
+      },
+      m_layout,
+      nullptr,
+      -1
+    };
+
+    if (vkCreateComputePipelines(getOwningDevice(), getOwningDevice().getPipelineCache(), 1, &createInfo, nullptr, &m_compute_x) != VK_SUCCESS)
+      throw std::runtime_error("Could not create summed-area table X pipeline");
+
+    createInfo.stage.module = m_sat_y->getCreateInfo().module;
+    if (vkCreateComputePipelines(getOwningDevice(), getOwningDevice().getPipelineCache(), 1, &createInfo, nullptr, &m_compute_y) != VK_SUCCESS)
+      throw std::runtime_error("Could not create summed-area table Y pipeline");
+  }
+
+  void SummedAreaStep::setupDescriptors() {
+    // 0: the atlas's moments, 1: the table. Both passes share the set; y only uses the table
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings = {
+      {
+        0,
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        1,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        nullptr
+      },
+      {
+        1,
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        1,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        nullptr
+      }
+    };
+
+    VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      nullptr,
+      0,
+      static_cast<uint32_t>(layoutBindings.size()),
+      layoutBindings.data()
+    };
+
+    if (vkCreateDescriptorSetLayout(getOwningDevice(), &layoutCreateInfo, nullptr, &m_descSetLayout) != VK_SUCCESS || !
+        m_descSetLayout)
+      throw std::runtime_error("Could not create descriptor set layout");
+
+    std::vector<VkDescriptorPoolSize> poolSizes = {
+      {
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        2
+      }
+    };
+
+    VkDescriptorPoolCreateInfo poolCreateInfo = {
+      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      nullptr,
+      0,
+      1,
+      static_cast<uint32_t>(poolSizes.size()),
+      poolSizes.data()
+    };
+
+    if (vkCreateDescriptorPool(getOwningDevice(), &poolCreateInfo, nullptr, &m_descriptorPool) != VK_SUCCESS || !
+        m_descriptorPool)
+      throw std::runtime_error("Could not create descriptor pool");
+
+    VkDescriptorSetAllocateInfo descSetAllocInfo = {
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      nullptr,
+      m_descriptorPool,
+      1,
+      &m_descSetLayout
+    };
+
+    if (vkAllocateDescriptorSets(getOwningDevice(), &descSetAllocInfo, &m_descriptorSet) != VK_SUCCESS)
+      throw std::runtime_error("Could not allocate summed-area table descriptor set");
+  }
+
+  CommandBuffer& SummedAreaStep::getCommandBuffer() const {
+    return m_cmdBuff;
+  }
+
+  void SummedAreaStep::updateDescriptorSet(ImageView& atlas, ImageView& table) const {
+    std::array<VkDescriptorImageInfo, 2> infos = {
+      VkDescriptorImageInfo{nullptr, atlas, VK_IMAGE_LAYOUT_GENERAL},
+      VkDescriptorImageInfo{nullptr, table, VK_IMAGE_LAYOUT_GENERAL}
+    };
+
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    for (uint32_t i = 0; i < writes.size(); ++i) {
+      writes[i] = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        nullptr,
+        m_descriptorSet,
+        i,
+        0,
+        1,
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        &infos[i],
+        nullptr,
+        nullptr
+      };
+    }
+
+    vkUpdateDescriptorSets(getOwningDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+  }
+
+  void SummedAreaStep::writeCmdBuff(std::vector<Renderer::ShadowMappedLight> const& lights,
+                                    DependentImage const&                           atlasImg,
+                                    ImageView&                                      atlasView,
+                                    DependentImage const&                           tableImg,
+                                    ImageView&                                      tableView,
+                                    VkQueryPool                                     timestamps) {
+    assert(lights.size() <= GlobalLightStep::MAX_SHADOW_MAPS);
+
+    updateDescriptorSet(atlasView, tableView);
+
+    // tiles that weren't drawn this frame still have their tables from when they were
+    std::vector<ShadowAtlas::Tile> tiles;
+    for (auto& light : lights) {
+      if (light.m_update != Renderer::ShadowMappedLight::Update::None && light.m_tile.size)
+        tiles.push_back(light.m_tile);
+    }
+
+    VkImageMemoryBarrier barrier = {
+      VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      nullptr,
+      VK_ACCESS_SHADER_READ_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT,
+      VK_IMAGE_LAYOUT_GENERAL,
+      VK_IMAGE_LAYOUT_GENERAL,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      tableImg,
+      {
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        0,
+        1,
+        0,
+        1
+      }
+    };
+
+    // the table was last read by global lighting; the atlas was just drawn
+    std::array<VkImageMemoryBarrier, 2> barriers{barrier, barrier};
+    barriers[1].image         = atlasImg;
+    barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[1].oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    auto& cmdBuff = m_cmdBuff.get();
+    cmdBuff.start(false);
+
+    if (timestamps) {
+      vkCmdResetQueryPool(cmdBuff, timestamps, 0, 2);
+      vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, 0);
+    }
+
+    vkCmdPipelineBarrier(cmdBuff,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(barriers.size()),
+                         barriers.data());
+
+    auto dispatchTiles = [&](VkPipeline pipeline, bool alongX) {
+      vkCmdBindPipeline(cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+      vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &m_descriptorSet, 0, nullptr);
+
+      // one group per row (or column), scanning the whole of it
+      for (auto const& tile : tiles) {
+        SummedAreaPush push = {
+          {static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y),
+           static_cast<int32_t>(tile.size), static_cast<int32_t>(tile.size)}
+        };
+        vkCmdPushConstants(cmdBuff, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+        vkCmdDispatch(cmdBuff, alongX ? 1 : tile.size, alongX ? tile.size : 1, 1);
+      }
+    };
+
+    dispatchTiles(m_compute_x, true);
+
+    // the rows are summed, the atlas is done being read
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[1].oldLayout     = VK_IMAGE_LAYOUT_GENERAL;
+    barriers[1].newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(cmdBuff,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(barriers.size()),
+                         barriers.data());
+
+    dispatchTiles(m_compute_y, false);
+
+    barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuff,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barriers[0]);
+
+    if (timestamps)
+      vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, 1);
+
+    cmdBuff.end();
+  }
+}